@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# Benchmarks, e.g. of the prediction path against the stand-in
+# network in src/main/misc/scripting/standinnetwork.py
+#
+#-------------------------------------------------
+
+TEMPLATE = app
+TARGET = 6D-PAT-benchmarks
+CONFIG += console
+CONFIG -= app_bundle
+
+include(./6dpatsources.pri)
+
+DEFINES += QT_DEPRECATED_WARNINGS
+# To find the stand-in network without passing its path
+DEFINES += SCRIPTING_PATH=\\\"$$PWD/src/main/misc/scripting\\\"
+
+HEADERS += \
+    $$PWD/src/benchmark/benchmarks.hpp \
+    $$PWD/src/benchmark/benchmarkdata.hpp
+
+SOURCES += \
+    $$PWD/src/benchmark/main.cpp \
+    $$PWD/src/benchmark/benchmarkdata.cpp \
+    $$PWD/src/benchmark/predictionbenchmark.cpp \
+    $$PWD/src/benchmark/rasterizerbenchmark.cpp
+
+DISTFILES = \
+    6dpatsources.pri
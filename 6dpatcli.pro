@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Command line tool that works on the annotations
+# without the user interface, e.g. on render nodes
+#
+#-------------------------------------------------
+
+TEMPLATE = app
+TARGET = 6D-PAT-cli
+CONFIG += console
+CONFIG -= app_bundle
+
+include(./6dpatsources.pri)
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    $$PWD/src/cli/main.cpp
+
+DISTFILES = \
+    6dpatsources.pri
@@ -11,9 +11,18 @@ INCLUDEPATH += $$PWD/src/main \
     /usr/local/include/opencv \
     /usr/include/assimp
 
-LIBS += -L/usr/local/lib/ -lopencv_core -lopencv_calib3d \
+LIBS += -L/usr/local/lib/ -lopencv_core -lopencv_imgproc -lopencv_calib3d -lopencv_videoio \
         -L/usr/lib/ -lassimp
 
+# Writes the 16 bit masks of the ground truth renderer, QImage can't before Qt 5.13
+lessThan(QT_MAJOR_VERSION, 6):lessThan(QT_MINOR_VERSION, 13): LIBS += -lopencv_imgcodecs
+
+# shm_open lives in librt on glibc before 2.34
+unix:!macx: LIBS += -lrt
+
+# Inflates the members of zip shards
+LIBS += -lz
+
 HEADERS  += \
     $$PWD/src/main/controller/maincontroller.hpp \
     $$PWD/src/main/model/cachingmodelmanager.hpp \
@@ -40,20 +49,49 @@ HEADERS  += \
     $$PWD/src/main/view/poseviewer/rendering/poseviewerglwidget.hpp \
     $$PWD/src/main/view/poseviewer/rendering/clickvisualizationoverlay.hpp \
     $$PWD/src/main/view/poseviewer/rendering/poserenderable.hpp \
+    $$PWD/src/main/view/poseviewer/rendering/texturepool.hpp \
     $$PWD/src/main/view/poseeditor/poseeditor.hpp \
     $$PWD/src/main/view/poseeditor/rendering/poseeditorglwidget.hpp \
     $$PWD/src/main/view/poseeditor/rendering/objectmodelrenderable.hpp \
     $$PWD/src/main/misc/generalhelper.h \
+    $$PWD/src/main/misc/cancellationtoken.hpp \
+    $$PWD/src/main/misc/npyfile.hpp \
+    $$PWD/src/main/misc/directoryindexer.hpp \
+    $$PWD/src/main/misc/posessnapshot.hpp \
+    $$PWD/src/main/misc/geometry/mesh.hpp \
+    $$PWD/src/main/misc/geometry/cpurasterizer.hpp \
+    $$PWD/src/main/misc/geometry/kdtree.hpp \
+    $$PWD/src/main/misc/geometry/bvh.hpp \
+    $$PWD/src/main/misc/geometry/pnpsolver.hpp \
+    $$PWD/src/main/misc/geometry/multiviewpnpsolver.hpp \
+    $$PWD/src/main/misc/geometry/poserefiner.hpp \
+    $$PWD/src/main/misc/evaluation/poseevaluator.hpp \
+    $$PWD/src/main/misc/evaluation/posequalityscorer.hpp \
+    $$PWD/src/main/misc/evaluation/visibilitycomputer.hpp \
+    $$PWD/src/main/misc/evaluation/penetrationchecker.hpp \
+    $$PWD/src/main/misc/imageloading/imageprefetcher.hpp \
+    $$PWD/src/main/misc/imageloading/imagepyramid.hpp \
+    $$PWD/src/main/misc/imageloading/imagepyramidcache.hpp \
+    $$PWD/src/main/misc/imageloading/imagesource.hpp \
+    $$PWD/src/main/misc/imageloading/directoryimagesource.hpp \
+    $$PWD/src/main/misc/imageloading/archiveimagesource.hpp \
+    $$PWD/src/main/misc/imageloading/videoimagesource.hpp \
     $$PWD/src/main/view/gallery/rendering/offscreenrenderer.hpp \
+    $$PWD/src/main/view/groundtruth/groundtruthrenderer.hpp \
     $$PWD/src/main/controller/neuralnetworkcontroller.hpp \
     $$PWD/src/main/view/settings/settingsnetworkpage.hpp \
-    $$PWD/src/main/controller/neuralnetworkrunnable.hpp \
+    $$PWD/src/main/controller/networkoutputparser.hpp \
+    $$PWD/src/main/controller/inferencejob.hpp \
+    $$PWD/src/main/controller/sharedmemoryimagetransport.hpp \
     $$PWD/src/main/view/neuralnetworkdialog/neuralnetworkdialog.hpp \
     $$PWD/src/main/view/gallery/resizeimagesrunnable.h \
     $$PWD/src/main/view/neuralnetworkprogressview/networkprogressview.hpp \
     $$PWD/src/main/settings/settings.hpp \
     $$PWD/src/main/settings/settingsstore.hpp \
-    $$PWD/src/main/controller/poserecoverer.hpp
+    $$PWD/src/main/controller/poserecoverer.hpp \
+    $$PWD/src/main/controller/posepropagator.hpp \
+    $$PWD/src/main/controller/poseinterpolator.hpp \
+    $$PWD/src/main/controller/multiviewpropagator.hpp
 
 SOURCES += \
     $$PWD/src/main/view/mainwindow.cpp \
@@ -80,20 +118,49 @@ SOURCES += \
     $$PWD/src/main/view/poseviewer/rendering/poseviewerglwidget.cpp \
     $$PWD/src/main/view/poseviewer/rendering/poserenderable.cpp \
     $$PWD/src/main/view/poseviewer/rendering/clickvisualizationoverlay.cpp \
+    $$PWD/src/main/view/poseviewer/rendering/texturepool.cpp \
     $$PWD/src/main/view/poseeditor/poseeditor.cpp \
     $$PWD/src/main/view/poseeditor/rendering/poseeditorglwidget.cpp \
     $$PWD/src/main/view/poseeditor/rendering/objectmodelrenderable.cpp \
     $$PWD/src/main/misc/generalhelper.cpp \
+    $$PWD/src/main/misc/cancellationtoken.cpp \
+    $$PWD/src/main/misc/npyfile.cpp \
+    $$PWD/src/main/misc/directoryindexer.cpp \
+    $$PWD/src/main/misc/posessnapshot.cpp \
+    $$PWD/src/main/misc/geometry/mesh.cpp \
+    $$PWD/src/main/misc/geometry/cpurasterizer.cpp \
+    $$PWD/src/main/misc/geometry/kdtree.cpp \
+    $$PWD/src/main/misc/geometry/bvh.cpp \
+    $$PWD/src/main/misc/geometry/pnpsolver.cpp \
+    $$PWD/src/main/misc/geometry/multiviewpnpsolver.cpp \
+    $$PWD/src/main/misc/geometry/poserefiner.cpp \
+    $$PWD/src/main/misc/evaluation/poseevaluator.cpp \
+    $$PWD/src/main/misc/evaluation/posequalityscorer.cpp \
+    $$PWD/src/main/misc/evaluation/visibilitycomputer.cpp \
+    $$PWD/src/main/misc/evaluation/penetrationchecker.cpp \
+    $$PWD/src/main/misc/imageloading/imageprefetcher.cpp \
+    $$PWD/src/main/misc/imageloading/imagepyramid.cpp \
+    $$PWD/src/main/misc/imageloading/imagepyramidcache.cpp \
+    $$PWD/src/main/misc/imageloading/imagesource.cpp \
+    $$PWD/src/main/misc/imageloading/directoryimagesource.cpp \
+    $$PWD/src/main/misc/imageloading/archiveimagesource.cpp \
+    $$PWD/src/main/misc/imageloading/videoimagesource.cpp \
     $$PWD/src/main/view/misc/displayhelper.cpp \
     $$PWD/src/main/view/gallery/rendering/offscreenrenderer.cpp \
+    $$PWD/src/main/view/groundtruth/groundtruthrenderer.cpp \
     $$PWD/src/main/controller/neuralnetworkcontroller.cpp \
-    $$PWD/src/main/controller/neuralnetworkrunnable.cpp \
+    $$PWD/src/main/controller/networkoutputparser.cpp \
+    $$PWD/src/main/controller/inferencejob.cpp \
+    $$PWD/src/main/controller/sharedmemoryimagetransport.cpp \
     $$PWD/src/main/view/neuralnetworkdialog/neuralnetworkdialog.cpp \
     $$PWD/src/main/view/gallery/resizeimagesrunnable.cpp \
     $$PWD/src/main/view/neuralnetworkprogressview/networkprogressview.cpp \
     $$PWD/src/main/settings/settings.cpp \
     $$PWD/src/main/settings/settingsstore.cpp \
-    $$PWD/src/main/controller/poserecoverer.cpp
+    $$PWD/src/main/controller/poserecoverer.cpp \
+    $$PWD/src/main/controller/posepropagator.cpp \
+    $$PWD/src/main/controller/poseinterpolator.cpp \
+    $$PWD/src/main/controller/multiviewpropagator.cpp
 
 FORMS    += \
     $$PWD/src/main/view/mainwindow.ui \
@@ -1,18 +1,30 @@
-#include(./OtiatSources.pri)
+include(./6dpatsources.pri)
 include(./gtest_dependency.pri)
 
 TEMPLATE = app
 CONFIG += console c++11
 CONFIG -= app_bundle
 CONFIG += thread
-CONFIG -= qt
 
 TARGET = OtiatTests
 
 SOURCES += \
     $$PWD/src/test/testmain.cpp
 
-HEADERS +=     $$PWD/src/test/tst_modeltests.h
+HEADERS += \
+    $$PWD/src/test/tst_modeltests.h \
+    $$PWD/src/test/tst_jsonloadandstorestrategytests.h \
+    $$PWD/src/test/tst_archivetests.h \
+    $$PWD/src/test/tst_videoimagesourcetests.h \
+    $$PWD/src/test/tst_directoryindexertests.h \
+    $$PWD/src/test/testscene.h \
+    $$PWD/src/test/tst_geometrytests.h \
+    $$PWD/src/test/tst_poserefinertests.h \
+    $$PWD/src/test/tst_posepropagatortests.h \
+    $$PWD/src/test/tst_poseinterpolatortests.h \
+    $$PWD/src/test/tst_posequalityscorertests.h \
+    $$PWD/src/test/tst_visibilitycomputertests.h \
+    $$PWD/src/test/tst_penetrationcheckertests.h
 
 DISTFILES = \
-    OtiatSources.pri
+    6dpatsources.pri
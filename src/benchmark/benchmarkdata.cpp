@@ -0,0 +1,80 @@
+#include "benchmarkdata.hpp"
+
+#include <QColor>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <math.h>
+
+namespace BenchmarkData {
+
+    bool createImages(const QDir &imagesDir, int numberOfImages, const QSize &size) {
+        if (!imagesDir.mkpath(".")) {
+            return false;
+        }
+        QJsonObject info;
+        QJsonArray cameraMatrix;
+        cameraMatrix << FOCAL_LENGTH << 0.0 << size.width() / 2.0
+                     << 0.0 << FOCAL_LENGTH << size.height() / 2.0
+                     << 0.0 << 0.0 << 1.0;
+        for (int i = 0; i < numberOfImages; i++) {
+            QString name = QString("%1.png").arg(i, 6, 10, QChar('0'));
+            QImage image(size, QImage::Format_RGB888);
+            image.fill(QColor::fromHsv((i * 7) % 360, 120, 200));
+            if (!image.save(imagesDir.filePath(name))) {
+                return false;
+            }
+            QJsonObject parameters;
+            parameters["K"] = cameraMatrix;
+            info[name] = parameters;
+        }
+        return writeJson(imagesDir.filePath("info.json"), QJsonDocument(info).toJson());
+    }
+
+    bool createSphere(const QString &path, float radius, int stacks, int slices) {
+        QFile file(path);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            return false;
+        }
+        QTextStream out(&file);
+        int vertexCount = (stacks + 1) * slices;
+        out << "ply\nformat ascii 1.0\n"
+            << "element vertex " << vertexCount << "\n"
+            << "property float x\nproperty float y\nproperty float z\n"
+            << "element face " << 2 * stacks * slices << "\n"
+            << "property list uchar int vertex_indices\nend_header\n";
+        for (int stack = 0; stack <= stacks; stack++) {
+            double theta = M_PI * stack / stacks;
+            for (int slice = 0; slice < slices; slice++) {
+                double phi = 2 * M_PI * slice / slices;
+                out << radius * sin(theta) * cos(phi) << " "
+                    << radius * sin(theta) * sin(phi) << " "
+                    << radius * cos(theta) << "\n";
+            }
+        }
+        for (int stack = 0; stack < stacks; stack++) {
+            for (int slice = 0; slice < slices; slice++) {
+                int a = stack * slices + slice;
+                int b = stack * slices + (slice + 1) % slices;
+                int c = a + slices;
+                int d = b + slices;
+                out << "3 " << a << " " << c << " " << b << "\n";
+                out << "3 " << b << " " << c << " " << d << "\n";
+            }
+        }
+        return out.status() == QTextStream::Ok;
+    }
+
+    bool writeJson(const QString &path, const QByteArray &json) {
+        QFile file(path);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            return false;
+        }
+        return file.write(json) == json.size();
+    }
+
+}
@@ -0,0 +1,30 @@
+#ifndef BENCHMARKDATA_H
+#define BENCHMARKDATA_H
+
+#include <QDir>
+#include <QSize>
+#include <QString>
+
+//! Creates the data sets that the benchmarks run on
+namespace BenchmarkData {
+
+    //! Focal length of the camera matrix of the generated images
+    static const float FOCAL_LENGTH = 572.4f;
+
+    /*!
+     * \brief createImages writes the given number of PNG images and the info.json with their
+     * camera matrices, the principal point is the center of the image.
+     */
+    bool createImages(const QDir &imagesDir, int numberOfImages, const QSize &size);
+
+    /*!
+     * \brief createSphere writes a UV sphere as ASCII PLY file, it has
+     * 2 * stacks * slices triangles.
+     */
+    bool createSphere(const QString &path, float radius, int stacks, int slices);
+
+    bool writeJson(const QString &path, const QByteArray &json);
+
+}
+
+#endif // BENCHMARKDATA_H
@@ -0,0 +1,12 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <QStringList>
+
+//! Runs inference with the stand-in network and measures latency and throughput
+int runPredictionBenchmark(const QStringList &arguments);
+
+//! Renders generated scenes with the CPU rasterizer and the OpenGL ground truth renderer
+int runRasterizerBenchmark(const QStringList &arguments);
+
+#endif // BENCHMARKS_H
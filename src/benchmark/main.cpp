@@ -0,0 +1,34 @@
+#include "benchmarks.hpp"
+#include "view/groundtruth/groundtruthrenderer.hpp"
+
+#include <QGuiApplication>
+#include <QStringList>
+#include <QTextStream>
+
+static const QString USAGE = "Usage: 6D-PAT-benchmarks <benchmark> [options]\n\n"
+                             "Benchmarks:\n"
+                             "  prediction    network predictions until they reach the views\n"
+                             "  rasterizer    CPU rasterizer against the OpenGL renderer\n\n"
+                             "Run 6D-PAT-benchmarks <benchmark> --help for the options.\n";
+
+int main(int argc, char *argv[]) {
+    // Render nodes usually do not have a display
+    GroundTruthRenderer::selectHeadlessPlatform();
+    QGuiApplication app(argc, argv);
+
+    QStringList arguments = app.arguments();
+    QString benchmark = arguments.value(1);
+    // The parser of the benchmark expects the program name as first argument
+    if (arguments.size() > 1) {
+        arguments.removeAt(1);
+    }
+
+    if (benchmark == "prediction") {
+        return runPredictionBenchmark(arguments);
+    } else if (benchmark == "rasterizer") {
+        return runRasterizerBenchmark(arguments);
+    }
+
+    QTextStream(stderr) << USAGE;
+    return benchmark.isEmpty() || benchmark == "--help" || benchmark == "-h" ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+#include "benchmarks.hpp"
+#include "benchmarkdata.hpp"
+#include "controller/neuralnetworkcontroller.hpp"
+#include "model/cachingmodelmanager.hpp"
+#include "model/jsonloadandstorestrategy.hpp"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QtDebug>
+
+#include <algorithm>
+
+/*!
+ * Runs inference with the stand-in network on a generated data set and measures
+ *
+ *  - the latency from the network writing a prediction until the poses have been added to the
+ *    model manager, i.e. until the views are notified (posesAdded)
+ *  - the time until the first poses arrive
+ *  - the overall throughput in images per second
+ *
+ * The data set is created in a temporary directory, nothing outside of it is modified.
+ */
+
+static double percentile(QList<qint64> values, double fraction) {
+    if (values.isEmpty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    int index = qMin(values.size() - 1, (int) (fraction * (values.size() - 1) + 0.5));
+    return values[index];
+}
+
+int runPredictionBenchmark(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("End-to-end benchmark of the network prediction path.");
+    parser.addHelpOption();
+    QCommandLineOption pythonOption("python", "Python interpreter.", "path", "python3");
+    QCommandLineOption scriptOption("script", "Stand-in network script.", "path",
+                                    QDir(SCRIPTING_PATH).filePath("standinnetwork.py"));
+    QCommandLineOption imagesOption("images", "Number of images.", "n", "500");
+    QCommandLineOption sizeOption("size", "Width and height of the images.", "wxh", "640x480");
+    QCommandLineOption chunkSizeOption("chunk-size", "Images per network run.", "n", "100");
+    QCommandLineOption latencyOption("latency", "Milliseconds per image in the network.", "ms", "0");
+    QCommandLineOption startupOption("startup", "Milliseconds until the network starts.", "ms", "0");
+    QCommandLineOption posesOption("poses", "Poses per image.", "n", "1");
+    QCommandLineOption sharedMemoryOption("shared-memory", "Pass the images through shared memory.");
+    parser.addOptions({pythonOption, scriptOption, imagesOption, sizeOption, chunkSizeOption,
+                       latencyOption, startupOption, posesOption, sharedMemoryOption});
+    parser.process(arguments);
+
+    int numberOfImages = parser.value(imagesOption).toInt();
+    QStringList size = parser.value(sizeOption).split('x');
+    int width = size.value(0).toInt();
+    int height = size.value(1).toInt();
+    if (numberOfImages <= 0 || width <= 0 || height <= 0) {
+        qCritical() << "Invalid number of images or image size.";
+        return 1;
+    }
+
+    QTemporaryDir workingDirectory;
+    QDir directory(workingDirectory.path());
+    QString posesFilePath = directory.filePath("poses.json");
+    QString timingFilePath = directory.filePath("timing.txt");
+    // Object models are only listed by the model manager, the size does not matter
+    if (!BenchmarkData::createImages(directory.filePath("images"), numberOfImages,
+                                     QSize(width, height))
+            || !directory.mkpath("models")
+            || !BenchmarkData::createSphere(directory.filePath("models/obj_01.ply"), 50, 4, 8)
+            || !BenchmarkData::writeJson(posesFilePath, "{}")) {
+        qCritical() << "Could not create the data set.";
+        return 1;
+    }
+
+    QJsonObject config;
+    QJsonArray objectModels;
+    objectModels << "obj_01.ply";
+    config["STANDIN_OBJECT_MODELS"] = objectModels;
+    config["STANDIN_POSES_PER_IMAGE"] = parser.value(posesOption).toInt();
+    config["STANDIN_LATENCY_MS"] = parser.value(latencyOption).toDouble();
+    config["STANDIN_STARTUP_MS"] = parser.value(startupOption).toDouble();
+    config["STANDIN_TIMING_FILE"] = timingFilePath;
+    QString configPath = directory.filePath("config.json");
+    QFile configFile(configPath);
+    if (!configFile.open(QFile::WriteOnly)) {
+        return 1;
+    }
+    configFile.write(QJsonDocument(config).toJson());
+    configFile.close();
+
+    QString imagesPath = directory.filePath("images");
+    JsonLoadAndStoreStrategy strategy(imagesPath, directory.filePath("models"), posesFilePath);
+    CachingModelManager modelManager(strategy);
+    if (modelManager.getImages().size() != numberOfImages) {
+        qCritical() << "Model manager did not load the generated images.";
+        return 1;
+    }
+
+    NeuralNetworkController controller(parser.value(pythonOption), "", parser.value(scriptOption));
+    controller.setImages(modelManager.getImages().toVector());
+    controller.setImagesPath(imagesPath);
+    controller.setPosesFilePath(posesFilePath);
+    controller.setModelManager(&modelManager);
+    controller.setInferenceChunkSize(parser.value(chunkSizeOption).toInt());
+    controller.setUseSharedMemoryTransport(parser.isSet(sharedMemoryOption));
+
+    //! Time at which the poses of each image arrived at the model manager
+    QMap<QString, qint64> arrivalTimes;
+    int numberOfPoses = 0;
+    QObject::connect(&modelManager, &ModelManager::posesAdded, [&](const QStringList &ids) {
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        for (const QString &id : ids) {
+            QSharedPointer<Pose> pose = modelManager.getPoseById(id);
+            if (!pose.isNull() && !arrivalTimes.contains(pose->getImage()->getImagePath())) {
+                arrivalTimes[pose->getImage()->getImagePath()] = now;
+            }
+        }
+        numberOfPoses += ids.size();
+    });
+    bool failed = false;
+    QObject::connect(&controller, &NeuralNetworkController::inferenceFailed,
+                     [&](const QString &message) {
+        qCritical() << message;
+        failed = true;
+        QCoreApplication::quit();
+    });
+    QObject::connect(&controller, &NeuralNetworkController::inferenceFinished,
+                     QCoreApplication::instance(), &QCoreApplication::quit);
+
+    QElapsedTimer timer;
+    qint64 startTime = 0;
+    //! Started from the event loop, quit() has no effect before exec() and inference() fails
+    //! right away e.g. if the script can't be started
+    QTimer::singleShot(0, &controller, [&]() {
+        startTime = QDateTime::currentMSecsSinceEpoch();
+        timer.start();
+        controller.inference(configPath);
+    });
+    QCoreApplication::exec();
+    qint64 elapsed = timer.elapsed();
+
+    //! Latency from the network writing the prediction until the poses were added
+    QList<qint64> latencies;
+    QFile timingFile(timingFilePath);
+    if (timingFile.open(QFile::ReadOnly)) {
+        QTextStream timing(&timingFile);
+        while (!timing.atEnd()) {
+            QStringList entry = timing.readLine().split('\t');
+            if (entry.size() == 2 && arrivalTimes.contains(entry[0])) {
+                latencies << arrivalTimes[entry[0]] - entry[1].toLongLong();
+            }
+        }
+    }
+    qint64 firstArrival = arrivalTimes.isEmpty()
+            ? -1 : *std::min_element(arrivalTimes.begin(), arrivalTimes.end()) - startTime;
+
+    QTextStream out(stdout);
+    out << "images:               " << numberOfImages << "\n";
+    out << "images with poses:    " << arrivalTimes.size() << "\n";
+    out << "poses added:          " << numberOfPoses << "\n";
+    out << "total time:           " << elapsed << " ms\n";
+    out << "throughput:           " << (elapsed > 0 ? arrivalTimes.size() * 1000.0 / elapsed : 0)
+        << " images/s\n";
+    out << "time to first poses:  " << firstArrival << " ms\n";
+    out << "latency p50/p95/max:  " << percentile(latencies, 0.5) << " / "
+        << percentile(latencies, 0.95) << " / " << percentile(latencies, 1.0) << " ms\n";
+    return failed || arrivalTimes.size() != numberOfImages ? 1 : 0;
+}
@@ -0,0 +1,199 @@
+#include "benchmarks.hpp"
+#include "benchmarkdata.hpp"
+#include "misc/geometry/cpurasterizer.hpp"
+#include "misc/npyfile.hpp"
+#include "model/cachingmodelmanager.hpp"
+#include "model/jsonloadandstorestrategy.hpp"
+#include "view/groundtruth/groundtruthrenderer.hpp"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QtDebug>
+
+#include <math.h>
+#include <random>
+
+/*!
+ * Renders the same generated scenes with the CpuRasterizer and the OpenGL based
+ * GroundTruthRenderer and reports
+ *
+ *  - the time the CPU rasterizer takes per image without and with writing mask and depth
+ *  - the time the OpenGL renderer takes per image for the same output
+ *  - how many pixels of the instance masks of both agree
+ */
+
+//! Places the objects at random positions in front of the camera, always the same ones
+static QJsonObject createPoses(const QStringList &images, int objectsPerImage) {
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> x(-150, 150);
+    std::uniform_real_distribution<double> y(-100, 100);
+    std::uniform_real_distribution<double> z(600, 1200);
+    std::uniform_real_distribution<double> angle(0, 2 * M_PI);
+    QJsonObject poses;
+    for (const QString &image : images) {
+        QJsonArray posesForImage;
+        for (int i = 0; i < objectsPerImage; i++) {
+            double a = angle(generator);
+            QJsonArray rotation;
+            rotation << cos(a) << -sin(a) << 0 << sin(a) << cos(a) << 0 << 0 << 0 << 1;
+            QJsonArray translation;
+            translation << x(generator) << y(generator) << z(generator);
+            QJsonObject pose;
+            pose["obj"] = "obj_01.ply";
+            pose["R"] = rotation;
+            pose["t"] = translation;
+            posesForImage << pose;
+        }
+        poses[image] = posesForImage;
+    }
+    return poses;
+}
+
+static bool writeRasterOutput(const RasterBuffers &buffers, const QString &basePath) {
+    QImage mask(buffers.size, QImage::Format_Grayscale8);
+    for (int y = 0; y < buffers.size.height(); y++) {
+        uchar *line = mask.scanLine(y);
+        for (int x = 0; x < buffers.size.width(); x++) {
+            line[x] = (uchar) qMin(255, (int) buffers.instanceIds[y * buffers.size.width() + x]);
+        }
+    }
+    return mask.save(basePath + "_mask.png")
+            && NpyFile::writeFloat32(basePath + "_depth.npy", buffers.depth.constData(),
+                                     {buffers.size.height(), buffers.size.width()});
+}
+
+int runRasterizerBenchmark(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compares the CPU rasterizer with the OpenGL renderer.");
+    parser.addHelpOption();
+    QCommandLineOption imagesOption("images", "Number of images.", "n", "20");
+    QCommandLineOption sizeOption("size", "Width and height of the images.", "wxh", "640x480");
+    QCommandLineOption objectsOption("objects", "Objects per image.", "n", "5");
+    QCommandLineOption trianglesOption("triangles", "Approximate triangles per object.", "n",
+                                       "40000");
+    QCommandLineOption threadsOption("threads", "Threads of both renderers, 0 is one per core.",
+                                     "n", "0");
+    QCommandLineOption skipGLOption("skip-gl", "Only run the CPU rasterizer.");
+    parser.addOptions({imagesOption, sizeOption, objectsOption, trianglesOption, threadsOption,
+                       skipGLOption});
+    parser.process(arguments);
+
+    int numberOfImages = parser.value(imagesOption).toInt();
+    QStringList sizeValues = parser.value(sizeOption).split('x');
+    QSize size(sizeValues.value(0).toInt(), sizeValues.value(1).toInt());
+    int objectsPerImage = parser.value(objectsOption).toInt();
+    int threads = parser.value(threadsOption).toInt();
+    if (numberOfImages <= 0 || size.isEmpty() || objectsPerImage <= 0) {
+        qCritical() << "Invalid number of images, objects or image size.";
+        return 1;
+    }
+
+    // A sphere has 2 * stacks * slices triangles, with twice as many slices as stacks
+    int stacks = qMax(2, (int) sqrt(parser.value(trianglesOption).toDouble() / 4));
+    QTemporaryDir workingDirectory;
+    QDir directory(workingDirectory.path());
+    QDir imagesDir(directory.filePath("images"));
+    QString posesFilePath = directory.filePath("poses.json");
+    if (!BenchmarkData::createImages(imagesDir, numberOfImages, size)
+            || !directory.mkpath("models")
+            || !BenchmarkData::createSphere(directory.filePath("models/obj_01.ply"),
+                                            60, stacks, 2 * stacks)) {
+        qCritical() << "Could not create the data set.";
+        return 1;
+    }
+    QStringList imageNames = imagesDir.entryList({"*.png"}, QDir::Files, QDir::Name);
+    QJsonObject poses = createPoses(imageNames, objectsPerImage);
+    if (!BenchmarkData::writeJson(posesFilePath, QJsonDocument(poses).toJson())) {
+        qCritical() << "Could not write the poses.";
+        return 1;
+    }
+
+    JsonLoadAndStoreStrategy strategy(imagesDir.path(), directory.filePath("models"),
+                                      posesFilePath);
+    CachingModelManager modelManager(strategy);
+    QList<Image> images = modelManager.getImages();
+    if (images.isEmpty()) {
+        qCritical() << "Model manager did not load the generated images.";
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    out << "images: " << images.size() << ", objects per image: " << objectsPerImage
+        << ", triangles per object: " << 4 * stacks * stacks << "\n";
+
+    CpuRasterizer rasterizer(threads);
+    // Loads the mesh so that only rasterizing is measured
+    rasterizer.rasterize(images.first(), size, modelManager.getPosesForImage(images.first()));
+
+    QList<RasterBuffers> cpuBuffers;
+    QElapsedTimer timer;
+    timer.start();
+    for (const Image &image : images) {
+        cpuBuffers << rasterizer.rasterize(image, size, modelManager.getPosesForImage(image));
+    }
+    double rasterizeTime = timer.nsecsElapsed() / 1e6;
+
+    QDir cpuOutputDir(directory.filePath("cpu"));
+    cpuOutputDir.mkpath(".");
+    timer.restart();
+    for (const Image &image : images) {
+        RasterBuffers buffers = rasterizer.rasterize(image, size,
+                                                     modelManager.getPosesForImage(image));
+        writeRasterOutput(buffers, cpuOutputDir.filePath(
+                              QFileInfo(image.getImagePath()).completeBaseName()));
+    }
+    double cpuOutputTime = timer.nsecsElapsed() / 1e6;
+
+    out << "cpu rasterize:        " << rasterizeTime / images.size() << " ms/image\n";
+    out << "cpu mask + depth:     " << cpuOutputTime / images.size() << " ms/image\n";
+
+    if (parser.isSet(skipGLOption)) {
+        return 0;
+    }
+
+    QString glOutputPath = directory.filePath("gl");
+    GroundTruthRenderer renderer(&modelManager, glOutputPath);
+    renderer.setThreadCount(threads);
+    renderer.setWriteObjectCoordinates(false);
+    timer.restart();
+    if (!renderer.render()) {
+        qCritical() << "The OpenGL renderer failed.";
+        return 1;
+    }
+    double glOutputTime = timer.nsecsElapsed() / 1e6;
+    out << "opengl mask + depth:  " << glOutputTime / images.size()
+        << " ms/image (including context creation and loading the object models)\n";
+
+    // Both use the same projection, they should only differ at the edges of the objects
+    QFile indexFile(QDir(glOutputPath).filePath(GroundTruthRenderer::INDEX_FILE_NAME));
+    indexFile.open(QFile::ReadOnly);
+    QJsonObject index = QJsonDocument::fromJson(indexFile.readAll()).object();
+    qint64 agreeing = 0;
+    qint64 total = 0;
+    for (int i = 0; i < images.size(); i++) {
+        QString maskPath = index[images[i].getImagePath()].toObject()["mask"].toString();
+        QImage glMask(QDir(glOutputPath).filePath(maskPath));
+        if (glMask.size() != size) {
+            continue;
+        }
+        glMask = glMask.convertToFormat(QImage::Format_Grayscale8);
+        for (int y = 0; y < size.height(); y++) {
+            const uchar *line = glMask.constScanLine(y);
+            for (int x = 0; x < size.width(); x++) {
+                agreeing += line[x] == qMin(255, (int) cpuBuffers[i].instanceIds[y * size.width() + x]);
+            }
+        }
+        total += size.width() * size.height();
+    }
+    out << "mask agreement:       " << (total > 0 ? 100.0 * agreeing / total : 0) << " %\n";
+    return 0;
+}
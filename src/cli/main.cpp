@@ -0,0 +1,517 @@
+#include "controller/multiviewpropagator.hpp"
+#include "controller/poseinterpolator.hpp"
+#include "misc/evaluation/poseevaluator.hpp"
+#include "misc/evaluation/posequalityscorer.hpp"
+#include "misc/evaluation/visibilitycomputer.hpp"
+#include "misc/evaluation/penetrationchecker.hpp"
+#include "misc/geometry/poserefiner.hpp"
+#include "model/cachingmodelmanager.hpp"
+#include "model/jsonloadandstorestrategy.hpp"
+#include "view/groundtruth/groundtruthrenderer.hpp"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QMap>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTextStream>
+#include <QtDebug>
+
+#include <algorithm>
+
+/*!
+ * Command line interface of 6D-PAT. The first argument is the command, the remaining
+ * arguments are the options of the command, e.g.
+ *
+ *     6D-PAT-cli render --images data/images --models data/models --poses data/poses.json
+ *                       --output data/ground_truth
+ */
+
+static const QString USAGE = "Usage: 6D-PAT-cli <command> [options]\n\n"
+                             "Commands:\n"
+                             "  render       renders masks, depth and object coordinates of all poses\n"
+                             "  refine       aligns all poses with the edges of their images\n"
+                             "  evaluate     compares predicted poses with the ground truth poses\n"
+                             "  interpolate  fills the images between keyframes with poses\n"
+                             "  views        transfers poses to the other views of their scenes\n"
+                             "  quality      scores all poses against the segmentation images\n"
+                             "  visibility   computes the visible fraction and boxes of all poses\n"
+                             "  penetration  finds poses whose objects intersect each other\n\n"
+                             "Run 6D-PAT-cli <command> --help for the options of a command.\n";
+
+//! Adds the options that every command needs to load the annotations
+static void addDataOptions(QCommandLineParser &parser) {
+    parser.addOption({"images", "Folder with the images.", "path"});
+    parser.addOption({"segmentations", "Folder with the segmentation images.", "path", ""});
+    parser.addOption({"models", "Folder with the object models.", "path"});
+    parser.addOption({"poses", "The poses file.", "path"});
+}
+
+//! Parses the arguments of the command, exits on --help, fails if a required option is missing
+static bool processArguments(QCommandLineParser &parser, const QStringList &arguments,
+                             const QStringList &requiredOptions) {
+    parser.process(arguments);
+    for (const QString &option : requiredOptions) {
+        if (parser.value(option).isEmpty()) {
+            qCritical() << "Missing option --" + option;
+            return false;
+        }
+    }
+    return true;
+}
+
+//! Returns the comma separated values of the option
+static QStringList listValue(const QCommandLineParser &parser, const QString &option) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    return parser.value(option).split(',', Qt::SkipEmptyParts);
+#else
+    return parser.value(option).split(',', QString::SkipEmptyParts);
+#endif
+}
+
+/*!
+ * \brief objectModelFileName returns the file name of an object model given on the command
+ * line. Poses and settings refer to object models by their file names only, also those in
+ * subfolders of --models, so folders in front of the file name are dropped. Warns if none of
+ * the object models has the file name.
+ */
+static QString objectModelFileName(const QString &objectModel,
+                                   const QList<ObjectModel> &objectModels,
+                                   const QString &option) {
+    QString fileName = QFileInfo(objectModel).fileName();
+    for (const ObjectModel &model : objectModels) {
+        if (model.getPath() == fileName) {
+            return fileName;
+        }
+    }
+    qWarning() << "No object model in --models is called " + fileName + " (--" + option + ")";
+    return fileName;
+}
+
+//! Returns the object models of the comma separated option by their file names
+static QStringList objectModelsValue(const QCommandLineParser &parser, const QString &option,
+                                     const QList<ObjectModel> &objectModels) {
+    QStringList fileNames;
+    for (const QString &objectModel : listValue(parser, option)) {
+        fileNames << objectModelFileName(objectModel, objectModels, option);
+    }
+    return fileNames;
+}
+
+/*!
+ * \brief The Annotations class loads the data that the options of addDataOptions() point to.
+ * The model manager, which loads all images, object models and poses, is only created when a
+ * command needs it.
+ */
+class Annotations
+{
+public:
+    //! \param posesOption the option with the poses file
+    explicit Annotations(const QCommandLineParser &parser,
+                         const QString &posesOption = "poses") :
+        strategy(parser.value("images"),
+                 parser.value("models"),
+                 parser.value(posesOption),
+                 parser.value("segmentations")) {
+    }
+
+    JsonLoadAndStoreStrategy &getStrategy() {
+        return strategy;
+    }
+
+    CachingModelManager &getModelManager() {
+        if (modelManager.isNull()) {
+            modelManager.reset(new CachingModelManager(strategy));
+        }
+        return *modelManager;
+    }
+
+private:
+    JsonLoadAndStoreStrategy strategy;
+    QScopedPointer<CachingModelManager> modelManager;
+};
+
+static int render(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders the poses of all images offscreen and writes "
+                                     "instance masks, depth maps and object coordinates.");
+    parser.addHelpOption();
+    addDataOptions(parser);
+    parser.addOption({"output", "Folder to write the ground truth to.", "path"});
+    parser.addOption({"threads", "Number of render threads, defaults to the number of cores.",
+                      "n", "0"});
+    parser.addOption({"near", "Near plane of the projection.", "value", "10"});
+    parser.addOption({"far", "Far plane of the projection.", "value", "10000"});
+    parser.addOption({"no-masks", "Do not write the instance masks."});
+    parser.addOption({"no-depth", "Do not write the depth maps."});
+    parser.addOption({"no-object-coordinates", "Do not write the object coordinates."});
+    if (!processArguments(parser, arguments, {"images", "models", "poses", "output"})) {
+        return 1;
+    }
+
+    Annotations annotations(parser);
+    CachingModelManager &modelManager = annotations.getModelManager();
+
+    GroundTruthRenderer renderer(&modelManager, parser.value("output"));
+    renderer.setThreadCount(parser.value("threads").toInt());
+    renderer.setNearPlane(parser.value("near").toFloat());
+    renderer.setFarPlane(parser.value("far").toFloat());
+    renderer.setWriteMasks(!parser.isSet("no-masks"));
+    renderer.setWriteDepth(!parser.isSet("no-depth"));
+    renderer.setWriteObjectCoordinates(!parser.isSet("no-object-coordinates"));
+    return renderer.render() ? 0 : 1;
+}
+
+static int refine(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Aligns the outlines of the rendered poses with the edges "
+                                     "of the images, or of the segmentation images if there "
+                                     "are any, and stores the poses that improved.");
+    parser.addHelpOption();
+    addDataOptions(parser);
+    parser.addOption({"threads", "Number of render threads, defaults to the number of cores.",
+                      "n", "0"});
+    parser.addOption({"levels", "Number of levels of the image pyramid.", "n", "3"});
+    parser.addOption({"max-distance", "Distance in pixels at which edges stop attracting.",
+                      "value", "20"});
+    if (!processArguments(parser, arguments, {"images", "models", "poses"})) {
+        return 1;
+    }
+
+    Annotations annotations(parser);
+    CachingModelManager &modelManager = annotations.getModelManager();
+
+    PoseRefiner refiner(parser.value("threads").toInt());
+    refiner.setPyramidLevels(parser.value("levels").toInt());
+    refiner.setMaxEdgeDistance(parser.value("max-distance").toFloat());
+    QList<Pose> poses = modelManager.getPoses();
+    QList<PoseRefinement> refinements = refiner.refine(poses);
+    QList<Pose> refinedPoses;
+    for (int i = 0; i < poses.size(); i++) {
+        const PoseRefinement &refinement = refinements[i];
+        if (refinement.valid && refinement.finalError < refinement.initialError) {
+            Pose refinedPose(poses[i]);
+            refinedPose.setPosition(refinement.position);
+            refinedPose.setRotation(refinement.rotation);
+            refinedPoses << refinedPose;
+        }
+    }
+    // Written in one go, updating the poses one by one rewrites the poses file every time
+    JsonLoadAndStoreStrategy &strategy = annotations.getStrategy();
+    bool written = refinedPoses.isEmpty()
+            || (strategy.persistPoses(refinedPoses, false) && strategy.flushPoses());
+    QTextStream(stdout) << "Refined " << (written ? refinedPoses.size() : 0) << " of "
+                        << poses.size() << " poses.\n";
+    return written ? 0 : 1;
+}
+
+static int evaluate(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Matches the predicted poses with the ground truth poses "
+                                     "of every image and object model and writes their ADD, "
+                                     "ADD-S, projection, rotation and translation errors, a "
+                                     "summary per object model and the recall curves.");
+    parser.addHelpOption();
+    addDataOptions(parser);
+    parser.addOption({"predictions", "The poses file with the predicted poses, the --poses "
+                                     "file holds the ground truth.", "path"});
+    parser.addOption({"output", "Folder to write errors.csv, summary.csv and summary.json to.",
+                      "path"});
+    parser.addOption({"symmetric", "Comma separated file names of the object models whose "
+                                   "recall uses ADD-S, e.g. cup.ply. Object models in "
+                                   "subfolders of --models are also given by their file "
+                                   "names.", "files", ""});
+    parser.addOption({"threads", "Number of images evaluated at once, defaults to the number "
+                                 "of cores.", "n", "0"});
+    if (!processArguments(parser, arguments, {"images", "models", "poses", "predictions", "output"})) {
+        return 1;
+    }
+
+    Annotations groundTruth(parser);
+    Annotations predictions(parser, "predictions");
+    PoseEvaluator evaluator(parser.value("threads").toInt());
+    evaluator.setSymmetricObjectModels(
+                objectModelsValue(parser, "symmetric",
+                                  groundTruth.getStrategy().loadObjectModels()));
+    QList<PoseErrors> errors = evaluator.evaluate(groundTruth.getStrategy(), predictions.getStrategy());
+    QList<ObjectModelSummary> summaries = evaluator.summarize(errors);
+
+    QDir output(parser.value("output"));
+    if (!output.mkpath(".")) {
+        qCritical() << "Could not create " + output.path();
+        return 1;
+    }
+    bool written = PoseEvaluator::writeErrorsCsv(output.filePath("errors.csv"), errors)
+            && PoseEvaluator::writeSummaryCsv(output.filePath("summary.csv"), summaries)
+            && PoseEvaluator::writeSummaryJson(output.filePath("summary.json"), summaries);
+
+    QTextStream out(stdout);
+    for (const ObjectModelSummary &summary : summaries) {
+        out << summary.objectModelPath << ": " << summary.matchedPoses << " of "
+            << summary.groundTruthPoses << " poses predicted, "
+            << summary.falsePositives << " false positives, ADD" << (summary.symmetric ? "-S" : "")
+            << " recall " << summary.addRecall << ", 5 px recall " << summary.projectionRecall
+            << "\n";
+    }
+    return written ? 0 : 1;
+}
+
+static int interpolate(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Interpolates the poses of the images between the "
+                                     "keyframes of every sequence, i.e. the images that have "
+                                     "exactly one pose of an object model, and stores them in "
+                                     "one batch.");
+    parser.addHelpOption();
+    addDataOptions(parser);
+    parser.addOption({"models-to-interpolate", "Comma separated file names of the object "
+                                               "models to interpolate, e.g. cup.ply, also for "
+                                               "those in subfolders of --models. All if not "
+                                               "given.", "files", ""});
+    parser.addOption({"max-gap", "Maximum number of images between two keyframes that are "
+                                 "filled, 0 for no maximum.", "n", "0"});
+    parser.addOption({"by-index", "Interpolate by the index of the images instead of the "
+                                  "numbers in their file names."});
+    if (!processArguments(parser, arguments, {"images", "models", "poses"})) {
+        return 1;
+    }
+
+    Annotations annotations(parser);
+    CachingModelManager &modelManager = annotations.getModelManager();
+
+    PoseInterpolator interpolator;
+    interpolator.setMaxGap(parser.value("max-gap").toInt());
+    interpolator.setUseFileNumbers(!parser.isSet("by-index"));
+    QList<Image> images = modelManager.getImages();
+    QList<Pose> poses = interpolator.interpolate(
+                images, modelManager.getPoses(),
+                objectModelsValue(parser, "models-to-interpolate",
+                                  modelManager.getObjectModels()));
+    QStringList added;
+    if (!poses.isEmpty()) {
+        added = modelManager.addObjectImagePoses(poses);
+    }
+    QTextStream(stdout) << "Interpolated " << added.size() << " poses.\n";
+    return added.size() == poses.size() ? 0 : 1;
+}
+
+static int views(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Transfers every pose of an image with extrinsics to the "
+                                     "other views of its scene through the world frame and "
+                                     "stores the new poses in one batch. Views that show the "
+                                     "object at the pose already are skipped.");
+    parser.addHelpOption();
+    addDataOptions(parser);
+    parser.addOption({"duplicate-distance", "Distance in pixels of the projected origins below "
+                                            "which a pose counts as the same object.",
+                      "value", "20"});
+    if (!processArguments(parser, arguments, {"images", "models", "poses"})) {
+        return 1;
+    }
+
+    Annotations annotations(parser);
+    CachingModelManager &modelManager = annotations.getModelManager();
+
+    MultiViewPropagator propagator;
+    propagator.setDuplicateDistance(parser.value("duplicate-distance").toFloat());
+    QList<Image> images = modelManager.getImages();
+    QList<Pose> existingPoses = modelManager.getPoses();
+    QList<Pose> propagatedPoses;
+    for (const Pose &pose : existingPoses) {
+        if (pose.getImage()->hasExtrinsics()) {
+            propagatedPoses += propagator.propagate(pose, images,
+                                                    existingPoses + propagatedPoses);
+        }
+    }
+    QStringList added;
+    if (!propagatedPoses.isEmpty()) {
+        added = modelManager.addObjectImagePoses(propagatedPoses);
+    }
+    QTextStream(stdout) << "Propagated " << added.size() << " poses.\n";
+    return added.size() == propagatedPoses.size() ? 0 : 1;
+}
+
+static int quality(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders the poses of every image and writes the IoU and "
+                                     "boundary F-score of each pose with the segmentation of "
+                                     "its object model, the worst poses first.");
+    parser.addHelpOption();
+    addDataOptions(parser);
+    parser.addOption({"output", "The CSV file to write the scores to.", "path"});
+    parser.addOption({"segmentation-codes", "Comma separated segmentation codes of the object "
+                                            "models by their file names as in the settings, "
+                                            "e.g. cup.ply=255.0.0, also for those in "
+                                            "subfolders of --models. Without a code all "
+                                            "pixels that are neither black nor white are the "
+                                            "object.", "codes", ""});
+    parser.addOption({"boundary-tolerance", "Distance in pixels up to which outline pixels "
+                                            "match.", "value", "2"});
+    parser.addOption({"threads", "Number of images scored at once, defaults to the number of "
+                                 "cores.", "n", "0"});
+    if (!processArguments(parser, arguments, {"images", "segmentations", "models", "poses",
+                                       "output"})) {
+        return 1;
+    }
+
+    Annotations annotations(parser);
+    CachingModelManager &modelManager = annotations.getModelManager();
+
+    QList<ObjectModel> objectModels = modelManager.getObjectModels();
+    QMap<QString, QString> segmentationCodes;
+    for (const QString &code : listValue(parser, "segmentation-codes")) {
+        QStringList objectModelAndCode = code.split('=');
+        if (objectModelAndCode.size() != 2) {
+            qCritical() << "Invalid segmentation code " + code;
+            return 1;
+        }
+        QString objectModel = objectModelFileName(objectModelAndCode[0],
+                                                  objectModels, "segmentation-codes");
+        segmentationCodes[objectModel] = objectModelAndCode[1];
+    }
+    PoseQualityScorer scorer(parser.value("threads").toInt());
+    scorer.setSegmentationCodes(segmentationCodes);
+    scorer.setBoundaryTolerance(parser.value("boundary-tolerance").toFloat());
+    QList<PoseQuality> qualities = scorer.score(modelManager.getPoses());
+    std::stable_sort(qualities.begin(), qualities.end(),
+                     [](const PoseQuality &quality1, const PoseQuality &quality2) {
+        return quality1.valid && (!quality2.valid || quality1.iou < quality2.iou);
+    });
+    bool written = PoseQualityScorer::writeCsv(parser.value("output"), qualities);
+
+    int scored = 0;
+    float iouSum = 0.f, boundaryFScoreSum = 0.f;
+    for (const PoseQuality &poseQuality : qualities) {
+        if (poseQuality.valid) {
+            scored++;
+            iouSum += poseQuality.iou;
+            boundaryFScoreSum += poseQuality.boundaryFScore;
+        }
+    }
+    QTextStream out(stdout);
+    out << "Scored " << scored << " of " << qualities.size() << " poses";
+    if (scored > 0) {
+        out << ", mean IoU " << iouSum / scored << ", mean boundary F-score "
+            << boundaryFScoreSum / scored << ", worst IoU " << qualities.first().iou
+            << " of pose " << qualities.first().poseId << " in " << qualities.first().imagePath;
+    }
+    out << ".\n";
+    return written ? 0 : 1;
+}
+
+static int visibility(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Computes the fraction of every pose that is not occluded "
+                                     "by the other poses of its image and the bounding boxes "
+                                     "of its silhouette and of the visible part. Images whose "
+                                     "poses did not change are read from the output.");
+    parser.addHelpOption();
+    addDataOptions(parser);
+    parser.addOption({"output", "The JSON file to write to, defaults to the poses file with "
+                                "the extension .visibility.json.", "path", ""});
+    parser.addOption({"depth-tolerance", "Distance in units of the poses up to which a "
+                                         "surface counts as visible behind the closest one.",
+                      "value", "0"});
+    parser.addOption({"threads", "Number of images computed at once, defaults to the number "
+                                 "of cores.", "n", "0"});
+    if (!processArguments(parser, arguments, {"images", "models", "poses"})) {
+        return 1;
+    }
+
+    Annotations annotations(parser);
+    CachingModelManager &modelManager = annotations.getModelManager();
+
+    QString output = parser.value("output");
+    if (output.isEmpty()) {
+        output = VisibilityComputer::cachePath(parser.value("poses"));
+    }
+    VisibilityComputer computer(parser.value("threads").toInt());
+    computer.setDepthTolerance(parser.value("depth-tolerance").toFloat());
+    int cachedImages = 0;
+    QList<PoseVisibility> visibilities = computer.compute(modelManager.getPoses(), output,
+                                                          &cachedImages);
+    int computed = 0, mostlyOccluded = 0;
+    for (const PoseVisibility &poseVisibility : visibilities) {
+        if (poseVisibility.valid) {
+            computed++;
+            mostlyOccluded += poseVisibility.visibleFraction < 0.1f ? 1 : 0;
+        }
+    }
+    QTextStream(stdout) << "Computed the visibility of " << computed << " of "
+                        << visibilities.size() << " poses (" << cachedImages
+                        << " images unchanged), " << mostlyOccluded
+                        << " are less than 10 % visible.\n";
+    return computed == visibilities.size() ? 0 : 1;
+}
+
+static int penetration(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Finds pairs of poses of the same image whose objects "
+                                     "intersect each other and writes them as CSV, the "
+                                     "deepest penetration first.");
+    parser.addHelpOption();
+    addDataOptions(parser);
+    parser.addOption({"output", "The CSV file to write the penetrating pairs to.", "path"});
+    parser.addOption({"min-depth", "Depth in units of the poses up to which objects may "
+                                   "touch.", "value", "0"});
+    parser.addOption({"threads", "Number of images checked at once, defaults to the number of "
+                                 "cores.", "n", "0"});
+    if (!processArguments(parser, arguments, {"images", "models", "poses", "output"})) {
+        return 1;
+    }
+
+    Annotations annotations(parser);
+    CachingModelManager &modelManager = annotations.getModelManager();
+
+    PenetrationChecker checker(parser.value("threads").toInt());
+    checker.setMinDepth(parser.value("min-depth").toFloat());
+    QList<Penetration> penetrations = checker.check(modelManager.getPoses());
+    bool written = PenetrationChecker::writeCsv(parser.value("output"), penetrations);
+
+    QTextStream out(stdout);
+    out << penetrations.size() << " pairs of poses penetrate each other";
+    if (!penetrations.isEmpty()) {
+        const Penetration &deepest = penetrations.first();
+        out << ", the deepest are " << deepest.poseId1 << " and " << deepest.poseId2
+            << " in " << deepest.imagePath << " by " << deepest.depth;
+    }
+    out << ".\n";
+    return written ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    // Render nodes usually do not have a display
+    GroundTruthRenderer::selectHeadlessPlatform();
+    QGuiApplication app(argc, argv);
+
+    QStringList arguments = app.arguments();
+    QString command = arguments.value(1);
+    // The parser of the command expects the program name as first argument
+    if (arguments.size() > 1) {
+        arguments.removeAt(1);
+    }
+
+    if (command == "render") {
+        return render(arguments);
+    } else if (command == "refine") {
+        return refine(arguments);
+    } else if (command == "evaluate") {
+        return evaluate(arguments);
+    } else if (command == "interpolate") {
+        return interpolate(arguments);
+    } else if (command == "views") {
+        return views(arguments);
+    } else if (command == "quality") {
+        return quality(arguments);
+    } else if (command == "visibility") {
+        return visibility(arguments);
+    } else if (command == "penetration") {
+        return penetration(arguments);
+    }
+
+    QTextStream(stderr) << USAGE;
+    return command.isEmpty() || command == "--help" || command == "-h" ? 0 : 1;
+}
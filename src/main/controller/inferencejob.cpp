@@ -0,0 +1,228 @@
+#include "inferencejob.hpp"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QtDebug>
+
+const QString InferenceJob::CHECKPOINT_SUFFIX = ".inference.json";
+
+//! Reads the given files once and discards the data, which leaves them in the file system
+//! cache. This is all the preparation an image needs before the network can read it.
+class ImagePrefetchRunnable : public QRunnable {
+public:
+    ImagePrefetchRunnable(const QStringList &paths,
+                          QSharedPointer<CancellationToken> cancellationToken) :
+        paths(paths),
+        cancellationToken(cancellationToken) {
+    }
+
+    void run() override {
+        QByteArray block(1 << 20, 0);
+        for (const QString &path : paths) {
+            QFile file(path);
+            if (!file.open(QFile::ReadOnly)) {
+                continue;
+            }
+            while (!cancellationToken->isCancelled()
+                   && file.read(block.data(), block.size()) > 0) {
+            }
+            if (cancellationToken->isCancelled()) {
+                return;
+            }
+        }
+    }
+
+private:
+    QStringList paths;
+    QSharedPointer<CancellationToken> cancellationToken;
+};
+
+InferenceJob::InferenceJob(const QString &configPath,
+                           const QString &posesFilePath,
+                           const QVector<Image> &images,
+                           int chunkSize) :
+    configPath(configPath),
+    posesFilePath(posesFilePath),
+    chunkSize(qMax(1, chunkSize)),
+    prefetchCancellationToken(new CancellationToken()) {
+    for (const Image &image : images) {
+        imagePaths << image.getImagePath();
+        absoluteImagePaths << image.getAbsoluteImagePath();
+    }
+}
+
+InferenceJob::~InferenceJob() {
+    prefetchCancellationToken->cancel();
+}
+
+QString InferenceJob::checkpointPath() const {
+    return posesFilePath + CHECKPOINT_SUFFIX;
+}
+
+int InferenceJob::loadCheckpoint() {
+    QFile checkpointFile(checkpointPath());
+    if (!checkpointFile.open(QFile::ReadOnly)) {
+        return 0;
+    }
+    QJsonObject checkpoint = QJsonDocument::fromJson(checkpointFile.readAll()).object();
+    if (checkpoint["config"].toString() != configPath) {
+        //! The checkpoint belongs to a different network, the predictions of that network
+        //! do not tell anything about what this network has done
+        return 0;
+    }
+    //! The range constructor of QSet needs Qt 5.14 and toSet() is deprecated there
+    QSet<QString> managedImages;
+    for (const QString &imagePath : imagePaths) {
+        managedImages.insert(imagePath);
+    }
+    int skippedImages = 0;
+    for (const QJsonValue &completedImage : checkpoint["completed"].toArray()) {
+        QString imagePath = completedImage.toString();
+        if (managedImages.contains(imagePath) && !completedImages.contains(imagePath)) {
+            completedImages.insert(imagePath);
+            skippedImages++;
+        }
+    }
+    advanceFirstIncompleteImage();
+    return skippedImages;
+}
+
+bool InferenceJob::saveCheckpoint() const {
+    QJsonArray completed;
+    for (const QString &imagePath : imagePaths) {
+        if (completedImages.contains(imagePath)) {
+            completed << imagePath;
+        }
+    }
+    QJsonObject checkpoint;
+    checkpoint["config"] = configPath;
+    checkpoint["completed"] = completed;
+    QFile checkpointFile(checkpointPath());
+    if (!checkpointFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        qDebug() << "Could not write inference checkpoint " + checkpointPath();
+        return false;
+    }
+    checkpointFile.write(QJsonDocument(checkpoint).toJson(QJsonDocument::Compact));
+    return true;
+}
+
+void InferenceJob::removeCheckpoint() const {
+    QFile::remove(checkpointPath());
+}
+
+bool InferenceJob::hasRemainingImages() const {
+    return completedImages.size() < imagePaths.size();
+}
+
+QString InferenceJob::prepareNextChunk(const QJsonObject &basicConfig) {
+    if (!workingDirectory.isValid()) {
+        qDebug() << "Could not create directory for the inference chunks.";
+        return "";
+    }
+
+    currentChunk = peekNextChunk();
+    QJsonArray imageList;
+    for (const QString &imagePath : currentChunk) {
+        imageList << imagePath;
+    }
+
+    QFile baseConfigFile(configPath);
+    if (!baseConfigFile.open(QFile::ReadOnly)) {
+        return "";
+    }
+    QJsonObject config = QJsonDocument::fromJson(baseConfigFile.readAll()).object();
+    for (const QString &key : basicConfig.keys()) {
+        config[key] = basicConfig[key];
+    }
+
+    QString chunkName = "chunk_" + QString::number(chunkCounter++);
+    currentChunkOutputPath.clear();
+    if (!config.contains("OUTPUT_FILE")) {
+        currentChunkOutputPath = workingDirectory.filePath(chunkName + "_poses.json");
+        config["OUTPUT_FILE"] = currentChunkOutputPath;
+    }
+    QString imageListPath = workingDirectory.filePath(chunkName + "_images.json");
+    QFile imageListFile(imageListPath);
+    if (!imageListFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        return "";
+    }
+    imageListFile.write(QJsonDocument(imageList).toJson());
+    config["IMAGE_LIST"] = imageListPath;
+
+    QString chunkConfigPath = workingDirectory.filePath(chunkName + ".json");
+    QFile chunkConfigFile(chunkConfigPath);
+    if (!chunkConfigFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        return "";
+    }
+    chunkConfigFile.write(QJsonDocument(config).toJson());
+    return chunkConfigPath;
+}
+
+QStringList InferenceJob::peekNextChunk() const {
+    QStringList chunk;
+    for (int i = firstIncompleteImage; i < imagePaths.size() && chunk.size() < chunkSize; i++) {
+        if (!completedImages.contains(imagePaths[i])) {
+            chunk << imagePaths[i];
+        }
+    }
+    return chunk;
+}
+
+void InferenceJob::prefetchChunkAfterCurrent() {
+    if (currentChunk.isEmpty()) {
+        return;
+    }
+    int lastOfCurrentChunk = imagePaths.indexOf(currentChunk.last(), firstIncompleteImage);
+    QStringList paths;
+    for (int i = lastOfCurrentChunk + 1; i < imagePaths.size() && paths.size() < chunkSize; i++) {
+        if (!completedImages.contains(imagePaths[i])) {
+            paths << absoluteImagePaths[i];
+        }
+    }
+    if (!paths.isEmpty()) {
+        QThreadPool::globalInstance()->start(
+                    new ImagePrefetchRunnable(paths, prefetchCancellationToken));
+    }
+}
+
+void InferenceJob::markImageCompleted(const QString &imagePath) {
+    if (currentChunk.contains(imagePath)) {
+        completedImages.insert(imagePath);
+        advanceFirstIncompleteImage();
+    }
+}
+
+void InferenceJob::markCurrentChunkCompleted() {
+    for (const QString &imagePath : currentChunk) {
+        completedImages.insert(imagePath);
+    }
+    currentChunk.clear();
+    advanceFirstIncompleteImage();
+}
+
+void InferenceJob::advanceFirstIncompleteImage() {
+    while (firstIncompleteImage < imagePaths.size()
+           && completedImages.contains(imagePaths[firstIncompleteImage])) {
+        firstIncompleteImage++;
+    }
+}
+
+int InferenceJob::getNumberOfImages() const {
+    return imagePaths.size();
+}
+
+int InferenceJob::getNumberOfCompletedImages() const {
+    return completedImages.size();
+}
+
+QStringList InferenceJob::getCurrentChunk() const {
+    return currentChunk;
+}
+
+QString InferenceJob::getCurrentChunkOutputPath() const {
+    return currentChunkOutputPath;
+}
@@ -0,0 +1,112 @@
+#ifndef INFERENCEJOB_H
+#define INFERENCEJOB_H
+
+#include "model/image.hpp"
+#include "misc/cancellationtoken.hpp"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSet>
+#include <QJsonObject>
+#include <QSharedPointer>
+#include <QTemporaryDir>
+
+/*!
+ * \brief The InferenceJob class splits the images that inference is to be run on into
+ * chunks, each of which is processed by a separate run of the inference script. This way
+ * the results of completed chunks are not lost if the network crashes.
+ *
+ * Completed images are recorded in a checkpoint file next to the poses file. A job that is
+ * created for the same config and poses file loads the checkpoint and skips the images that
+ * have already been completed. The checkpoint is removed once all images are done.
+ *
+ * The per-chunk configs and image lists are copies of the user's config and are written
+ * to a temporary directory that lives as long as the job. Unless the config that is passed
+ * sets OUTPUT_FILE, every chunk writes its predictions to its own file in that directory,
+ * so that a network that does not stream its predictions does not rewrite all poses that
+ * were predicted before once per chunk.
+ */
+class InferenceJob
+{
+public:
+    InferenceJob(const QString &configPath,
+                 const QString &posesFilePath,
+                 const QVector<Image> &images,
+                 int chunkSize);
+    ~InferenceJob();
+
+    //! The suffix that is appended to the poses file path to obtain the checkpoint path
+    static const QString CHECKPOINT_SUFFIX;
+
+    /*!
+     * \brief loadCheckpoint loads the checkpoint of an earlier, interrupted run of the
+     * same job. Images that have been completed back then are not run again.
+     * \return the number of images that were skipped because of the checkpoint
+     */
+    int loadCheckpoint();
+    bool saveCheckpoint() const;
+    void removeCheckpoint() const;
+
+    /*!
+     * \brief hasRemainingImages returns whether there are images that have not been
+     * completed yet
+     */
+    bool hasRemainingImages() const;
+
+    /*!
+     * \brief prepareNextChunk writes the config and image list for the next chunk,
+     * i.e. the next images that have not been completed yet. The chunk stays the current
+     * one until all of its images have been completed.
+     * \param basicConfig the paths that have to be set on the config of every chunk
+     * \return the path to the config of the chunk, empty if it could not be written
+     */
+    QString prepareNextChunk(const QJsonObject &basicConfig);
+
+    /*!
+     * \brief peekNextChunk returns the images that prepareNextChunk would put into the
+     * next chunk without preparing it.
+     * \return the paths of the images relative to the images path
+     */
+    QStringList peekNextChunk() const;
+
+    /*!
+     * \brief prefetchChunkAfterCurrent reads the image files of the chunk following the
+     * current one on the global thread pool, so that they are already in the file system
+     * cache when the network gets to them.
+     */
+    void prefetchChunkAfterCurrent();
+
+    void markImageCompleted(const QString &imagePath);
+    void markCurrentChunkCompleted();
+
+    int getNumberOfImages() const;
+    int getNumberOfCompletedImages() const;
+    QStringList getCurrentChunk() const;
+    //! The file that the network writes the predictions of the current chunk to, empty if
+    //! the config set OUTPUT_FILE itself
+    QString getCurrentChunkOutputPath() const;
+
+private:
+    QString configPath;
+    QString posesFilePath;
+    QStringList imagePaths;
+    QStringList absoluteImagePaths;
+    int chunkSize;
+
+    QSet<QString> completedImages;
+    //! Index into imagePaths up to which all images have been completed
+    int firstIncompleteImage = 0;
+    QStringList currentChunk;
+    QString currentChunkOutputPath;
+    int chunkCounter = 0;
+
+    QTemporaryDir workingDirectory;
+    //! Cancels the prefetching when the job is destroyed
+    QSharedPointer<CancellationToken> prefetchCancellationToken;
+
+    QString checkpointPath() const;
+    void advanceFirstIncompleteImage();
+};
+
+#endif // INFERENCEJOB_H
@@ -14,9 +14,28 @@ MainController::MainController() {
     strategy.reset(new JsonLoadAndStoreStrategy(settingsStore.data(),
                                                 settingsIdentifier));
     modelManager.reset(new CachingModelManager(*strategy.data()));
+    imagePyramidCache.reset(new ImagePyramidCache(ImagePyramidCache::defaultDiskCachePath()));
     connect(settingsStore.data(), SIGNAL(settingsChanged(QString)),
             this, SLOT(onSettingsChanged(QString)));
     poseCreator.reset(new PoseCreator(0, modelManager.data()));
+    poseRefiner.reset(new PoseRefiner());
+    // One refinement at a time, it uses all cores already
+    poseRefinementThreadPool.setMaxThreadCount(1);
+    qRegisterMetaType<PoseRefinement>("PoseRefinement");
+    posePropagator.reset(new PosePropagator(modelManager.data()));
+    connect(posePropagator.data(), &PosePropagator::propagationProgress,
+            this, &MainController::onPosePropagationProgress);
+    connect(posePropagator.data(), &PosePropagator::propagationFinished,
+            this, &MainController::onPosePropagationFinished);
+    poseQualityScorer.reset(new PoseQualityScorer());
+    poseQualityThreadPool.setMaxThreadCount(1);
+    qRegisterMetaType<QList<PoseQuality>>("QList<PoseQuality>");
+    visibilityComputer.reset(new VisibilityComputer());
+    visibilityThreadPool.setMaxThreadCount(1);
+    qRegisterMetaType<QList<PoseVisibility>>("QList<PoseVisibility>");
+    penetrationChecker.reset(new PenetrationChecker());
+    penetrationThreadPool.setMaxThreadCount(1);
+    qRegisterMetaType<QList<Penetration>>("QList<Penetration>");
     // Whenever the user clicks the create button in the pose editor we need to reset
     // the controller as well
     connect(modelManager.data(), SIGNAL(poseAdded(QString)),
@@ -24,6 +43,7 @@ MainController::MainController() {
     connect(modelManager.data(), SIGNAL(poseDeleted(QString)),
             this, SLOT(resetPoseCreation()));
     connect(strategy.data(), SIGNAL(failedToLoadImages(QString)), this, SLOT(onFailedToLoadImages(QString)));
+    connect(strategy.data(), SIGNAL(failedToFlushPoses(QString)), this, SLOT(onFailedToFlushPoses(QString)));
 }
 
 MainController::~MainController() {
@@ -35,6 +55,8 @@ MainController::~MainController() {
 
 void MainController::initialize() {
     currentSettings = settingsStore->loadPreferencesByIdentifier(settingsIdentifier);
+    poseCreator->setRobustSolving(currentSettings->getRobustPoseCreation());
+    poseCreator->setInlierThreshold(currentSettings->getPoseCreationInlierThreshold());
     initializeMainWindow();
 }
 
@@ -53,12 +75,16 @@ void MainController::initializeMainWindow() {
 
     // The models do not need to notify the gallery of any changes on the data because the list view
     // has its own update loop, i.e. automatically fetches new data
-    galleryImageModel = new GalleryImageModel(modelManager.data());
+    galleryImageModel = new GalleryImageModel(modelManager.data(), imagePyramidCache.data());
     mainWindow.setGalleryImageModel(galleryImageModel);
     galleryObjectModelModel = new GalleryObjectModelModel(modelManager.data());
     setSegmentationCodesOnGalleryObjectModelModel();
+    poseRefiner->setSegmentationCodes(currentSettings->getSegmentationCodes());
+    posePropagator->setSegmentationCodes(currentSettings->getSegmentationCodes());
+    poseQualityScorer->setSegmentationCodes(currentSettings->getSegmentationCodes());
     mainWindow.setGalleryObjectModelModel(galleryObjectModelModel);
     mainWindow.setModelManager(modelManager.data());
+    mainWindow.setImagePyramidCache(imagePyramidCache.data());
 
     // Delegation of user clicks to this controller
     connect(&mainWindow, SIGNAL(imageClicked(Image*,QPoint)),
@@ -86,6 +112,22 @@ void MainController::initializeMainWindow() {
             this, &MainController::onPosePredictionRequested);
     connect(&mainWindow, &MainWindow::posePredictionRequestedForImages,
             this, &MainController::onPosePredictionRequestedForImages);
+    connect(&mainWindow, &MainWindow::networkStopRequested,
+            this, &MainController::onNetworkStopRequested);
+    connect(&mainWindow, &MainWindow::poseRefinementRequested,
+            this, &MainController::onPoseRefinementRequested);
+    connect(&mainWindow, &MainWindow::posePropagationRequested,
+            this, &MainController::onPosePropagationRequested);
+    connect(&mainWindow, &MainWindow::poseInterpolationRequested,
+            this, &MainController::onPoseInterpolationRequested);
+    connect(&mainWindow, &MainWindow::posePropagationToViewsRequested,
+            this, &MainController::onPosePropagationToViewsRequested);
+    connect(&mainWindow, &MainWindow::poseScoringRequested,
+            this, &MainController::onPoseScoringRequested);
+    connect(&mainWindow, &MainWindow::visibilityComputationRequested,
+            this, &MainController::onVisibilityComputationRequested);
+    connect(&mainWindow, &MainWindow::penetrationCheckRequested,
+            this, &MainController::onPenetrationCheckRequested);
 
 
     mainWindow.onInitializationCompleted();
@@ -114,7 +156,11 @@ void MainController::onObjectModelClicked(ObjectModel* objectModel, QVector3D po
 
 
 void MainController::onPoseCreationInterrupted() {
-    // nothing to do here
+    // The points of one view of a calibrated scene are solved for jointly with the points that
+    // the user clicks in the next view
+    if (!poseCreator->interruptCreation()) {
+        mainWindow.abortPoseCreation();
+    }
 }
 
 void MainController::onPoseCreationAborted() {
@@ -133,7 +179,240 @@ void MainController::resetPoseCreation() {
 void MainController::onPoseCreationRequested() {
     // The user can't request this before all the requirements are met because the creat button
     // is not enabled earlier
-    poseCreator->createPose();
+    bool created = poseCreator->createPose();
+    PnPSolution solution = poseCreator->getLastSolution();
+    QStringList unusedPoints;
+    for (int i = 0; i < solution.inliers.size(); i++) {
+        if (!solution.inliers[i]) {
+            unusedPoints << QString::number(i + 1);
+        }
+    }
+    QString message;
+    if (created) {
+        message = "Created pose from " + QString::number(solution.numberOfInliers) + " of "
+                + QString::number(solution.inliers.size()) + " points, reprojection error "
+                + QString::number(solution.inlierError, 'f', 2) + " px.";
+        if (solution.triangulatedPoints > 0) {
+            message += " " + QString::number(solution.triangulatedPoints)
+                    + " points were triangulated from several views.";
+        }
+    } else if (solution.inliers.isEmpty()) {
+        message = "Could not create a pose, more points are needed.";
+    } else {
+        message = "Could not create a pose, only " + QString::number(solution.numberOfInliers)
+                + " of " + QString::number(solution.inliers.size()) + " points agree.";
+    }
+    if (!unusedPoints.isEmpty()) {
+        message += " Points not agreeing: " + unusedPoints.join(", ") + ".";
+    }
+    mainWindow.setStatusBarText(message);
+}
+
+void MainController::onPoseRefinementRequested(const Pose &pose) {
+    mainWindow.setStatusBarText("Refining pose...");
+    PoseRefinementRunnable *runnable = new PoseRefinementRunnable(poseRefiner.data(), pose);
+    connect(runnable, &PoseRefinementRunnable::poseRefined,
+            this, &MainController::onPoseRefined);
+    poseRefinementThreadPool.start(runnable);
+}
+
+void MainController::onPoseRefined(const QString &poseId, PoseRefinement refinement) {
+    if (!refinement.valid) {
+        mainWindow.setStatusBarText("Could not refine the pose, the object is not visible "
+                                    "or the image could not be read.");
+        return;
+    }
+    mainWindow.onPoseRefined(poseId, refinement.position, refinement.rotation);
+    mainWindow.setStatusBarText("Refined pose, the outline is "
+                                + QString::number(refinement.finalError, 'f', 2)
+                                + " px from the edges of the image on average (before: "
+                                + QString::number(refinement.initialError, 'f', 2)
+                                + " px). Save to keep it.");
+}
+
+void MainController::onPosePropagationRequested(const Pose &pose, int frames) {
+    if (!posePropagator->propagate(pose, frames)) {
+        mainWindow.setStatusBarText("Could not propagate the pose, another pose is still being "
+                                    "propagated.");
+        return;
+    }
+    mainWindow.setStatusBarText("Propagating pose...");
+}
+
+void MainController::onPosePropagationProgress(int trackedFrames, int totalFrames,
+                                               double framesPerSecond) {
+    mainWindow.setStatusBarText("Propagating pose, image " + QString::number(trackedFrames)
+                                + " of at most " + QString::number(totalFrames) + " ("
+                                + QString::number(framesPerSecond, 'f', 1) + " images/s)...");
+}
+
+void MainController::onPosePropagationFinished(const QStringList &addedPoses,
+                                               int trackedFrames, double framesPerSecond) {
+    mainWindow.setStatusBarText("Propagated pose to " + QString::number(addedPoses.size())
+                                + " images, tracked through " + QString::number(trackedFrames)
+                                + " images at " + QString::number(framesPerSecond, 'f', 1)
+                                + " images/s. Review the new poses in the pose editor.");
+}
+
+void MainController::onPoseInterpolationRequested() {
+    QList<Image> images = modelManager->getImages();
+    QList<Pose> poses = poseInterpolator.interpolate(images, modelManager->getPoses());
+    if (poses.isEmpty()) {
+        mainWindow.setStatusBarText("No images to interpolate, annotate the same object in "
+                                    "two images of a sequence first.");
+        return;
+    }
+    // All at once, a single write of the poses file instead of one per image
+    QStringList addedPoses = modelManager->addObjectImagePoses(poses);
+    mainWindow.setStatusBarText("Interpolated " + QString::number(addedPoses.size())
+                                + " poses between keyframes.");
+}
+
+void MainController::onPosePropagationToViewsRequested(const Image &image) {
+    if (!image.hasExtrinsics()) {
+        mainWindow.setStatusBarText("Can't propagate the poses, the info.json has no "
+                                    "extrinsics R and t for this image.");
+        return;
+    }
+    QList<Image> images = modelManager->getImages();
+    QList<Pose> existingPoses = modelManager->getPoses();
+    QList<Pose> propagatedPoses;
+    for (const Pose &pose : modelManager->getPosesForImage(image)) {
+        // The poses propagated so far count as existing, two annotations of the same object
+        // must not both end up in the other views
+        propagatedPoses += multiViewPropagator.propagate(pose, images,
+                                                         existingPoses + propagatedPoses);
+    }
+    QStringList addedPoses;
+    if (!propagatedPoses.isEmpty()) {
+        addedPoses = modelManager->addObjectImagePoses(propagatedPoses);
+    }
+    mainWindow.setStatusBarText("Propagated " + QString::number(addedPoses.size())
+                                + " poses to the other views of the scene.");
+}
+
+void MainController::onPoseScoringRequested() {
+    if (poseQualityThreadPool.activeThreadCount() > 0) {
+        mainWindow.setStatusBarText("The poses are still being scored.");
+        return;
+    }
+    QList<Pose> poses = modelManager->getPoses();
+    PoseQualityRunnable *runnable = new PoseQualityRunnable(poseQualityScorer.data(),
+                                                            modelManager->getImages(),
+                                                            modelManager->getObjectModels(),
+                                                            poses);
+    connect(runnable, &PoseQualityRunnable::posesScored,
+            this, &MainController::onPosesScored);
+    poseQualityThreadPool.start(runnable);
+    mainWindow.setStatusBarText("Scoring " + QString::number(poses.size())
+                                + " poses against the segmentation images...");
+}
+
+void MainController::onPosesScored(const QList<PoseQuality> &qualities) {
+    const PoseQuality *worst = Q_NULLPTR;
+    int scored = 0;
+    float iouSum = 0.f, boundaryFScoreSum = 0.f;
+    for (const PoseQuality &quality : qualities) {
+        if (!quality.valid) {
+            continue;
+        }
+        scored++;
+        iouSum += quality.iou;
+        boundaryFScoreSum += quality.boundaryFScore;
+        if (!worst || quality.iou < worst->iou) {
+            worst = &quality;
+        }
+    }
+    galleryImageModel->setQualityScores(PoseQualityScorer::worstScores(qualities));
+    if (scored == 0) {
+        mainWindow.setStatusBarText("Could not score any pose, the images need segmentation "
+                                    "images.");
+        return;
+    }
+    mainWindow.setStatusBarText("Scored " + QString::number(scored) + " of "
+                                + QString::number(qualities.size()) + " poses, mean IoU "
+                                + QString::number(iouSum / scored, 'f', 3)
+                                + ", mean boundary F-score "
+                                + QString::number(boundaryFScoreSum / scored, 'f', 3)
+                                + ", worst IoU " + QString::number(worst->iou, 'f', 3)
+                                + " in " + worst->imagePath
+                                + ". Sort or filter the images by score in the Edit menu.");
+}
+
+void MainController::onVisibilityComputationRequested() {
+    if (visibilityThreadPool.activeThreadCount() > 0) {
+        mainWindow.setStatusBarText("The visibility of the poses is still being computed.");
+        return;
+    }
+    QList<Pose> poses = modelManager->getPoses();
+    VisibilityRunnable *runnable = new VisibilityRunnable(
+                visibilityComputer.data(), modelManager->getImages(),
+                modelManager->getObjectModels(), poses,
+                VisibilityComputer::cachePath(currentSettings->getPosesFilePath()));
+    connect(runnable, &VisibilityRunnable::visibilitiesComputed,
+            this, &MainController::onVisibilitiesComputed);
+    visibilityThreadPool.start(runnable);
+    mainWindow.setStatusBarText("Computing the visibility of " + QString::number(poses.size())
+                                + " poses...");
+}
+
+void MainController::onVisibilitiesComputed(const QList<PoseVisibility> &visibilities,
+                                            int cachedImages) {
+    int computed = 0, mostlyOccluded = 0;
+    for (const PoseVisibility &visibility : visibilities) {
+        if (visibility.valid) {
+            computed++;
+            mostlyOccluded += visibility.visibleFraction < 0.1f ? 1 : 0;
+        }
+    }
+    mainWindow.setStatusBarText("Computed the visibility of " + QString::number(computed)
+                                + " of " + QString::number(visibilities.size()) + " poses ("
+                                + QString::number(cachedImages) + " images unchanged), "
+                                + QString::number(mostlyOccluded)
+                                + " are less than 10 % visible. Written to "
+                                + VisibilityComputer::cachePath(
+                                      currentSettings->getPosesFilePath()) + ".");
+}
+
+void MainController::onPenetrationCheckRequested() {
+    if (penetrationThreadPool.activeThreadCount() > 0) {
+        mainWindow.setStatusBarText("The poses are still being checked for penetrations.");
+        return;
+    }
+    QList<Pose> poses = modelManager->getPoses();
+    PenetrationCheckRunnable *runnable = new PenetrationCheckRunnable(
+                penetrationChecker.data(), modelManager->getImages(),
+                modelManager->getObjectModels(), poses);
+    connect(runnable, &PenetrationCheckRunnable::penetrationsChecked,
+            this, &MainController::onPenetrationsChecked);
+    penetrationThreadPool.start(runnable);
+    mainWindow.setStatusBarText("Checking " + QString::number(poses.size())
+                                + " poses for penetrations...");
+}
+
+void MainController::onPenetrationsChecked(const QList<Penetration> &penetrations) {
+    if (penetrations.isEmpty()) {
+        mainWindow.setStatusBarText("No poses penetrate each other.");
+        return;
+    }
+    mainWindow.setStatusBarText(QString::number(penetrations.size())
+                                + " pairs of poses penetrate each other, the deepest by "
+                                + QString::number(penetrations.first().depth, 'g', 4)
+                                + " in " + penetrations.first().imagePath + ".");
+    // The deepest ones, the command line tool writes all of them
+    const int shown = 10;
+    QString text = "The deepest penetrating pairs of poses:\n";
+    for (int i = 0; i < penetrations.size() && i < shown; i++) {
+        const Penetration &penetration = penetrations[i];
+        text += "\n" + penetration.imagePath + ": " + penetration.poseId1 + " ("
+                + penetration.objectModelPath1 + ") and " + penetration.poseId2 + " ("
+                + penetration.objectModelPath2 + ") by "
+                + QString::number(penetration.depth, 'g', 4);
+    }
+    if (penetrations.size() > shown) {
+        text += "\n\nand " + QString::number(penetrations.size() - shown) + " more.";
+    }
+    mainWindow.displayWarning("Penetrating poses", text);
 }
 
 void MainController::onPosePredictionRequested() {
@@ -158,11 +437,23 @@ void MainController::performPosePredictionForImages(QList<Image> images) {
                                                 currentSettings->getInferenceScriptPath()));
         connect(networkController.data(), &NeuralNetworkController::inferenceFinished,
                 this, &MainController::onNetworkInferenceFinished);
+        connect(networkController.data(), &NeuralNetworkController::networkStopped,
+                this, &MainController::onNetworkInferenceFinished);
+        connect(networkController.data(), &NeuralNetworkController::progressChanged,
+                &mainWindow, &MainWindow::setNetworkProgress);
+        connect(networkController.data(), &NeuralNetworkController::throughputChanged,
+                &mainWindow, &MainWindow::setNetworkThroughput);
+        connect(networkController.data(), &NeuralNetworkController::inferenceFailed,
+                this, &MainController::onNetworkInferenceFailed);
     } else {
         networkController->setPythonInterpreter(currentSettings->getPythonInterpreterPath());
         networkController->setTrainPythonScript(currentSettings->getTrainingScriptPath());
         networkController->setInferencePythonScript(currentSettings->getInferenceScriptPath());
     }
+    networkController->setModelManager(modelManager.data());
+    networkController->setInferenceChunkSize(currentSettings->getInferenceChunkSize());
+    networkController->setUseSharedMemoryTransport(currentSettings->getUseSharedMemoryTransport());
+    networkController->setImagePyramidCache(imagePyramidCache.data());
     networkController->setImages(images.toVector());
     networkController->setPosesFilePath(currentSettings->getPosesFilePath());
     networkController->setImagesPath(currentSettings->getImagesPath());
@@ -178,6 +469,17 @@ void MainController::onNetworkInferenceFinished() {
     mainWindow.hideNetworkProgressView();
 }
 
+void MainController::onNetworkInferenceFailed(const QString &message) {
+    mainWindow.hideNetworkProgressView();
+    mainWindow.displayWarning("Network inference failed", message);
+}
+
+void MainController::onNetworkStopRequested() {
+    if (!networkController.isNull()) {
+        networkController->stop();
+    }
+}
+
 void MainController::onFailedToLoadImages(const QString &message){
     QString imagesPath = currentSettings->getImagesPath();
     if (imagesPath != "." && imagesPath != "") {
@@ -189,9 +491,18 @@ void MainController::onFailedToLoadImages(const QString &message){
     }
 }
 
+void MainController::onFailedToFlushPoses(const QString &message) {
+    mainWindow.displayWarning("Error saving poses", message);
+}
+
 void MainController::onSettingsChanged(const QString &identifier) {
     currentSettings = settingsStore->loadPreferencesByIdentifier(identifier);
     // Load and store strategy updates itself
     setSegmentationCodesOnGalleryObjectModelModel();
+    poseRefiner->setSegmentationCodes(currentSettings->getSegmentationCodes());
+    posePropagator->setSegmentationCodes(currentSettings->getSegmentationCodes());
+    poseQualityScorer->setSegmentationCodes(currentSettings->getSegmentationCodes());
     poseCreator->abortCreation();
+    poseCreator->setRobustSolving(currentSettings->getRobustPoseCreation());
+    poseCreator->setInlierThreshold(currentSettings->getPoseCreationInlierThreshold());
 }
@@ -8,13 +8,22 @@
 #include "misc/global.h"
 #include "view/gallery/galleryobjectmodelmodel.hpp"
 #include "view/gallery/galleryimagemodel.hpp"
+#include "misc/imageloading/imagepyramidcache.hpp"
 #include "controller/poserecoverer.hpp"
 #include "controller/neuralnetworkcontroller.hpp"
+#include "misc/geometry/poserefiner.hpp"
+#include "controller/posepropagator.hpp"
+#include "controller/poseinterpolator.hpp"
+#include "controller/multiviewpropagator.hpp"
+#include "misc/evaluation/posequalityscorer.hpp"
+#include "misc/evaluation/visibilitycomputer.hpp"
+#include "misc/evaluation/penetrationchecker.hpp"
 
 #include <QScopedPointer>
 #include <QSharedPointer>
 #include <QMap>
 #include <QList>
+#include <QThreadPool>
 
 //! This class is responsible for the overall program to work.
 //! It maintains references to all the important parts and
@@ -41,8 +50,27 @@ private:
     QScopedPointer<JsonLoadAndStoreStrategy> strategy;
     QScopedPointer<CachingModelManager> modelManager;
     UniquePointer<PoseCreator> poseCreator;
+    // Declared before the network controller and the main window so that it outlives the
+    // image transport and the views that load through it
+    QScopedPointer<ImagePyramidCache> imagePyramidCache;
     QScopedPointer<NeuralNetworkController> networkController;
     MainWindow mainWindow;
+    QScopedPointer<PoseRefiner> poseRefiner;
+    // Declared after the refiner so that running refinements finish before it is destroyed
+    QThreadPool poseRefinementThreadPool;
+    QScopedPointer<PosePropagator> posePropagator;
+    PoseInterpolator poseInterpolator;
+    MultiViewPropagator multiViewPropagator;
+    QScopedPointer<PoseQualityScorer> poseQualityScorer;
+    // Declared after the scorer so that a running scoring finishes before it is destroyed
+    QThreadPool poseQualityThreadPool;
+    QScopedPointer<VisibilityComputer> visibilityComputer;
+    // Declared after the computer so that a running computation finishes before it is
+    // destroyed
+    QThreadPool visibilityThreadPool;
+    QScopedPointer<PenetrationChecker> penetrationChecker;
+    // Declared after the checker so that a running check finishes before it is destroyed
+    QThreadPool penetrationThreadPool;
 
     QMap<QString, ObjectModel*> segmentationCodes;
     QSharedPointer<SettingsStore> settingsStore;
@@ -66,12 +94,29 @@ private Q_SLOTS:
     void onSettingsChanged(const QString &identifier);
     void resetPoseCreation();
     void onPoseCreationRequested();
+    void onPoseRefinementRequested(const Pose &pose);
+    void onPoseRefined(const QString &poseId, PoseRefinement refinement);
+    void onPosePropagationRequested(const Pose &pose, int frames);
+    void onPosePropagationProgress(int trackedFrames, int totalFrames, double framesPerSecond);
+    void onPosePropagationFinished(const QStringList &addedPoses, int trackedFrames,
+                                   double framesPerSecond);
+    void onPoseInterpolationRequested();
+    void onPosePropagationToViewsRequested(const Image &image);
+    void onPoseScoringRequested();
+    void onPosesScored(const QList<PoseQuality> &qualities);
+    void onVisibilityComputationRequested();
+    void onVisibilitiesComputed(const QList<PoseVisibility> &visibilities, int cachedImages);
+    void onPenetrationCheckRequested();
+    void onPenetrationsChecked(const QList<Penetration> &penetrations);
     void onPosePredictionRequested();
     void onPosePredictionRequestedForImages(QList<Image> images);
     void performPosePredictionForImages(QList<Image> images);
     void onNetworkTrainingFinished();
     void onNetworkInferenceFinished();
+    void onNetworkInferenceFailed(const QString &message);
+    void onNetworkStopRequested();
     void onFailedToLoadImages(const QString &message);
+    void onFailedToFlushPoses(const QString &message);
 };
 
 #endif // MAINCONTROLLER_H
@@ -0,0 +1,93 @@
+#include "multiviewpropagator.hpp"
+
+#include <QPointF>
+#include <QtDebug>
+
+static QVector3D rotate(const QMatrix3x3 &rotation, const QVector3D &point) {
+    return QVector3D(
+        rotation(0, 0) * point.x() + rotation(0, 1) * point.y() + rotation(0, 2) * point.z(),
+        rotation(1, 0) * point.x() + rotation(1, 1) * point.y() + rotation(1, 2) * point.z(),
+        rotation(2, 0) * point.x() + rotation(2, 1) * point.y() + rotation(2, 2) * point.z());
+}
+
+//! Projects a point in camera coordinates to pixels
+static QPointF project(const QMatrix3x3 &cameraMatrix, const QVector3D &point) {
+    QVector3D projected = rotate(cameraMatrix, point);
+    return QPointF(projected.x() / projected.z(), projected.y() / projected.z());
+}
+
+MultiViewPropagator::MultiViewPropagator() {
+}
+
+QList<Pose> MultiViewPropagator::propagate(const Pose &pose, const QList<Image> &images,
+                                           const QList<Pose> &existingPoses) const {
+    const Image *image = pose.getImage();
+    if (!image->hasExtrinsics()) {
+        qWarning() << "Can't propagate pose" << pose.getID() << "to other views,"
+                   << image->getImagePath() << "has no extrinsics.";
+        return QList<Pose>();
+    }
+    // x_camera = R_camera * x_world + t_camera and x_camera = R_pose * x_model + t_pose
+    QMatrix3x3 inverseRotation = image->getWorldRotation().transposed();
+    QVector3D worldPosition = rotate(inverseRotation,
+                                     pose.getPosition() - image->getWorldTranslation());
+    QMatrix3x3 worldRotation = inverseRotation * pose.getRotation();
+
+    QList<Pose> propagatedPoses;
+    for (const Pose &propagatedPose : instantiate(worldPosition, worldRotation,
+                                                  pose.getObjectModel(), image->getScene(),
+                                                  images, existingPoses)) {
+        if (propagatedPose.getImage()->getImagePath() != image->getImagePath()) {
+            propagatedPoses.append(propagatedPose);
+        }
+    }
+    return propagatedPoses;
+}
+
+QList<Pose> MultiViewPropagator::instantiate(const QVector3D &worldPosition,
+                                             const QMatrix3x3 &worldRotation,
+                                             const ObjectModel *objectModel,
+                                             const QString &scene,
+                                             const QList<Image> &images,
+                                             const QList<Pose> &existingPoses) const {
+    QList<Pose> poses;
+    for (const Image &view : images) {
+        if (!view.hasExtrinsics() || view.getScene() != scene) {
+            continue;
+        }
+        QVector3D position = rotate(view.getWorldRotation(), worldPosition)
+                + view.getWorldTranslation();
+        if (position.z() <= 0.f) {
+            // Behind the camera
+            continue;
+        }
+        if (hasDuplicate(view, objectModel, position, existingPoses)) {
+            continue;
+        }
+        poses.append(Pose(QString(), position, view.getWorldRotation() * worldRotation,
+                          &view, objectModel));
+    }
+    return poses;
+}
+
+void MultiViewPropagator::setDuplicateDistance(float duplicateDistance) {
+    this->duplicateDistance = duplicateDistance;
+}
+
+bool MultiViewPropagator::hasDuplicate(const Image &image, const ObjectModel *objectModel,
+                                       const QVector3D &position,
+                                       const QList<Pose> &existingPoses) const {
+    QPointF projected = project(image.getCameraMatrix(), position);
+    for (const Pose &existingPose : existingPoses) {
+        if (existingPose.getImage()->getImagePath() != image.getImagePath()
+                || existingPose.getObjectModel()->getPath() != objectModel->getPath()
+                || existingPose.getPosition().z() <= 0.f) {
+            continue;
+        }
+        QPointF offset = project(image.getCameraMatrix(), existingPose.getPosition()) - projected;
+        if (QPointF::dotProduct(offset, offset) < duplicateDistance * duplicateDistance) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,62 @@
+#ifndef MULTIVIEWPROPAGATOR_H
+#define MULTIVIEWPROPAGATOR_H
+
+#include "model/image.hpp"
+#include "model/objectmodel.hpp"
+#include "model/pose.hpp"
+
+#include <QList>
+#include <QMatrix3x3>
+#include <QVector3D>
+
+/*!
+ * \brief The MultiViewPropagator class transfers poses between the views of a scene that was
+ * captured by calibrated cameras, i.e. between images with extrinsics and the same scene,
+ * see Image::hasExtrinsics().
+ *
+ * A pose annotated in one view is transformed to the world frame with the extrinsics of its
+ * image and from there to the frame of every other view. Views that show the object at the
+ * propagated pose already, i.e. that have a pose of the same object model whose origin
+ * projects close to the propagated one, are skipped, so that propagating twice does not
+ * duplicate poses. The caller adds the returned poses in one batch, see
+ * ModelManager::addObjectImagePoses.
+ */
+class MultiViewPropagator
+{
+public:
+    MultiViewPropagator();
+
+    /*!
+     * \brief propagate computes the poses of the given pose in all other views of its scene.
+     * \param pose the annotated pose, its image has to have extrinsics
+     * \param images the images to search for the other views
+     * \param existingPoses the poses that the images have already
+     * \return the poses without IDs, they refer to the given images and the object model of
+     * the given pose
+     */
+    QList<Pose> propagate(const Pose &pose, const QList<Image> &images,
+                          const QList<Pose> &existingPoses) const;
+
+    /*!
+     * \brief instantiate computes the poses of an object that is given in the world frame of
+     * a scene in all views of the scene.
+     */
+    QList<Pose> instantiate(const QVector3D &worldPosition, const QMatrix3x3 &worldRotation,
+                            const ObjectModel *objectModel, const QString &scene,
+                            const QList<Image> &images,
+                            const QList<Pose> &existingPoses) const;
+
+    /*!
+     * \brief setDuplicateDistance sets the distance in pixels between the projected origins
+     * below which a pose in a view is considered to be the propagated one, defaults to 20
+     */
+    void setDuplicateDistance(float duplicateDistance);
+
+private:
+    float duplicateDistance = 20.f;
+
+    bool hasDuplicate(const Image &image, const ObjectModel *objectModel,
+                      const QVector3D &position, const QList<Pose> &existingPoses) const;
+};
+
+#endif // MULTIVIEWPROPAGATOR_H
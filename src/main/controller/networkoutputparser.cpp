@@ -0,0 +1,62 @@
+#include "networkoutputparser.hpp"
+
+#include <QJsonDocument>
+#include <QJsonParseError>
+
+const QString NetworkOutputParser::RECORD_TYPE_KEY = "type";
+const QString NetworkOutputParser::RECORD_TYPE_PREDICTION = "prediction";
+const QString NetworkOutputParser::RECORD_TYPE_PROGRESS = "progress";
+
+void NetworkOutputParser::append(const QByteArray &output) {
+    buffer.append(output);
+    int newLineIndex = buffer.indexOf('\n');
+    while (newLineIndex != -1) {
+        parseLine(buffer.left(newLineIndex));
+        buffer.remove(0, newLineIndex + 1);
+        newLineIndex = buffer.indexOf('\n');
+    }
+}
+
+void NetworkOutputParser::flush() {
+    if (!buffer.isEmpty()) {
+        parseLine(buffer);
+        buffer.clear();
+    }
+}
+
+QList<QJsonObject> NetworkOutputParser::takeRecords() {
+    QList<QJsonObject> result = records;
+    records.clear();
+    return result;
+}
+
+QStringList NetworkOutputParser::takeMessages() {
+    QStringList result = messages;
+    messages.clear();
+    return result;
+}
+
+void NetworkOutputParser::reset() {
+    buffer.clear();
+    records.clear();
+    messages.clear();
+}
+
+void NetworkOutputParser::parseLine(const QByteArray &line) {
+    QByteArray trimmedLine = line.trimmed();
+    if (trimmedLine.isEmpty()) {
+        return;
+    }
+    //! Only try to parse lines that look like JSON objects, everything else
+    //! is normal output of the network (e.g. print statements)
+    if (trimmedLine.startsWith('{')) {
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(trimmedLine, &error);
+        if (error.error == QJsonParseError::NoError && document.isObject()
+                && document.object().contains(RECORD_TYPE_KEY)) {
+            records.append(document.object());
+            return;
+        }
+    }
+    messages.append(QString::fromUtf8(trimmedLine));
+}
@@ -0,0 +1,68 @@
+#ifndef NETWORKOUTPUTPARSER_H
+#define NETWORKOUTPUTPARSER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QList>
+#include <QStringList>
+
+/*!
+ * \brief The NetworkOutputParser class incrementally parses what the network process writes
+ * to its standard output. Besides normal log output the network can stream structured records,
+ * which are JSON objects on a single line with a "type" field, e.g.
+ *
+ * {"type": "prediction", "image": "0001.jpg", "poses": [{"obj": "obj_01.ply", "R": [...], "t": [...]}]}
+ * {"type": "progress", "current": 12, "total": 100}
+ *
+ * The output arrives in arbitrary chunks, which is why incomplete lines are kept back until
+ * the rest of the line has been appended. Every complete line that is not a record is
+ * treated as a message.
+ */
+class NetworkOutputParser
+{
+public:
+    static const QString RECORD_TYPE_KEY;
+    static const QString RECORD_TYPE_PREDICTION;
+    static const QString RECORD_TYPE_PROGRESS;
+
+    /*!
+     * \brief append appends the given raw output of the network and parses all lines
+     * that are complete afterwards.
+     * \param output the raw output as read from the process
+     */
+    void append(const QByteArray &output);
+
+    /*!
+     * \brief flush parses what is left in the buffer even though the line has not been
+     * terminated. This should be called when the process has finished.
+     */
+    void flush();
+
+    /*!
+     * \brief takeRecords returns all records parsed since the last call and removes them
+     * from the parser.
+     * \return the parsed records in the order they were written by the network
+     */
+    QList<QJsonObject> takeRecords();
+
+    /*!
+     * \brief takeMessages returns all lines that were not records since the last call
+     * and removes them from the parser.
+     * \return the lines that were not records
+     */
+    QStringList takeMessages();
+
+    /*!
+     * \brief reset discards any buffered output, records and messages.
+     */
+    void reset();
+
+private:
+    QByteArray buffer;
+    QList<QJsonObject> records;
+    QStringList messages;
+
+    void parseLine(const QByteArray &line);
+};
+
+#endif // NETWORKOUTPUTPARSER_H
@@ -4,9 +4,66 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QFile>
-#include <QThreadPool>
 #include <QDir>
 #include <QProcess>
+#include <QMap>
+#include <QMultiMap>
+#include <QMatrix3x3>
+#include <QVector3D>
+#include <QTimer>
+#include <QThreadPool>
+#include <QtDebug>
+
+#ifdef Q_OS_LINUX
+#include <signal.h>
+#include <sys/types.h>
+#endif
+
+const int NeuralNetworkController::TERMINATION_GRACE_PERIOD = 3000;
+
+#ifdef Q_OS_LINUX
+//! Collects the IDs of all processes that descend from the given process by walking the
+//! parent IDs in /proc. The children have to be collected before the parent is terminated,
+//! afterwards they are reparented and cannot be found anymore.
+static QList<qint64> descendantProcessIds(qint64 rootProcessId) {
+    QMultiMap<qint64, qint64> childrenOfProcess;
+    QDir procDir("/proc");
+    for (const QString &entry : procDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        bool isProcess = false;
+        qint64 processId = entry.toLongLong(&isProcess);
+        if (!isProcess) {
+            continue;
+        }
+        QFile statFile(procDir.filePath(entry + "/stat"));
+        if (!statFile.open(QFile::ReadOnly)) {
+            // The process has exited in the meantime
+            continue;
+        }
+        QByteArray stat = statFile.readAll();
+        // Format is "pid (comm) state ppid ...", comm can contain spaces and parentheses
+        int commEnd = stat.lastIndexOf(')');
+        if (commEnd == -1) {
+            continue;
+        }
+        QList<QByteArray> fields = stat.mid(commEnd + 2).split(' ');
+        if (fields.size() > 1) {
+            childrenOfProcess.insert(fields[1].toLongLong(), processId);
+        }
+    }
+
+    QList<qint64> result;
+    QList<qint64> processesToVisit;
+    processesToVisit << rootProcessId;
+    while (!processesToVisit.isEmpty()) {
+        qint64 processId = processesToVisit.takeFirst();
+        for (qint64 child : childrenOfProcess.values(processId)) {
+            result << child;
+            processesToVisit << child;
+        }
+    }
+    return result;
+}
+#endif
 
 NeuralNetworkController::NeuralNetworkController(const QString &pythonInterpreter,
                                                  const QString &trainPythonScript,
@@ -14,40 +71,152 @@ NeuralNetworkController::NeuralNetworkController(const QString &pythonInterprete
     pythonInterpreter(pythonInterpreter),
     trainPythonScript(trainPythonScript),
     inferencePythonScript(inferencePythonScript) {
-    connect(&queryTimer, &QTimer::timeout, this, &NeuralNetworkController::writeOutput);
+    imageTransportThreadPool.setMaxThreadCount(1);
 }
 
 NeuralNetworkController::~NeuralNetworkController() {
-    QThreadPool::globalInstance()->clear();
+    if (networkProcess) {
+        cancellationToken->cancel();
+        disconnect(networkProcess, 0, this, 0);
+        terminateProcessTree(networkProcess, true);
+        networkProcess->waitForFinished(TERMINATION_GRACE_PERIOD);
+    }
+    killTerminatedProcesses();
 }
 
 void NeuralNetworkController::training(const QString &configPath) {
-    if (networkRunnable) {
-        QThreadPool::globalInstance()->waitForDone();
+    if (networkProcess) {
+        // Only one network can run at a time, the previous run is not of interest anymore
+        stop();
     }
-    networkRunnable = new NeuralNetworkRunnable(pythonInterpreter, trainPythonScript);
     setPathsOnConfig(configPath);
-    networkRunnable->setConfigPath(configPath);
-    connect(networkRunnable, &NeuralNetworkRunnable::processFinished,
-            this, &NeuralNetworkController::onTrainingFinished);
-    QThreadPool::globalInstance()->start(networkRunnable);
-    queryTimer.start(1000);
+    startNetwork(trainPythonScript, configPath, false);
     Q_EMIT trainingStarted();
 }
 
 void NeuralNetworkController::inference(const QString &configPath) {
-
-    if (networkRunnable) {
-        QThreadPool::globalInstance()->waitForDone();
+    if (networkProcess) {
+        stop();
     }
-    networkRunnable = new NeuralNetworkRunnable(pythonInterpreter, inferencePythonScript);
-    setPathsOnConfig(configPath);
-    networkRunnable->setConfigPath(configPath);
-    connect(networkRunnable, &NeuralNetworkRunnable::processFinished,
-            this, &NeuralNetworkController::onInferenceFinished);
-    QThreadPool::globalInstance()->start(networkRunnable);
-    queryTimer.start(1000);
+    if (modelManager) {
+        objectModels = modelManager->getObjectModels();
+    }
+    imageIndices.clear();
+    for (int i = 0; i < images.size(); i++) {
+        imageIndices[images[i].getImagePath()] = i;
+    }
+    inferenceJob.reset(new InferenceJob(configPath, posesFilePath, images, inferenceChunkSize));
+    int skippedImages = inferenceJob->loadCheckpoint();
+    if (skippedImages > 0) {
+        qDebug() << "Resuming inference, skipping " + QString::number(skippedImages)
+                    + " images that have already been completed.";
+    }
+    completedImagesOnStart = inferenceJob->getNumberOfCompletedImages();
+    failedAttemptsOfChunk = 0;
+    inferenceTimer.start();
     Q_EMIT inferenceStarted();
+    startNextInferenceChunk();
+}
+
+void NeuralNetworkController::startNextInferenceChunk() {
+    if (!inferenceJob->hasRemainingImages()) {
+        finishInference();
+        return;
+    }
+    QJsonObject config = pathsForConfig();
+    if (modelManager) {
+        //! The chunk writes to a file of its own (see InferenceJob), the network would
+        //! otherwise read and write all poses once per chunk
+        config.remove("OUTPUT_FILE");
+    }
+    QSharedPointer<SharedMemoryImageTransport> transport;
+    QVector<Image> chunkImages;
+    if (useSharedMemoryTransport) {
+        QStringList absoluteImagePaths;
+        for (const QString &imagePath : inferenceJob->peekNextChunk()) {
+            const Image &image = images.at(imageIndices.value(imagePath));
+            chunkImages << image;
+            absoluteImagePaths << image.getAbsoluteImagePath();
+        }
+        transport.reset(new SharedMemoryImageTransport(
+                            SharedMemoryImageTransport::createName(),
+                            SharedMemoryImageTransport::DEFAULT_NUMBER_OF_SLOTS,
+                            SharedMemoryImageTransport::requiredSlotCapacity(absoluteImagePaths)));
+        if (transport->isValid()) {
+            QJsonObject transportEntries = transport->configEntries();
+            for (const QString &key : transportEntries.keys()) {
+                config[key] = transportEntries[key];
+            }
+        } else {
+            // The network falls back to reading the images from disk
+            transport.reset();
+        }
+    }
+    QString chunkConfigPath = inferenceJob->prepareNextChunk(config);
+    if (chunkConfigPath.isEmpty()) {
+        inferenceJob.reset();
+        objectModels.clear();
+        Q_EMIT inferenceFailed("Could not write the network config for the next images.");
+        return;
+    }
+    completedImagesBeforeChunk = inferenceJob->getNumberOfCompletedImages();
+    startNetwork(inferencePythonScript, chunkConfigPath, true);
+    if (transport) {
+        imageTransport = transport;
+        imageTransportThreadPool.start(new SharedMemoryImageWriterRunnable(
+                                           transport, chunkImages, cancellationToken,
+                                           imagePyramidCache));
+    }
+    // Pipelining, the network reads the images of the current chunk while the ones of the
+    // next chunk are being loaded into the file system cache
+    inferenceJob->prefetchChunkAfterCurrent();
+    reportInferenceProgress();
+}
+
+void NeuralNetworkController::finishInference() {
+    inferenceJob->removeCheckpoint();
+    inferenceJob.reset();
+    objectModels.clear();
+    Q_EMIT inferenceFinished();
+}
+
+void NeuralNetworkController::reportInferenceProgress() {
+    if (!inferenceJob) {
+        return;
+    }
+    int completedImages = inferenceJob->getNumberOfCompletedImages();
+    Q_EMIT progressChanged(completedImages, inferenceJob->getNumberOfImages());
+    qint64 elapsed = inferenceTimer.elapsed();
+    if (elapsed > 0 && completedImages > completedImagesOnStart) {
+        Q_EMIT throughputChanged((completedImages - completedImagesOnStart) * 1000.0 / elapsed);
+    }
+}
+
+void NeuralNetworkController::startNetwork(const QString &pythonScript,
+                                           const QString &configPath,
+                                           bool inference) {
+    outputParser.reset();
+    runningInference = inference;
+    cancellationToken.reset(new CancellationToken());
+
+    networkProcess = new QProcess(this);
+    // Only stdout carries records, stderr (e.g. warnings of the framework) is passed through
+    // to our stderr instead of piling up in the process's buffer
+    networkProcess->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    connect(networkProcess, &QProcess::readyReadStandardOutput,
+            this, &NeuralNetworkController::onNetworkOutputReceived);
+    connect(networkProcess, &QProcess::errorOccurred,
+            this, &NeuralNetworkController::onNetworkErrorOccurred);
+    if (inference) {
+        connect(networkProcess, SIGNAL(finished(int,QProcess::ExitStatus)),
+                this, SLOT(onInferenceChunkFinished(int,QProcess::ExitStatus)));
+    } else {
+        connect(networkProcess, SIGNAL(finished(int,QProcess::ExitStatus)),
+                this, SLOT(onTrainingFinished()));
+    }
+    qDebug() << "Running network with configuration: " + configPath;
+    networkProcess->start(pythonInterpreter,
+                          QStringList() << pythonScript << "--config" << configPath);
 }
 
 void NeuralNetworkController::setImages(const QVector<Image> &images) {
@@ -59,11 +228,72 @@ void NeuralNetworkController::setPosesFilePath(const QString &filePath) {
 }
 
 void NeuralNetworkController::stop() {
-    if (networkRunnable) {
-        queryTimer.stop();
-        QThreadPool::globalInstance()->clear();
-        Q_EMIT networkStopped();
+    if (!networkProcess) {
+        return;
+    }
+    cancellationToken->cancel();
+    QProcess *process = networkProcess;
+    networkProcess = Q_NULLPTR;
+    // The run is over for the rest of the program, whatever the process still does is
+    // not of interest anymore
+    disconnect(process, 0, this, 0);
+    connect(process, SIGNAL(finished(int,QProcess::ExitStatus)), process, SLOT(deleteLater()));
+    terminateProcessTree(process, false);
+    imageTransport.reset();
+    outputParser.reset();
+    objectModels.clear();
+    if (inferenceJob) {
+        // Keep what has been completed so far so that the user can resume
+        inferenceJob->saveCheckpoint();
+        inferenceJob.reset();
+    }
+    qDebug() << "Network stopped.";
+    Q_EMIT networkStopped();
+}
+
+bool NeuralNetworkController::isRunning() const {
+    return networkProcess != Q_NULLPTR;
+}
+
+void NeuralNetworkController::terminateProcessTree(QProcess *process, bool immediately) {
+    if (process->state() == QProcess::NotRunning) {
+        return;
+    }
+#ifdef Q_OS_LINUX
+    QList<qint64> childProcessIds = descendantProcessIds(process->processId());
+    for (qint64 childProcessId : childProcessIds) {
+        ::kill((pid_t) childProcessId, immediately ? SIGKILL : SIGTERM);
+    }
+    terminatedChildProcessIds.append(childProcessIds);
+#elif defined(Q_OS_WIN)
+    // Windows has no notion of terminating gracefully for console programs, taskkill
+    // at least takes care of the children
+    QProcess::execute("taskkill", QStringList() << "/T" << "/F" << "/PID"
+                                                << QString::number(process->processId()));
+#endif
+    if (immediately) {
+        process->kill();
+        return;
+    }
+    process->terminate();
+    terminatedProcesses << QPointer<QProcess>(process);
+    QTimer::singleShot(TERMINATION_GRACE_PERIOD, this, SLOT(killTerminatedProcesses()));
+}
+
+void NeuralNetworkController::killTerminatedProcesses() {
+#ifdef Q_OS_LINUX
+    for (qint64 childProcessId : terminatedChildProcessIds) {
+        // Fails silently if the process has already exited
+        ::kill((pid_t) childProcessId, SIGKILL);
+    }
+#endif
+    terminatedChildProcessIds.clear();
+    for (const QPointer<QProcess> &process : terminatedProcesses) {
+        if (!process.isNull() && process->state() != QProcess::NotRunning) {
+            process->kill();
+        }
     }
+    terminatedProcesses.clear();
 }
 
 void NeuralNetworkController::setTrainPythonScript(const QString &value)
@@ -77,20 +307,197 @@ void NeuralNetworkController::setInferencePythonScript(const QString &value)
 }
 
 void NeuralNetworkController::onTrainingFinished() {
-    queryTimer.stop();
+    finishRun();
     Q_EMIT trainingFinished();
 }
 
-void NeuralNetworkController::onInferenceFinished() {
-    queryTimer.stop();
-    Q_EMIT inferenceFinished();
+void NeuralNetworkController::onInferenceChunkFinished(int exitCode,
+                                                       QProcess::ExitStatus exitStatus) {
+    finishRun();
+    if (!inferenceJob) {
+        return;
+    }
+    importChunkOutput();
+    if (exitStatus == QProcess::NormalExit && exitCode == 0) {
+        inferenceJob->markCurrentChunkCompleted();
+        inferenceJob->saveCheckpoint();
+        failedAttemptsOfChunk = 0;
+        reportInferenceProgress();
+        startNextInferenceChunk();
+        return;
+    }
+
+    //! The images the network streamed predictions for are done, saving them makes
+    //! sure that they are not run again
+    inferenceJob->saveCheckpoint();
+    failedAttemptsOfChunk++;
+    if (failedAttemptsOfChunk < 2) {
+        qDebug() << "Network failed on the current images, retrying.";
+        startNextInferenceChunk();
+        return;
+    }
+    inferenceJob.reset();
+    objectModels.clear();
+    Q_EMIT inferenceFailed("The network failed repeatedly (exit code " + QString::number(exitCode)
+                           + "). The images that have been completed are remembered, "
+                             "running the inference again continues with the remaining images.");
+}
+
+void NeuralNetworkController::finishRun() {
+    if (cancellationToken) {
+        // Nobody reads the images anymore, the writer must not wait for the network
+        cancellationToken->cancel();
+    }
+    imageTransport.reset();
+    if (networkProcess) {
+        outputParser.append(networkProcess->readAllStandardOutput());
+        networkProcess->deleteLater();
+        networkProcess = Q_NULLPTR;
+    }
+    outputParser.flush();
+    for (const QString &message : outputParser.takeMessages()) {
+        qDebug() << message;
+    }
+    processRecords(outputParser.takeRecords());
+    qDebug() << "Network run finished.";
 }
 
-void NeuralNetworkController::writeOutput() {
-    QProcess *process = networkRunnable->getProcess();
-    if (process != Q_NULLPTR) {
-        qDebug() << process->readAllStandardOutput();
+void NeuralNetworkController::onNetworkOutputReceived() {
+    if (!networkProcess || cancellationToken->isCancelled()) {
+        return;
+    }
+    outputParser.append(networkProcess->readAllStandardOutput());
+    for (const QString &message : outputParser.takeMessages()) {
+        qDebug() << message;
     }
+    processRecords(outputParser.takeRecords());
+}
+
+void NeuralNetworkController::onNetworkErrorOccurred(QProcess::ProcessError error) {
+    if (error != QProcess::FailedToStart) {
+        // The other errors are followed by finished or only concern reading and writing
+        return;
+    }
+    qDebug() << "Could not start the network: " + networkProcess->errorString();
+    // finished is not Q_EMITted when the process could not be started
+    if (runningInference) {
+        // Retrying would not help here, the interpreter or script is not set correctly
+        finishRun();
+        if (inferenceJob) {
+            inferenceJob.reset();
+            objectModels.clear();
+            Q_EMIT inferenceFailed("Could not start the network. Please check the "
+                                   "Python interpreter and the inference script in the settings.");
+        }
+    } else {
+        onTrainingFinished();
+    }
+}
+
+void NeuralNetworkController::processRecords(const QList<QJsonObject> &records) {
+    if (records.isEmpty()) {
+        return;
+    }
+
+    QMap<QString, const ObjectModel*> objectModelMap;
+    for (int i = 0; i < objectModels.size(); i++) {
+        objectModelMap[objectModels.at(i).getPath()] = &(objectModels.at(i));
+    }
+
+    //! All predictions of one chunk of output are added at once, this way the poses file
+    //! is written only once and the views are updated only once
+    QList<Pose> predictedPoses;
+    for (const QJsonObject &record : records) {
+        QString type = record[NetworkOutputParser::RECORD_TYPE_KEY].toString();
+        if (type == NetworkOutputParser::RECORD_TYPE_PROGRESS) {
+            if (inferenceJob) {
+                //! The network only knows about the images of the current chunk
+                Q_EMIT progressChanged(completedImagesBeforeChunk + record["current"].toInt(),
+                                       inferenceJob->getNumberOfImages());
+            } else {
+                Q_EMIT progressChanged(record["current"].toInt(), record["total"].toInt());
+            }
+            continue;
+        }
+        if (type != NetworkOutputParser::RECORD_TYPE_PREDICTION || !modelManager) {
+            continue;
+        }
+        QString imagePath = record["image"].toString();
+        if (!imageIndices.contains(imagePath)) {
+            qDebug() << "Network predicted poses for unknown image " + imagePath;
+            continue;
+        }
+        const Image *image = &(images.at(imageIndices.value(imagePath)));
+        if (inferenceJob) {
+            inferenceJob->markImageCompleted(imagePath);
+        }
+        for (const QJsonValue &poseEntryRaw : record["poses"].toArray()) {
+            QJsonObject poseEntry = poseEntryRaw.toObject();
+            const ObjectModel *objectModel = objectModelMap.value(poseEntry["obj"].toString());
+            QJsonArray rotation = poseEntry["R"].toArray();
+            QJsonArray translation = poseEntry["t"].toArray();
+            if (!objectModel || rotation.size() != 9 || translation.size() != 3) {
+                qDebug() << "Skipping invalid predicted pose for image " + image->getImagePath();
+                continue;
+            }
+            QMatrix3x3 rotationMatrix;
+            for (int i = 0; i < 9; i++) {
+                rotationMatrix(i / 3, i % 3) = (float) rotation[i].toDouble();
+            }
+            QVector3D position((float) translation[0].toDouble(),
+                               (float) translation[1].toDouble(),
+                               (float) translation[2].toDouble());
+            //! Empty ID lets the model manager create one
+            predictedPoses.append(Pose("", position, rotationMatrix, image, objectModel));
+        }
+    }
+
+    if (!predictedPoses.isEmpty()) {
+        QStringList ids = modelManager->addObjectImagePoses(predictedPoses);
+        if (!ids.isEmpty()) {
+            Q_EMIT posesPredicted(ids);
+        }
+    }
+    reportInferenceProgress();
+}
+
+void NeuralNetworkController::importChunkOutput() {
+    QFile outputFile(inferenceJob->getCurrentChunkOutputPath());
+    if (outputFile.fileName().isEmpty() || !outputFile.open(QFile::ReadOnly)) {
+        //! The network streamed its predictions or did not predict anything
+        return;
+    }
+    QJsonObject output = QJsonDocument::fromJson(outputFile.readAll()).object();
+    //! Same format as the poses file, added like streamed predictions
+    QList<QJsonObject> records;
+    for (const QString &imagePath : output.keys()) {
+        QJsonObject record;
+        record[NetworkOutputParser::RECORD_TYPE_KEY] = NetworkOutputParser::RECORD_TYPE_PREDICTION;
+        record["image"] = imagePath;
+        record["poses"] = output[imagePath].toArray();
+        records << record;
+    }
+    processRecords(records);
+}
+
+void NeuralNetworkController::setInferenceChunkSize(int value)
+{
+    inferenceChunkSize = value;
+}
+
+void NeuralNetworkController::setUseSharedMemoryTransport(bool value)
+{
+    useSharedMemoryTransport = value;
+}
+
+void NeuralNetworkController::setImagePyramidCache(ImagePyramidCache *value)
+{
+    imagePyramidCache = value;
+}
+
+void NeuralNetworkController::setModelManager(ModelManager *value)
+{
+    modelManager = value;
 }
 
 void NeuralNetworkController::setSegmentationImagesPath(const QString &value)
@@ -108,6 +515,17 @@ void NeuralNetworkController::setPythonInterpreter(const QString &value)
     pythonInterpreter = value;
 }
 
+QJsonObject NeuralNetworkController::pathsForConfig() const {
+    QJsonObject paths;
+    paths["OUTPUT_FILE"] = posesFilePath;
+    paths["IMAGES_PATH"] = imagesPath;
+    paths["CAM_INFO_PATH"] = QDir(imagesPath).filePath("info.json");
+    paths["SEGMENTATION_IMAGES_PATH"] = segmentationImagesPath;
+    // Tells the network that it may stream its predictions as records on stdout
+    paths["STREAM_PREDICTIONS"] = true;
+    return paths;
+}
+
 void NeuralNetworkController::setPathsOnConfig(const QString &configPath) {
     QFile configFile(configPath);
     if (configFile.open(QFile::ReadWrite)) {
@@ -124,10 +542,10 @@ void NeuralNetworkController::setPathsOnConfig(const QString &configPath) {
             imageListFile.resize(0);
             imageListFile.write(QJsonDocument(imageList).toJson());
         }
-        jsonObject["OUTPUT_FILE"] = posesFilePath;
-        jsonObject["IMAGES_PATH"] = imagesPath;
-        jsonObject["CAM_INFO_PATH"] = QDir(imagesPath).filePath("info.json");
-        jsonObject["SEGMENTATION_IMAGES_PATH"] = segmentationImagesPath;
+        QJsonObject paths = pathsForConfig();
+        for (const QString &key : paths.keys()) {
+            jsonObject[key] = paths[key];
+        }
         configFile.resize(0);
         configFile.write(QJsonDocument(jsonObject).toJson());
     }
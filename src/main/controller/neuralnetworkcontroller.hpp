@@ -3,20 +3,54 @@
 
 #include "stdio.h"
 
-#include "neuralnetworkrunnable.hpp"
+#include "networkoutputparser.hpp"
+#include "inferencejob.hpp"
+#include "sharedmemoryimagetransport.hpp"
 #include "model/image.hpp"
+#include "model/objectmodel.hpp"
+#include "model/modelmanager.hpp"
+#include "misc/cancellationtoken.hpp"
 
 #include <QString>
 #include <QObject>
 #include <QVector>
-#include <QTimer>
+#include <QList>
+#include <QJsonObject>
+#include <QProcess>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QScopedPointer>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QThreadPool>
 
 using namespace std;
 
 /*!
  * \brief The NeuralNetworkController class defines an access point to the neural network
- * written in Python. It constructs a Python bridge and performs all operations in concurrent
- * thread to keep the UI responsive.
+ * written in Python. The network runs in a child process whose output is processed as soon
+ * as it arrives (i.e. event-driven, there is no polling), which keeps the UI responsive.
+ *
+ * The network can stream its predictions as records on stdout (see NetworkOutputParser), the
+ * config receives STREAM_PREDICTIONS set to true to signal that this is supported. If a model
+ * manager is set, the streamed predictions are added through its batch method as soon as they
+ * arrive, so that they show up while the network is still running. A network that streams its
+ * predictions must not write them to the OUTPUT_FILE as well. Progress records are forwarded
+ * through progressChanged. With a model manager, a network that does not stream writes the
+ * predictions of every chunk to a file of its own, which is added to the model manager when
+ * the chunk finishes.
+ *
+ * Inference runs in chunks (see InferenceJob): the inference script is started once per
+ * chunk of images and the image files of the next chunk are read ahead while the current
+ * chunk runs. A chunk that fails is retried once with the images that have no prediction
+ * yet, if it fails again the inference is aborted. Completed images are checkpointed, i.e.
+ * running the inference again on the same images continues where the failed run stopped.
+ * Optionally, the images of a chunk are taken from the image pyramid cache, i.e. decoded only
+ * if they have not been decoded for display already, and passed to the network through shared
+ * memory.
+ *
+ * Stopping the network terminates the child process and all processes it spawned (e.g. data
+ * loader workers). They get a short grace period to exit and are killed afterwards.
  */
 class NeuralNetworkController : public QObject
 {
@@ -32,29 +66,74 @@ public:
     void inference(const QString &configPath);
     void setImages(const QVector<Image> &images);
     void setPosesFilePath(const QString &filePath);
+    /*!
+     * \brief stop stops the running network immediately. Output that the network writes
+     * after this call is discarded and neither trainingFinished nor inferenceFinished is
+     * Q_EMITted for the stopped run.
+     */
     void stop();
+    bool isRunning() const;
 
     void setTrainPythonScript(const QString &value);
     void setInferencePythonScript(const QString &value);
     void setPythonInterpreter(const QString &value);
     void setImagesPath(const QString &value);
     void setSegmentationImagesPath(const QString &value);
+    void setModelManager(ModelManager *value);
+    void setInferenceChunkSize(int value);
+    /*!
+     * \brief setUseSharedMemoryTransport sets whether the images are decoded by the program
+     * and handed to the network through shared memory (see SharedMemoryImageTransport)
+     * instead of the network reading them from disk.
+     */
+    void setUseSharedMemoryTransport(bool value);
+    //! Sets the cache that the images for the shared memory transport are taken from, they
+    //! are decoded from the files if it is null
+    void setImagePyramidCache(ImagePyramidCache *value);
+
+    //! The time in milliseconds that the network processes get to exit after being
+    //! asked to terminate before they are killed
+    static const int TERMINATION_GRACE_PERIOD;
 
 Q_SIGNALS:
     void trainingStarted();
     void trainingFinished();
     void inferenceStarted();
     void inferenceFinished();
+    /*!
+     * \brief posesPredicted Q_EMITted when streamed predictions have been added.
+     * \param ids the IDs of the poses that were added
+     */
+    void posesPredicted(const QStringList &ids);
+    /*!
+     * \brief progressChanged Q_EMITted when the network reports its progress.
+     * \param current the number of items processed so far
+     * \param total the total number of items
+     */
+    void progressChanged(int current, int total);
+    /*!
+     * \brief throughputChanged Q_EMITted whenever images have been completed.
+     * \param imagesPerSecond the number of images the inference processed per second
+     * since it was started
+     */
+    void throughputChanged(double imagesPerSecond);
+    /*!
+     * \brief inferenceFailed Q_EMITted when a chunk failed repeatedly and the inference
+     * has been aborted. The completed images are kept in the checkpoint.
+     * \param message describes the failure
+     */
+    void inferenceFailed(const QString &message);
 
     void networkStopped();
 
 private Q_SLOTS:
     void onTrainingFinished();
-    void onInferenceFinished();
-    void writeOutput();
+    void onInferenceChunkFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onNetworkOutputReceived();
+    void onNetworkErrorOccurred(QProcess::ProcessError error);
+    void killTerminatedProcesses();
 
 private:
-    NeuralNetworkRunnable *networkRunnable = 0;
     QString pythonInterpreter;
     QString trainPythonScript;
     QString inferencePythonScript;
@@ -62,10 +141,50 @@ private:
     QString imagesPath;
     QString segmentationImagesPath;
     QVector<Image> images;
+    //! Index of the images by their path for fast lookup of streamed predictions
+    QHash<QString, int> imageIndices;
+    ModelManager *modelManager = Q_NULLPTR;
+    //! The object models at the time the inference was started, the streamed poses
+    //! reference them until they have been added to the model manager
+    QList<ObjectModel> objectModels;
+    NetworkOutputParser outputParser;
+
+    int inferenceChunkSize = 100;
+    //! The job of the running inference, null when no inference is running
+    QScopedPointer<InferenceJob> inferenceJob;
+    int failedAttemptsOfChunk = 0;
+    //! The number of completed images when the current chunk started, chunk-local
+    //! progress reported by the network is relative to this
+    int completedImagesBeforeChunk = 0;
+    int completedImagesOnStart = 0;
+    QElapsedTimer inferenceTimer;
+    bool useSharedMemoryTransport = false;
+    //! The transport of the current chunk, null if the network reads the images from disk
+    QSharedPointer<SharedMemoryImageTransport> imageTransport;
+    ImagePyramidCache *imagePyramidCache = Q_NULLPTR;
+    //! Runs the writer of the transport, which waits for the network most of the time and
+    //! would otherwise keep a thread of the global pool from decoding
+    QThreadPool imageTransportThreadPool;
 
-    QTimer queryTimer;
+    //! The process of the current run, null if the network is not running
+    QProcess *networkProcess = Q_NULLPTR;
+    //! The token of the current run, cancelled when the run is stopped
+    QSharedPointer<CancellationToken> cancellationToken;
+    bool runningInference = false;
+    //! Processes that have been asked to terminate and that are killed after the grace period
+    QList<QPointer<QProcess>> terminatedProcesses;
+    QList<qint64> terminatedChildProcessIds;
 
+    void startNetwork(const QString &pythonScript, const QString &configPath, bool inference);
+    void startNextInferenceChunk();
+    void finishInference();
+    void reportInferenceProgress();
+    void finishRun();
+    void terminateProcessTree(QProcess *process, bool immediately);
     void setPathsOnConfig(const QString &configPath);
+    QJsonObject pathsForConfig() const;
+    void processRecords(const QList<QJsonObject> &records);
+    void importChunkOutput();
 };
 
 #endif // NEURALNETWORKCONTROLLER_H
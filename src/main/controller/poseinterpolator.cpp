@@ -0,0 +1,137 @@
+#include "poseinterpolator.hpp"
+
+#include <QFileInfo>
+#include <QHash>
+#include <QMap>
+#include <QQuaternion>
+#include <QVector>
+
+PoseInterpolator::PoseInterpolator() {
+}
+
+QList<Pose> PoseInterpolator::interpolate(const QList<Image> &images, const QList<Pose> &poses,
+                                          const QStringList &objectModelPaths) const {
+    QList<Pose> interpolatedPoses;
+
+    // The indices of the images of every sequence, in the order of the first image of each
+    QStringList sequencePaths;
+    QHash<QString, QVector<int>> sequences;
+    QHash<QString, int> imageIndices;
+    for (int i = 0; i < images.size(); i++) {
+        const Image &image = images[i];
+        imageIndices[image.getImagePath()] = i;
+        QString sequencePath = QFileInfo(image.getAbsoluteImagePath()).path();
+        if (!sequences.contains(sequencePath)) {
+            sequencePaths.append(sequencePath);
+        }
+        sequences[sequencePath].append(i);
+    }
+
+    // The poses of every object model by the index of their image
+    QMap<QString, QHash<int, QList<const Pose*>>> posesByObjectModel;
+    for (const Pose &pose : poses) {
+        QString objectModelPath = pose.getObjectModel()->getPath();
+        if (!objectModelPaths.isEmpty() && !objectModelPaths.contains(objectModelPath)) {
+            continue;
+        }
+        int index = imageIndices.value(pose.getImage()->getImagePath(), -1);
+        if (index != -1) {
+            posesByObjectModel[objectModelPath][index].append(&pose);
+        }
+    }
+
+    for (const QString &sequencePath : sequencePaths) {
+        const QVector<int> &sequence = sequences[sequencePath];
+        QVector<double> times(sequence.size());
+        bool fileNumbersValid = useFileNumbers;
+        for (int i = 0; i < sequence.size() && fileNumbersValid; i++) {
+            qint64 number = fileNumber(images[sequence[i]].getImagePath());
+            fileNumbersValid = number >= 0 && (i == 0 || number > times[i - 1]);
+            times[i] = number;
+        }
+        if (!fileNumbersValid) {
+            for (int i = 0; i < sequence.size(); i++) {
+                times[i] = i;
+            }
+        }
+
+        for (const QHash<int, QList<const Pose*>> &posesByImage : posesByObjectModel) {
+            QList<Keyframe> keyframes;
+            const ObjectModel *objectModel = Q_NULLPTR;
+            for (int i = 0; i < sequence.size(); i++) {
+                const QList<const Pose*> imagePoses = posesByImage.value(sequence[i]);
+                // With several instances of the object model in the image it is unclear
+                // which one continues the track
+                if (imagePoses.size() == 1) {
+                    const Pose *pose = imagePoses.first();
+                    keyframes.append(Keyframe { i, times[i], pose->getPosition(),
+                                                pose->getRotation() });
+                    objectModel = pose->getObjectModel();
+                }
+            }
+
+            for (int k = 0; k + 1 < keyframes.size(); k++) {
+                const Keyframe &start = keyframes[k];
+                const Keyframe &end = keyframes[k + 1];
+                int gap = end.index - start.index - 1;
+                if (gap <= 0 || (maxGap > 0 && gap > maxGap)) {
+                    continue;
+                }
+                double duration = end.time - start.time;
+                // Scaled to the unit interval of the Hermite basis
+                QVector3D startTangent = tangent(keyframes, k) * duration;
+                QVector3D endTangent = tangent(keyframes, k + 1) * duration;
+                QQuaternion startRotation = QQuaternion::fromRotationMatrix(start.rotation);
+                QQuaternion endRotation = QQuaternion::fromRotationMatrix(end.rotation);
+
+                for (int i = start.index + 1; i < end.index; i++) {
+                    if (posesByImage.contains(sequence[i])) {
+                        continue;
+                    }
+                    float t = (times[i] - start.time) / duration;
+                    float t2 = t * t;
+                    float t3 = t2 * t;
+                    QVector3D position = (2 * t3 - 3 * t2 + 1) * start.position
+                            + (t3 - 2 * t2 + t) * startTangent
+                            + (-2 * t3 + 3 * t2) * end.position
+                            + (t3 - t2) * endTangent;
+                    QMatrix3x3 rotation =
+                            QQuaternion::slerp(startRotation, endRotation, t).toRotationMatrix();
+                    interpolatedPoses.append(Pose(QString(), position, rotation,
+                                                  &images[sequence[i]], objectModel));
+                }
+            }
+        }
+    }
+
+    return interpolatedPoses;
+}
+
+void PoseInterpolator::setMaxGap(int maxGap) {
+    this->maxGap = maxGap;
+}
+
+void PoseInterpolator::setUseFileNumbers(bool useFileNumbers) {
+    this->useFileNumbers = useFileNumbers;
+}
+
+qint64 PoseInterpolator::fileNumber(const QString &imagePath) {
+    QString name = QFileInfo(imagePath).completeBaseName();
+    int begin = name.size();
+    while (begin > 0 && name[begin - 1].isDigit()) {
+        begin--;
+    }
+    // More digits do not fit and are not a frame number anyway
+    if (begin == name.size() || name.size() - begin > 18) {
+        return -1;
+    }
+    return name.mid(begin).toLongLong();
+}
+
+QVector3D PoseInterpolator::tangent(const QList<Keyframe> &keyframes, int index) {
+    // One-sided at the first and last keyframe, which makes the spline linear there if there
+    // are only two keyframes
+    const Keyframe &previous = keyframes[qMax(index - 1, 0)];
+    const Keyframe &next = keyframes[qMin(index + 1, keyframes.size() - 1)];
+    return (next.position - previous.position) / (next.time - previous.time);
+}
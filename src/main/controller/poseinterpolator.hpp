@@ -0,0 +1,73 @@
+#ifndef POSEINTERPOLATOR_H
+#define POSEINTERPOLATOR_H
+
+#include "model/image.hpp"
+#include "model/pose.hpp"
+
+#include <QList>
+#include <QMatrix3x3>
+#include <QString>
+#include <QStringList>
+#include <QVector3D>
+
+/*!
+ * \brief The PoseInterpolator class fills the images between annotated keyframes of a
+ * sequence, e.g. of the frames of a video, with interpolated poses.
+ *
+ * Images in the same folder, or archive or video, form a sequence in the order they are
+ * given in. Their time is the number at the end of the file name, e.g. the frame index of
+ * video_000123.png or a timestamp, if all images of the sequence have one and the numbers
+ * increase, otherwise it is the index of the image in the sequence. Keyframes of an object
+ * model are the images with exactly one pose of it. The translation between two keyframes
+ * follows a cubic Hermite spline whose tangents are the Catmull-Rom tangents of the
+ * neighbouring keyframes, the rotation is interpolated with spherical linear interpolation.
+ * Images that have poses of the object model already are left as they are.
+ *
+ * Only the computation happens here, it takes linear time in the number of images. The
+ * caller adds the poses in one batch, see ModelManager::addObjectImagePoses.
+ */
+class PoseInterpolator
+{
+public:
+    PoseInterpolator();
+
+    /*!
+     * \brief interpolate computes the poses of the images between the keyframes.
+     * \param images the images in the order of their sequences
+     * \param poses the annotated poses of the images
+     * \param objectModelPaths the object models to interpolate, all if empty
+     * \return the interpolated poses without IDs, they refer to the given images and to the
+     * object models of the given poses, which have to outlive them
+     */
+    QList<Pose> interpolate(const QList<Image> &images, const QList<Pose> &poses,
+                            const QStringList &objectModelPaths = QStringList()) const;
+
+    /*!
+     * \brief setMaxGap sets the maximum number of images between two keyframes that are
+     * filled, longer gaps are left empty, e.g. because the object was occluded. Defaults to
+     * 0, i.e. no maximum.
+     */
+    void setMaxGap(int maxGap);
+    //! Whether to take the times from the numbers in the file names, defaults to true
+    void setUseFileNumbers(bool useFileNumbers);
+
+    //! Returns the number at the end of the file name of the image path or -1
+    static qint64 fileNumber(const QString &imagePath);
+
+private:
+    struct Keyframe {
+        //! Index in the images of the sequence
+        int index;
+        double time;
+        QVector3D position;
+        QMatrix3x3 rotation;
+    };
+
+    int maxGap = 0;
+    bool useFileNumbers = true;
+
+    //! The Catmull-Rom tangent of the translation at the keyframe with the given index
+    static QVector3D tangent(const QList<Keyframe> &keyframes, int index);
+};
+
+#endif // POSEINTERPOLATOR_H
@@ -0,0 +1,206 @@
+#include "posepropagator.hpp"
+
+#include <QElapsedTimer>
+#include <QtDebug>
+
+PosePropagationRunnable::PosePropagationRunnable(PoseRefiner *poseRefiner,
+                                                 const QList<Image> &images,
+                                                 const ObjectModel &objectModel,
+                                                 int startIndex,
+                                                 const QVector3D &position,
+                                                 const QMatrix3x3 &rotation,
+                                                 int frames, float maxError,
+                                                 const QMap<int, QList<PropagatedPose>>
+                                                 &existingPoses) :
+    poseRefiner(poseRefiner),
+    images(images),
+    objectModel(objectModel),
+    startIndex(startIndex),
+    position(position),
+    rotation(rotation),
+    frames(frames),
+    maxError(maxError),
+    existingPoses(existingPoses) {
+    // Deleted by the propagator once it has received the results
+    setAutoDelete(false);
+}
+
+void PosePropagationRunnable::run() {
+    QList<PropagatedPose> propagatedPoses;
+    int totalFrames = qMin(frames, images.size() - 1 - startIndex)
+            + qMin(frames, startIndex);
+    int trackedFrames = 0;
+    QElapsedTimer timer;
+    timer.start();
+    auto framesPerSecond = [&timer, &trackedFrames]() {
+        qint64 elapsed = timer.elapsed();
+        return elapsed > 0 ? trackedFrames * 1000.0 / elapsed : 0.0;
+    };
+
+    for (int direction : {1, -1}) {
+        QVector3D currentPosition = position;
+        QMatrix3x3 currentRotation = rotation;
+        for (int step = 1; step <= frames; step++) {
+            int index = startIndex + direction * step;
+            if (index < 0 || index >= images.size() || cancellationToken.isCancelled()) {
+                break;
+            }
+            trackedFrames++;
+
+            if (existingPoses.contains(index)) {
+                // The image has been annotated already, continue from the annotation that is
+                // closest to the tracked one in case there are several of the object model
+                const QList<PropagatedPose> &poses = existingPoses[index];
+                const PropagatedPose *closest = &poses.first();
+                for (const PropagatedPose &pose : poses) {
+                    if ((pose.position - currentPosition).lengthSquared()
+                            < (closest->position - currentPosition).lengthSquared()) {
+                        closest = &pose;
+                    }
+                }
+                currentPosition = closest->position;
+                currentRotation = closest->rotation;
+                Q_EMIT progress(trackedFrames, totalFrames, framesPerSecond());
+                continue;
+            }
+
+            Pose pose(QString(), currentPosition, currentRotation, &images[index], &objectModel);
+            PoseRefinement refinement = poseRefiner->refine(pose);
+            if (!refinement.valid || refinement.finalError > maxError) {
+                // The object left the image, got occluded or moved too fast, the following
+                // images would only drift further off
+                qDebug() << "Lost track of" << objectModel.getPath() << "in"
+                         << images[index].getImagePath() << "with an error of"
+                         << refinement.finalError;
+                Q_EMIT progress(trackedFrames, totalFrames, framesPerSecond());
+                break;
+            }
+            currentPosition = refinement.position;
+            currentRotation = refinement.rotation;
+            propagatedPoses.append(PropagatedPose { index, currentPosition, currentRotation,
+                                                    refinement.finalError });
+            Q_EMIT progress(trackedFrames, totalFrames, framesPerSecond());
+        }
+    }
+
+    Q_EMIT finished(propagatedPoses, trackedFrames, framesPerSecond());
+}
+
+void PosePropagationRunnable::stop() {
+    cancellationToken.cancel();
+}
+
+PosePropagator::PosePropagator(ModelManager *modelManager, QObject *parent) :
+    QObject(parent),
+    modelManager(modelManager) {
+    qRegisterMetaType<QList<PropagatedPose>>();
+    // Consecutive images differ only slightly, the coarsest level of the Refine button is
+    // not needed and tracking has to keep up with long sequences
+    poseRefiner.setPyramidLevels(2);
+    poseRefiner.setMaxIterations(30);
+    threadPool.setMaxThreadCount(1);
+}
+
+PosePropagator::~PosePropagator() {
+    stop();
+    threadPool.waitForDone();
+    delete runnable;
+}
+
+bool PosePropagator::propagate(const Pose &pose, int frames) {
+    if (runnable) {
+        qWarning() << "A pose is being propagated already.";
+        return false;
+    }
+
+    images = modelManager->getImages();
+    QString imagePath = pose.getImage()->getImagePath();
+    int startIndex = -1;
+    for (int i = 0; i < images.size(); i++) {
+        if (images[i].getImagePath() == imagePath) {
+            startIndex = i;
+            break;
+        }
+    }
+    if (startIndex == -1) {
+        qWarning() << "Can't propagate pose" << pose.getID() << "of unknown image" << imagePath;
+        return false;
+    }
+
+    objectModelPath = pose.getObjectModel()->getPath();
+    QMap<int, QList<PropagatedPose>> existingPoses;
+    QMap<QString, int> imageIndices;
+    for (int i = 0; i < images.size(); i++) {
+        imageIndices[images[i].getImagePath()] = i;
+    }
+    for (const Pose &existingPose : modelManager->getPoses()) {
+        if (existingPose.getObjectModel()->getPath() != objectModelPath) {
+            continue;
+        }
+        int index = imageIndices.value(existingPose.getImage()->getImagePath(), -1);
+        if (index != -1 && index != startIndex) {
+            existingPoses[index].append(PropagatedPose { index, existingPose.getPosition(),
+                                                         existingPose.getRotation(), 0.f });
+        }
+    }
+
+    runnable = new PosePropagationRunnable(&poseRefiner, images, *pose.getObjectModel(),
+                                           startIndex, pose.getPosition(), pose.getRotation(),
+                                           frames, maxError, existingPoses);
+    connect(runnable, &PosePropagationRunnable::progress,
+            this, &PosePropagator::propagationProgress);
+    connect(runnable, &PosePropagationRunnable::finished,
+            this, &PosePropagator::onRunnableFinished);
+    threadPool.start(runnable);
+    return true;
+}
+
+bool PosePropagator::isRunning() const {
+    return runnable != Q_NULLPTR;
+}
+
+void PosePropagator::stop() {
+    if (runnable) {
+        runnable->stop();
+    }
+}
+
+void PosePropagator::setSegmentationCodes(const QMap<QString, QString> &codes) {
+    poseRefiner.setSegmentationCodes(codes);
+}
+
+void PosePropagator::setMaxError(float maxError) {
+    this->maxError = maxError;
+}
+
+void PosePropagator::onRunnableFinished(QList<PropagatedPose> poses, int trackedFrames,
+                                        double framesPerSecond) {
+    // The runnable has returned from run() once the results arrive here
+    threadPool.waitForDone();
+    delete runnable;
+    runnable = Q_NULLPTR;
+
+    // The images might have been reloaded in the meantime, the poses are created on the
+    // copies taken at the start and resolved by their paths when they are added
+    QList<ObjectModel> objectModels = modelManager->getObjectModels();
+    const ObjectModel *objectModel = Q_NULLPTR;
+    for (const ObjectModel &candidate : objectModels) {
+        if (candidate.getPath() == objectModelPath) {
+            objectModel = &candidate;
+            break;
+        }
+    }
+
+    QList<Pose> posesToAdd;
+    if (objectModel) {
+        for (const PropagatedPose &propagatedPose : poses) {
+            posesToAdd.append(Pose(QString(), propagatedPose.position, propagatedPose.rotation,
+                                   &images[propagatedPose.imageIndex], objectModel));
+        }
+    }
+    QStringList addedPoses;
+    if (!posesToAdd.isEmpty()) {
+        addedPoses = modelManager->addObjectImagePoses(posesToAdd);
+    }
+    Q_EMIT propagationFinished(addedPoses, trackedFrames, framesPerSecond);
+}
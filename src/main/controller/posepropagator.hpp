@@ -0,0 +1,126 @@
+#ifndef POSEPROPAGATOR_H
+#define POSEPROPAGATOR_H
+
+#include "model/modelmanager.hpp"
+#include "misc/geometry/poserefiner.hpp"
+#include "misc/cancellationtoken.hpp"
+
+#include <QList>
+#include <QMap>
+#include <QMatrix3x3>
+#include <QMetaType>
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+#include <QThreadPool>
+#include <QVector3D>
+
+//! A pose tracked into another image of the sequence
+struct PropagatedPose {
+    //! Index of the image in the images of the model manager
+    int imageIndex;
+    QVector3D position;
+    QMatrix3x3 rotation;
+    //! The error of the refinement, see PoseRefinement
+    float error;
+};
+
+Q_DECLARE_METATYPE(QList<PropagatedPose>)
+
+/*!
+ * \brief The PosePropagationRunnable class tracks a pose from image to image in one or both
+ * directions of the sequence, each refinement starts at the pose of the previous image.
+ */
+class PosePropagationRunnable : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * \param existingPoses the poses of the object model that the images already have, by
+     * the index of the image, tracking continues from them instead of refining
+     */
+    PosePropagationRunnable(PoseRefiner *poseRefiner, const QList<Image> &images,
+                            const ObjectModel &objectModel, int startIndex,
+                            const QVector3D &position, const QMatrix3x3 &rotation,
+                            int frames, float maxError,
+                            const QMap<int, QList<PropagatedPose>> &existingPoses);
+    void run() override;
+    void stop();
+
+Q_SIGNALS:
+    void progress(int trackedFrames, int totalFrames, double framesPerSecond);
+    void finished(QList<PropagatedPose> poses, int trackedFrames, double framesPerSecond);
+
+private:
+    PoseRefiner *poseRefiner;
+    QList<Image> images;
+    ObjectModel objectModel;
+    int startIndex;
+    QVector3D position;
+    QMatrix3x3 rotation;
+    int frames;
+    float maxError;
+    QMap<int, QList<PropagatedPose>> existingPoses;
+    CancellationToken cancellationToken;
+};
+
+/*!
+ * \brief The PosePropagator class propagates an annotated pose to the neighbouring images,
+ * e.g. the frames of a video or of a capture in an image folder, whose poses differ only
+ * slightly. The pose is tracked forward and backward with a fast refinement that starts at
+ * the pose of the previous image. Tracking in a direction stops when the pose does not align
+ * with the image anymore. The tracked poses are added through the model manager in one batch
+ * when the propagation has finished, so that the user can review them.
+ */
+class PosePropagator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PosePropagator(ModelManager *modelManager, QObject *parent = Q_NULLPTR);
+    ~PosePropagator();
+
+    /*!
+     * \brief propagate starts tracking the pose through the given number of images before and
+     * after its image in the background.
+     * \return false if a propagation is already running or the image of the pose is unknown
+     */
+    bool propagate(const Pose &pose, int frames);
+    bool isRunning() const;
+    void stop();
+
+    void setSegmentationCodes(const QMap<QString, QString> &codes);
+    //! The refinement error in pixels above which a pose is lost, defaults to 4
+    void setMaxError(float maxError);
+
+Q_SIGNALS:
+    void propagationProgress(int trackedFrames, int totalFrames, double framesPerSecond);
+    /*!
+     * \brief propagationFinished Q_EMITted when the propagated poses have been added.
+     * \param addedPoses the IDs of the poses added to the model manager
+     * \param trackedFrames the number of images the pose was tracked through, including the
+     * ones that already had a pose
+     * \param framesPerSecond the throughput of the tracking
+     */
+    void propagationFinished(QStringList addedPoses, int trackedFrames, double framesPerSecond);
+
+private Q_SLOTS:
+    void onRunnableFinished(QList<PropagatedPose> poses, int trackedFrames,
+                            double framesPerSecond);
+
+private:
+    ModelManager *modelManager;
+    //! Separate from the refiner of the Refine button, tracking takes smaller steps
+    PoseRefiner poseRefiner;
+    //! The images and object model at the start of the propagation, the model manager
+    //! resolves the propagated poses by their paths
+    QList<Image> images;
+    QString objectModelPath;
+    float maxError = 4.f;
+    PosePropagationRunnable *runnable = Q_NULLPTR;
+    // Declared last so that it waits for the runnable before the refiner is destroyed
+    QThreadPool threadPool;
+};
+
+#endif // POSEPROPAGATOR_H
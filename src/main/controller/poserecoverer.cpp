@@ -1,10 +1,7 @@
 #include "poserecoverer.hpp"
 #include "model/pose.hpp"
+#include "controller/multiviewpropagator.hpp"
 #include "misc/generalhelper.h"
-#include <opencv2/calib3d/calib3d.hpp>
-#include <opencv2/core/core.hpp>
-#include <opencv2/imgproc/imgproc.hpp>
-#include <QImage>
 #include <QDebug>
 
 PoseCreator::PoseCreator(QObject *parent, ModelManager *modelManager) :
@@ -23,13 +20,22 @@ PoseCreator::State PoseCreator::getState() {
 }
 
 void PoseCreator::abortCreation() {
-    image = Q_NULLPTR;
+    image.reset();
     objectModel = Q_NULLPTR;
     points.clear();
     currentState = State::Empty;
     Q_EMIT poseCreationAborted();
 }
 
+bool PoseCreator::interruptCreation() {
+    if (!image || points.isEmpty() || !isCalibratedView(*image)) {
+        return false;
+    }
+    currentState = (points.size() >= minimumNumberOfPoints ? State::ReadyForPoseCreation :
+                                                      State::AwaitingMorePosePoints);
+    return true;
+}
+
 void PoseCreator::setMinimumNumberOfPoints(int numberOfPoints) {
     Q_ASSERT(numberOfPoints >= 1);
     minimumNumberOfPoints = numberOfPoints;
@@ -47,11 +53,15 @@ int PoseCreator::getMinimumNumberOfPoints() {
 
 void PoseCreator::setImage(Image *image) {
     Q_ASSERT(image);
-    if (this->image != image) {
-        points.clear();
-        objectModel = Q_NULLPTR;
-        this->image = image;
-        currentState = State::Empty;
+    if (!this->image || this->image->getImagePath() != image->getImagePath()) {
+        bool otherView = this->image && isCalibratedView(*this->image)
+                && isCalibratedView(*image) && this->image->getScene() == image->getScene();
+        if (!otherView) {
+            points.clear();
+            objectModel = Q_NULLPTR;
+            currentState = State::Empty;
+        }
+        this->image.reset(new Image(*image));
     }
 }
 
@@ -69,15 +79,15 @@ void PoseCreator::setObjectModel(ObjectModel *objectModel) {
 
 void PoseCreator::startPosePoint(QPoint imagePoint) {
     currentState = State::PosePointStarted;
-    QImage loadedImage(image->getAbsoluteImagePath());
+    QSize imageSize = image->getSize();
     // A bit confusing, but I started off with the T-Less dataset, which apparently
-    posePointStart = QPoint(loadedImage.width() - imagePoint.x(), loadedImage.height() - imagePoint.y());
+    posePointStart = QPoint(imageSize.width() - imagePoint.x(), imageSize.height() - imagePoint.y());
     Q_EMIT posePointStarted(posePointStart, points.size(), minimumNumberOfPoints);
 }
 
 void PoseCreator::finishPosePoint(QVector3D objectModelPoint) {
     if (currentState == State::PosePointStarted) {
-        points.push_back(CorrespondingPoints{posePointStart, objectModelPoint});
+        points.push_back(CorrespondingPoints{posePointStart, objectModelPoint, *image});
         currentState = (points.size() >= minimumNumberOfPoints ? State::ReadyForPoseCreation :
                                                           State::AwaitingMorePosePoints);
         qDebug() << "Added corresponding point for image (" + image->getImagePath() + ") and object (" +
@@ -91,82 +101,132 @@ void PoseCreator::finishPosePoint(QVector3D objectModelPoint) {
 bool PoseCreator::createPose() {
     Q_ASSERT(objectModel);
     Q_ASSERT(image);
-    Q_ASSERT(currentState == State::ReadyForPoseCreation);
-    Q_ASSERT_X(points.size() >= 4, "create pose", "number of pose points needs"
-                                                            "to be greater than 4");
+    if (currentState != State::ReadyForPoseCreation || points.size() < minimumNumberOfPoints) {
+        qWarning() << "At least " + QString::number(minimumNumberOfPoints)
+                      + " points are needed to create a pose.";
+        lastSolution = PnPSolution();
+        return false;
+    }
 
-    qDebug() << "Creating pose for the following points:" << endl
-             << correspondingPointsToString(points.at(0)) << endl
-             << correspondingPointsToString(points.at(1)) << endl
-             << correspondingPointsToString(points.at(2)) << endl
-             << correspondingPointsToString(points.at(3)) << endl;
+    qDebug() << "Creating pose for the following points:";
+    QStringList views;
+    for (const CorrespondingPoints &point : points) {
+        qDebug() << correspondingPointsToString(point);
+        if (!views.contains(point.image.getImagePath())) {
+            views << point.image.getImagePath();
+        }
+    }
 
-    std::vector<cv::Point3f> objectPoints;
-    std::vector<cv::Point2f> imagePoints;
+    bool success = views.size() > 1 ? createMultiViewPose() : createSingleViewPose();
+    if (!lastSolution.valid) {
+        return false;
+    }
+    points.clear();
+    objectModel = Q_NULLPTR;
+    image.reset();
+    return success;
+}
+
+//! We need to mirror the clicked points, as we mirror the rendered image. The clicked
+//! pixel x becomes pixel W - 1 - x, which covers the area up to the next pixel, i.e. its
+//! center is at W - x - 0.5.
+static QPointF unmirroredPixelCenter(const QPoint &point, const QSize &imageSize) {
+    return QPointF(imageSize.width() - point.x() - 0.5, imageSize.height() - point.y() - 0.5);
+}
+
+bool PoseCreator::createSingleViewPose() {
+    QList<QVector3D> objectPoints;
+    QList<QPointF> imagePoints;
 
-    QImage loadedImage = QImage(image->getAbsoluteImagePath());
+    // The user might have moved on to another view without clicking points in it
+    Image pointsImage = points.first().image;
+    QSize imageSize = pointsImage.getSize();
 
     for (CorrespondingPoints &point : points) {
-        objectPoints.push_back(cv::Point3f(point.pointIn3D.x(), point.pointIn3D.y(), point.pointIn3D.z()));
-        // We need to mirror the clicked points, as we mirror the rendered image
-        imagePoints.push_back(cv::Point2f(loadedImage.size().width() - point.pointIn2D.x(),
-                                          loadedImage.size().height() - point.pointIn2D.y()));
+        objectPoints << point.pointIn3D;
+        imagePoints << unmirroredPixelCenter(point.pointIn2D, imageSize);
     }
 
-    cv::Mat cameraMatrix =
-            (cv::Mat_<float>(3,3) << image->getCameraMatrix()(0, 0), 0, image->getCameraMatrix()(0, 2),
-                                     0 , image->getCameraMatrix()(1, 1), image->getCameraMatrix()(1, 2),
-                                     0, 0, 1);
-    cv::Mat coefficient = cv::Mat::zeros(4,1,cv::DataType<float>::type);
-
-    cv::Mat resultRotation;
-    cv::Mat resultTranslation;
+    lastSolution = solver.solve(objectPoints, imagePoints, pointsImage.getCameraMatrix());
+    for (int i = 0; i < lastSolution.reprojectionErrors.size(); i++) {
+        qDebug() << "Reprojection error of point " + QString::number(i) + ": " +
+                    QString::number(lastSolution.reprojectionErrors[i]) + " px" +
+                    (lastSolution.inliers[i] ? "" : " (not used)");
+    }
+    if (!lastSolution.valid) {
+        qWarning() << "Could not find a pose that enough of the points agree with.";
+        return false;
+    }
 
-    cv::solvePnP(objectPoints, imagePoints, cameraMatrix, coefficient, resultRotation, resultTranslation);
+    // The adding process already notifies observers of the new correspondnece
+    return modelManager->addObjectImagePose(&pointsImage,
+                                            objectModel,
+                                            lastSolution.translation,
+                                            lastSolution.rotation);
+}
 
-    for (int i = 0; i < resultTranslation.size[0]; i++) {
-        for (int j = 0; j < resultTranslation.size[1]; j++) {
-            qDebug() << "Result translation [" + QString::number(i) + ", " +
-                                                QString::number(j) + "]: " +
-                                                QString::number(resultTranslation.at<float>(i, j));
+bool PoseCreator::createMultiViewPose() {
+    QList<PnPView> views;
+    QStringList viewPaths;
+    QList<PnPObservation> observations;
+    for (const CorrespondingPoints &point : points) {
+        int view = viewPaths.indexOf(point.image.getImagePath());
+        if (view == -1) {
+            view = views.size();
+            viewPaths << point.image.getImagePath();
+            views << PnPView { point.image.getCameraMatrix(), point.image.getWorldRotation(),
+                               point.image.getWorldTranslation() };
         }
+        observations << PnPObservation { point.pointIn3D,
+                                         unmirroredPixelCenter(point.pointIn2D,
+                                                               point.image.getSize()),
+                                         view };
     }
 
-    for (int i = 0; i < resultRotation.size[0]; i++) {
-        for (int j = 0; j < resultRotation.size[1]; j++) {
-            qDebug() << "Result rotation [" + QString::number(i) + ", " +
-                                              QString::number(j) + "]: " +
-                                              QString::number(resultRotation.at<float>(i, j));
-        }
+    lastSolution = multiViewSolver.solve(observations, views);
+    for (int i = 0; i < lastSolution.reprojectionErrors.size(); i++) {
+        qDebug() << "Reprojection error of point " + QString::number(i) + " in " +
+                    points[i].image.getImagePath() + ": " +
+                    QString::number(lastSolution.reprojectionErrors[i]) + " px" +
+                    (lastSolution.inliers[i] ? "" : " (not used)");
+    }
+    if (!lastSolution.valid) {
+        qWarning() << "Could not find a pose that enough of the points agree with.";
+        return false;
     }
 
-    // The adding process already notifies observers of the new correspondnece
-    QVector3D position(resultTranslation.at<float>(0, 0),
-                       resultTranslation.at<float>(1, 0),
-                       resultTranslation.at<float>(2, 0));
-    // Conversion from radians to degrees
-    cv::Mat rotMatrix;
-    cv::Rodrigues(resultRotation, rotMatrix);
-    QMatrix3x3 rotationMatrix(new float[9] {
-        rotMatrix.at<float>(0, 0), rotMatrix.at<float>(0, 1), rotMatrix.at<float>(0, 2),
-        rotMatrix.at<float>(1, 0), rotMatrix.at<float>(1, 1), rotMatrix.at<float>(1, 2),
-        rotMatrix.at<float>(2, 0), rotMatrix.at<float>(2, 1), rotMatrix.at<float>(2, 2)
-    });
-    bool success = modelManager->addObjectImagePose(image,
-                                               objectModel,
-                                               position,
-                                               rotationMatrix);
+    // The solution is the pose in the world frame, every view of the scene shows it
+    QList<Image> images = modelManager->getImages();
+    QList<Pose> poses = MultiViewPropagator().instantiate(lastSolution.translation,
+                                                          lastSolution.rotation,
+                                                          objectModel,
+                                                          points.first().image.getScene(),
+                                                          images, modelManager->getPoses());
+    return !modelManager->addObjectImagePoses(poses).isEmpty();
+}
 
-    points.clear();
-    objectModel = Q_NULLPTR;
-    image = Q_NULLPTR;
-    return success;
+PnPSolution PoseCreator::getLastSolution() const {
+    return lastSolution;
+}
+
+void PoseCreator::setRobustSolving(bool robust) {
+    solver.setRobust(robust);
+    multiViewSolver.setRobust(robust);
+}
+
+void PoseCreator::setInlierThreshold(float threshold) {
+    solver.setInlierThreshold(threshold);
+    multiViewSolver.setInlierThreshold(threshold);
 }
 
 bool PoseCreator::isImageSet() {
     return image != Q_NULLPTR;
 }
 
+bool PoseCreator::isCalibratedView(const Image &image) {
+    return image.hasExtrinsics();
+}
+
 bool PoseCreator::isObjectModelSet() {
     return objectModel != Q_NULLPTR;
 }
@@ -4,6 +4,9 @@
 #include "model/image.hpp"
 #include "model/objectmodel.hpp"
 #include "model/modelmanager.hpp"
+#include "misc/geometry/pnpsolver.hpp"
+#include "misc/geometry/multiviewpnpsolver.hpp"
+#include "misc/global.h"
 
 #include <QPoint>
 #include <QVector3D>
@@ -17,6 +20,12 @@
  * setImage
  * setObjectModel
  * addPosePoint
+ *
+ * Images of a scene captured by calibrated cameras, i.e. with extrinsics, are views of the
+ * same object. Setting another view of the scene keeps the points, so that the user can
+ * click the object in several views. Points of several views are solved for jointly with
+ * the MultiViewPnPSolver, which also triangulates the object points clicked in more than one
+ * view, and the pose is added to all views of the scene.
  */
 class PoseCreator : public QObject
 {
@@ -53,6 +62,14 @@ public:
      */
     void abortCreation();
 
+    /*!
+     * \brief interruptCreation discards the started pose point, e.g. because the user
+     * selected another image. The finished points are kept if they belong to a view of a
+     * calibrated scene, so that the user can continue in another view.
+     * \return whether the points were kept, otherwise the creation should be aborted
+     */
+    bool interruptCreation();
+
     /*!
      * \brief setMinimumNumberOfPoints sets the minimum number of points required before being
      * able to create a pose. The default is 4.
@@ -69,10 +86,11 @@ public:
 
     /*!
      * \brief setImage sets the image that pose points are to be created for. If set image
-     * is called and sets a new image, all already added points will be cleared. This does not affect
+     * is called and sets a new image, all already added points will be cleared, unless both
+     * images are views of the same calibrated scene. This does not affect
      * poses (i.e. objects of type ObjectImagePose) that were created because
      * four pose points were added.
-     * \param image the image to be set
+     * \param image the image to be set, it is copied
      */
     void setImage(Image *image);
 
@@ -100,10 +118,34 @@ public:
 
     /*!
      * \brief createPose creates a pose for the set image and object model
-     * if the number of points is sufficient (>= 4).
+     * if the number of points is sufficient (>= 4), otherwise it fails without a solution. Any number of points can be used, with
+     * robust solving points that don't agree with the others, e.g. mis-clicks, are ignored.
+     * If no pose is found that enough points agree with, the points are kept so that more
+     * can be added.
+     * \return whether a pose has been created
      */
     bool createPose();
 
+    /*!
+     * \brief getLastSolution returns the solution of the last call of createPose, with the
+     * reprojection error of every point and which points have been used. For points of
+     * several views the pose is in the world frame of the scene.
+     */
+    PnPSolution getLastSolution() const;
+
+    /*!
+     * \brief setRobustSolving sets whether points that don't agree with the others are
+     * ignored when creating the pose. The default is true, the main controller applies the
+     * setting of the user.
+     */
+    void setRobustSolving(bool robust);
+
+    /*!
+     * \brief setInlierThreshold sets the reprojection error in pixels up to which a point
+     * agrees with a pose. The default is 8.
+     */
+    void setInlierThreshold(float threshold);
+
     /*!
      * \brief numberOfPosePoints returns the numer of currently added pose points
      * \return the number of pose points
@@ -157,6 +199,8 @@ private:
     struct CorrespondingPoints {
         QPoint pointIn2D;
         QVector3D pointIn3D;
+        // The view the point was clicked in
+        Image image;
     };
 
     ModelManager *modelManager;
@@ -169,10 +213,20 @@ private:
     QPoint posePointStart;
     // The list of already added points
     QList<CorrespondingPoints> points;
-    // The image that the pose is to be created for
-    Image *image = Q_NULLPTR;
+    // The image that the pose is to be created for, a copy because the views replace theirs
+    UniquePointer<Image> image;
     // The object model that the pose is to be created for
     ObjectModel *objectModel = Q_NULLPTR;
+    // Computes the pose from the points
+    PnPSolver solver;
+    // Computes the pose from the points of several views
+    MultiViewPnPSolver multiViewSolver;
+    // The result of the last pose creation
+    PnPSolution lastSolution;
+    // Whether the points of the image can be combined with the points of other views
+    static bool isCalibratedView(const Image &image);
+    bool createSingleViewPose();
+    bool createMultiViewPose();
     // Helper method to print debug statements
     QString correspondingPointsToString(const CorrespondingPoints& points);
 };
@@ -0,0 +1,296 @@
+#include "sharedmemoryimagetransport.hpp"
+#include "misc/imageloading/imagesource.hpp"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QtDebug>
+
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const QString SharedMemoryImageTransport::CONFIG_KEY = "IMAGE_TRANSPORT";
+const QString SharedMemoryImageTransport::CONFIG_VALUE_SHARED_MEMORY = "shared_memory";
+const QString SharedMemoryImageTransport::CONFIG_NAME_KEY = "IMAGE_TRANSPORT_NAME";
+const QString SharedMemoryImageTransport::CONFIG_NOTIFY_KEY = "IMAGE_TRANSPORT_NOTIFY";
+const int SharedMemoryImageTransport::DEFAULT_NUMBER_OF_SLOTS = 4;
+const int SharedMemoryImageTransport::WAIT_TIMEOUT = 50;
+
+//! Keep in sync with misc/scripting/shmimagering.py
+static const char RING_MAGIC[8] = {'6', 'D', 'P', 'A', 'T', 'R', 'B', '1'};
+static const quint32 RING_VERSION = 1;
+static const qint64 RING_HEADER_SIZE = 64;
+static const qint64 SLOT_HEADER_SIZE = 1152;
+static const int SLOT_PATH_SIZE = 1024;
+static const int CHANNELS = 3;
+
+struct RingHeader {
+    char magic[8];
+    quint32 version;
+    quint32 slotCount;
+    quint64 slotSize;
+    quint64 headerSize;
+    quint64 writeSequence;
+    quint64 readSequence;
+    quint32 closed;
+    quint32 reserved;
+};
+
+struct SlotHeader {
+    quint64 sequence;
+    quint32 width;
+    quint32 height;
+    quint32 stride;
+    quint32 channels;
+    double cameraMatrix[9];
+    char path[SLOT_PATH_SIZE];
+};
+
+Q_STATIC_ASSERT(sizeof(RingHeader) <= RING_HEADER_SIZE);
+Q_STATIC_ASSERT(sizeof(SlotHeader) <= SLOT_HEADER_SIZE);
+
+static QAtomicInt transportCounter;
+
+QString SharedMemoryImageTransport::createName() {
+    return QString("/6dpat_%1_%2").arg(QCoreApplication::applicationPid())
+                                  .arg(transportCounter.fetchAndAddRelaxed(1));
+}
+
+//! Rows are padded to 4 bytes, just like QImage does it
+static qint64 strideForWidth(qint64 width) {
+    return (width * CHANNELS + 3) & ~qint64(3);
+}
+
+qint64 SharedMemoryImageTransport::requiredSlotCapacity(const QStringList &absoluteImagePaths) {
+    qint64 capacity = 0;
+    for (const QString &path : absoluteImagePaths) {
+        QSize size = ImageSource::readImageSize(path);
+        if (size.isValid()) {
+            capacity = qMax(capacity, strideForWidth(size.width()) * size.height());
+        }
+    }
+    return capacity;
+}
+
+SharedMemoryImageTransport::SharedMemoryImageTransport(const QString &name,
+                                                       int numberOfSlots,
+                                                       qint64 slotCapacity) :
+    name(name),
+    numberOfSlots(numberOfSlots) {
+#ifdef Q_OS_UNIX
+    // Slots are padded to multiples of 64 bytes so that the pixels of every slot start
+    // at an aligned address
+    slotSize = (SLOT_HEADER_SIZE + slotCapacity + 63) & ~qint64(63);
+    mappedSize = (size_t) (RING_HEADER_SIZE + slotSize * numberOfSlots);
+    QByteArray nativeName = name.toLocal8Bit();
+    int fileDescriptor = shm_open(nativeName.constData(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fileDescriptor == -1) {
+        qDebug() << "Could not create shared memory " + name;
+        return;
+    }
+    if (ftruncate(fileDescriptor, (off_t) mappedSize) == -1) {
+        qDebug() << "Could not allocate shared memory " + name;
+        ::close(fileDescriptor);
+        shm_unlink(nativeName.constData());
+        return;
+    }
+    void *mapped = mmap(Q_NULLPTR, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    // The mapping stays valid after closing the descriptor
+    ::close(fileDescriptor);
+    if (mapped == MAP_FAILED) {
+        qDebug() << "Could not map shared memory " + name;
+        shm_unlink(nativeName.constData());
+        return;
+    }
+    memory = static_cast<uchar*>(mapped);
+
+    // ftruncate zero-fills, only the non-zero fields have to be set
+    RingHeader *header = reinterpret_cast<RingHeader*>(memory);
+    std::memcpy(header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+    header->version = RING_VERSION;
+    header->slotCount = (quint32) numberOfSlots;
+    header->slotSize = (quint64) slotSize;
+    header->headerSize = (quint64) RING_HEADER_SIZE;
+    createNotifyFifo();
+#else
+    Q_UNUSED(slotCapacity)
+#endif
+}
+
+SharedMemoryImageTransport::~SharedMemoryImageTransport() {
+#ifdef Q_OS_UNIX
+    if (notifyReadDescriptor != -1) {
+        ::close(notifyReadDescriptor);
+        ::close(notifyWriteDescriptor);
+        ::unlink(QFile::encodeName(notifyPath).constData());
+    }
+    if (memory) {
+        munmap(memory, mappedSize);
+        // The network keeps its mapping if it still has one, the memory is freed once
+        // both sides have unmapped it
+        shm_unlink(name.toLocal8Bit().constData());
+    }
+#endif
+}
+
+void SharedMemoryImageTransport::createNotifyFifo() {
+#ifdef Q_OS_UNIX
+    // The name of the shared memory starts with a slash
+    QString path = QDir(QDir::tempPath()).filePath(name.mid(1) + ".notify");
+    QByteArray nativePath = QFile::encodeName(path);
+    if (mkfifo(nativePath.constData(), 0600) == -1) {
+        qDebug() << "Could not create " + path + ", waiting for the network by polling.";
+        return;
+    }
+    // Opening the reading end first, the writing end would fail otherwise
+    notifyReadDescriptor = ::open(nativePath.constData(), O_RDONLY | O_NONBLOCK);
+    notifyWriteDescriptor = notifyReadDescriptor == -1
+            ? -1 : ::open(nativePath.constData(), O_WRONLY | O_NONBLOCK);
+    if (notifyWriteDescriptor == -1) {
+        qDebug() << "Could not open " + path + ", waiting for the network by polling.";
+        if (notifyReadDescriptor != -1) {
+            ::close(notifyReadDescriptor);
+            notifyReadDescriptor = -1;
+        }
+        ::unlink(nativePath.constData());
+        return;
+    }
+    notifyPath = path;
+#endif
+}
+
+void SharedMemoryImageTransport::waitForNotification() {
+#ifdef Q_OS_UNIX
+    if (notifyReadDescriptor == -1) {
+        poll(Q_NULLPTR, 0, WAIT_TIMEOUT);
+        return;
+    }
+    struct pollfd notification = { notifyReadDescriptor, POLLIN, 0 };
+    if (poll(&notification, 1, WAIT_TIMEOUT) > 0) {
+        // Several notifications count as one, the read sequence tells how far the reader is
+        char buffer[64];
+        while (::read(notifyReadDescriptor, buffer, sizeof(buffer)) > 0) {
+        }
+    }
+#endif
+}
+
+bool SharedMemoryImageTransport::isValid() const {
+    return memory != Q_NULLPTR;
+}
+
+QString SharedMemoryImageTransport::getName() const {
+    return name;
+}
+
+QJsonObject SharedMemoryImageTransport::configEntries() const {
+    QJsonObject entries;
+    if (isValid()) {
+        entries[CONFIG_KEY] = CONFIG_VALUE_SHARED_MEMORY;
+        entries[CONFIG_NAME_KEY] = name;
+        if (!notifyPath.isEmpty()) {
+            entries[CONFIG_NOTIFY_KEY] = notifyPath;
+        }
+    }
+    return entries;
+}
+
+bool SharedMemoryImageTransport::write(const QImage &image, const QMatrix3x3 &cameraMatrix,
+                                       const QString &imagePath,
+                                       const CancellationToken &cancellationToken) {
+#ifdef Q_OS_UNIX
+    if (!isValid()) {
+        return false;
+    }
+    RingHeader *header = reinterpret_cast<RingHeader*>(memory);
+    quint64 sequence = writeSequence + 1;
+
+    // Wait until the reader has released the slot that we are going to overwrite
+    while (sequence - __atomic_load_n(&header->readSequence, __ATOMIC_ACQUIRE)
+           > (quint64) numberOfSlots) {
+        if (cancellationToken.isCancelled()) {
+            return false;
+        }
+        waitForNotification();
+    }
+
+    uchar *slot = memory + RING_HEADER_SIZE + ((sequence - 1) % numberOfSlots) * slotSize;
+    SlotHeader *slotHeader = reinterpret_cast<SlotHeader*>(slot);
+    uchar *pixels = slot + SLOT_HEADER_SIZE;
+
+    QImage rgbImage = image.isNull() ? QImage() : image.convertToFormat(QImage::Format_RGB888);
+    qint64 stride = strideForWidth(rgbImage.width());
+    bool fits = stride * rgbImage.height() <= slotSize - SLOT_HEADER_SIZE;
+    if (!fits) {
+        qDebug() << "Image " + imagePath + " does not fit into the shared memory slot.";
+        rgbImage = QImage();
+    }
+    slotHeader->width = (quint32) rgbImage.width();
+    slotHeader->height = (quint32) rgbImage.height();
+    slotHeader->stride = (quint32) stride;
+    slotHeader->channels = (quint32) CHANNELS;
+    for (int i = 0; i < 9; i++) {
+        slotHeader->cameraMatrix[i] = (double) cameraMatrix(i / 3, i % 3);
+    }
+    QByteArray path = imagePath.toUtf8().left(SLOT_PATH_SIZE - 1);
+    std::memcpy(slotHeader->path, path.constData(), path.size());
+    slotHeader->path[path.size()] = '\0';
+    for (int y = 0; y < rgbImage.height(); y++) {
+        std::memcpy(pixels + y * stride, rgbImage.constScanLine(y), rgbImage.width() * CHANNELS);
+    }
+
+    // Publish the slot only after its contents are complete
+    __atomic_store_n(&slotHeader->sequence, sequence, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->writeSequence, sequence, __ATOMIC_RELEASE);
+    writeSequence = sequence;
+    return fits;
+#else
+    Q_UNUSED(image)
+    Q_UNUSED(cameraMatrix)
+    Q_UNUSED(imagePath)
+    Q_UNUSED(cancellationToken)
+    return false;
+#endif
+}
+
+void SharedMemoryImageTransport::close() {
+#ifdef Q_OS_UNIX
+    if (isValid()) {
+        RingHeader *header = reinterpret_cast<RingHeader*>(memory);
+        __atomic_store_n(&header->closed, (quint32) 1, __ATOMIC_RELEASE);
+    }
+#endif
+}
+
+SharedMemoryImageWriterRunnable::SharedMemoryImageWriterRunnable(
+        QSharedPointer<SharedMemoryImageTransport> transport,
+        const QVector<Image> &images,
+        QSharedPointer<CancellationToken> cancellationToken,
+        ImagePyramidCache *imagePyramidCache) :
+    transport(transport),
+    images(images),
+    imagePyramidCache(imagePyramidCache),
+    cancellationToken(cancellationToken) {
+}
+
+void SharedMemoryImageWriterRunnable::run() {
+    for (const Image &image : images) {
+        if (cancellationToken->isCancelled()) {
+            return;
+        }
+        QImage decodedImage = imagePyramidCache
+                ? imagePyramidCache->get(image.getAbsoluteImagePath())->getLevel(0)
+                : ImageSource::readImage(image.getAbsoluteImagePath());
+        transport->write(decodedImage, image.getCameraMatrix(),
+                         image.getImagePath(), *cancellationToken);
+    }
+    transport->close();
+}
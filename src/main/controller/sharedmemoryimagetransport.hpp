@@ -0,0 +1,141 @@
+#ifndef SHAREDMEMORYIMAGETRANSPORT_H
+#define SHAREDMEMORYIMAGETRANSPORT_H
+
+#include "model/image.hpp"
+#include "misc/cancellationtoken.hpp"
+#include "misc/imageloading/imagepyramidcache.hpp"
+
+#include <QString>
+#include <QStringList>
+#include <QImage>
+#include <QMatrix3x3>
+#include <QJsonObject>
+#include <QVector>
+#include <QSharedPointer>
+#include <QRunnable>
+
+/*!
+ * \brief The SharedMemoryImageTransport class hands decoded images and their camera matrices
+ * to the network through a ring buffer in POSIX shared memory, so that the network does not
+ * have to read and decode the images from disk again. The counterpart for the network is
+ * misc/scripting/shmimagering.py, which maps the slots as arrays without copying.
+ *
+ * The memory starts with a ring header followed by the slots:
+ *
+ * ring header (64 bytes): magic "6DPATRB1", version, slot count, slot size, header size,
+ *                         write sequence, read sequence, closed flag
+ * slot header (1152 bytes): sequence, width, height, stride, channels, K (9 doubles, row-major),
+ *                           image path (UTF-8, zero-terminated)
+ * pixels: RGB, 8 bit per channel, rows of `stride` bytes
+ *
+ * Frames are written in the order of the image list. The writer only reuses a slot once the
+ * reader has acknowledged it by advancing the read sequence. Images that cannot be decoded are
+ * written with width and height 0 to keep the order intact. The reader writes a byte to the
+ * FIFO named by CONFIG_NOTIFY_KEY after advancing the read sequence, the writer sleeps on it
+ * while all slots are full. Readers that do not notify still work, the writer then checks the
+ * read sequence every WAIT_TIMEOUT milliseconds.
+ *
+ * Shared memory is only supported on Unix systems, elsewhere isValid() returns false and the
+ * network has to read the images from disk.
+ */
+class SharedMemoryImageTransport
+{
+public:
+    //! The config key that tells the network which transport to use
+    static const QString CONFIG_KEY;
+    static const QString CONFIG_VALUE_SHARED_MEMORY;
+    //! The config key of the name of the shared memory object
+    static const QString CONFIG_NAME_KEY;
+    //! The config key of the path of the FIFO that the reader notifies the writer through
+    static const QString CONFIG_NOTIFY_KEY;
+    static const int DEFAULT_NUMBER_OF_SLOTS;
+    //! The longest time in milliseconds that the writer waits for a notification before it
+    //! checks the read sequence and the cancellation again
+    static const int WAIT_TIMEOUT;
+
+    /*!
+     * \brief createName creates a name for a shared memory object that is unique for this
+     * process.
+     */
+    static QString createName();
+
+    /*!
+     * \brief requiredSlotCapacity computes how many bytes of pixels the slots need to be able
+     * to hold the largest of the given images. Only the headers of the image files are read.
+     */
+    static qint64 requiredSlotCapacity(const QStringList &absoluteImagePaths);
+
+    /*!
+     * \brief SharedMemoryImageTransport creates the shared memory object with the given name.
+     * \param name the name of the object, see createName()
+     * \param numberOfSlots the number of frames that can be written ahead of the reader
+     * \param slotCapacity the number of bytes of pixels that one slot can hold
+     */
+    SharedMemoryImageTransport(const QString &name, int numberOfSlots, qint64 slotCapacity);
+    ~SharedMemoryImageTransport();
+
+    bool isValid() const;
+    QString getName() const;
+
+    /*!
+     * \brief configEntries returns the entries that have to be set on the network's config
+     * so that the network reads the images through this transport.
+     */
+    QJsonObject configEntries() const;
+
+    /*!
+     * \brief write writes the image into the next slot. Blocks until the reader has freed a
+     * slot or the token is cancelled.
+     * \param image the decoded image, may be null if it could not be decoded
+     * \return false if the transport is invalid, the image is too large or the write was cancelled
+     */
+    bool write(const QImage &image, const QMatrix3x3 &cameraMatrix,
+               const QString &imagePath, const CancellationToken &cancellationToken);
+
+    /*!
+     * \brief close marks the end of the stream, the reader stops after the last written frame.
+     */
+    void close();
+
+private:
+    QString name;
+    int numberOfSlots;
+    qint64 slotSize = 0;
+    size_t mappedSize = 0;
+    uchar *memory = Q_NULLPTR;
+    quint64 writeSequence = 0;
+    QString notifyPath;
+    //! Both ends of the FIFO, the writing end keeps it open when the reader has not opened it
+    //! yet or closed it already
+    int notifyReadDescriptor = -1;
+    int notifyWriteDescriptor = -1;
+
+    void createNotifyFifo();
+    //! Blocks until the reader notifies or the timeout has passed
+    void waitForNotification();
+};
+
+/*!
+ * \brief The SharedMemoryImageWriterRunnable class writes the images of a chunk to the
+ * transport in the order the network expects them. The images are taken from the
+ * ImagePyramidCache if one is set, i.e. images that have already been decoded for display are
+ * not decoded again and the ones decoded here are there when the user looks at them.
+ */
+class SharedMemoryImageWriterRunnable : public QRunnable
+{
+public:
+    //! \param imagePyramidCache the cache to take the images from, null to decode them
+    SharedMemoryImageWriterRunnable(QSharedPointer<SharedMemoryImageTransport> transport,
+                                    const QVector<Image> &images,
+                                    QSharedPointer<CancellationToken> cancellationToken,
+                                    ImagePyramidCache *imagePyramidCache = Q_NULLPTR);
+    void run() override;
+
+private:
+    QSharedPointer<SharedMemoryImageTransport> transport;
+    QVector<Image> images;
+    ImagePyramidCache *imagePyramidCache;
+    QSharedPointer<CancellationToken> cancellationToken;
+};
+
+#endif // SHAREDMEMORYIMAGETRANSPORT_H
@@ -0,0 +1,12 @@
+#include "cancellationtoken.hpp"
+
+CancellationToken::CancellationToken() : cancelled(0) {
+}
+
+void CancellationToken::cancel() {
+    cancelled.storeRelease(1);
+}
+
+bool CancellationToken::isCancelled() const {
+    return cancelled.loadAcquire() != 0;
+}
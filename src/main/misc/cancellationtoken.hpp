@@ -0,0 +1,31 @@
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <QAtomicInt>
+
+/*!
+ * \brief The CancellationToken class is a thread-safe flag that allows to request the
+ * cancellation of a long running operation. The operation polls isCancelled() at points
+ * where it can stop safely, the requester calls cancel() from any thread.
+ */
+class CancellationToken
+{
+public:
+    CancellationToken();
+
+    /*!
+     * \brief cancel requests the cancellation of the operation that holds this token.
+     */
+    void cancel();
+
+    /*!
+     * \brief isCancelled returns whether cancel() has been called on this token.
+     * \return whether the operation is to be cancelled
+     */
+    bool isCancelled() const;
+
+private:
+    QAtomicInt cancelled;
+};
+
+#endif // CANCELLATIONTOKEN_H
@@ -0,0 +1,214 @@
+#include "directoryindexer.hpp"
+
+#include <QCollator>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtDebug>
+
+#include <algorithm>
+
+//! Identifies the manifest files, followed by the version
+static const quint32 MANIFEST_FILE_MAGIC = 0x3650444d;
+static const quint32 MANIFEST_FILE_VERSION = 1;
+
+DirectoryScanRunnable::DirectoryScanRunnable(const QString &root,
+                                             const QStringList &nameFilters,
+                                             ScannedDirectory *directory) :
+    root(root),
+    nameFilters(nameFilters),
+    directory(directory) {
+}
+
+void DirectoryScanRunnable::run() {
+    QString path = directory->path.isEmpty() ? root : QDir(root).filePath(directory->path);
+    directory->lastModified = QFileInfo(path).lastModified().toMSecsSinceEpoch();
+    // The name filters are applied to files only, folders are always descended into except
+    // for links to folders, which may point to a folder above and loop forever
+    QDirIterator iterator(path, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (iterator.hasNext()) {
+        iterator.next();
+        QFileInfo info = iterator.fileInfo();
+        QString relativePath = directory->path.isEmpty()
+                ? info.fileName() : directory->path + "/" + info.fileName();
+        if (info.isDir()) {
+            if (!info.isSymLink()) {
+                directory->subdirectories << relativePath;
+            }
+        } else if (nameFilters.isEmpty() || QDir::match(nameFilters, info.fileName())) {
+            IndexedFile file;
+            file.path = relativePath;
+            file.size = info.size();
+            file.lastModified = info.lastModified().toMSecsSinceEpoch();
+            directory->files << file;
+        }
+    }
+}
+
+DirectoryIndexer::DirectoryIndexer(const QString &manifestCachePath) :
+    manifestCachePath(manifestCachePath) {
+}
+
+QList<IndexedFile> DirectoryIndexer::index(const QString &root,
+                                           const QStringList &nameFilters,
+                                           bool recursive) {
+    QList<IndexedFile> files;
+    if (!QFileInfo(root).isDir()) {
+        return files;
+    }
+    QString manifestPath = manifestFilePath(root, nameFilters, recursive);
+    if (readManifest(root, manifestPath, files)) {
+        return files;
+    }
+
+    // Level by level, the folders of one level are listed in parallel
+    QList<ScannedDirectory> directories;
+    QStringList pending = {QString()};
+    while (!pending.isEmpty()) {
+        QVector<ScannedDirectory> level(pending.size());
+        for (int i = 0; i < pending.size(); i++) {
+            level[i].path = pending[i];
+            threadPool.start(new DirectoryScanRunnable(root, nameFilters, &level[i]));
+        }
+        threadPool.waitForDone();
+        pending.clear();
+        for (const ScannedDirectory &directory : level) {
+            directories << directory;
+            files << directory.files;
+            if (recursive) {
+                pending << directory.subdirectories;
+            }
+        }
+    }
+    if (!recursive) {
+        // The manifest doesn't depend on the subfolders then
+        directories.first().subdirectories.clear();
+        directories = {directories.first()};
+    }
+
+    QStringList paths;
+    paths.reserve(files.size());
+    for (const IndexedFile &file : files) {
+        paths << file.path;
+    }
+    QList<IndexedFile> sortedFiles;
+    sortedFiles.reserve(files.size());
+    for (int i : naturalOrder(paths)) {
+        sortedFiles << files[i];
+    }
+    writeManifest(root, manifestPath, directories, sortedFiles);
+    return sortedFiles;
+}
+
+QVector<int> DirectoryIndexer::naturalOrder(const QStringList &strings) {
+    QCollator collator;
+    collator.setNumericMode(true);
+    QList<QCollatorSortKey> sortKeys;
+    sortKeys.reserve(strings.size());
+    QVector<int> order(strings.size());
+    for (int i = 0; i < strings.size(); i++) {
+        sortKeys << collator.sortKey(strings[i]);
+        order[i] = i;
+    }
+    std::sort(
+        order.begin(),
+        order.end(),
+        [&sortKeys](int i1, int i2)
+        {
+            return sortKeys[i1].compare(sortKeys[i2]) < 0;
+        });
+    return order;
+}
+
+QString DirectoryIndexer::defaultManifestCachePath() {
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+            .filePath("manifests");
+}
+
+QString DirectoryIndexer::manifestFilePath(const QString &root, const QStringList &nameFilters,
+                                           bool recursive) const {
+    if (manifestCachePath.isEmpty()) {
+        return QString();
+    }
+    QByteArray identity = QFileInfo(root).absoluteFilePath().toUtf8() + '|'
+            + nameFilters.join(';').toUtf8() + '|' + (recursive ? "1" : "0");
+    QByteArray key = QCryptographicHash::hash(identity, QCryptographicHash::Sha1).toHex();
+    return QDir(manifestCachePath).filePath(key + ".manifest");
+}
+
+bool DirectoryIndexer::readManifest(const QString &root, const QString &manifestPath,
+                                    QList<IndexedFile> &files) const {
+    if (manifestPath.isEmpty()) {
+        return false;
+    }
+    QFile file(manifestPath);
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    quint32 magic, version;
+    QString locale;
+    stream >> magic >> version >> locale;
+    // The natural order depends on the locale
+    if (magic != MANIFEST_FILE_MAGIC || version != MANIFEST_FILE_VERSION
+            || locale != QLocale().name()) {
+        return false;
+    }
+    // Adding, removing or renaming a file modifies the folder it is in
+    quint32 numberOfDirectories;
+    stream >> numberOfDirectories;
+    for (quint32 i = 0; i < numberOfDirectories && stream.status() == QDataStream::Ok; i++) {
+        QString path;
+        qint64 lastModified;
+        stream >> path >> lastModified;
+        QString absolutePath = path.isEmpty() ? root : QDir(root).filePath(path);
+        if (QFileInfo(absolutePath).lastModified().toMSecsSinceEpoch() != lastModified) {
+            return false;
+        }
+    }
+    quint32 numberOfFiles;
+    stream >> numberOfFiles;
+    files.reserve(numberOfFiles);
+    for (quint32 i = 0; i < numberOfFiles && stream.status() == QDataStream::Ok; i++) {
+        IndexedFile indexedFile;
+        stream >> indexedFile.path >> indexedFile.size >> indexedFile.lastModified;
+        files << indexedFile;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        files.clear();
+        return false;
+    }
+    return true;
+}
+
+void DirectoryIndexer::writeManifest(const QString &root, const QString &manifestPath,
+                                     const QList<ScannedDirectory> &directories,
+                                     const QList<IndexedFile> &files) const {
+    if (manifestPath.isEmpty() || !QDir().mkpath(manifestCachePath)) {
+        return;
+    }
+    QSaveFile file(manifestPath);
+    if (!file.open(QFile::WriteOnly)) {
+        return;
+    }
+    QDataStream stream(&file);
+    stream << MANIFEST_FILE_MAGIC << MANIFEST_FILE_VERSION << QLocale().name()
+           << (quint32) directories.size();
+    for (const ScannedDirectory &directory : directories) {
+        stream << directory.path << directory.lastModified;
+    }
+    stream << (quint32) files.size();
+    for (const IndexedFile &indexedFile : files) {
+        stream << indexedFile.path << indexedFile.size << indexedFile.lastModified;
+    }
+    if (!file.commit()) {
+        qDebug() << "Could not store the manifest of " + root;
+    }
+}
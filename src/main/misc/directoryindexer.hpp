@@ -0,0 +1,99 @@
+#ifndef DIRECTORYINDEXER_H
+#define DIRECTORYINDEXER_H
+
+#include <QList>
+#include <QRunnable>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+//! A file found by the DirectoryIndexer
+struct IndexedFile {
+    //! Path relative to the indexed folder
+    QString path;
+    qint64 size;
+    //! Milliseconds since epoch
+    qint64 lastModified;
+};
+
+//! The files and subfolders directly in one folder
+struct ScannedDirectory {
+    //! Path relative to the indexed folder, empty for the folder itself
+    QString path;
+    qint64 lastModified = 0;
+    QList<IndexedFile> files;
+    QStringList subdirectories;
+};
+
+/*!
+ * \brief The DirectoryScanRunnable class lists one folder of an index.
+ */
+class DirectoryScanRunnable : public QRunnable
+{
+public:
+    DirectoryScanRunnable(const QString &root, const QStringList &nameFilters,
+                          ScannedDirectory *directory);
+    void run() override;
+
+private:
+    QString root;
+    QStringList nameFilters;
+    ScannedDirectory *directory;
+};
+
+/*!
+ * \brief The DirectoryIndexer class lists the files of a folder, optionally including its
+ * subfolders, in natural order, i.e. image_2 before image_10. Links to folders are not
+ * followed.
+ *
+ * The subfolders are listed in parallel. The result is stored as a manifest with the names,
+ * sizes and modification times of the files in the cache location of the user. When the
+ * same folder is indexed again and none of the listed folders has been modified since, the
+ * manifest is returned and only the folders are looked at, not the files in them. Note that
+ * overwriting a file doesn't modify its folder, i.e. the size and modification time in the
+ * manifest are those of the time of the scan.
+ */
+class DirectoryIndexer
+{
+public:
+    /*!
+     * \brief DirectoryIndexer constructor.
+     * \param manifestCachePath the folder to store the manifests in, empty to always scan
+     */
+    explicit DirectoryIndexer(const QString &manifestCachePath = defaultManifestCachePath());
+
+    /*!
+     * \brief index returns the files in the folder that match the name filters, sorted
+     * naturally by their relative paths.
+     * \param root the folder to index
+     * \param nameFilters wildcards like *.png, all files are listed if empty
+     * \param recursive whether the files in subfolders are listed as well
+     */
+    QList<IndexedFile> index(const QString &root,
+                             const QStringList &nameFilters = QStringList(),
+                             bool recursive = false);
+
+    /*!
+     * \brief naturalOrder returns the indices of the strings in natural order. The collation
+     * key of every string is computed once instead of once per comparison.
+     */
+    static QVector<int> naturalOrder(const QStringList &strings);
+
+    //! The folder in the cache location of the user
+    static QString defaultManifestCachePath();
+
+private:
+    QString manifestCachePath;
+    QThreadPool threadPool;
+
+    QString manifestFilePath(const QString &root, const QStringList &nameFilters,
+                             bool recursive) const;
+    bool readManifest(const QString &root, const QString &manifestPath,
+                      QList<IndexedFile> &files) const;
+    void writeManifest(const QString &root, const QString &manifestPath,
+                       const QList<ScannedDirectory> &directories,
+                       const QList<IndexedFile> &files) const;
+};
+
+#endif // DIRECTORYINDEXER_H
@@ -0,0 +1,296 @@
+#include "penetrationchecker.hpp"
+
+#include <QMap>
+#include <QSet>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+#include <QtDebug>
+
+#include <algorithm>
+
+static QVector3D rotate(const QMatrix3x3 &rotation, const QVector3D &point) {
+    return QVector3D(
+        rotation(0, 0) * point.x() + rotation(0, 1) * point.y() + rotation(0, 2) * point.z(),
+        rotation(1, 0) * point.x() + rotation(1, 1) * point.y() + rotation(1, 2) * point.z(),
+        rotation(2, 0) * point.x() + rotation(2, 1) * point.y() + rotation(2, 2) * point.z());
+}
+
+//! Rotates by the inverse, i.e. the transposed rotation
+static QVector3D rotateInverse(const QMatrix3x3 &rotation, const QVector3D &point) {
+    return QVector3D(
+        rotation(0, 0) * point.x() + rotation(1, 0) * point.y() + rotation(2, 0) * point.z(),
+        rotation(0, 1) * point.x() + rotation(1, 1) * point.y() + rotation(2, 1) * point.z(),
+        rotation(0, 2) * point.x() + rotation(1, 2) * point.y() + rotation(2, 2) * point.z());
+}
+
+//! A pose with everything the check needs, the box is in camera coordinates
+struct PosedObject {
+    const Pose *pose;
+    MeshPtr mesh;
+    BvhPtr bvh;
+    QVector3D minimum;
+    QVector3D maximum;
+};
+
+static PosedObject posedObject(const Pose &pose, const MeshPtr &mesh, const BvhPtr &bvh) {
+    PosedObject object { &pose, mesh, bvh, QVector3D(), QVector3D() };
+    QVector3D modelMinimum = bvh->getMinimum();
+    QVector3D modelMaximum = bvh->getMaximum();
+    for (int corner = 0; corner < 8; corner++) {
+        QVector3D point(corner & 1 ? modelMaximum.x() : modelMinimum.x(),
+                        corner & 2 ? modelMaximum.y() : modelMinimum.y(),
+                        corner & 4 ? modelMaximum.z() : modelMinimum.z());
+        point = rotate(pose.getRotation(), point) + pose.getPosition();
+        for (int axis = 0; axis < 3; axis++) {
+            object.minimum[axis] = corner == 0 ? point[axis]
+                                               : std::min(object.minimum[axis], point[axis]);
+            object.maximum[axis] = corner == 0 ? point[axis]
+                                               : std::max(object.maximum[axis], point[axis]);
+        }
+    }
+    return object;
+}
+
+/*!
+ * \brief penetrate tests the vertices of the one object that lie in the overlap of the boxes
+ * for being inside the other object.
+ * \return the depth of the deepest vertex, 0 if there is none
+ */
+static float penetrate(const PosedObject &vertexObject, const PosedObject &meshObject,
+                       const QVector3D &overlapMinimum, const QVector3D &overlapMaximum,
+                       int &penetratingVertices) {
+    float depth = 0.f;
+    QMatrix3x3 rotation = vertexObject.pose->getRotation();
+    QVector3D position = vertexObject.pose->getPosition();
+    QMatrix3x3 meshRotation = meshObject.pose->getRotation();
+    QVector3D meshPosition = meshObject.pose->getPosition();
+    for (const QVector3D &vertex : vertexObject.mesh->getVertices()) {
+        QVector3D point = rotate(rotation, vertex) + position;
+        if (point.x() < overlapMinimum.x() || point.y() < overlapMinimum.y()
+                || point.z() < overlapMinimum.z() || point.x() > overlapMaximum.x()
+                || point.y() > overlapMaximum.y() || point.z() > overlapMaximum.z()) {
+            continue;
+        }
+        QVector3D meshPoint = rotateInverse(meshRotation, point - meshPosition);
+        if (meshObject.bvh->contains(meshPoint)) {
+            penetratingVertices++;
+            depth = std::max(depth, meshObject.bvh->distance(meshPoint));
+        }
+    }
+    return depth;
+}
+
+/*!
+ * \brief crossEdges tests the edges of the one object that reach into the overlap of the boxes
+ * for crossing the triangles of the other object. The parts of an edge between its crossings
+ * are alternately inside and outside of the other object, an inside part counts with the
+ * distance of its middle to the surface of the other object.
+ * \return the depth of the deepest part of an edge, 0 if there is none
+ */
+static float crossEdges(const PosedObject &edgeObject, const PosedObject &meshObject,
+                        const QVector3D &overlapMinimum, const QVector3D &overlapMaximum,
+                        int &crossingEdges) {
+    const QVector<QVector3D> &vertices = edgeObject.mesh->getVertices();
+    const QVector<quint32> &indices = edgeObject.mesh->getIndices();
+    QMatrix3x3 rotation = edgeObject.pose->getRotation();
+    QVector3D position = edgeObject.pose->getPosition();
+    QMatrix3x3 meshRotation = meshObject.pose->getRotation();
+    QVector3D meshPosition = meshObject.pose->getPosition();
+    // The vertices in camera coordinates and in the ones of the other object model
+    QVector<QVector3D> points(vertices.size());
+    QVector<QVector3D> meshPoints(vertices.size());
+    for (int i = 0; i < vertices.size(); i++) {
+        points[i] = rotate(rotation, vertices[i]) + position;
+        meshPoints[i] = rotateInverse(meshRotation, points[i] - meshPosition);
+    }
+
+    float depth = 0.f;
+    // Neighbouring triangles share their edges
+    QSet<quint64> testedEdges;
+    for (int i = 0; i < indices.size(); i++) {
+        quint32 start = indices[i];
+        quint32 end = indices[i % 3 == 2 ? i - 2 : i + 1];
+        quint64 edge = (quint64) std::min(start, end) << 32 | std::max(start, end);
+        if (start == end || testedEdges.contains(edge)) {
+            continue;
+        }
+        testedEdges.insert(edge);
+        bool outside = false;
+        for (int axis = 0; axis < 3; axis++) {
+            outside = outside
+                    || std::max(points[start][axis], points[end][axis]) < overlapMinimum[axis]
+                    || std::min(points[start][axis], points[end][axis]) > overlapMaximum[axis];
+        }
+        if (outside) {
+            continue;
+        }
+        QVector<float> parameters = meshObject.bvh->crossings(meshPoints[start],
+                                                              meshPoints[end]);
+        if (parameters.isEmpty()) {
+            continue;
+        }
+        parameters.prepend(0.f);
+        parameters.append(1.f);
+        bool crossing = false;
+        for (int j = 1; j < parameters.size(); j++) {
+            QVector3D middle = meshPoints[start] + (meshPoints[end] - meshPoints[start])
+                    * (0.5f * (parameters[j - 1] + parameters[j]));
+            if (meshObject.bvh->contains(middle)) {
+                crossing = true;
+                depth = std::max(depth, meshObject.bvh->distance(middle));
+            }
+        }
+        crossingEdges += crossing ? 1 : 0;
+    }
+    return depth;
+}
+
+//! The poses of one image
+struct ImageCheck {
+    QList<Pose> poses;
+    QList<Penetration> penetrations;
+};
+
+/*!
+ * \brief The ImageCheckRunnable class checks all pairs of poses of one image.
+ */
+class ImageCheckRunnable : public QRunnable {
+public:
+    ImageCheckRunnable(ImageCheck *imageCheck, const QHash<QString, MeshPtr> *meshes,
+                       const QHash<QString, BvhPtr> *bvhs, float minDepth) :
+        imageCheck(imageCheck),
+        meshes(meshes),
+        bvhs(bvhs),
+        minDepth(minDepth) {
+    }
+
+    void run() override {
+        QList<PosedObject> objects;
+        for (const Pose &pose : imageCheck->poses) {
+            QString path = pose.getObjectModel()->getAbsolutePath();
+            BvhPtr bvh = bvhs->value(path);
+            if (!bvh.isNull() && bvh->getTriangleCount() > 0) {
+                objects << posedObject(pose, meshes->value(path), bvh);
+            }
+        }
+        for (int i = 0; i < objects.size(); i++) {
+            for (int j = i + 1; j < objects.size(); j++) {
+                check(objects[i], objects[j]);
+            }
+        }
+    }
+
+private:
+    ImageCheck *imageCheck;
+    const QHash<QString, MeshPtr> *meshes;
+    const QHash<QString, BvhPtr> *bvhs;
+    float minDepth;
+
+    void check(const PosedObject &object1, const PosedObject &object2) {
+        QVector3D overlapMinimum, overlapMaximum;
+        for (int axis = 0; axis < 3; axis++) {
+            overlapMinimum[axis] = std::max(object1.minimum[axis], object2.minimum[axis]);
+            overlapMaximum[axis] = std::min(object1.maximum[axis], object2.maximum[axis]);
+            if (overlapMinimum[axis] > overlapMaximum[axis]) {
+                // The boxes do not overlap
+                return;
+            }
+        }
+        Penetration penetration;
+        penetration.depth = std::max({
+                    penetrate(object1, object2, overlapMinimum, overlapMaximum,
+                              penetration.penetratingVertices),
+                    penetrate(object2, object1, overlapMinimum, overlapMaximum,
+                              penetration.penetratingVertices),
+                    crossEdges(object1, object2, overlapMinimum, overlapMaximum,
+                               penetration.crossingEdges),
+                    crossEdges(object2, object1, overlapMinimum, overlapMaximum,
+                               penetration.crossingEdges)});
+        if ((penetration.penetratingVertices == 0 && penetration.crossingEdges == 0)
+                || penetration.depth <= minDepth) {
+            return;
+        }
+        penetration.imagePath = object1.pose->getImage()->getImagePath();
+        penetration.poseId1 = object1.pose->getID();
+        penetration.objectModelPath1 = object1.pose->getObjectModel()->getPath();
+        penetration.poseId2 = object2.pose->getID();
+        penetration.objectModelPath2 = object2.pose->getObjectModel()->getPath();
+        imageCheck->penetrations << penetration;
+    }
+};
+
+PenetrationChecker::PenetrationChecker(int threadCount) {
+    threadPool.setMaxThreadCount(threadCount > 0 ? threadCount : QThread::idealThreadCount());
+}
+
+QList<Penetration> PenetrationChecker::check(const QList<Pose> &poses) {
+    QHash<QString, MeshPtr> meshes;
+    QMap<QString, ImageCheck> imageChecks;
+    for (const Pose &pose : poses) {
+        QString path = pose.getObjectModel()->getAbsolutePath();
+        if (!meshes.contains(path)) {
+            meshes[path] = meshCache.get(path);
+            if (meshes[path].isNull()) {
+                qWarning() << "Could not load the object model " + path
+                              + ", its poses are not checked.";
+            } else if (!bvhs.contains(path)) {
+                bvhs[path] = BvhPtr(new Bvh(*meshes[path]));
+            }
+        }
+        imageChecks[pose.getImage()->getImagePath()].poses << pose;
+    }
+
+    for (ImageCheck &imageCheck : imageChecks) {
+        if (imageCheck.poses.size() > 1) {
+            threadPool.start(new ImageCheckRunnable(&imageCheck, &meshes, &bvhs, minDepth));
+        }
+    }
+    threadPool.waitForDone();
+
+    QList<Penetration> penetrations;
+    for (const ImageCheck &imageCheck : imageChecks) {
+        penetrations += imageCheck.penetrations;
+    }
+    std::stable_sort(penetrations.begin(), penetrations.end(),
+                     [](const Penetration &penetration1, const Penetration &penetration2) {
+        return penetration1.depth > penetration2.depth;
+    });
+    return penetrations;
+}
+
+void PenetrationChecker::setMinDepth(float minDepth) {
+    this->minDepth = minDepth;
+}
+
+bool PenetrationChecker::writeCsv(const QString &path, const QList<Penetration> &penetrations) {
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        qWarning() << "Could not write " + path + ".";
+        return false;
+    }
+    QTextStream stream(&file);
+    stream << "image,pose_id_1,object_model_1,pose_id_2,object_model_2,depth,"
+              "penetrating_vertices,crossing_edges\n";
+    for (const Penetration &penetration : penetrations) {
+        stream << penetration.imagePath << ',' << penetration.poseId1 << ','
+               << penetration.objectModelPath1 << ',' << penetration.poseId2 << ','
+               << penetration.objectModelPath2 << ','
+               << QString::number(penetration.depth, 'g', 6) << ','
+               << penetration.penetratingVertices << ',' << penetration.crossingEdges << '\n';
+    }
+    stream.flush();
+    return file.commit();
+}
+
+PenetrationCheckRunnable::PenetrationCheckRunnable(PenetrationChecker *penetrationChecker,
+                                                   const QList<Image> &images,
+                                                   const QList<ObjectModel> &objectModels,
+                                                   const QList<Pose> &poses) :
+    penetrationChecker(penetrationChecker),
+    snapshot(images, objectModels, poses) {
+}
+
+void PenetrationCheckRunnable::run() {
+    Q_EMIT penetrationsChecked(penetrationChecker->check(snapshot.getPoses()));
+}
@@ -0,0 +1,101 @@
+#ifndef PENETRATIONCHECKER_H
+#define PENETRATIONCHECKER_H
+
+#include "misc/posessnapshot.hpp"
+#include "misc/geometry/bvh.hpp"
+#include "misc/geometry/mesh.hpp"
+#include "model/image.hpp"
+#include "model/objectmodel.hpp"
+#include "model/pose.hpp"
+
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+#include <QThreadPool>
+
+//! Two poses of an image whose objects intersect each other
+struct Penetration {
+    QString imagePath;
+    QString poseId1;
+    QString objectModelPath1;
+    QString poseId2;
+    QString objectModelPath2;
+    //! The largest distance of a vertex or an edge of one object inside the other object to
+    //! the surface of the other object, in units of the poses
+    float depth = 0.f;
+    //! The number of vertices of either object inside the other object
+    int penetratingVertices = 0;
+    //! The number of edges of either object that cross the surface of the other object
+    int crossingEdges = 0;
+};
+
+Q_DECLARE_METATYPE(QList<Penetration>)
+
+/*!
+ * \brief The PenetrationChecker class finds poses of the same image whose objects intersect,
+ * which physically placed objects cannot, i.e. at least one of the poses is wrong.
+ *
+ * Every object model gets a Bvh over its triangles once. The boxes of the object models are
+ * transformed by the poses and only pairs of poses whose boxes overlap are checked further.
+ * The vertices of each object that are in the overlap of the boxes are tested for being
+ * inside the other object with the Bvh of the other one. So are the edges for crossing the
+ * triangles of the other object, which finds two coarse meshes that cross without a vertex
+ * inside each other, too. Two triangles that intersect always have an edge of one of them
+ * crossing the other one, only touching coplanar triangles are missed. The penetration depth
+ * is the largest distance to the surface of the other object of a vertex inside it or of the
+ * middle of a part of an edge inside it, i.e. a lower bound of the actual depth. The object
+ * models should be closed meshes. The images are checked in parallel.
+ */
+class PenetrationChecker
+{
+public:
+    //! \param threadCount the number of images that are checked at once, 0 uses one per core
+    explicit PenetrationChecker(int threadCount = 0);
+
+    /*!
+     * \brief check checks all pairs of poses of every image. Poses belong to the same image
+     * if the paths of the images are the same.
+     * \return the penetrations deeper than the minimum depth, the deepest first
+     */
+    QList<Penetration> check(const QList<Pose> &poses);
+
+    //! The depth in units of the poses up to which objects may touch, defaults to 0
+    void setMinDepth(float minDepth);
+
+    //! Writes one line per penetration
+    static bool writeCsv(const QString &path, const QList<Penetration> &penetrations);
+
+private:
+    QThreadPool threadPool;
+    MeshCache meshCache;
+    //! By the absolute paths of the object models, built once
+    QHash<QString, BvhPtr> bvhs;
+    float minDepth = 0.f;
+};
+
+/*!
+ * \brief The PenetrationCheckRunnable class checks poses in the background and reports the
+ * result through penetrationsChecked.
+ */
+class PenetrationCheckRunnable : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    PenetrationCheckRunnable(PenetrationChecker *penetrationChecker, const QList<Image> &images,
+                             const QList<ObjectModel> &objectModels, const QList<Pose> &poses);
+    void run() override;
+
+Q_SIGNALS:
+    void penetrationsChecked(QList<Penetration> penetrations);
+
+private:
+    PenetrationChecker *penetrationChecker;
+    // The model manager might reload its images and object models in the meantime
+    PosesSnapshot snapshot;
+};
+
+#endif // PENETRATIONCHECKER_H
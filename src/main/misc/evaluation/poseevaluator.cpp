@@ -0,0 +1,477 @@
+#include "poseevaluator.hpp"
+#include "misc/geometry/kdtree.hpp"
+
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QPair>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSharedPointer>
+#include <QTextStream>
+#include <QThread>
+#include <QtDebug>
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static const float INFINITE_ERROR = std::numeric_limits<float>::infinity();
+//! The ADD(-S) recall threshold relative to the diameter and the projection threshold
+static const float ADD_THRESHOLD = 0.1f;
+static const float PROJECTION_THRESHOLD = 5.f;
+//! The diameter is computed exactly on at most this many of the model points
+static const int MAX_DIAMETER_POINTS = 4096;
+
+static QVector<float> thresholds(float step, int count) {
+    QVector<float> values;
+    for (int i = 1; i <= count; i++) {
+        values << step * i;
+    }
+    return values;
+}
+
+const QVector<float> PoseEvaluator::ADD_CURVE_THRESHOLDS = thresholds(0.01f, 50);
+const QVector<float> PoseEvaluator::PROJECTION_CURVE_THRESHOLDS = thresholds(1.f, 50);
+
+bool PoseErrors::isMatched() const {
+    return !groundTruthId.isEmpty() && !predictionId.isEmpty();
+}
+
+bool PoseErrors::isFalsePositive() const {
+    return groundTruthId.isEmpty();
+}
+
+//! The vertices of an object model prepared for the evaluation
+struct EvaluationModelPoints {
+    QVector<QVector3D> points;
+    KdTree tree;
+    float diameter = 0.f;
+};
+
+typedef QSharedPointer<const EvaluationModelPoints> EvaluationModelPointsPtr;
+
+static QVector3D rotate(const QMatrix3x3 &rotation, const QVector3D &point) {
+    return QVector3D(
+        rotation(0, 0) * point.x() + rotation(0, 1) * point.y() + rotation(0, 2) * point.z(),
+        rotation(1, 0) * point.x() + rotation(1, 1) * point.y() + rotation(1, 2) * point.z(),
+        rotation(2, 0) * point.x() + rotation(2, 1) * point.y() + rotation(2, 2) * point.z());
+}
+
+//! Rotates by the inverse, i.e. the transposed rotation
+static QVector3D rotateInverse(const QMatrix3x3 &rotation, const QVector3D &point) {
+    return QVector3D(
+        rotation(0, 0) * point.x() + rotation(1, 0) * point.y() + rotation(2, 0) * point.z(),
+        rotation(0, 1) * point.x() + rotation(1, 1) * point.y() + rotation(2, 1) * point.z(),
+        rotation(0, 2) * point.x() + rotation(1, 2) * point.y() + rotation(2, 2) * point.z());
+}
+
+/*!
+ * \brief diameter returns the largest distance between two of the points. Above
+ * MAX_DIAMETER_POINTS points it is computed on evenly spaced points and then extended by
+ * searching the point farthest from each end, i.e. it might be slightly too small.
+ */
+static float diameter(const QVector<QVector3D> &points) {
+    int stride = std::max(1, (points.size() + MAX_DIAMETER_POINTS - 1) / MAX_DIAMETER_POINTS);
+    float maximum = 0.f;
+    int end1 = 0, end2 = 0;
+    for (int i = 0; i < points.size(); i += stride) {
+        for (int j = i + stride; j < points.size(); j += stride) {
+            float distance = (points[i] - points[j]).lengthSquared();
+            if (distance > maximum) {
+                maximum = distance;
+                end1 = i;
+                end2 = j;
+            }
+        }
+    }
+    if (stride > 1) {
+        for (int sweep = 0; sweep < 2; sweep++) {
+            int from = sweep == 0 ? end1 : end2;
+            for (int i = 0; i < points.size(); i++) {
+                float distance = (points[i] - points[from]).lengthSquared();
+                if (distance > maximum) {
+                    maximum = distance;
+                    (sweep == 0 ? end2 : end1) = i;
+                }
+            }
+        }
+    }
+    return std::sqrt(maximum);
+}
+
+static EvaluationModelPointsPtr loadModelPoints(MeshCache &meshCache,
+                                                const ObjectModel &objectModel) {
+    MeshPtr mesh = meshCache.get(objectModel.getAbsolutePath());
+    if (mesh.isNull()) {
+        return EvaluationModelPointsPtr();
+    }
+    QSharedPointer<EvaluationModelPoints> modelPoints(new EvaluationModelPoints);
+    modelPoints->points = mesh->getVertices();
+    modelPoints->tree = KdTree(modelPoints->points);
+    modelPoints->diameter = diameter(modelPoints->points);
+    return modelPoints;
+}
+
+static PoseErrors unmatchedErrors(const Pose &pose, bool groundTruth, float diameter) {
+    PoseErrors errors;
+    errors.imagePath = pose.getImage()->getImagePath();
+    errors.objectModelPath = pose.getObjectModel()->getPath();
+    (groundTruth ? errors.groundTruthId : errors.predictionId) = pose.getID();
+    errors.add = INFINITE_ERROR;
+    errors.adds = INFINITE_ERROR;
+    errors.projectionError = INFINITE_ERROR;
+    errors.rotationError = INFINITE_ERROR;
+    errors.translationError = INFINITE_ERROR;
+    errors.diameter = diameter;
+    return errors;
+}
+
+static PoseErrors computeErrors(const Pose &groundTruth, const Pose &prediction,
+                                const EvaluationModelPoints &model) {
+    PoseErrors errors = unmatchedErrors(groundTruth, true, model.diameter);
+    errors.predictionId = prediction.getID();
+    QMatrix3x3 groundTruthRotation = groundTruth.getRotation();
+    QMatrix3x3 predictedRotation = prediction.getRotation();
+    QVector3D groundTruthPosition = groundTruth.getPosition();
+    QVector3D predictedPosition = prediction.getPosition();
+    QMatrix3x3 cameraMatrix = groundTruth.getImage()->getCameraMatrix();
+
+    double addSum = 0, addsSum = 0, projectionSum = 0;
+    bool projectable = true;
+    for (const QVector3D &point : model.points) {
+        QVector3D expected = rotate(groundTruthRotation, point) + groundTruthPosition;
+        QVector3D predicted = rotate(predictedRotation, point) + predictedPosition;
+        addSum += (expected - predicted).length();
+
+        // The closest point is searched in model coordinates of the prediction, where the
+        // tree has been built
+        float squaredDistance;
+        model.tree.nearest(rotateInverse(predictedRotation, expected - predictedPosition),
+                           &squaredDistance);
+        addsSum += std::sqrt(squaredDistance);
+
+        if (expected.z() <= 0 || predicted.z() <= 0) {
+            projectable = false;
+            continue;
+        }
+        QVector3D expectedPixel = rotate(cameraMatrix, expected) / expected.z();
+        QVector3D predictedPixel = rotate(cameraMatrix, predicted) / predicted.z();
+        projectionSum += (expectedPixel - predictedPixel).toVector2D().length();
+    }
+    int count = std::max(model.points.size(), 1);
+    errors.add = (float) (addSum / count);
+    errors.adds = (float) (addsSum / count);
+    errors.projectionError = projectable ? (float) (projectionSum / count) : INFINITE_ERROR;
+
+    float trace = 0;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            trace += groundTruthRotation(i, j) * predictedRotation(i, j);
+        }
+    }
+    errors.rotationError = qRadiansToDegrees(std::acos(qBound(-1.f, (trace - 1) / 2, 1.f)));
+    errors.translationError = (groundTruthPosition - predictedPosition).length();
+    return errors;
+}
+
+//! The poses of one image
+struct ImageEvaluation {
+    QList<Pose> groundTruth;
+    QList<Pose> predictions;
+    QList<PoseErrors> errors;
+};
+
+/*!
+ * \brief The ImageEvaluationRunnable class matches the poses of one image per object model
+ * and computes their errors.
+ */
+class ImageEvaluationRunnable : public QRunnable {
+public:
+    ImageEvaluationRunnable(ImageEvaluation *evaluation,
+                            const QHash<QString, EvaluationModelPointsPtr> *modelPoints) :
+        evaluation(evaluation),
+        modelPoints(modelPoints) {
+    }
+
+    void run() override {
+        QMap<QString, QList<Pose>> groundTruthByObjectModel, predictionsByObjectModel;
+        for (const Pose &pose : evaluation->groundTruth) {
+            groundTruthByObjectModel[pose.getObjectModel()->getPath()] << pose;
+        }
+        for (const Pose &pose : evaluation->predictions) {
+            predictionsByObjectModel[pose.getObjectModel()->getPath()] << pose;
+        }
+        QStringList objectModelPaths = groundTruthByObjectModel.keys()
+                + predictionsByObjectModel.keys();
+        objectModelPaths.removeDuplicates();
+        std::sort(objectModelPaths.begin(), objectModelPaths.end());
+        for (const QString &objectModelPath : objectModelPaths) {
+            match(groundTruthByObjectModel.value(objectModelPath),
+                  predictionsByObjectModel.value(objectModelPath),
+                  modelPoints->value(objectModelPath));
+        }
+    }
+
+private:
+    ImageEvaluation *evaluation;
+    const QHash<QString, EvaluationModelPointsPtr> *modelPoints;
+
+    void match(const QList<Pose> &groundTruth, const QList<Pose> &predictions,
+               const EvaluationModelPointsPtr &model) {
+        float diameter = model.isNull() ? 0.f : model->diameter;
+        QVector<bool> groundTruthMatched(groundTruth.size(), false);
+        QVector<bool> predictionMatched(predictions.size(), false);
+        if (!model.isNull()) {
+            // All pairs, there are only a few instances of an object in an image
+            QList<PoseErrors> pairs;
+            QList<QPair<int, int>> indices;
+            for (int i = 0; i < groundTruth.size(); i++) {
+                for (int j = 0; j < predictions.size(); j++) {
+                    pairs << computeErrors(groundTruth[i], predictions[j], *model);
+                    indices << qMakePair(i, j);
+                }
+            }
+            QVector<int> order(pairs.size());
+            for (int i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), [&pairs](int i1, int i2) {
+                return pairs[i1].adds < pairs[i2].adds;
+            });
+            for (int i : order) {
+                if (groundTruthMatched[indices[i].first] || predictionMatched[indices[i].second]) {
+                    continue;
+                }
+                groundTruthMatched[indices[i].first] = true;
+                predictionMatched[indices[i].second] = true;
+                evaluation->errors << pairs[i];
+            }
+        }
+        for (int i = 0; i < groundTruth.size(); i++) {
+            if (!groundTruthMatched[i]) {
+                evaluation->errors << unmatchedErrors(groundTruth[i], true, diameter);
+            }
+        }
+        for (int j = 0; j < predictions.size(); j++) {
+            if (!predictionMatched[j]) {
+                evaluation->errors << unmatchedErrors(predictions[j], false, diameter);
+            }
+        }
+    }
+};
+
+PoseEvaluator::PoseEvaluator(int threadCount) {
+    threadPool.setMaxThreadCount(threadCount > 0 ? threadCount : QThread::idealThreadCount());
+}
+
+QList<PoseErrors> PoseEvaluator::evaluate(LoadAndStoreStrategy &groundTruth,
+                                          LoadAndStoreStrategy &predictions) {
+    // The poses refer to the images and object models, which must not be copied before the
+    // evaluation is done
+    QList<Image> images = groundTruth.loadImages();
+    QList<ObjectModel> objectModels = groundTruth.loadObjectModels();
+    return evaluate(groundTruth.loadPoses(images, objectModels),
+                    predictions.loadPoses(images, objectModels));
+}
+
+QList<PoseErrors> PoseEvaluator::evaluate(const QList<Pose> &groundTruth,
+                                          const QList<Pose> &predictions) {
+    QHash<QString, EvaluationModelPointsPtr> modelPoints;
+    QMap<QString, ImageEvaluation> evaluations;
+    for (const Pose &pose : groundTruth + predictions) {
+        const ObjectModel *objectModel = pose.getObjectModel();
+        if (!modelPoints.contains(objectModel->getPath())) {
+            modelPoints[objectModel->getPath()] = loadModelPoints(meshCache, *objectModel);
+            if (modelPoints[objectModel->getPath()].isNull()) {
+                qWarning() << "Could not load the object model " + objectModel->getAbsolutePath()
+                              + ", its poses are not evaluated.";
+            }
+        }
+    }
+    for (const Pose &pose : groundTruth) {
+        evaluations[pose.getImage()->getImagePath()].groundTruth << pose;
+    }
+    for (const Pose &pose : predictions) {
+        evaluations[pose.getImage()->getImagePath()].predictions << pose;
+    }
+
+    for (ImageEvaluation &evaluation : evaluations) {
+        threadPool.start(new ImageEvaluationRunnable(&evaluation, &modelPoints));
+    }
+    threadPool.waitForDone();
+
+    QList<PoseErrors> errors;
+    for (const ImageEvaluation &evaluation : evaluations) {
+        errors += evaluation.errors;
+    }
+    return errors;
+}
+
+//! Fraction of the values below each threshold
+static QVector<float> recallCurve(const QVector<float> &values, const QVector<float> &thresholds) {
+    QVector<float> curve;
+    for (float threshold : thresholds) {
+        int below = std::count_if(values.begin(), values.end(),
+                                  [threshold](float value) { return value < threshold; });
+        curve << (values.isEmpty() ? 0.f : (float) below / values.size());
+    }
+    return curve;
+}
+
+QList<ObjectModelSummary> PoseEvaluator::summarize(const QList<PoseErrors> &errors) const {
+    QMap<QString, QList<PoseErrors>> errorsByObjectModel;
+    for (const PoseErrors &poseErrors : errors) {
+        errorsByObjectModel[poseErrors.objectModelPath] << poseErrors;
+    }
+
+    QList<ObjectModelSummary> summaries;
+    for (auto it = errorsByObjectModel.begin(); it != errorsByObjectModel.end(); it++) {
+        ObjectModelSummary summary;
+        summary.objectModelPath = it.key();
+        summary.symmetric = symmetricObjectModels.contains(it.key());
+        // Relative to the diameter for the ADD curves, infinite if not predicted
+        QVector<float> relativeAdd, relativeAdds, projectionErrors;
+        for (const PoseErrors &poseErrors : it.value()) {
+            if (poseErrors.isFalsePositive()) {
+                summary.predictions++;
+                summary.falsePositives++;
+                continue;
+            }
+            summary.groundTruthPoses++;
+            float diameter = poseErrors.diameter > 0 ? poseErrors.diameter : INFINITE_ERROR;
+            relativeAdd << poseErrors.add / diameter;
+            relativeAdds << poseErrors.adds / diameter;
+            projectionErrors << poseErrors.projectionError;
+            if (!poseErrors.isMatched()) {
+                continue;
+            }
+            summary.predictions++;
+            summary.matchedPoses++;
+            summary.meanAdd += poseErrors.add;
+            summary.meanAdds += poseErrors.adds;
+            summary.meanProjectionError += poseErrors.projectionError;
+            summary.meanRotationError += poseErrors.rotationError;
+            summary.meanTranslationError += poseErrors.translationError;
+        }
+        if (summary.matchedPoses > 0) {
+            summary.meanAdd /= summary.matchedPoses;
+            summary.meanAdds /= summary.matchedPoses;
+            summary.meanProjectionError /= summary.matchedPoses;
+            summary.meanRotationError /= summary.matchedPoses;
+            summary.meanTranslationError /= summary.matchedPoses;
+        }
+        summary.addCurve = recallCurve(relativeAdd, ADD_CURVE_THRESHOLDS);
+        summary.addsCurve = recallCurve(relativeAdds, ADD_CURVE_THRESHOLDS);
+        summary.projectionCurve = recallCurve(projectionErrors, PROJECTION_CURVE_THRESHOLDS);
+        summary.addRecall = recallCurve(summary.symmetric ? relativeAdds : relativeAdd,
+                                        {ADD_THRESHOLD}).first();
+        summary.projectionRecall = recallCurve(projectionErrors, {PROJECTION_THRESHOLD}).first();
+        summaries << summary;
+    }
+    return summaries;
+}
+
+void PoseEvaluator::setSymmetricObjectModels(const QStringList &objectModelPaths) {
+    symmetricObjectModels.clear();
+    for (const QString &objectModelPath : objectModelPaths) {
+        symmetricObjectModels.insert(objectModelPath);
+    }
+}
+
+static QString number(float value) {
+    return std::isinf(value) ? QString("inf") : QString::number(value, 'g', 6);
+}
+
+bool PoseEvaluator::writeErrorsCsv(const QString &path, const QList<PoseErrors> &errors) {
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        qWarning() << "Could not write " + path + ".";
+        return false;
+    }
+    QTextStream stream(&file);
+    stream << "image,object_model,ground_truth_id,prediction_id,add,adds,projection_error,"
+              "rotation_error,translation_error,diameter\n";
+    for (const PoseErrors &poseErrors : errors) {
+        stream << poseErrors.imagePath << ',' << poseErrors.objectModelPath << ','
+               << poseErrors.groundTruthId << ',' << poseErrors.predictionId << ','
+               << number(poseErrors.add) << ',' << number(poseErrors.adds) << ','
+               << number(poseErrors.projectionError) << ','
+               << number(poseErrors.rotationError) << ','
+               << number(poseErrors.translationError) << ','
+               << number(poseErrors.diameter) << '\n';
+    }
+    stream.flush();
+    return file.commit();
+}
+
+bool PoseEvaluator::writeSummaryCsv(const QString &path,
+                                    const QList<ObjectModelSummary> &summaries) {
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        qWarning() << "Could not write " + path + ".";
+        return false;
+    }
+    QTextStream stream(&file);
+    stream << "object_model,ground_truth_poses,predictions,matched_poses,false_positives,"
+              "symmetric,mean_add,mean_adds,mean_projection_error,mean_rotation_error,"
+              "mean_translation_error,add_recall,projection_recall\n";
+    for (const ObjectModelSummary &summary : summaries) {
+        stream << summary.objectModelPath << ',' << summary.groundTruthPoses << ','
+               << summary.predictions << ',' << summary.matchedPoses << ','
+               << summary.falsePositives << ',' << (summary.symmetric ? 1 : 0) << ','
+               << number(summary.meanAdd) << ',' << number(summary.meanAdds) << ','
+               << number(summary.meanProjectionError) << ','
+               << number(summary.meanRotationError) << ','
+               << number(summary.meanTranslationError) << ','
+               << number(summary.addRecall) << ',' << number(summary.projectionRecall) << '\n';
+    }
+    stream.flush();
+    return file.commit();
+}
+
+static QJsonArray curveToJson(const QVector<float> &thresholds, const QVector<float> &curve) {
+    QJsonArray points;
+    for (int i = 0; i < thresholds.size() && i < curve.size(); i++) {
+        points.append(QJsonArray({thresholds[i], curve[i]}));
+    }
+    return points;
+}
+
+bool PoseEvaluator::writeSummaryJson(const QString &path,
+                                     const QList<ObjectModelSummary> &summaries) {
+    QJsonArray objectModels;
+    for (const ObjectModelSummary &summary : summaries) {
+        QJsonObject object;
+        object["object_model"] = summary.objectModelPath;
+        object["ground_truth_poses"] = summary.groundTruthPoses;
+        object["predictions"] = summary.predictions;
+        object["matched_poses"] = summary.matchedPoses;
+        object["false_positives"] = summary.falsePositives;
+        object["symmetric"] = summary.symmetric;
+        object["mean_add"] = summary.meanAdd;
+        object["mean_adds"] = summary.meanAdds;
+        object["mean_projection_error"] = summary.meanProjectionError;
+        object["mean_rotation_error"] = summary.meanRotationError;
+        object["mean_translation_error"] = summary.meanTranslationError;
+        object["add_recall"] = summary.addRecall;
+        object["projection_recall"] = summary.projectionRecall;
+        // Pairs of threshold and recall
+        object["add_curve"] = curveToJson(ADD_CURVE_THRESHOLDS, summary.addCurve);
+        object["adds_curve"] = curveToJson(ADD_CURVE_THRESHOLDS, summary.addsCurve);
+        object["projection_curve"] = curveToJson(PROJECTION_CURVE_THRESHOLDS,
+                                                 summary.projectionCurve);
+        objectModels.append(object);
+    }
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly)) {
+        qWarning() << "Could not write " + path + ".";
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject({{"object_models", objectModels}})).toJson());
+    return file.commit();
+}
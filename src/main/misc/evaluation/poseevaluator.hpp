@@ -0,0 +1,129 @@
+#ifndef POSEEVALUATOR_H
+#define POSEEVALUATOR_H
+
+#include "misc/geometry/mesh.hpp"
+#include "model/loadandstorestrategy.hpp"
+#include "model/pose.hpp"
+
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+/*!
+ * \brief The PoseErrors struct holds the errors of a predicted pose with respect to the ground
+ * truth pose it was matched to. The errors are infinite for ground truth poses that have not
+ * been predicted and for predictions without a ground truth pose, i.e. false positives.
+ */
+struct PoseErrors {
+    QString imagePath;
+    QString objectModelPath;
+    //! Empty for false positives
+    QString groundTruthId;
+    //! Empty if the ground truth pose has not been predicted
+    QString predictionId;
+    //! Average distance of the model points under both poses
+    float add;
+    //! Average distance of each point under the ground truth pose to the closest point
+    //! under the predicted pose, for symmetric objects
+    float adds;
+    //! Average distance in pixels of the projected model points
+    float projectionError;
+    //! Angle of the rotation between both rotations in degrees
+    float rotationError;
+    float translationError;
+    //! Diameter of the object model, the ADD thresholds are relative to it
+    float diameter;
+
+    bool isMatched() const;
+    bool isFalsePositive() const;
+};
+
+//! The evaluation of all poses of one object model
+struct ObjectModelSummary {
+    QString objectModelPath;
+    int groundTruthPoses = 0;
+    int predictions = 0;
+    int matchedPoses = 0;
+    //! Predictions that were not matched to any ground truth pose
+    int falsePositives = 0;
+    bool symmetric = false;
+    //! Means over the matched poses
+    float meanAdd = 0.f;
+    float meanAdds = 0.f;
+    float meanProjectionError = 0.f;
+    float meanRotationError = 0.f;
+    float meanTranslationError = 0.f;
+    //! Fraction of the ground truth poses with an ADD, or ADD-S for symmetric objects, below
+    //! a tenth of the diameter
+    float addRecall = 0.f;
+    //! Fraction of the ground truth poses with a projection error below 5 pixels
+    float projectionRecall = 0.f;
+    //! Recall at each of ADD_CURVE_THRESHOLDS, relative to the diameter
+    QVector<float> addCurve;
+    QVector<float> addsCurve;
+    //! Recall at each of PROJECTION_CURVE_THRESHOLDS, in pixels
+    QVector<float> projectionCurve;
+};
+
+/*!
+ * \brief The PoseEvaluator class compares predicted poses, e.g. of the network, with ground
+ * truth poses.
+ *
+ * The poses of every image and object model are matched greedily, the pair with the lowest
+ * ADD-S first. Ground truth poses without a prediction are counted as failures in the recalls,
+ * predictions without a ground truth pose as false positives. The model points are the
+ * vertices of the object models, the closest points for ADD-S are found with a KdTree. The
+ * images are evaluated in parallel.
+ */
+class PoseEvaluator
+{
+public:
+    static const QVector<float> ADD_CURVE_THRESHOLDS;
+    static const QVector<float> PROJECTION_CURVE_THRESHOLDS;
+
+    //! \param threadCount the number of images that are evaluated at once, 0 uses one per core
+    explicit PoseEvaluator(int threadCount = 0);
+
+    /*!
+     * \brief evaluate loads the images, object models and ground truth poses through the
+     * first strategy and the predicted poses of the same images and object models through
+     * the second one.
+     * \return the errors of all ground truth poses and false positives
+     */
+    QList<PoseErrors> evaluate(LoadAndStoreStrategy &groundTruth,
+                               LoadAndStoreStrategy &predictions);
+
+    /*!
+     * \brief evaluate matches the predictions with the ground truth poses and computes their
+     * errors. Poses belong to the same image if the paths of the images are the same.
+     * \return the errors of all ground truth poses and false positives, ordered by image
+     */
+    QList<PoseErrors> evaluate(const QList<Pose> &groundTruth, const QList<Pose> &predictions);
+
+    //! Summarizes the errors per object model
+    QList<ObjectModelSummary> summarize(const QList<PoseErrors> &errors) const;
+
+    /*!
+     * \brief setSymmetricObjectModels sets the object models, by their paths, whose recall is
+     * computed with ADD-S instead of ADD.
+     */
+    void setSymmetricObjectModels(const QStringList &objectModelPaths);
+
+    //! Writes one line per ground truth pose and false positive
+    static bool writeErrorsCsv(const QString &path, const QList<PoseErrors> &errors);
+    //! Writes one line per object model, without the curves
+    static bool writeSummaryCsv(const QString &path, const QList<ObjectModelSummary> &summaries);
+    //! Writes the summaries including the recall curves
+    static bool writeSummaryJson(const QString &path,
+                                 const QList<ObjectModelSummary> &summaries);
+
+private:
+    QThreadPool threadPool;
+    MeshCache meshCache;
+    QSet<QString> symmetricObjectModels;
+};
+
+#endif // POSEEVALUATOR_H
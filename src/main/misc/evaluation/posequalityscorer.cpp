@@ -0,0 +1,302 @@
+#include "posequalityscorer.hpp"
+#include "misc/generalhelper.h"
+#include "misc/geometry/cpurasterizer.hpp"
+#include "misc/imageloading/imagesource.hpp"
+
+#include <QHash>
+#include <QImage>
+#include <QMutexLocker>
+#include <QPoint>
+#include <QRect>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <QtDebug>
+
+#include <algorithm>
+#include <cmath>
+
+//! Pixels of a mask that have a neighbour outside of the mask, the rect encloses the mask
+static QVector<QPoint> outline(const QVector<quint8> &mask, const QSize &size,
+                               const QRect &rect) {
+    QVector<QPoint> points;
+    auto inside = [&mask, &size](int x, int y) {
+        return x >= 0 && y >= 0 && x < size.width() && y < size.height()
+                && mask[y * size.width() + x];
+    };
+    for (int y = rect.top(); y <= rect.bottom(); y++) {
+        for (int x = rect.left(); x <= rect.right(); x++) {
+            if (inside(x, y) && (!inside(x - 1, y) || !inside(x + 1, y)
+                                 || !inside(x, y - 1) || !inside(x, y + 1))) {
+                points << QPoint(x, y);
+            }
+        }
+    }
+    return points;
+}
+
+/*!
+ * \brief matchedFraction returns the fraction of the points that are within the tolerance of
+ * one of the other points. The other points are drawn as discs into a mask of the rect.
+ */
+static float matchedFraction(const QVector<QPoint> &points, const QVector<QPoint> &others,
+                             const QRect &rect, float tolerance) {
+    if (points.isEmpty()) {
+        return 0.f;
+    }
+    int radius = (int) std::floor(tolerance);
+    QVector<QPoint> disc;
+    for (int dy = -radius; dy <= radius; dy++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+            if (dx * dx + dy * dy <= tolerance * tolerance) {
+                disc << QPoint(dx, dy);
+            }
+        }
+    }
+    QVector<quint8> covered(rect.width() * rect.height(), 0);
+    for (const QPoint &other : others) {
+        for (const QPoint &offset : disc) {
+            QPoint point = other + offset - rect.topLeft();
+            if (point.x() >= 0 && point.y() >= 0
+                    && point.x() < rect.width() && point.y() < rect.height()) {
+                covered[point.y() * rect.width() + point.x()] = 1;
+            }
+        }
+    }
+    int matched = 0;
+    for (const QPoint &point : points) {
+        QPoint local = point - rect.topLeft();
+        matched += covered[local.y() * rect.width() + local.x()];
+    }
+    return (float) matched / points.size();
+}
+
+//! The poses of one image
+struct ImageScoring {
+    QList<Pose> poses;
+    QList<PoseQuality> qualities;
+};
+
+/*!
+ * \brief The ImageScoringRunnable class renders all poses of one image and compares each of
+ * them with the segmentation image.
+ */
+class ImageScoringRunnable : public QRunnable {
+public:
+    ImageScoringRunnable(ImageScoring *scoring, const QHash<QString, MeshPtr> *meshes,
+                         const QMap<QString, QString> *segmentationCodes,
+                         float boundaryTolerance) :
+        scoring(scoring),
+        meshes(meshes),
+        segmentationCodes(segmentationCodes),
+        boundaryTolerance(boundaryTolerance) {
+    }
+
+    void run() override {
+        const QList<Pose> &poses = scoring->poses;
+        for (const Pose &pose : poses) {
+            PoseQuality quality;
+            quality.imagePath = pose.getImage()->getImagePath();
+            quality.poseId = pose.getID();
+            quality.objectModelPath = pose.getObjectModel()->getPath();
+            scoring->qualities << quality;
+        }
+        const Image &image = *poses.first().getImage();
+        if (image.getSegmentationImagePath().isEmpty()) {
+            return;
+        }
+        QImage segmentation = ImageSource::readImage(image.getAbsoluteSegmentationImagePath())
+                .convertToFormat(QImage::Format_RGB32);
+        if (segmentation.isNull()) {
+            qWarning() << "Could not read the segmentation image "
+                          + image.getAbsoluteSegmentationImagePath() + ".";
+            return;
+        }
+        QSize size = image.getSize();
+        if (size.isEmpty()) {
+            size = segmentation.size();
+        }
+
+        QList<RasterInstance> instances;
+        QVector<QRgb> colors;
+        for (const Pose &pose : poses) {
+            RasterInstance instance;
+            instance.mesh = meshes->value(pose.getObjectModel()->getPath());
+            instance.rotation = pose.getRotation();
+            instance.position = pose.getPosition();
+            instances << instance;
+            QString code = segmentationCodes->value(pose.getObjectModel()->getPath());
+            // Black is the background, i.e. never a code
+            colors << (code.isEmpty()
+                       ? qRgb(0, 0, 0) : GeneralHelper::colorFromSegmentationCode(code).rgb());
+        }
+        // A single thread, the images are scored in parallel already
+        CpuRasterizer rasterizer(1);
+        RasterBuffers buffers = rasterizer.rasterize(image.getCameraMatrix(), size, instances);
+
+        QVector<QRgb> labels(size.width() * size.height());
+        for (int y = 0; y < size.height(); y++) {
+            const QRgb *line = (const QRgb *) segmentation.constScanLine(
+                        y * segmentation.height() / size.height());
+            for (int x = 0; x < size.width(); x++) {
+                labels[y * size.width() + x] = line[x * segmentation.width() / size.width()];
+            }
+        }
+
+        for (int i = 0; i < poses.size(); i++) {
+            if (!instances[i].mesh.isNull()) {
+                score(i, colors, labels, buffers, scoring->qualities[i]);
+            }
+        }
+    }
+
+private:
+    ImageScoring *scoring;
+    const QHash<QString, MeshPtr> *meshes;
+    const QMap<QString, QString> *segmentationCodes;
+    float boundaryTolerance;
+
+    void score(int instance, const QVector<QRgb> &colors, const QVector<QRgb> &labels,
+               const RasterBuffers &buffers, PoseQuality &quality) const {
+        const QSize &size = buffers.size;
+        QRgb color = colors[instance];
+        auto isSegmented = [color](QRgb label) {
+            return color == qRgb(0, 0, 0)
+                    ? label != qRgb(0, 0, 0) && label != qRgb(255, 255, 255)
+                    : label == color;
+        };
+        QVector<quint8> rendered(labels.size()), segmented(labels.size());
+        int intersection = 0, joined = 0;
+        int minX = size.width(), minY = size.height(), maxX = -1, maxY = -1;
+        for (int i = 0; i < labels.size(); i++) {
+            int visible = buffers.instanceIds[i] - 1;
+            rendered[i] = visible == instance;
+            // Pixels of the color where another pose of the same color is visible are the
+            // segmentation of that pose
+            segmented[i] = isSegmented(labels[i])
+                    && (visible < 0 || visible == instance || colors[visible] != color);
+            quality.renderedPixels += rendered[i];
+            quality.segmentedPixels += segmented[i];
+            intersection += rendered[i] && segmented[i];
+            if (rendered[i] || segmented[i]) {
+                joined++;
+                int x = i % size.width(), y = i / size.width();
+                minX = std::min(minX, x);
+                minY = std::min(minY, y);
+                maxX = std::max(maxX, x);
+                maxY = std::max(maxY, y);
+            }
+        }
+        if (joined == 0) {
+            return;
+        }
+        quality.valid = true;
+        quality.iou = (float) intersection / joined;
+
+        QRect rect(QPoint(minX, minY), QPoint(maxX, maxY));
+        QVector<QPoint> renderedOutline = outline(rendered, size, rect);
+        QVector<QPoint> segmentedOutline = outline(segmented, size, rect);
+        float precision = matchedFraction(renderedOutline, segmentedOutline, rect,
+                                          boundaryTolerance);
+        float recall = matchedFraction(segmentedOutline, renderedOutline, rect,
+                                       boundaryTolerance);
+        quality.boundaryFScore = precision + recall > 0.f
+                ? 2.f * precision * recall / (precision + recall) : 0.f;
+    }
+};
+
+PoseQualityScorer::PoseQualityScorer(int threadCount) {
+    threadPool.setMaxThreadCount(threadCount > 0 ? threadCount : QThread::idealThreadCount());
+}
+
+QList<PoseQuality> PoseQualityScorer::score(const QList<Pose> &poses) {
+    // A copy, setting the codes must not wait for the scoring
+    QMap<QString, QString> segmentationCodes;
+    {
+        QMutexLocker locker(&mutex);
+        segmentationCodes = this->segmentationCodes;
+    }
+    QHash<QString, MeshPtr> meshes;
+    QMap<QString, ImageScoring> scorings;
+    for (const Pose &pose : poses) {
+        const ObjectModel *objectModel = pose.getObjectModel();
+        if (!meshes.contains(objectModel->getPath())) {
+            meshes[objectModel->getPath()] = meshCache.get(objectModel->getAbsolutePath());
+            if (meshes[objectModel->getPath()].isNull()) {
+                qWarning() << "Could not load the object model " + objectModel->getAbsolutePath()
+                              + ", its poses are not scored.";
+            }
+        }
+        scorings[pose.getImage()->getImagePath()].poses << pose;
+    }
+
+    for (ImageScoring &scoring : scorings) {
+        threadPool.start(new ImageScoringRunnable(&scoring, &meshes, &segmentationCodes,
+                                                  boundaryTolerance));
+    }
+    threadPool.waitForDone();
+
+    QList<PoseQuality> qualities;
+    for (const ImageScoring &scoring : scorings) {
+        qualities += scoring.qualities;
+    }
+    return qualities;
+}
+
+void PoseQualityScorer::setSegmentationCodes(const QMap<QString, QString> &codes) {
+    QMutexLocker locker(&mutex);
+    segmentationCodes = codes;
+}
+
+void PoseQualityScorer::setBoundaryTolerance(float tolerance) {
+    Q_ASSERT(tolerance >= 0.f);
+    boundaryTolerance = tolerance;
+}
+
+float PoseQualityScorer::getBoundaryTolerance() const {
+    return boundaryTolerance;
+}
+
+QMap<QString, float> PoseQualityScorer::worstScores(const QList<PoseQuality> &qualities) {
+    QMap<QString, float> scores;
+    for (const PoseQuality &quality : qualities) {
+        if (quality.valid && (!scores.contains(quality.imagePath)
+                              || quality.iou < scores[quality.imagePath])) {
+            scores[quality.imagePath] = quality.iou;
+        }
+    }
+    return scores;
+}
+
+bool PoseQualityScorer::writeCsv(const QString &path, const QList<PoseQuality> &qualities) {
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        qWarning() << "Could not write " + path + ".";
+        return false;
+    }
+    QTextStream stream(&file);
+    stream << "image,pose_id,object_model,valid,iou,boundary_f_score,rendered_pixels,"
+              "segmented_pixels\n";
+    for (const PoseQuality &quality : qualities) {
+        stream << quality.imagePath << ',' << quality.poseId << ','
+               << quality.objectModelPath << ',' << (quality.valid ? 1 : 0) << ','
+               << QString::number(quality.iou, 'g', 6) << ','
+               << QString::number(quality.boundaryFScore, 'g', 6) << ','
+               << quality.renderedPixels << ',' << quality.segmentedPixels << '\n';
+    }
+    stream.flush();
+    return file.commit();
+}
+
+PoseQualityRunnable::PoseQualityRunnable(PoseQualityScorer *poseQualityScorer,
+                                         const QList<Image> &images,
+                                         const QList<ObjectModel> &objectModels,
+                                         const QList<Pose> &poses) :
+    poseQualityScorer(poseQualityScorer),
+    snapshot(images, objectModels, poses) {
+}
+
+void PoseQualityRunnable::run() {
+    Q_EMIT posesScored(poseQualityScorer->score(snapshot.getPoses()));
+}
@@ -0,0 +1,108 @@
+#ifndef POSEQUALITYSCORER_H
+#define POSEQUALITYSCORER_H
+
+#include "misc/posessnapshot.hpp"
+#include "misc/geometry/mesh.hpp"
+#include "model/image.hpp"
+#include "model/objectmodel.hpp"
+#include "model/pose.hpp"
+
+#include <QList>
+#include <QMap>
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+#include <QThreadPool>
+
+//! How well the rendered silhouette of a pose matches the segmentation of its object
+struct PoseQuality {
+    QString imagePath;
+    QString poseId;
+    QString objectModelPath;
+    //! False if the image has no segmentation image, it or the object model could not be
+    //! read or neither the pose nor the segmentation show the object
+    bool valid = false;
+    //! Intersection over union of the visible part of the silhouette and the segmentation
+    float iou = 0.f;
+    //! F-score of the outline pixels of both that are within the boundary tolerance of the
+    //! other outline
+    float boundaryFScore = 0.f;
+    int renderedPixels = 0;
+    int segmentedPixels = 0;
+};
+
+Q_DECLARE_METATYPE(QList<PoseQuality>)
+
+/*!
+ * \brief The PoseQualityScorer class checks annotated poses against the segmentation images,
+ * e.g. to find the poses that need another look before a dataset is released.
+ *
+ * All poses of an image are rendered with the CpuRasterizer so that occluded parts of a
+ * silhouette do not count. The segmentation of a pose are the pixels of the segmentation
+ * image that have the color of its object model, see setSegmentationCodes(), without a code
+ * all pixels that are neither black nor white. If several poses share a color, the pixels
+ * where another one of them is visible belong to that pose. The segmentation image does not
+ * need to have the resolution of the image, it is sampled at the nearest pixel. The images
+ * are scored in parallel.
+ */
+class PoseQualityScorer
+{
+public:
+    //! \param threadCount the number of images that are scored at once, 0 uses one per core
+    explicit PoseQualityScorer(int threadCount = 0);
+
+    /*!
+     * \brief score renders the poses and compares them with the segmentation images of their
+     * images. Poses belong to the same image if the paths of the images are the same.
+     * \return the qualities of all poses, ordered by image
+     */
+    QList<PoseQuality> score(const QList<Pose> &poses);
+
+    /*!
+     * \brief setSegmentationCodes sets the segmentation colors of the object models as stored
+     * in the settings, i.e. the paths of the object models mapped to codes like 255,0,0.
+     */
+    void setSegmentationCodes(const QMap<QString, QString> &codes);
+    //! The distance in pixels up to which outline pixels match, defaults to 2
+    void setBoundaryTolerance(float tolerance);
+    float getBoundaryTolerance() const;
+
+    //! The lowest IoU of the valid poses of every image, by the path of the image
+    static QMap<QString, float> worstScores(const QList<PoseQuality> &qualities);
+    //! Writes one line per pose
+    static bool writeCsv(const QString &path, const QList<PoseQuality> &qualities);
+
+private:
+    QThreadPool threadPool;
+    MeshCache meshCache;
+    QMap<QString, QString> segmentationCodes;
+    float boundaryTolerance = 2.f;
+    // The codes can change in the settings while the poses are scored in the background
+    QMutex mutex;
+};
+
+/*!
+ * \brief The PoseQualityRunnable class scores poses in the background and reports the
+ * result through posesScored.
+ */
+class PoseQualityRunnable : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    PoseQualityRunnable(PoseQualityScorer *poseQualityScorer, const QList<Image> &images,
+                        const QList<ObjectModel> &objectModels, const QList<Pose> &poses);
+    void run() override;
+
+Q_SIGNALS:
+    void posesScored(QList<PoseQuality> qualities);
+
+private:
+    PoseQualityScorer *poseQualityScorer;
+    // The model manager might reload its images and object models in the meantime
+    PosesSnapshot snapshot;
+};
+
+#endif // POSEQUALITYSCORER_H
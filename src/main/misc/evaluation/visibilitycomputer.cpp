@@ -0,0 +1,309 @@
+#include "visibilitycomputer.hpp"
+#include "misc/geometry/cpurasterizer.hpp"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QSaveFile>
+#include <QStringList>
+#include <QThread>
+#include <QtDebug>
+
+//! The visibilities of an image as read from or written to the cache
+struct CachedImage {
+    //! Identifies the camera matrix, size and poses the visibilities were computed for
+    QString key;
+    QList<PoseVisibility> visibilities;
+};
+
+//! Results with a pose that couldn't be computed must not be taken from the cache, the object
+//! model or image might be readable the next time
+static bool allValid(const QList<PoseVisibility> &visibilities) {
+    for (const PoseVisibility &visibility : visibilities) {
+        if (!visibility.valid) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//! The poses of one image
+struct ImageVisibility {
+    QList<Pose> poses;
+    //! The entry in the cache, if there is one
+    const CachedImage *cached = Q_NULLPTR;
+    CachedImage result;
+    bool fromCache = false;
+};
+
+static QString imageKey(const Image &image, const QSize &size, const QList<Pose> &poses) {
+    QStringList values;
+    values << QString::number(size.width()) << QString::number(size.height());
+    QMatrix3x3 cameraMatrix = image.getCameraMatrix();
+    for (int i = 0; i < 9; i++) {
+        values << QString::number(cameraMatrix.constData()[i], 'g', 9);
+    }
+    for (const Pose &pose : poses) {
+        values << pose.getID() << pose.getObjectModel()->getPath();
+        QVector3D position = pose.getPosition();
+        QMatrix3x3 rotation = pose.getRotation();
+        for (int i = 0; i < 3; i++) {
+            values << QString::number(position[i], 'g', 9);
+        }
+        for (int i = 0; i < 9; i++) {
+            values << QString::number(rotation.constData()[i], 'g', 9);
+        }
+    }
+    return QString::fromLatin1(QCryptographicHash::hash(values.join(' ').toUtf8(),
+                                                        QCryptographicHash::Sha1).toHex());
+}
+
+//! Bounding boxes as x, y, width and height, -1 for an empty box like in the BOP datasets
+static QJsonArray boxToJson(const QRect &box) {
+    return box.isNull() ? QJsonArray({-1, -1, -1, -1})
+                        : QJsonArray({box.x(), box.y(), box.width(), box.height()});
+}
+
+static QRect boxFromJson(const QJsonArray &box) {
+    return box.size() != 4 || box[2].toInt() <= 0
+            ? QRect() : QRect(box[0].toInt(), box[1].toInt(), box[2].toInt(), box[3].toInt());
+}
+
+static QMap<QString, CachedImage> readCache(const QString &path) {
+    QMap<QString, CachedImage> cache;
+    QFile file(path);
+    if (!file.exists()) {
+        return cache;
+    }
+    if (!file.open(QFile::ReadOnly)) {
+        qWarning() << "Could not read the visibility cache " + path + ".";
+        return cache;
+    }
+    QJsonObject images = QJsonDocument::fromJson(file.readAll()).object()["images"].toObject();
+    for (auto it = images.begin(); it != images.end(); it++) {
+        QJsonObject image = it.value().toObject();
+        CachedImage &cachedImage = cache[it.key()];
+        cachedImage.key = image["key"].toString();
+        for (const QJsonValue &value : image["poses"].toArray()) {
+            QJsonObject object = value.toObject();
+            PoseVisibility visibility;
+            visibility.imagePath = it.key();
+            visibility.poseId = object["pose_id"].toString();
+            visibility.objectModelPath = object["object_model"].toString();
+            visibility.valid = object["valid"].toBool();
+            visibility.amodalPixels = object["px_count_all"].toInt();
+            visibility.visiblePixels = object["px_count_visib"].toInt();
+            visibility.visibleFraction = (float) object["visib_fract"].toDouble();
+            visibility.amodalBox = boxFromJson(object["bbox_obj"].toArray());
+            visibility.visibleBox = boxFromJson(object["bbox_visib"].toArray());
+            cachedImage.visibilities << visibility;
+        }
+    }
+    return cache;
+}
+
+static bool writeCache(const QString &path, const QMap<QString, ImageVisibility> &results) {
+    QJsonObject images;
+    for (auto it = results.begin(); it != results.end(); it++) {
+        QJsonArray poses;
+        for (const PoseVisibility &visibility : it.value().result.visibilities) {
+            QJsonObject object;
+            object["pose_id"] = visibility.poseId;
+            object["object_model"] = visibility.objectModelPath;
+            object["valid"] = visibility.valid;
+            object["px_count_all"] = visibility.amodalPixels;
+            object["px_count_visib"] = visibility.visiblePixels;
+            object["visib_fract"] = visibility.visibleFraction;
+            object["bbox_obj"] = boxToJson(visibility.amodalBox);
+            object["bbox_visib"] = boxToJson(visibility.visibleBox);
+            poses.append(object);
+        }
+        images[it.key()] = QJsonObject({{"key", it.value().result.key}, {"poses", poses}});
+    }
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly)) {
+        qWarning() << "Could not write " + path + ".";
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject({{"images", images}})).toJson());
+    return file.commit();
+}
+
+/*!
+ * \brief The ImageVisibilityRunnable class renders the poses of one image together and, where
+ * they are occluded, alone.
+ */
+class ImageVisibilityRunnable : public QRunnable {
+public:
+    ImageVisibilityRunnable(ImageVisibility *imageVisibility,
+                            const QHash<QString, MeshPtr> *meshes, float depthTolerance) :
+        imageVisibility(imageVisibility),
+        meshes(meshes),
+        depthTolerance(depthTolerance) {
+    }
+
+    void run() override {
+        const QList<Pose> &poses = imageVisibility->poses;
+        const Image &image = *poses.first().getImage();
+        QSize size = image.getSize();
+        CachedImage &result = imageVisibility->result;
+        // Only set once all poses are computed, results without key are never cache hits
+        QString key = imageKey(image, size, poses);
+        const CachedImage *cached = imageVisibility->cached;
+        if (cached && cached->key == key && cached->visibilities.size() == poses.size()
+                && allValid(cached->visibilities)) {
+            result.key = key;
+            result.visibilities = cached->visibilities;
+            imageVisibility->fromCache = true;
+            return;
+        }
+
+        QList<RasterInstance> instances;
+        for (const Pose &pose : poses) {
+            RasterInstance instance;
+            instance.mesh = meshes->value(pose.getObjectModel()->getPath());
+            instance.rotation = pose.getRotation();
+            instance.position = pose.getPosition();
+            instances << instance;
+
+            PoseVisibility visibility;
+            visibility.imagePath = image.getImagePath();
+            visibility.poseId = pose.getID();
+            visibility.objectModelPath = pose.getObjectModel()->getPath();
+            visibility.valid = !instance.mesh.isNull() && !size.isEmpty();
+            result.visibilities << visibility;
+        }
+        if (size.isEmpty()) {
+            qWarning() << "Could not read the size of " + image.getAbsoluteImagePath() + ".";
+            return;
+        }
+        // A single thread, the images are computed in parallel already
+        CpuRasterizer rasterizer(1);
+        RasterBuffers together = rasterizer.rasterize(image.getCameraMatrix(), size, instances);
+        for (int i = 0; i < instances.size(); i++) {
+            if (instances[i].mesh.isNull()) {
+                continue;
+            }
+            PoseVisibility &visibility = result.visibilities[i];
+            if (together.visiblePixels[i] == together.silhouettePixels[i]) {
+                // Not occluded, the pixels where it is the closest pose are its silhouette
+                for (int pixel = 0; pixel < together.instanceIds.size(); pixel++) {
+                    if (together.instanceIds[pixel] == i + 1) {
+                        add(visibility, pixel, size, true);
+                    }
+                }
+            } else {
+                RasterBuffers alone = rasterizer.rasterize(image.getCameraMatrix(), size,
+                                                           {instances[i]});
+                for (int pixel = 0; pixel < alone.depth.size(); pixel++) {
+                    if (alone.depth[pixel] > 0.f) {
+                        add(visibility, pixel, size,
+                            together.instanceIds[pixel] == i + 1
+                            || alone.depth[pixel] - together.depth[pixel] <= depthTolerance);
+                    }
+                }
+            }
+            visibility.visibleFraction = visibility.amodalPixels > 0
+                    ? (float) visibility.visiblePixels / visibility.amodalPixels : 0.f;
+        }
+        if (allValid(result.visibilities)) {
+            result.key = key;
+        }
+    }
+
+private:
+    ImageVisibility *imageVisibility;
+    const QHash<QString, MeshPtr> *meshes;
+    float depthTolerance;
+
+    static void add(PoseVisibility &visibility, int pixel, const QSize &size, bool visible) {
+        QRect pixelRect(pixel % size.width(), pixel / size.width(), 1, 1);
+        visibility.amodalPixels++;
+        visibility.amodalBox |= pixelRect;
+        if (visible) {
+            visibility.visiblePixels++;
+            visibility.visibleBox |= pixelRect;
+        }
+    }
+};
+
+VisibilityComputer::VisibilityComputer(int threadCount) {
+    threadPool.setMaxThreadCount(threadCount > 0 ? threadCount : QThread::idealThreadCount());
+}
+
+QList<PoseVisibility> VisibilityComputer::compute(const QList<Pose> &poses,
+                                                  const QString &cachePath,
+                                                  int *cachedImages) {
+    QMap<QString, CachedImage> cache;
+    if (!cachePath.isEmpty()) {
+        cache = readCache(cachePath);
+    }
+    QHash<QString, MeshPtr> meshes;
+    QMap<QString, ImageVisibility> imageVisibilities;
+    for (const Pose &pose : poses) {
+        const ObjectModel *objectModel = pose.getObjectModel();
+        if (!meshes.contains(objectModel->getPath())) {
+            meshes[objectModel->getPath()] = meshCache.get(objectModel->getAbsolutePath());
+            if (meshes[objectModel->getPath()].isNull()) {
+                qWarning() << "Could not load the object model " + objectModel->getAbsolutePath()
+                              + ", the visibility of its poses is not computed.";
+            }
+        }
+        imageVisibilities[pose.getImage()->getImagePath()].poses << pose;
+    }
+
+    for (auto it = imageVisibilities.begin(); it != imageVisibilities.end(); it++) {
+        auto cached = cache.constFind(it.key());
+        if (cached != cache.constEnd()) {
+            it.value().cached = &cached.value();
+        }
+        threadPool.start(new ImageVisibilityRunnable(&it.value(), &meshes, depthTolerance));
+    }
+    threadPool.waitForDone();
+
+    QList<PoseVisibility> visibilities;
+    int fromCache = 0;
+    for (const ImageVisibility &imageVisibility : imageVisibilities) {
+        visibilities += imageVisibility.result.visibilities;
+        fromCache += imageVisibility.fromCache ? 1 : 0;
+    }
+    if (cachedImages) {
+        *cachedImages = fromCache;
+    }
+    if (!cachePath.isEmpty()) {
+        writeCache(cachePath, imageVisibilities);
+    }
+    return visibilities;
+}
+
+void VisibilityComputer::setDepthTolerance(float tolerance) {
+    depthTolerance = tolerance;
+}
+
+QString VisibilityComputer::cachePath(const QString &posesFilePath) {
+    QFileInfo posesFile(posesFilePath);
+    return posesFile.dir().filePath(posesFile.completeBaseName() + ".visibility.json");
+}
+
+VisibilityRunnable::VisibilityRunnable(VisibilityComputer *visibilityComputer,
+                                       const QList<Image> &images,
+                                       const QList<ObjectModel> &objectModels,
+                                       const QList<Pose> &poses,
+                                       const QString &cachePath) :
+    visibilityComputer(visibilityComputer),
+    snapshot(images, objectModels, poses),
+    cachePath(cachePath) {
+}
+
+void VisibilityRunnable::run() {
+    int cachedImages = 0;
+    QList<PoseVisibility> visibilities = visibilityComputer->compute(snapshot.getPoses(), cachePath,
+                                                                     &cachedImages);
+    Q_EMIT visibilitiesComputed(visibilities, cachedImages);
+}
@@ -0,0 +1,105 @@
+#ifndef VISIBILITYCOMPUTER_H
+#define VISIBILITYCOMPUTER_H
+
+#include "misc/posessnapshot.hpp"
+#include "misc/geometry/mesh.hpp"
+#include "model/image.hpp"
+#include "model/objectmodel.hpp"
+#include "model/pose.hpp"
+
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QRect>
+#include <QRunnable>
+#include <QString>
+#include <QThreadPool>
+
+//! How much of a pose is visible in its image, like the visib_fract of the BOP datasets
+struct PoseVisibility {
+    QString imagePath;
+    QString poseId;
+    QString objectModelPath;
+    //! False if the object model could not be loaded or the size of the image not be read
+    bool valid = false;
+    //! Pixels of the silhouette of the pose alone, i.e. as if there were no other poses
+    int amodalPixels = 0;
+    //! Pixels of the silhouette that are not occluded by other poses
+    int visiblePixels = 0;
+    //! visiblePixels / amodalPixels, 0 if the object is not in the image at all
+    float visibleFraction = 0.f;
+    //! Bounding boxes of both silhouettes clipped to the image, null if they are empty
+    QRect amodalBox;
+    QRect visibleBox;
+};
+
+Q_DECLARE_METATYPE(QList<PoseVisibility>)
+
+/*!
+ * \brief The VisibilityComputer class computes how much of every pose is occluded by the
+ * other poses of its image, e.g. to export a dataset or to skip mostly hidden objects.
+ *
+ * All poses of an image are rendered together with the CpuRasterizer and every occluded pose
+ * alone once more, poses that nothing occludes have the same silhouette in both. A pixel of
+ * the silhouette alone is visible if the pose is the closest one there or its depth alone is
+ * at most the depth tolerance behind the closest depth. The images are computed in parallel.
+ *
+ * The results can be cached in a JSON file next to the poses file, see cachePath(). An image
+ * is taken from the cache if its camera matrix, size and poses did not change, changed
+ * object model files are not detected.
+ */
+class VisibilityComputer
+{
+public:
+    //! \param threadCount the number of images that are computed at once, 0 uses one per core
+    explicit VisibilityComputer(int threadCount = 0);
+
+    /*!
+     * \brief compute computes the visibility of the poses. Poses belong to the same image if
+     * the paths of the images are the same.
+     * \param cachePath the cache to read unchanged images from and to write all images to,
+     * none if empty
+     * \param cachedImages set to the number of images that were read from the cache
+     * \return the visibilities of all poses, ordered by image
+     */
+    QList<PoseVisibility> compute(const QList<Pose> &poses, const QString &cachePath = QString(),
+                                  int *cachedImages = Q_NULLPTR);
+
+    //! The distance along the camera axis in units of the poses up to which a surface counts
+    //! as visible behind the closest one, defaults to 0
+    void setDepthTolerance(float tolerance);
+
+    //! The cache file of the given poses file, poses.json is cached in poses.visibility.json
+    static QString cachePath(const QString &posesFilePath);
+
+private:
+    QThreadPool threadPool;
+    MeshCache meshCache;
+    float depthTolerance = 0.f;
+};
+
+/*!
+ * \brief The VisibilityRunnable class computes the visibility of poses in the background and
+ * reports the result through visibilitiesComputed.
+ */
+class VisibilityRunnable : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    VisibilityRunnable(VisibilityComputer *visibilityComputer, const QList<Image> &images,
+                       const QList<ObjectModel> &objectModels, const QList<Pose> &poses,
+                       const QString &cachePath);
+    void run() override;
+
+Q_SIGNALS:
+    void visibilitiesComputed(QList<PoseVisibility> visibilities, int cachedImages);
+
+private:
+    VisibilityComputer *visibilityComputer;
+    // The model manager might reload its images and object models in the meantime
+    PosesSnapshot snapshot;
+    QString cachePath;
+};
+
+#endif // VISIBILITYCOMPUTER_H
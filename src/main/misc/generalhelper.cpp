@@ -94,4 +94,17 @@ namespace GeneralHelper {
         return R.t();
     }
 
+    QMatrix4x4 projectionMatrixFromCameraMatrix(const QMatrix3x3 &K, float width, float height,
+                                                float nearPlane, float farPlane) {
+        float w = width;
+        float h = height;
+        float depth = farPlane - nearPlane;
+        float q = -(farPlane + nearPlane) / depth;
+        float qn = -2 * (farPlane * nearPlane) / depth;
+        return QMatrix4x4(2 * K(0, 0) / w, -2 * K(0, 1) / w, (-2 * K(0, 2) + w) / w, 0,
+                                        0,  2 * K(1, 1) / h,  (2 * K(1 ,2) - h) / h, 0,
+                                        0,                0,                      q, qn,
+                                        0,                0,                     -1, 0);
+    }
+
 }
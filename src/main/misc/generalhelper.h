@@ -11,6 +11,8 @@
 #include <QFileInfo>
 #include <QStringList>
 #include <QDateTime>
+#include <QMatrix3x3>
+#include <QMatrix4x4>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/core.hpp>
 
@@ -33,6 +35,11 @@ namespace GeneralHelper {
 
     cv::Mat eulerAnglesToRotationMatrix(cv::Vec3f theta);
 
+    // Computes the OpenGL projection matrix that projects points in camera coordinates onto
+    // an image of the given size exactly like the camera with the camera matrix K does.
+    QMatrix4x4 projectionMatrixFromCameraMatrix(const QMatrix3x3 &K, float width, float height,
+                                                float nearPlane, float farPlane);
+
 }
 
 #endif // OTIATHELPER_H
@@ -0,0 +1,337 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//! The directions of the rays of contains(), not along an axis so that they rarely hit edges
+//! of axis aligned triangles exactly
+static const QVector3D RAY_DIRECTIONS[3] = {
+    QVector3D(0.9173f, 0.3321f, 0.2197f),
+    QVector3D(-0.2873f, 0.9051f, 0.3137f),
+    QVector3D(0.1943f, -0.3419f, 0.9194f)
+};
+
+//! The closest point to p on the triangle abc, see Ericson, Real-Time Collision Detection
+static QVector3D closestPointOnTriangle(const QVector3D &p, const QVector3D &a,
+                                        const QVector3D &b, const QVector3D &c) {
+    QVector3D ab = b - a;
+    QVector3D ac = c - a;
+    QVector3D ap = p - a;
+    float d1 = QVector3D::dotProduct(ab, ap);
+    float d2 = QVector3D::dotProduct(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f) {
+        return a;
+    }
+    QVector3D bp = p - b;
+    float d3 = QVector3D::dotProduct(ab, bp);
+    float d4 = QVector3D::dotProduct(ac, bp);
+    if (d3 >= 0.f && d4 <= d3) {
+        return b;
+    }
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+    QVector3D cp = p - c;
+    float d5 = QVector3D::dotProduct(ab, cp);
+    float d6 = QVector3D::dotProduct(ac, cp);
+    if (d6 >= 0.f && d5 <= d6) {
+        return c;
+    }
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    float sum = va + vb + vc;
+    if (sum <= 0.f) {
+        // Degenerate triangle
+        return a;
+    }
+    return a + ab * (vb / sum) + ac * (vc / sum);
+}
+
+static float squaredDistanceToBox(const QVector3D &point, const QVector3D &minimum,
+                                  const QVector3D &maximum) {
+    float squaredDistance = 0.f;
+    for (int axis = 0; axis < 3; axis++) {
+        float outside = std::max(std::max(minimum[axis] - point[axis], 0.f),
+                                 point[axis] - maximum[axis]);
+        squaredDistance += outside * outside;
+    }
+    return squaredDistance;
+}
+
+//! Slab test of the ray against the box, the direction must not have zero components
+static bool rayHitsBox(const QVector3D &origin, const QVector3D &inverseDirection,
+                       const QVector3D &minimum, const QVector3D &maximum) {
+    float entry = 0.f;
+    float exit = std::numeric_limits<float>::infinity();
+    for (int axis = 0; axis < 3; axis++) {
+        float t1 = (minimum[axis] - origin[axis]) * inverseDirection[axis];
+        float t2 = (maximum[axis] - origin[axis]) * inverseDirection[axis];
+        entry = std::max(entry, std::min(t1, t2));
+        exit = std::min(exit, std::max(t1, t2));
+    }
+    return entry <= exit;
+}
+
+static bool boxesOverlap(const QVector3D &minimum1, const QVector3D &maximum1,
+                         const QVector3D &minimum2, const QVector3D &maximum2) {
+    for (int axis = 0; axis < 3; axis++) {
+        if (minimum1[axis] > maximum2[axis] || minimum2[axis] > maximum1[axis]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief rayHitsTriangle is the Moller-Trumbore intersection of the ray with the triangle abc
+ * in front of the origin.
+ * \param parameter set to the distance of the hit along the ray in units of the direction
+ */
+static bool rayHitsTriangle(const QVector3D &origin, const QVector3D &direction,
+                            const QVector3D &a, const QVector3D &b, const QVector3D &c,
+                            float *parameter = Q_NULLPTR) {
+    QVector3D edge1 = b - a;
+    QVector3D edge2 = c - a;
+    QVector3D p = QVector3D::crossProduct(direction, edge2);
+    float determinant = QVector3D::dotProduct(edge1, p);
+    if (determinant == 0.f) {
+        // Parallel to the triangle
+        return false;
+    }
+    float inverseDeterminant = 1.f / determinant;
+    QVector3D t = origin - a;
+    float u = QVector3D::dotProduct(t, p) * inverseDeterminant;
+    if (u < 0.f || u > 1.f) {
+        return false;
+    }
+    QVector3D q = QVector3D::crossProduct(t, edge1);
+    float v = QVector3D::dotProduct(direction, q) * inverseDeterminant;
+    if (v < 0.f || u + v > 1.f) {
+        return false;
+    }
+    float distance = QVector3D::dotProduct(edge2, q) * inverseDeterminant;
+    if (parameter) {
+        *parameter = distance;
+    }
+    return distance > 0.f;
+}
+
+Bvh::Bvh() {
+}
+
+Bvh::Bvh(const Mesh &mesh) {
+    const QVector<QVector3D> &vertices = mesh.getVertices();
+    const QVector<quint32> &indices = mesh.getIndices();
+    int triangleCount = mesh.getTriangleCount();
+    if (triangleCount == 0) {
+        return;
+    }
+    QVector<QVector3D> originalTriangles(3 * triangleCount);
+    QVector<QVector3D> centroids(triangleCount);
+    QVector<int> order(triangleCount);
+    for (int i = 0; i < triangleCount; i++) {
+        for (int corner = 0; corner < 3; corner++) {
+            originalTriangles[3 * i + corner] = vertices[indices[3 * i + corner]];
+        }
+        centroids[i] = (originalTriangles[3 * i] + originalTriangles[3 * i + 1]
+                + originalTriangles[3 * i + 2]) / 3.f;
+        order[i] = i;
+    }
+    // A balanced tree has less than two nodes per leaf
+    nodes.reserve(2 * (triangleCount / LEAF_SIZE + 1));
+    build(originalTriangles, centroids, order, 0, triangleCount);
+    // Leaves read their triangles from consecutive memory
+    triangles.resize(originalTriangles.size());
+    for (int i = 0; i < triangleCount; i++) {
+        for (int corner = 0; corner < 3; corner++) {
+            triangles[3 * i + corner] = originalTriangles[3 * order[i] + corner];
+        }
+    }
+}
+
+int Bvh::build(const QVector<QVector3D> &originalTriangles, const QVector<QVector3D> &centroids,
+               QVector<int> &order, int begin, int end) {
+    QVector3D minimum = originalTriangles[3 * order[begin]];
+    QVector3D maximum = minimum;
+    QVector3D centroidMinimum = centroids[order[begin]];
+    QVector3D centroidMaximum = centroidMinimum;
+    for (int i = begin; i < end; i++) {
+        for (int corner = 0; corner < 3; corner++) {
+            const QVector3D &point = originalTriangles[3 * order[i] + corner];
+            for (int axis = 0; axis < 3; axis++) {
+                minimum[axis] = std::min(minimum[axis], point[axis]);
+                maximum[axis] = std::max(maximum[axis], point[axis]);
+            }
+        }
+        const QVector3D &centroid = centroids[order[i]];
+        for (int axis = 0; axis < 3; axis++) {
+            centroidMinimum[axis] = std::min(centroidMinimum[axis], centroid[axis]);
+            centroidMaximum[axis] = std::max(centroidMaximum[axis], centroid[axis]);
+        }
+    }
+    int index = nodes.size();
+    nodes.append(Node { minimum, maximum, begin, end, -1, -1 });
+    if (end - begin <= LEAF_SIZE) {
+        return index;
+    }
+
+    QVector3D extent = centroidMaximum - centroidMinimum;
+    int axis = extent.x() >= extent.y() && extent.x() >= extent.z()
+            ? 0 : (extent.y() >= extent.z() ? 1 : 2);
+    int middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [&centroids, axis](int i1, int i2) {
+                         return centroids[i1][axis] < centroids[i2][axis];
+                     });
+    int left = build(originalTriangles, centroids, order, begin, middle);
+    int right = build(originalTriangles, centroids, order, middle, end);
+    // Not through a reference, building the children may reallocate the nodes
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+QVector3D Bvh::getMinimum() const {
+    return nodes.isEmpty() ? QVector3D() : nodes.first().minimum;
+}
+
+QVector3D Bvh::getMaximum() const {
+    return nodes.isEmpty() ? QVector3D() : nodes.first().maximum;
+}
+
+float Bvh::distance(const QVector3D &point) const {
+    float bestDistance = std::numeric_limits<float>::infinity();
+    if (nodes.isEmpty()) {
+        return bestDistance;
+    }
+
+    // Nodes still to search with the squared distance of the point to their box, a lower
+    // bound of the distance to their triangles
+    struct Pending {
+        int node;
+        float bound;
+    };
+    // The depth of a balanced tree stays far below this
+    Pending stack[128];
+    int stackSize = 0;
+    stack[stackSize++] = Pending { 0, squaredDistanceToBox(point, nodes[0].minimum,
+                                                           nodes[0].maximum) };
+    while (stackSize > 0) {
+        Pending pending = stack[--stackSize];
+        if (pending.bound >= bestDistance) {
+            continue;
+        }
+        const Node &node = nodes[pending.node];
+        if (node.left < 0) {
+            for (int i = node.begin; i < node.end; i++) {
+                QVector3D closest = closestPointOnTriangle(point, triangles[3 * i],
+                                                           triangles[3 * i + 1],
+                                                           triangles[3 * i + 2]);
+                bestDistance = std::min(bestDistance, (closest - point).lengthSquared());
+            }
+            continue;
+        }
+        const Node &left = nodes[node.left];
+        const Node &right = nodes[node.right];
+        float leftBound = squaredDistanceToBox(point, left.minimum, left.maximum);
+        float rightBound = squaredDistanceToBox(point, right.minimum, right.maximum);
+        // The closer child is searched first, i.e. pushed last
+        if (leftBound < rightBound) {
+            stack[stackSize++] = Pending { node.right, rightBound };
+            stack[stackSize++] = Pending { node.left, leftBound };
+        } else {
+            stack[stackSize++] = Pending { node.left, leftBound };
+            stack[stackSize++] = Pending { node.right, rightBound };
+        }
+    }
+    return std::sqrt(bestDistance);
+}
+
+int Bvh::intersections(const QVector3D &origin, const QVector3D &direction) const {
+    int count = 0;
+    if (nodes.isEmpty()) {
+        return count;
+    }
+    QVector3D inverseDirection(1.f / direction.x(), 1.f / direction.y(), 1.f / direction.z());
+    int stack[128];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node &node = nodes[stack[--stackSize]];
+        if (!rayHitsBox(origin, inverseDirection, node.minimum, node.maximum)) {
+            continue;
+        }
+        if (node.left < 0) {
+            for (int i = node.begin; i < node.end; i++) {
+                count += rayHitsTriangle(origin, direction, triangles[3 * i],
+                                         triangles[3 * i + 1], triangles[3 * i + 2]) ? 1 : 0;
+            }
+        } else {
+            stack[stackSize++] = node.left;
+            stack[stackSize++] = node.right;
+        }
+    }
+    return count;
+}
+
+QVector<float> Bvh::crossings(const QVector3D &start, const QVector3D &end) const {
+    QVector<float> parameters;
+    if (nodes.isEmpty()) {
+        return parameters;
+    }
+    QVector3D direction = end - start;
+    // The box of the segment, the slab test of rayHitsBox() needs a direction without zero
+    // components and does not end at the end of the segment
+    QVector3D minimum, maximum;
+    for (int axis = 0; axis < 3; axis++) {
+        minimum[axis] = std::min(start[axis], end[axis]);
+        maximum[axis] = std::max(start[axis], end[axis]);
+    }
+    int stack[128];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node &node = nodes[stack[--stackSize]];
+        if (!boxesOverlap(minimum, maximum, node.minimum, node.maximum)) {
+            continue;
+        }
+        if (node.left < 0) {
+            for (int i = node.begin; i < node.end; i++) {
+                float parameter;
+                if (rayHitsTriangle(start, direction, triangles[3 * i], triangles[3 * i + 1],
+                                    triangles[3 * i + 2], &parameter) && parameter <= 1.f) {
+                    parameters << parameter;
+                }
+            }
+        } else {
+            stack[stackSize++] = node.left;
+            stack[stackSize++] = node.right;
+        }
+    }
+    std::sort(parameters.begin(), parameters.end());
+    return parameters;
+}
+
+bool Bvh::contains(const QVector3D &point) const {
+    if (nodes.isEmpty() || squaredDistanceToBox(point, nodes[0].minimum,
+                                                nodes[0].maximum) > 0.f) {
+        return false;
+    }
+    int votes = 0;
+    for (const QVector3D &direction : RAY_DIRECTIONS) {
+        votes += intersections(point, direction) % 2;
+    }
+    return votes >= 2;
+}
+
+int Bvh::getTriangleCount() const {
+    return triangles.size() / 3;
+}
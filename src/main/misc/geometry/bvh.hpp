@@ -0,0 +1,73 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "misc/geometry/mesh.hpp"
+
+#include <QSharedPointer>
+#include <QVector>
+#include <QVector3D>
+
+/*!
+ * \brief The Bvh class is a bounding volume hierarchy over the triangles of a mesh, for
+ * distance and inside queries of points, e.g. of the vertices of another object model, and
+ * crossing queries of segments, e.g. of its edges.
+ *
+ * Every node holds the axis aligned box around its triangles and splits them at the median
+ * of their centroids along the axis of the largest extent. The nodes are stored in an array
+ * and refer to ranges of the reordered triangles, leaves hold up to LEAF_SIZE triangles.
+ */
+class Bvh
+{
+public:
+    static const int LEAF_SIZE = 4;
+
+    Bvh();
+    explicit Bvh(const Mesh &mesh);
+
+    //! The corners of the box around all triangles, both zero if there are none
+    QVector3D getMinimum() const;
+    QVector3D getMaximum() const;
+
+    //! Distance from the point to the closest point on the triangles, infinite if there are
+    //! none
+    float distance(const QVector3D &point) const;
+
+    //! Number of triangles the ray from the origin along the direction crosses
+    int intersections(const QVector3D &origin, const QVector3D &direction) const;
+
+    //! Where the segment from start to end crosses the triangles, as sorted parameters
+    //! between 0 at start and 1 at end
+    QVector<float> crossings(const QVector3D &start, const QVector3D &end) const;
+
+    /*!
+     * \brief contains returns whether the point is inside the mesh, i.e. whether rays from it
+     * cross the triangles an odd number of times. Three rays vote so that a hole or a hit on
+     * an edge does not flip the result, the mesh should be closed nevertheless.
+     */
+    bool contains(const QVector3D &point) const;
+
+    int getTriangleCount() const;
+
+private:
+    struct Node {
+        QVector3D minimum;
+        QVector3D maximum;
+        //! Range of the triangles of this node in triangles
+        int begin;
+        int end;
+        //! -1 for leaves
+        int left;
+        int right;
+    };
+
+    //! Three corners per triangle, ordered by the leaves they are in
+    QVector<QVector3D> triangles;
+    QVector<Node> nodes;
+
+    int build(const QVector<QVector3D> &originalTriangles, const QVector<QVector3D> &centroids,
+              QVector<int> &order, int begin, int end);
+};
+
+typedef QSharedPointer<const Bvh> BvhPtr;
+
+#endif // BVH_H
@@ -0,0 +1,470 @@
+#include "cpurasterizer.hpp"
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+#include <QtDebug>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+int RasterBuffers::instanceAt(const QPoint &pixel) const {
+    if (pixel.x() < 0 || pixel.y() < 0 || pixel.x() >= size.width() || pixel.y() >= size.height()) {
+        return -1;
+    }
+    return instanceIds[pixel.y() * size.width() + pixel.x()] - 1;
+}
+
+float RasterBuffers::depthAt(const QPoint &pixel) const {
+    if (pixel.x() < 0 || pixel.y() < 0 || pixel.x() >= size.width() || pixel.y() >= size.height()) {
+        return 0.f;
+    }
+    return depth[pixel.y() * size.width() + pixel.x()];
+}
+
+//! A triangle in pixel coordinates, ready to be rasterized
+struct RasterTriangle {
+    //! Edge functions a * x + b * y + c, positive inside the triangle. Edge i is the one
+    //! opposite of vertex i.
+    double a[3];
+    double b[3];
+    double c[3];
+    //! Whether a pixel center exactly on the edge belongs to the triangle (top-left rule),
+    //! so that pixels on edges shared by two triangles are only drawn once
+    bool inclusive[3];
+    //! The inverse depth is linear in pixel coordinates: za * x + zb * y + zc
+    double za;
+    double zb;
+    double zc;
+    //! Pixels whose centers may lie inside, clamped to the image
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+    quint16 instanceId;
+};
+
+struct CameraIntrinsics {
+    float fx;
+    float fy;
+    float s;
+    float cx;
+    float cy;
+};
+
+//! Projects the polygon and adds it as triangle fan
+static void addProjectedPolygon(const QVector3D *polygon, int count,
+                                const CameraIntrinsics &K, const QSize &size,
+                                quint16 instanceId, QVector<RasterTriangle> &triangles) {
+    double x[4], y[4], inverseDepth[4];
+    for (int i = 0; i < count; i++) {
+        inverseDepth[i] = 1.0 / polygon[i].z();
+        x[i] = (K.fx * polygon[i].x() + K.s * polygon[i].y()) * inverseDepth[i] + K.cx;
+        y[i] = K.fy * polygon[i].y() * inverseDepth[i] + K.cy;
+    }
+
+    for (int fan = 1; fan + 1 < count; fan++) {
+        int v[3] = { 0, fan, fan + 1 };
+        RasterTriangle triangle;
+        for (int i = 0; i < 3; i++) {
+            int j = v[(i + 1) % 3];
+            int k = v[(i + 2) % 3];
+            triangle.a[i] = y[j] - y[k];
+            triangle.b[i] = x[k] - x[j];
+            triangle.c[i] = y[k] * x[j] - x[k] * y[j];
+        }
+        double area = triangle.a[0] * x[v[0]] + triangle.b[0] * y[v[0]] + triangle.c[0];
+        if (area == 0.0 || !std::isfinite(area)) {
+            continue;
+        }
+        double sign = area > 0 ? 1.0 : -1.0;
+        triangle.za = 0;
+        triangle.zb = 0;
+        triangle.zc = 0;
+        for (int i = 0; i < 3; i++) {
+            triangle.a[i] *= sign;
+            triangle.b[i] *= sign;
+            triangle.c[i] *= sign;
+            // Inside is to the right of left edges and below top edges
+            triangle.inclusive[i] = triangle.a[i] > 0 || (triangle.a[i] == 0 && triangle.b[i] > 0);
+            triangle.za += triangle.a[i] * inverseDepth[v[i]];
+            triangle.zb += triangle.b[i] * inverseDepth[v[i]];
+            triangle.zc += triangle.c[i] * inverseDepth[v[i]];
+        }
+        double absoluteArea = area * sign;
+        triangle.za /= absoluteArea;
+        triangle.zb /= absoluteArea;
+        triangle.zc /= absoluteArea;
+
+        double minX = std::min({x[v[0]], x[v[1]], x[v[2]]});
+        double maxX = std::max({x[v[0]], x[v[1]], x[v[2]]});
+        double minY = std::min({y[v[0]], y[v[1]], y[v[2]]});
+        double maxY = std::max({y[v[0]], y[v[1]], y[v[2]]});
+        // Pixel x is sampled at x + 0.5
+        triangle.minX = (int) std::max(0.0, std::ceil(minX - 0.5));
+        triangle.minY = (int) std::max(0.0, std::ceil(minY - 0.5));
+        triangle.maxX = (int) std::min(size.width() - 1.0, std::floor(maxX - 0.5));
+        triangle.maxY = (int) std::min(size.height() - 1.0, std::floor(maxY - 0.5));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            continue;
+        }
+        triangle.instanceId = instanceId;
+        triangles << triangle;
+    }
+}
+
+//! Clips the triangle in camera coordinates at the near plane and sets up the remaining part
+static void setupTriangle(const QVector3D *vertices, float nearPlane,
+                          const CameraIntrinsics &K, const QSize &size,
+                          quint16 instanceId, QVector<RasterTriangle> &triangles) {
+    bool inside[3];
+    int insideCount = 0;
+    for (int i = 0; i < 3; i++) {
+        inside[i] = vertices[i].z() >= nearPlane;
+        insideCount += inside[i];
+    }
+    if (insideCount == 3) {
+        addProjectedPolygon(vertices, 3, K, size, instanceId, triangles);
+        return;
+    }
+    if (insideCount == 0) {
+        return;
+    }
+    QVector3D polygon[4];
+    int count = 0;
+    for (int i = 0; i < 3; i++) {
+        const QVector3D &current = vertices[i];
+        const QVector3D &next = vertices[(i + 1) % 3];
+        if (inside[i]) {
+            polygon[count++] = current;
+        }
+        if (inside[i] != inside[(i + 1) % 3]) {
+            float t = (nearPlane - current.z()) / (next.z() - current.z());
+            polygon[count++] = current + t * (next - current);
+        }
+    }
+    addProjectedPolygon(polygon, count, K, size, instanceId, triangles);
+}
+
+//! Shared state of one rasterize call
+struct RasterJob {
+    CameraIntrinsics intrinsics;
+    QSize size;
+    float nearPlane;
+    const QList<RasterInstance> *instances;
+
+    //! Ranges of triangles of the instances that are set up by one task each
+    struct SetupRange {
+        int instance;
+        int firstTriangle;
+        int lastTriangle;
+    };
+    QVector<SetupRange> setupRanges;
+    QVector<QVector<RasterTriangle>> setupResults;
+    QAtomicInt nextSetupRange;
+
+    QVector<RasterTriangle> triangles;
+    int tilesX;
+    int tilesY;
+    QVector<QVector<int>> bins;
+    QAtomicInt nextTile;
+
+    //! The inverse depth while rasterizing, converted to depth when a tile is done
+    RasterBuffers *buffers;
+    //! Last instance that covered each pixel to count every instance only once per pixel
+    QVector<quint16> lastCoveringInstance;
+    QMutex countsMutex;
+};
+
+class TriangleSetupRunnable : public QRunnable {
+public:
+    TriangleSetupRunnable(RasterJob *job) : job(job) {
+    }
+
+    void run() override {
+        int rangeIndex;
+        while ((rangeIndex = job->nextSetupRange.fetchAndAddOrdered(1)) < job->setupRanges.size()) {
+            const RasterJob::SetupRange &range = job->setupRanges[rangeIndex];
+            const RasterInstance &instance = job->instances->at(range.instance);
+            const QVector<QVector3D> &vertices = instance.mesh->getVertices();
+            const QVector<quint32> &indices = instance.mesh->getIndices();
+            QVector<RasterTriangle> &triangles = job->setupResults[rangeIndex];
+            for (int t = range.firstTriangle; t < range.lastTriangle; t++) {
+                QVector3D cameraVertices[3];
+                for (int i = 0; i < 3; i++) {
+                    const QVector3D &v = vertices[indices[t * 3 + i]];
+                    const QMatrix3x3 &R = instance.rotation;
+                    cameraVertices[i] = QVector3D(
+                                R(0, 0) * v.x() + R(0, 1) * v.y() + R(0, 2) * v.z(),
+                                R(1, 0) * v.x() + R(1, 1) * v.y() + R(1, 2) * v.z(),
+                                R(2, 0) * v.x() + R(2, 1) * v.y() + R(2, 2) * v.z())
+                            + instance.position;
+                }
+                setupTriangle(cameraVertices, job->nearPlane, job->intrinsics, job->size,
+                              range.instance + 1, triangles);
+            }
+        }
+    }
+
+private:
+    RasterJob *job;
+};
+
+class TileRasterRunnable : public QRunnable {
+public:
+    TileRasterRunnable(RasterJob *job) : job(job) {
+        silhouettePixels.fill(0, job->instances->size());
+        visiblePixels.fill(0, job->instances->size());
+    }
+
+    void run() override {
+        int tile;
+        int tileCount = job->tilesX * job->tilesY;
+        while ((tile = job->nextTile.fetchAndAddOrdered(1)) < tileCount) {
+            rasterizeTile(tile);
+        }
+        QMutexLocker locker(&job->countsMutex);
+        for (int i = 0; i < silhouettePixels.size(); i++) {
+            job->buffers->silhouettePixels[i] += silhouettePixels[i];
+            job->buffers->visiblePixels[i] += visiblePixels[i];
+        }
+    }
+
+private:
+    RasterJob *job;
+    QVector<int> silhouettePixels;
+    QVector<int> visiblePixels;
+
+    inline void shadePixel(int index, float inverseDepth, quint16 instanceId) {
+        RasterBuffers *buffers = job->buffers;
+        if (job->lastCoveringInstance[index] != instanceId) {
+            job->lastCoveringInstance[index] = instanceId;
+            if (buffers->coverage[index] < 255) {
+                buffers->coverage[index]++;
+            }
+            silhouettePixels[instanceId - 1]++;
+        }
+        if (inverseDepth > buffers->depth[index]) {
+            buffers->depth[index] = inverseDepth;
+            buffers->instanceIds[index] = instanceId;
+        }
+    }
+
+    void rasterizeTriangle(const RasterTriangle &triangle, int tileMinX, int tileMinY,
+                           int tileMaxX, int tileMaxY) {
+        int minX = std::max(triangle.minX, tileMinX);
+        int maxX = std::min(triangle.maxX, tileMaxX);
+        int minY = std::max(triangle.minY, tileMinY);
+        int maxY = std::min(triangle.maxY, tileMaxY);
+        if (minX > maxX || minY > maxY) {
+            return;
+        }
+        int width = job->size.width();
+
+        for (int y = minY; y <= maxY; y++) {
+            double px = minX + 0.5;
+            double py = y + 0.5;
+            // Evaluated in double at the start of each row so that the error of the
+            // incremental float evaluation stays small
+            float w[3];
+            for (int i = 0; i < 3; i++) {
+                w[i] = (float) (triangle.a[i] * px + triangle.b[i] * py + triangle.c[i]);
+            }
+            float z = (float) (triangle.za * px + triangle.zb * py + triangle.zc);
+            int rowOffset = y * width;
+            int x = minX;
+
+#ifdef CPU_RASTERIZER_SSE2
+            const __m128 steps = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+            const __m128 zero = _mm_setzero_ps();
+            __m128 edge[3];
+            __m128 edgeStep[3];
+            __m128 inclusive[3];
+            for (int i = 0; i < 3; i++) {
+                float a = (float) triangle.a[i];
+                edge[i] = _mm_add_ps(_mm_set1_ps(w[i]), _mm_mul_ps(_mm_set1_ps(a), steps));
+                edgeStep[i] = _mm_set1_ps(4.f * a);
+                inclusive[i] = triangle.inclusive[i]
+                        ? _mm_castsi128_ps(_mm_set1_epi32(-1)) : zero;
+            }
+            float za = (float) triangle.za;
+            __m128 depth = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(_mm_set1_ps(za), steps));
+            __m128 depthStep = _mm_set1_ps(4.f * za);
+            for (; x + 3 <= maxX; x += 4) {
+                __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (int i = 0; i < 3; i++) {
+                    __m128 insideEdge = _mm_or_ps(
+                                _mm_cmpgt_ps(edge[i], zero),
+                                _mm_and_ps(_mm_cmpeq_ps(edge[i], zero), inclusive[i]));
+                    mask = _mm_and_ps(mask, insideEdge);
+                    edge[i] = _mm_add_ps(edge[i], edgeStep[i]);
+                }
+                int bits = _mm_movemask_ps(mask);
+                if (bits) {
+                    float depths[4];
+                    _mm_storeu_ps(depths, depth);
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (bits & (1 << lane)) {
+                            shadePixel(rowOffset + x + lane, depths[lane], triangle.instanceId);
+                        }
+                    }
+                }
+                depth = _mm_add_ps(depth, depthStep);
+            }
+            // The remaining pixels of the row continue from where the vector loop stopped
+            float stepped = (float) (x - minX);
+            for (int i = 0; i < 3; i++) {
+                w[i] += stepped * (float) triangle.a[i];
+            }
+            z += stepped * (float) triangle.za;
+#endif
+
+            for (; x <= maxX; x++) {
+                bool inside = true;
+                for (int i = 0; i < 3; i++) {
+                    inside &= w[i] > 0 || (w[i] == 0 && triangle.inclusive[i]);
+                    w[i] += (float) triangle.a[i];
+                }
+                if (inside) {
+                    shadePixel(rowOffset + x, z, triangle.instanceId);
+                }
+                z += (float) triangle.za;
+            }
+        }
+    }
+
+    void rasterizeTile(int tile) {
+        int tileMinX = (tile % job->tilesX) * CpuRasterizer::TILE_SIZE;
+        int tileMinY = (tile / job->tilesX) * CpuRasterizer::TILE_SIZE;
+        int tileMaxX = std::min(tileMinX + CpuRasterizer::TILE_SIZE, job->size.width()) - 1;
+        int tileMaxY = std::min(tileMinY + CpuRasterizer::TILE_SIZE, job->size.height()) - 1;
+
+        // The bins are in the order of the instances, which the coverage counting relies on
+        for (int triangleIndex : job->bins[tile]) {
+            rasterizeTriangle(job->triangles[triangleIndex], tileMinX, tileMinY,
+                              tileMaxX, tileMaxY);
+        }
+
+        RasterBuffers *buffers = job->buffers;
+        int width = job->size.width();
+        for (int y = tileMinY; y <= tileMaxY; y++) {
+            for (int x = tileMinX; x <= tileMaxX; x++) {
+                int index = y * width + x;
+                if (buffers->instanceIds[index] > 0) {
+                    buffers->depth[index] = 1.f / buffers->depth[index];
+                    visiblePixels[buffers->instanceIds[index] - 1]++;
+                }
+            }
+        }
+    }
+};
+
+CpuRasterizer::CpuRasterizer(int threadCount) {
+    threadPool.setMaxThreadCount(threadCount > 0 ? threadCount : QThread::idealThreadCount());
+}
+
+RasterBuffers CpuRasterizer::rasterize(const QMatrix3x3 &cameraMatrix,
+                                       const QSize &size,
+                                       const QList<RasterInstance> &instances) {
+    RasterBuffers buffers;
+    buffers.size = size.isEmpty() ? QSize(0, 0) : size;
+    int pixelCount = buffers.size.width() * buffers.size.height();
+    buffers.depth.fill(0.f, pixelCount);
+    buffers.instanceIds.fill(0, pixelCount);
+    buffers.coverage.fill(0, pixelCount);
+    buffers.silhouettePixels.fill(0, instances.size());
+    buffers.visiblePixels.fill(0, instances.size());
+    if (pixelCount == 0 || instances.isEmpty()) {
+        return buffers;
+    }
+    // The instance IDs are 16 bit, the instances beyond MAX_INSTANCES are left out
+    QList<RasterInstance> rasterizedInstances = instances;
+    if (instances.size() > MAX_INSTANCES) {
+        qWarning() << "Rasterizing only the first" << MAX_INSTANCES << "of"
+                   << instances.size() << "instances.";
+        rasterizedInstances = instances.mid(0, MAX_INSTANCES);
+    }
+
+    RasterJob job;
+    job.intrinsics = { cameraMatrix(0, 0), cameraMatrix(1, 1), cameraMatrix(0, 1),
+                       cameraMatrix(0, 2), cameraMatrix(1, 2) };
+    job.size = size;
+    job.nearPlane = nearPlane;
+    job.instances = &rasterizedInstances;
+    job.buffers = &buffers;
+    int threads = threadPool.maxThreadCount();
+
+    // Setup in ranges of triangles so that a single large mesh is also set up in parallel
+    const int trianglesPerRange = 16384;
+    for (int i = 0; i < rasterizedInstances.size(); i++) {
+        if (rasterizedInstances[i].mesh.isNull()) {
+            continue;
+        }
+        int triangleCount = rasterizedInstances[i].mesh->getTriangleCount();
+        for (int first = 0; first < triangleCount; first += trianglesPerRange) {
+            job.setupRanges << RasterJob::SetupRange {
+                i, first, std::min(first + trianglesPerRange, triangleCount) };
+        }
+    }
+    job.setupResults.resize(job.setupRanges.size());
+    for (int i = 0; i < std::min(threads, job.setupRanges.size()); i++) {
+        threadPool.start(new TriangleSetupRunnable(&job));
+    }
+    threadPool.waitForDone();
+
+    for (const QVector<RasterTriangle> &triangles : job.setupResults) {
+        job.triangles += triangles;
+    }
+    job.setupResults.clear();
+
+    job.tilesX = (size.width() + TILE_SIZE - 1) / TILE_SIZE;
+    job.tilesY = (size.height() + TILE_SIZE - 1) / TILE_SIZE;
+    job.bins.resize(job.tilesX * job.tilesY);
+    for (int t = 0; t < job.triangles.size(); t++) {
+        const RasterTriangle &triangle = job.triangles[t];
+        for (int tileY = triangle.minY / TILE_SIZE; tileY <= triangle.maxY / TILE_SIZE; tileY++) {
+            for (int tileX = triangle.minX / TILE_SIZE; tileX <= triangle.maxX / TILE_SIZE; tileX++) {
+                job.bins[tileY * job.tilesX + tileX] << t;
+            }
+        }
+    }
+
+    job.lastCoveringInstance.fill(0, pixelCount);
+    for (int i = 0; i < std::min(threads, job.bins.size()); i++) {
+        threadPool.start(new TileRasterRunnable(&job));
+    }
+    threadPool.waitForDone();
+    return buffers;
+}
+
+RasterBuffers CpuRasterizer::rasterize(const Image &image, const QSize &size,
+                                       const QList<Pose> &poses) {
+    QList<RasterInstance> instances;
+    for (const Pose &pose : poses) {
+        RasterInstance instance;
+        instance.mesh = meshCache.get(pose.getObjectModel()->getAbsolutePath());
+        instance.rotation = pose.getRotation();
+        instance.position = pose.getPosition();
+        instances << instance;
+    }
+    return rasterize(image.getCameraMatrix(), size, instances);
+}
+
+RasterBuffers CpuRasterizer::rasterize(const Image &image, const QList<Pose> &poses) {
+    return rasterize(image, image.getSize(), poses);
+}
+
+void CpuRasterizer::setNearPlane(float value) {
+    nearPlane = value;
+}
+
+MeshCache &CpuRasterizer::getMeshCache() {
+    return meshCache;
+}
@@ -0,0 +1,100 @@
+#ifndef CPURASTERIZER_H
+#define CPURASTERIZER_H
+
+#include "misc/geometry/mesh.hpp"
+#include "model/image.hpp"
+#include "model/pose.hpp"
+
+#include <QList>
+#include <QMatrix3x3>
+#include <QPoint>
+#include <QSize>
+#include <QThreadPool>
+#include <QVector>
+#include <QVector3D>
+
+//! An object model placed in front of the camera
+struct RasterInstance {
+    MeshPtr mesh;
+    QMatrix3x3 rotation;
+    QVector3D position;
+};
+
+/*!
+ * \brief The RasterBuffers struct holds the result of rasterizing instances into an image.
+ * All buffers are stored row by row starting at the top left pixel.
+ */
+struct RasterBuffers {
+    QSize size;
+    //! Distance of the closest surface from the camera plane, 0 where no object is
+    QVector<float> depth;
+    //! Index of the closest instance plus one, 0 where no object is
+    QVector<quint16> instanceIds;
+    //! Number of instances whose silhouette covers the pixel, occluded ones included
+    QVector<quint8> coverage;
+    //! Number of pixels covered by the silhouette of each instance, ignoring other instances
+    QVector<int> silhouettePixels;
+    //! Number of pixels where each instance is the closest one
+    QVector<int> visiblePixels;
+
+    //! Returns the index of the instance visible at the given pixel or -1 if there is none
+    int instanceAt(const QPoint &pixel) const;
+    float depthAt(const QPoint &pixel) const;
+};
+
+/*!
+ * \brief The CpuRasterizer class renders object models without OpenGL, so that masks and
+ * depth can be computed on machines without a (working) OpenGL implementation.
+ *
+ * The projection matches the one of the pose viewer and the ground truth renderer: the
+ * vertices are transformed by the pose and projected with the camera matrix, pixel (x, y)
+ * covers the area from (x, y) to (x + 1, y + 1) and is sampled at its center.
+ *
+ * The triangles are set up and binned into tiles of TILE_SIZE x TILE_SIZE pixels, then the
+ * tiles are rasterized in parallel. The edge functions are evaluated for four pixels at once
+ * with SSE2 where available. Triangles are not culled, i.e. meshes do not have to be closed
+ * or consistently oriented.
+ */
+class CpuRasterizer
+{
+public:
+    //! \param threadCount the number of threads, 0 uses one per core
+    explicit CpuRasterizer(int threadCount = 0);
+
+    static const int TILE_SIZE = 64;
+    //! The instance IDs are 16 bit, the buffers of more instances only show the first ones
+    static const int MAX_INSTANCES = 65535;
+
+    /*!
+     * \brief rasterize renders the given instances into buffers of the given size.
+     * \param cameraMatrix the intrinsic camera parameters K
+     * \param size the size of the image in pixels
+     * \param instances the instances, the index of an instance is its index in this list,
+     * instances without a mesh are skipped, instances beyond MAX_INSTANCES as well with a
+     * warning
+     */
+    RasterBuffers rasterize(const QMatrix3x3 &cameraMatrix,
+                            const QSize &size,
+                            const QList<RasterInstance> &instances);
+
+    /*!
+     * \brief rasterize renders the poses with the camera matrix of the image. The meshes of
+     * the object models are loaded through the mesh cache of this rasterizer. Instance i is
+     * the i-th pose.
+     */
+    RasterBuffers rasterize(const Image &image, const QSize &size, const QList<Pose> &poses);
+
+    //! Like the other overload but reads the size of the image from its file header
+    RasterBuffers rasterize(const Image &image, const QList<Pose> &poses);
+
+    //! Sets the distance from the camera below which geometry is clipped, defaults to 1
+    void setNearPlane(float value);
+    MeshCache &getMeshCache();
+
+private:
+    QThreadPool threadPool;
+    MeshCache meshCache;
+    float nearPlane = 1.f;
+};
+
+#endif // CPURASTERIZER_H
@@ -0,0 +1,110 @@
+#include "kdtree.hpp"
+
+#include <algorithm>
+#include <limits>
+
+KdTree::KdTree() {
+}
+
+KdTree::KdTree(const QVector<QVector3D> &originalPoints) {
+    indices.resize(originalPoints.size());
+    for (int i = 0; i < indices.size(); i++) {
+        indices[i] = i;
+    }
+    if (originalPoints.isEmpty()) {
+        return;
+    }
+    // A balanced tree has less than two nodes per leaf
+    nodes.reserve(2 * (originalPoints.size() / LEAF_SIZE + 1));
+    build(originalPoints, 0, originalPoints.size());
+    // Leaves read their points from consecutive memory
+    points.resize(originalPoints.size());
+    for (int i = 0; i < points.size(); i++) {
+        points[i] = originalPoints[indices[i]];
+    }
+}
+
+int KdTree::build(const QVector<QVector3D> &originalPoints, int begin, int end) {
+    int index = nodes.size();
+    nodes.append(Node { begin, end, -1, 0.f, -1, -1 });
+    if (end - begin <= LEAF_SIZE) {
+        return index;
+    }
+
+    QVector3D minimum = originalPoints[indices[begin]];
+    QVector3D maximum = minimum;
+    for (int i = begin + 1; i < end; i++) {
+        const QVector3D &point = originalPoints[indices[i]];
+        for (int axis = 0; axis < 3; axis++) {
+            minimum[axis] = std::min(minimum[axis], point[axis]);
+            maximum[axis] = std::max(maximum[axis], point[axis]);
+        }
+    }
+    QVector3D extent = maximum - minimum;
+    int axis = extent.x() >= extent.y() && extent.x() >= extent.z()
+            ? 0 : (extent.y() >= extent.z() ? 1 : 2);
+
+    int middle = begin + (end - begin) / 2;
+    std::nth_element(indices.begin() + begin, indices.begin() + middle, indices.begin() + end,
+                     [&originalPoints, axis](int i1, int i2) {
+                         return originalPoints[i1][axis] < originalPoints[i2][axis];
+                     });
+    float split = originalPoints[indices[middle]][axis];
+    int left = build(originalPoints, begin, middle);
+    int right = build(originalPoints, middle, end);
+    // Not through a reference, building the children may reallocate the nodes
+    nodes[index].axis = axis;
+    nodes[index].split = split;
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+int KdTree::nearest(const QVector3D &query, float *squaredDistance) const {
+    int best = -1;
+    float bestDistance = std::numeric_limits<float>::infinity();
+    if (nodes.isEmpty()) {
+        return best;
+    }
+
+    // Nodes still to search with the squared distance of the query to their side of the
+    // splitting plane, a lower bound of the distance to their points
+    struct Pending {
+        int node;
+        float bound;
+    };
+    // The depth of a balanced tree stays far below this
+    Pending stack[128];
+    int stackSize = 0;
+    stack[stackSize++] = Pending { 0, 0.f };
+    while (stackSize > 0) {
+        Pending pending = stack[--stackSize];
+        if (pending.bound >= bestDistance) {
+            continue;
+        }
+        const Node &node = nodes[pending.node];
+        if (node.axis < 0) {
+            for (int i = node.begin; i < node.end; i++) {
+                float distance = (points[i] - query).lengthSquared();
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = i;
+                }
+            }
+            continue;
+        }
+        float offset = query[node.axis] - node.split;
+        // The near child is searched first, i.e. pushed last
+        stack[stackSize++] = Pending { offset < 0 ? node.right : node.left,
+                                       std::max(pending.bound, offset * offset) };
+        stack[stackSize++] = Pending { offset < 0 ? node.left : node.right, pending.bound };
+    }
+    if (squaredDistance) {
+        *squaredDistance = bestDistance;
+    }
+    return indices[best];
+}
+
+int KdTree::size() const {
+    return points.size();
+}
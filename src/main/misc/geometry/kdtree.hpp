@@ -0,0 +1,54 @@
+#ifndef KDTREE_H
+#define KDTREE_H
+
+#include <QVector>
+#include <QVector3D>
+
+/*!
+ * \brief The KdTree class finds the closest of a fixed set of points, e.g. of the vertices of
+ * an object model.
+ *
+ * The tree is balanced, every node splits its points at the median along the axis of their
+ * largest extent. The nodes are stored in an array and refer to ranges of the reordered
+ * points, leaves hold up to LEAF_SIZE points that are searched linearly.
+ */
+class KdTree
+{
+public:
+    static const int LEAF_SIZE = 8;
+
+    KdTree();
+    explicit KdTree(const QVector<QVector3D> &points);
+
+    /*!
+     * \brief nearest returns the index of the closest point in the points that the tree was
+     * built from, or -1 if there are none.
+     * \param query the point to search the closest point to
+     * \param squaredDistance set to the squared distance to the closest point if not null
+     */
+    int nearest(const QVector3D &query, float *squaredDistance = nullptr) const;
+
+    int size() const;
+
+private:
+    struct Node {
+        //! Range of the points of this node in points
+        int begin;
+        int end;
+        //! -1 for leaves
+        int axis;
+        float split;
+        int left;
+        int right;
+    };
+
+    //! The points ordered by the leaves they are in
+    QVector<QVector3D> points;
+    //! The index of each point in the points the tree was built from
+    QVector<int> indices;
+    QVector<Node> nodes;
+
+    int build(const QVector<QVector3D> &originalPoints, int begin, int end);
+};
+
+#endif // KDTREE_H
@@ -0,0 +1,75 @@
+#include "mesh.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <QMutexLocker>
+#include <QtDebug>
+
+QSharedPointer<const Mesh> Mesh::load(const QString &path) {
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(path.toStdString(),
+                                             aiProcess_Triangulate |
+                                             aiProcess_JoinIdenticalVertices |
+                                             aiProcess_SortByPType);
+    if (!scene) {
+        qDebug() << "Could not load object model " + path;
+        return QSharedPointer<const Mesh>();
+    }
+
+    QSharedPointer<Mesh> mesh(new Mesh);
+    for (uint i = 0; i < scene->mNumMeshes; i++) {
+        const aiMesh *sceneMesh = scene->mMeshes[i];
+        quint32 offset = mesh->vertices.size();
+        for (uint v = 0; v < sceneMesh->mNumVertices; v++) {
+            const aiVector3D &vertex = sceneMesh->mVertices[v];
+            mesh->vertices << QVector3D(vertex.x, vertex.y, vertex.z);
+        }
+        for (uint f = 0; f < sceneMesh->mNumFaces; f++) {
+            const aiFace &face = sceneMesh->mFaces[f];
+            // Points and lines remain after triangulation, they have no area
+            if (face.mNumIndices != 3) {
+                continue;
+            }
+            mesh->indices << offset + face.mIndices[0]
+                          << offset + face.mIndices[1]
+                          << offset + face.mIndices[2];
+        }
+    }
+    return mesh;
+}
+
+const QVector<QVector3D> &Mesh::getVertices() const {
+    return vertices;
+}
+
+const QVector<quint32> &Mesh::getIndices() const {
+    return indices;
+}
+
+int Mesh::getTriangleCount() const {
+    return indices.size() / 3;
+}
+
+MeshPtr MeshCache::get(const QString &path) {
+    {
+        QMutexLocker locker(&mutex);
+        if (meshes.contains(path)) {
+            return meshes[path];
+        }
+    }
+    // Loading takes long, other meshes can be retrieved in the meantime. If two threads load
+    // the same mesh at once the first one wins.
+    MeshPtr mesh = Mesh::load(path);
+    QMutexLocker locker(&mutex);
+    if (!meshes.contains(path)) {
+        meshes[path] = mesh;
+    }
+    return meshes[path];
+}
+
+void MeshCache::clear() {
+    QMutexLocker locker(&mutex);
+    meshes.clear();
+}
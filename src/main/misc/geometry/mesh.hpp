@@ -0,0 +1,57 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <QVector3D>
+
+/*!
+ * \brief The Mesh class holds the triangles of an object model on the CPU, i.e. without
+ * the OpenGL buffers of the renderables. All meshes of the object model file are merged
+ * into one.
+ */
+class Mesh
+{
+public:
+    /*!
+     * \brief load loads the object model at the given path with Assimp.
+     * \return the mesh or a null pointer if the file could not be loaded
+     */
+    static QSharedPointer<const Mesh> load(const QString &path);
+
+    const QVector<QVector3D> &getVertices() const;
+    //! Three indices into the vertices per triangle
+    const QVector<quint32> &getIndices() const;
+    int getTriangleCount() const;
+
+private:
+    QVector<QVector3D> vertices;
+    QVector<quint32> indices;
+};
+
+typedef QSharedPointer<const Mesh> MeshPtr;
+
+/*!
+ * \brief The MeshCache class loads every object model only once and shares the mesh
+ * between all users. It can be used from multiple threads.
+ */
+class MeshCache
+{
+public:
+    /*!
+     * \brief get returns the mesh of the object model at the given absolute path and loads
+     * it if this has not happened yet.
+     * \return the mesh or a null pointer if the file could not be loaded
+     */
+    MeshPtr get(const QString &path);
+    void clear();
+
+private:
+    QMutex mutex;
+    QHash<QString, MeshPtr> meshes;
+};
+
+#endif // MESH_H
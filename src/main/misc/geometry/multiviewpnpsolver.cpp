@@ -0,0 +1,436 @@
+#include "multiviewpnpsolver.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <QtDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+//! Triangulating rays that are closer to parallel than this, in terms of the smallest
+//! singular value of the normal equations, gives no depth
+static const double MIN_TRIANGULATION_CONDITION = 1e-4;
+
+struct ViewGeometry {
+    cv::Matx33d cameraMatrix;
+    cv::Matx33d rotation;
+    cv::Vec3d translation;
+};
+
+struct Observation {
+    cv::Vec3d objectPoint;
+    cv::Vec2d imagePoint;
+    int view;
+};
+
+//! The pose of the object in the world frame
+struct WorldPose {
+    cv::Matx33d rotation;
+    cv::Vec3d translation;
+};
+
+static cv::Matx33d toMatx(const QMatrix3x3 &matrix) {
+    return cv::Matx33d(matrix(0, 0), matrix(0, 1), matrix(0, 2),
+                       matrix(1, 0), matrix(1, 1), matrix(1, 2),
+                       matrix(2, 0), matrix(2, 1), matrix(2, 2));
+}
+
+static cv::Vec3d toVec(const QVector3D &vector) {
+    return cv::Vec3d(vector.x(), vector.y(), vector.z());
+}
+
+static cv::Matx33d skew(const cv::Vec3d &v) {
+    return cv::Matx33d(0, -v[2], v[1],
+                       v[2], 0, -v[0],
+                       -v[1], v[0], 0);
+}
+
+//! The rotation about the axis v by the angle |v|
+static cv::Matx33d exponential(const cv::Vec3d &v) {
+    double angle = cv::norm(v);
+    cv::Matx33d k = skew(v);
+    if (angle < 1e-12) {
+        return cv::Matx33d::eye() + k;
+    }
+    return cv::Matx33d::eye() + (std::sin(angle) / angle) * k
+            + ((1 - std::cos(angle)) / (angle * angle)) * (k * k);
+}
+
+//! Infinite for points behind the camera
+static double reprojectionError(const WorldPose &pose, const ViewGeometry &view,
+                                const Observation &observation) {
+    cv::Vec3d camera = view.rotation * (pose.rotation * observation.objectPoint
+                                        + pose.translation) + view.translation;
+    if (camera[2] <= 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    cv::Vec3d projected = view.cameraMatrix * camera;
+    return std::hypot(projected[0] / projected[2] - observation.imagePoint[0],
+                      projected[1] / projected[2] - observation.imagePoint[1]);
+}
+
+static std::vector<double> reprojectionErrors(const WorldPose &pose,
+                                              const std::vector<ViewGeometry> &views,
+                                              const std::vector<Observation> &observations) {
+    std::vector<double> errors(observations.size());
+    for (size_t i = 0; i < observations.size(); i++) {
+        errors[i] = reprojectionError(pose, views[observations[i].view], observations[i]);
+    }
+    return errors;
+}
+
+//! Truncated squared error (MSAC score), lower is better
+static double score(const std::vector<double> &errors, double threshold) {
+    double sum = 0;
+    for (double error : errors) {
+        sum += std::min(error * error, threshold * threshold);
+    }
+    return sum;
+}
+
+/*!
+ * \brief triangulate computes the point closest to the viewing rays of the observations in
+ * the least squares sense.
+ * \return false if the rays are too close to parallel or the point is behind a camera
+ */
+static bool triangulate(const std::vector<int> &indices,
+                        const std::vector<Observation> &observations,
+                        const std::vector<ViewGeometry> &views, cv::Vec3d &point) {
+    cv::Matx33d normal = cv::Matx33d::zeros();
+    cv::Vec3d right(0, 0, 0);
+    for (int index : indices) {
+        const Observation &observation = observations[index];
+        const ViewGeometry &view = views[observation.view];
+        cv::Vec3d pixel(observation.imagePoint[0], observation.imagePoint[1], 1);
+        cv::Vec3d direction = view.rotation.t() * (view.cameraMatrix.inv() * pixel);
+        direction = cv::normalize(direction);
+        cv::Vec3d center = -(view.rotation.t() * view.translation);
+        // Projects onto the plane orthogonal to the ray
+        cv::Matx33d projection = cv::Matx33d::eye() - direction * direction.t();
+        normal += projection;
+        right += projection * center;
+    }
+    cv::Mat singularValues;
+    cv::SVD::compute(cv::Mat(normal), singularValues, cv::SVD::NO_UV);
+    if (singularValues.at<double>(2) < MIN_TRIANGULATION_CONDITION
+            * singularValues.at<double>(0)) {
+        return false;
+    }
+    point = normal.inv(cv::DECOMP_CHOLESKY) * right;
+    for (int index : indices) {
+        const ViewGeometry &view = views[observations[index].view];
+        if ((view.rotation * point + view.translation)[2] <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//! Aligns the object points with the world points (Kabsch), false if they are collinear
+static bool align(const std::vector<cv::Vec3d> &objectPoints,
+                  const std::vector<cv::Vec3d> &worldPoints, WorldPose &pose) {
+    cv::Vec3d objectCenter(0, 0, 0);
+    cv::Vec3d worldCenter(0, 0, 0);
+    for (size_t i = 0; i < objectPoints.size(); i++) {
+        objectCenter += objectPoints[i];
+        worldCenter += worldPoints[i];
+    }
+    objectCenter *= 1.0 / objectPoints.size();
+    worldCenter *= 1.0 / worldPoints.size();
+    cv::Matx33d covariance = cv::Matx33d::zeros();
+    for (size_t i = 0; i < objectPoints.size(); i++) {
+        covariance += (objectPoints[i] - objectCenter) * (worldPoints[i] - worldCenter).t();
+    }
+    cv::Mat singularValues, u, vt;
+    cv::SVD::compute(cv::Mat(covariance), singularValues, u, vt);
+    if (singularValues.at<double>(1) < 1e-9 * singularValues.at<double>(0)) {
+        return false;
+    }
+    cv::Matx33d uMatrix = u;
+    cv::Matx33d vMatrix = cv::Matx33d(vt).t();
+    // Avoids reflections
+    double sign = cv::determinant(vMatrix * uMatrix.t()) < 0 ? -1 : 1;
+    cv::Matx33d correction(1, 0, 0,
+                           0, 1, 0,
+                           0, 0, sign);
+    pose.rotation = vMatrix * correction * uMatrix.t();
+    pose.translation = worldCenter - pose.rotation * objectCenter;
+    return true;
+}
+
+//! Levenberg-Marquardt on the reprojection errors of the given observations in all views
+static void refine(WorldPose &pose, const std::vector<int> &indices,
+                   const std::vector<Observation> &observations,
+                   const std::vector<ViewGeometry> &views) {
+    auto cost = [&](const WorldPose &candidate) {
+        double sum = 0;
+        for (int index : indices) {
+            double error = reprojectionError(candidate, views[observations[index].view],
+                                             observations[index]);
+            sum += error * error;
+        }
+        return sum;
+    };
+
+    double currentCost = cost(pose);
+    double damping = -1;
+    for (int iteration = 0; iteration < MultiViewPnPSolver::MAX_REFINEMENT_ITERATIONS;
+         iteration++) {
+        // The rotation is updated by a small rotation in the world frame, exp(w) * R
+        cv::Matx66d normal = cv::Matx66d::zeros();
+        cv::Vec6d gradient(0, 0, 0, 0, 0, 0);
+        for (int index : indices) {
+            const Observation &observation = observations[index];
+            const ViewGeometry &view = views[observation.view];
+            cv::Vec3d rotated = pose.rotation * observation.objectPoint;
+            cv::Vec3d camera = view.rotation * (rotated + pose.translation) + view.translation;
+            cv::Vec3d projected = view.cameraMatrix * camera;
+            double z = projected[2];
+            if (camera[2] <= 0 || z <= 0) {
+                continue;
+            }
+            cv::Vec2d residual(projected[0] / z - observation.imagePoint[0],
+                               projected[1] / z - observation.imagePoint[1]);
+            // Derivative of the pixel with respect to the point in camera coordinates
+            cv::Matx<double, 2, 3> pixelByCamera;
+            for (int column = 0; column < 3; column++) {
+                pixelByCamera(0, column) = (view.cameraMatrix(0, column) * z
+                                            - projected[0] * view.cameraMatrix(2, column))
+                        / (z * z);
+                pixelByCamera(1, column) = (view.cameraMatrix(1, column) * z
+                                            - projected[1] * view.cameraMatrix(2, column))
+                        / (z * z);
+            }
+            cv::Matx<double, 2, 3> byRotation = pixelByCamera * view.rotation
+                    * (-skew(rotated));
+            cv::Matx<double, 2, 3> byTranslation = pixelByCamera * view.rotation;
+            cv::Matx<double, 2, 6> jacobian;
+            for (int row = 0; row < 2; row++) {
+                for (int column = 0; column < 3; column++) {
+                    jacobian(row, column) = byRotation(row, column);
+                    jacobian(row, column + 3) = byTranslation(row, column);
+                }
+            }
+            normal += jacobian.t() * jacobian;
+            gradient += jacobian.t() * residual;
+        }
+
+        if (damping < 0) {
+            double maximum = 0;
+            for (int i = 0; i < 6; i++) {
+                maximum = std::max(maximum, normal(i, i));
+            }
+            damping = 1e-3 * maximum;
+        }
+        bool improved = false;
+        // Increases the damping until a step lowers the cost
+        for (int attempt = 0; attempt < 10 && !improved; attempt++) {
+            cv::Matx66d damped = normal;
+            for (int i = 0; i < 6; i++) {
+                damped(i, i) += damping;
+            }
+            cv::Vec6d step = damped.solve(-gradient, cv::DECOMP_CHOLESKY);
+            WorldPose candidate;
+            candidate.rotation = exponential(cv::Vec3d(step[0], step[1], step[2]))
+                    * pose.rotation;
+            candidate.translation = pose.translation + cv::Vec3d(step[3], step[4], step[5]);
+            double candidateCost = cost(candidate);
+            if (candidateCost < currentCost) {
+                improved = true;
+                bool converged = currentCost - candidateCost < 1e-10 * (currentCost + 1e-10);
+                pose = candidate;
+                currentCost = candidateCost;
+                damping *= 0.1;
+                if (converged) {
+                    return;
+                }
+            } else {
+                damping *= 10;
+            }
+        }
+        if (!improved) {
+            return;
+        }
+    }
+}
+
+MultiViewPnPSolver::MultiViewPnPSolver(float inlierThreshold) :
+    inlierThreshold(inlierThreshold) {
+}
+
+PnPSolution MultiViewPnPSolver::solve(const QList<PnPObservation> &pnpObservations,
+                                      const QList<PnPView> &pnpViews) const {
+    PnPSolution solution;
+    int n = pnpObservations.size();
+    solution.reprojectionErrors.fill(std::numeric_limits<float>::infinity(), n);
+    solution.inliers.fill(false, n);
+    if (n < PnPSolver::MINIMAL_SAMPLE_SIZE) {
+        return solution;
+    }
+
+    std::vector<ViewGeometry> views;
+    for (const PnPView &view : pnpViews) {
+        views.push_back(ViewGeometry { toMatx(view.cameraMatrix), toMatx(view.worldRotation),
+                                       toVec(view.worldTranslation) });
+    }
+    std::vector<Observation> observations;
+    cv::Vec3d minimum = toVec(pnpObservations.first().objectPoint);
+    cv::Vec3d maximum = minimum;
+    for (const PnPObservation &observation : pnpObservations) {
+        Q_ASSERT(observation.view >= 0 && observation.view < pnpViews.size());
+        observations.push_back(Observation { toVec(observation.objectPoint),
+                                             cv::Vec2d(observation.imagePoint.x(),
+                                                       observation.imagePoint.y()),
+                                             observation.view });
+        for (int axis = 0; axis < 3; axis++) {
+            minimum[axis] = std::min(minimum[axis], observations.back().objectPoint[axis]);
+            maximum[axis] = std::max(maximum[axis], observations.back().objectPoint[axis]);
+        }
+    }
+
+    // Groups the observations of the same object point, clicks on the same spot of the object
+    // model never hit exactly the same point
+    double mergeThreshold = mergeDistance * cv::norm(maximum - minimum);
+    std::vector<std::vector<int>> groups;
+    for (int i = 0; i < n; i++) {
+        bool merged = false;
+        for (std::vector<int> &group : groups) {
+            if (cv::norm(observations[group.front()].objectPoint
+                         - observations[i].objectPoint) <= mergeThreshold) {
+                group.push_back(i);
+                merged = true;
+                break;
+            }
+        }
+        if (!merged) {
+            groups.push_back({i});
+        }
+    }
+
+    std::vector<cv::Vec3d> triangulatedObjectPoints;
+    std::vector<cv::Vec3d> triangulatedWorldPoints;
+    for (const std::vector<int> &group : groups) {
+        bool severalViews = false;
+        cv::Vec3d objectPoint(0, 0, 0);
+        for (int index : group) {
+            severalViews |= observations[index].view != observations[group.front()].view;
+            objectPoint += observations[index].objectPoint;
+        }
+        cv::Vec3d worldPoint;
+        if (severalViews && triangulate(group, observations, views, worldPoint)) {
+            triangulatedObjectPoints.push_back(objectPoint * (1.0 / group.size()));
+            triangulatedWorldPoints.push_back(worldPoint);
+        }
+    }
+    solution.triangulatedPoints = (int) triangulatedWorldPoints.size();
+
+    // Initial poses from the triangulated points and from every view on its own
+    std::vector<WorldPose> hypotheses;
+    WorldPose aligned;
+    if (triangulatedWorldPoints.size() >= 3
+            && align(triangulatedObjectPoints, triangulatedWorldPoints, aligned)) {
+        hypotheses.push_back(aligned);
+    }
+    PnPSolver singleViewSolver(inlierThreshold);
+    singleViewSolver.setRobust(robust);
+    for (int view = 0; view < (int) views.size(); view++) {
+        QList<QVector3D> objectPoints;
+        QList<QPointF> imagePoints;
+        for (const PnPObservation &observation : pnpObservations) {
+            if (observation.view == view) {
+                objectPoints << observation.objectPoint;
+                imagePoints << observation.imagePoint;
+            }
+        }
+        if (objectPoints.size() < PnPSolver::MINIMAL_SAMPLE_SIZE) {
+            continue;
+        }
+        PnPSolution viewSolution = singleViewSolver.solve(objectPoints, imagePoints,
+                                                          pnpViews[view].cameraMatrix);
+        if (viewSolution.valid) {
+            // From the camera to the world frame
+            const ViewGeometry &geometry = views[view];
+            WorldPose pose;
+            pose.rotation = geometry.rotation.t() * toMatx(viewSolution.rotation);
+            pose.translation = geometry.rotation.t()
+                    * (toVec(viewSolution.translation) - geometry.translation);
+            hypotheses.push_back(pose);
+        }
+    }
+    if (hypotheses.empty()) {
+        qDebug() << "Could not compute an initial pose, click at least three points in two "
+                    "views or four points in one view.";
+        return solution;
+    }
+
+    double threshold = robust ? inlierThreshold : std::numeric_limits<double>::infinity();
+    WorldPose best = hypotheses.front();
+    double bestScore = std::numeric_limits<double>::infinity();
+    for (const WorldPose &hypothesis : hypotheses) {
+        double hypothesisScore = score(reprojectionErrors(hypothesis, views, observations),
+                                       threshold);
+        if (hypothesisScore < bestScore) {
+            bestScore = hypothesisScore;
+            best = hypothesis;
+        }
+    }
+
+    // Refining on the inliers can turn further observations into inliers
+    std::vector<double> errors = reprojectionErrors(best, views, observations);
+    std::vector<int> inliers;
+    for (int step = 0; step < 2; step++) {
+        inliers.clear();
+        for (int i = 0; i < n; i++) {
+            if (errors[i] < threshold) {
+                inliers.push_back(i);
+            }
+        }
+        if ((int) inliers.size() < PnPSolver::MINIMAL_SAMPLE_SIZE) {
+            break;
+        }
+        refine(best, inliers, observations, views);
+        errors = reprojectionErrors(best, views, observations);
+    }
+    inliers.clear();
+    double squaredErrorSum = 0;
+    for (int i = 0; i < n; i++) {
+        solution.reprojectionErrors[i] = (float) errors[i];
+        if (errors[i] < threshold) {
+            inliers.push_back(i);
+            solution.inliers[i] = true;
+            squaredErrorSum += errors[i] * errors[i];
+        }
+    }
+
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            solution.rotation(row, column) = (float) best.rotation(row, column);
+        }
+    }
+    solution.translation = QVector3D((float) best.translation[0],
+                                     (float) best.translation[1],
+                                     (float) best.translation[2]);
+    solution.numberOfInliers = (int) inliers.size();
+    solution.inlierError = inliers.empty() ? 0.f
+                                           : (float) std::sqrt(squaredErrorSum / inliers.size());
+    solution.valid = solution.numberOfInliers >= PnPSolver::MINIMAL_SAMPLE_SIZE;
+    return solution;
+}
+
+void MultiViewPnPSolver::setRobust(bool robust) {
+    this->robust = robust;
+}
+
+void MultiViewPnPSolver::setInlierThreshold(float inlierThreshold) {
+    this->inlierThreshold = inlierThreshold;
+}
+
+float MultiViewPnPSolver::getInlierThreshold() const {
+    return inlierThreshold;
+}
+
+void MultiViewPnPSolver::setMergeDistance(float mergeDistance) {
+    this->mergeDistance = mergeDistance;
+}
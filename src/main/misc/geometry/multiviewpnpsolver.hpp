@@ -0,0 +1,71 @@
+#ifndef MULTIVIEWPNPSOLVER_H
+#define MULTIVIEWPNPSOLVER_H
+
+#include "misc/geometry/pnpsolver.hpp"
+
+#include <QList>
+#include <QMatrix3x3>
+#include <QPointF>
+#include <QVector3D>
+
+//! A calibrated camera of a multi-view capture
+struct PnPView {
+    //! The intrinsic camera parameters K
+    QMatrix3x3 cameraMatrix;
+    //! The extrinsics, a point x in world coordinates is at
+    //! worldRotation * x + worldTranslation in camera coordinates
+    QMatrix3x3 worldRotation;
+    QVector3D worldTranslation;
+};
+
+//! A point on the object model and the pixel it is seen at in one of the views
+struct PnPObservation {
+    QVector3D objectPoint;
+    //! The center of the top left pixel is at 0.5
+    QPointF imagePoint;
+    //! Index of the view
+    int view;
+};
+
+/*!
+ * \brief The MultiViewPnPSolver class computes the pose of an object in the world frame from
+ * correspondences in several calibrated views, i.e. solves the generalized
+ * perspective-n-point problem.
+ *
+ * Observations of the same point on the object model, i.e. of object points closer than the
+ * merge distance, in different views are triangulated. With three triangulated points the
+ * pose follows in closed form from aligning the object points with the triangulated points.
+ * Every view with at least PnPSolver::MINIMAL_SAMPLE_SIZE observations gives another initial
+ * pose through the PnPSolver. The initial pose that the most observations agree with is
+ * refined with Levenberg-Marquardt on the reprojection errors of all inliers in all views at
+ * once. The solution holds the world pose and the errors of the observations in their order.
+ */
+class MultiViewPnPSolver
+{
+public:
+    //! Iterations of the joint Levenberg-Marquardt refinement at most
+    static const int MAX_REFINEMENT_ITERATIONS = 30;
+
+    //! \param inlierThreshold the reprojection error in pixels up to which an observation is
+    //! an inlier
+    explicit MultiViewPnPSolver(float inlierThreshold = 8.f);
+
+    PnPSolution solve(const QList<PnPObservation> &observations,
+                      const QList<PnPView> &views) const;
+
+    void setRobust(bool robust);
+    void setInlierThreshold(float inlierThreshold);
+    float getInlierThreshold() const;
+    /*!
+     * \brief setMergeDistance sets the distance below which object points are the same
+     * point, relative to the extent of all object points. Defaults to 0.02.
+     */
+    void setMergeDistance(float mergeDistance);
+
+private:
+    bool robust = true;
+    float inlierThreshold;
+    float mergeDistance = 0.02f;
+};
+
+#endif // MULTIVIEWPNPSOLVER_H
@@ -0,0 +1,298 @@
+#include "pnpsolver.hpp"
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <QtDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+//! How often a new best pose is re-estimated from its inliers at most
+static const int LOCAL_OPTIMIZATION_STEPS = 4;
+
+//! A pose hypothesis with its truncated squared error (MSAC score), lower is better
+struct PnPHypothesis {
+    cv::Mat rotation;
+    cv::Mat translation;
+    std::vector<double> errors;
+    double score = std::numeric_limits<double>::infinity();
+};
+
+struct PnPProblem {
+    std::vector<cv::Point3d> objectPoints;
+    std::vector<cv::Point2d> imagePoints;
+    cv::Mat cameraMatrix;
+};
+
+//! Infinite for points behind the camera
+static std::vector<double> reprojectionErrors(const PnPProblem &problem,
+                                              const cv::Mat &rotation,
+                                              const cv::Mat &translation) {
+    cv::Mat rotationMatrix;
+    cv::Rodrigues(rotation, rotationMatrix);
+    const double *r = rotationMatrix.ptr<double>();
+    const double *t = translation.ptr<double>();
+    const double *k = problem.cameraMatrix.ptr<double>();
+    std::vector<double> errors(problem.objectPoints.size());
+    for (size_t i = 0; i < problem.objectPoints.size(); i++) {
+        const cv::Point3d &p = problem.objectPoints[i];
+        double x = r[0] * p.x + r[1] * p.y + r[2] * p.z + t[0];
+        double y = r[3] * p.x + r[4] * p.y + r[5] * p.z + t[1];
+        double z = r[6] * p.x + r[7] * p.y + r[8] * p.z + t[2];
+        if (z <= 0) {
+            errors[i] = std::numeric_limits<double>::infinity();
+            continue;
+        }
+        double u = k[0] * x / z + k[1] * y / z + k[2];
+        double v = k[4] * y / z + k[5];
+        errors[i] = std::hypot(u - problem.imagePoints[i].x, v - problem.imagePoints[i].y);
+    }
+    return errors;
+}
+
+static void score(PnPHypothesis &hypothesis, const PnPProblem &problem, double threshold) {
+    hypothesis.errors = reprojectionErrors(problem, hypothesis.rotation,
+                                           hypothesis.translation);
+    hypothesis.score = 0;
+    for (double error : hypothesis.errors) {
+        hypothesis.score += std::min(error * error, threshold * threshold);
+    }
+}
+
+static std::vector<int> inlierIndices(const PnPHypothesis &hypothesis, double threshold) {
+    std::vector<int> indices;
+    for (size_t i = 0; i < hypothesis.errors.size(); i++) {
+        if (hypothesis.errors[i] < threshold) {
+            indices.push_back((int) i);
+        }
+    }
+    return indices;
+}
+
+/*!
+ * \brief solveSubset computes the pose from the given correspondences, with EPnP or with
+ * Levenberg-Marquardt starting at the current pose of the hypothesis.
+ */
+static bool solveSubset(const PnPProblem &problem, const std::vector<int> &indices,
+                        bool refine, PnPHypothesis &hypothesis) {
+    std::vector<cv::Point3d> objectPoints;
+    std::vector<cv::Point2d> imagePoints;
+    for (int index : indices) {
+        objectPoints.push_back(problem.objectPoints[index]);
+        imagePoints.push_back(problem.imagePoints[index]);
+    }
+    cv::Mat rotation = refine ? hypothesis.rotation.clone() : cv::Mat();
+    cv::Mat translation = refine ? hypothesis.translation.clone() : cv::Mat();
+    try {
+        if (!cv::solvePnP(objectPoints, imagePoints, problem.cameraMatrix, cv::noArray(),
+                          rotation, translation, refine,
+                          refine ? cv::SOLVEPNP_ITERATIVE : cv::SOLVEPNP_EPNP)) {
+            return false;
+        }
+    } catch (const cv::Exception &) {
+        // Degenerate samples, e.g. collinear points
+        return false;
+    }
+    // New matrices, copies of hypotheses share the data of their matrices
+    cv::Mat convertedRotation, convertedTranslation;
+    rotation.convertTo(convertedRotation, CV_64F);
+    translation.convertTo(convertedTranslation, CV_64F);
+    hypothesis.rotation = convertedRotation.reshape(1, 3);
+    hypothesis.translation = convertedTranslation.reshape(1, 3);
+    return true;
+}
+
+//! Re-estimates the pose from its inliers as long as that lowers the score
+static void optimizeLocally(PnPHypothesis &best, const PnPProblem &problem, double threshold) {
+    for (int step = 0; step < LOCAL_OPTIMIZATION_STEPS; step++) {
+        std::vector<int> inliers = inlierIndices(best, threshold);
+        if ((int) inliers.size() < PnPSolver::MINIMAL_SAMPLE_SIZE) {
+            return;
+        }
+        PnPHypothesis optimized = best;
+        if (!solveSubset(problem, inliers, true, optimized)) {
+            return;
+        }
+        score(optimized, problem, threshold);
+        if (optimized.score >= best.score) {
+            return;
+        }
+        best = optimized;
+    }
+}
+
+//! Returns the next combination of indices in lexicographic order or false after the last
+static bool nextCombination(std::vector<int> &combination, int n) {
+    int k = (int) combination.size();
+    for (int i = k - 1; i >= 0; i--) {
+        if (combination[i] < n - k + i) {
+            combination[i]++;
+            for (int j = i + 1; j < k; j++) {
+                combination[j] = combination[j - 1] + 1;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+PnPSolver::PnPSolver(float inlierThreshold) :
+    inlierThreshold(inlierThreshold) {
+}
+
+PnPSolution PnPSolver::solve(const QList<QVector3D> &objectPoints,
+                             const QList<QPointF> &imagePoints,
+                             const QMatrix3x3 &cameraMatrix) const {
+    PnPSolution solution;
+    int n = qMin(objectPoints.size(), imagePoints.size());
+    if (n < MINIMAL_SAMPLE_SIZE) {
+        return solution;
+    }
+
+    PnPProblem problem;
+    for (int i = 0; i < n; i++) {
+        problem.objectPoints.push_back(cv::Point3d(objectPoints[i].x(), objectPoints[i].y(),
+                                                   objectPoints[i].z()));
+        problem.imagePoints.push_back(cv::Point2d(imagePoints[i].x(), imagePoints[i].y()));
+    }
+    problem.cameraMatrix = cv::Mat(3, 3, CV_64F);
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            problem.cameraMatrix.at<double>(row, column) = cameraMatrix(row, column);
+        }
+    }
+
+    double threshold = robust ? inlierThreshold : std::numeric_limits<double>::infinity();
+    std::vector<int> all(n);
+    for (int i = 0; i < n; i++) {
+        all[i] = i;
+    }
+    PnPHypothesis best;
+    if (!robust || n == MINIMAL_SAMPLE_SIZE) {
+        // A minimal set has no redundancy to detect outliers with
+        if (solveSubset(problem, all, false, best)) {
+            score(best, problem, threshold);
+        }
+    } else {
+        double numberOfSamples = 1;
+        for (int i = 0; i < MINIMAL_SAMPLE_SIZE; i++) {
+            numberOfSamples = numberOfSamples * (n - i) / (i + 1);
+        }
+        bool exhaustive = numberOfSamples <= maxIterations;
+        std::vector<int> sample(MINIMAL_SAMPLE_SIZE);
+        for (int i = 0; i < MINIMAL_SAMPLE_SIZE; i++) {
+            sample[i] = i;
+        }
+        // Seeded so that the same clicks always give the same pose
+        std::mt19937 generator((unsigned int) n);
+        int requiredIterations = maxIterations;
+        for (int iteration = 0; iteration < requiredIterations; iteration++) {
+            if (!exhaustive) {
+                std::vector<int> indices = all;
+                for (int i = 0; i < MINIMAL_SAMPLE_SIZE; i++) {
+                    std::uniform_int_distribution<int> distribution(i, n - 1);
+                    std::swap(indices[i], indices[distribution(generator)]);
+                }
+                sample.assign(indices.begin(), indices.begin() + MINIMAL_SAMPLE_SIZE);
+            } else if (iteration > 0 && !nextCombination(sample, n)) {
+                break;
+            }
+            PnPHypothesis hypothesis;
+            if (!solveSubset(problem, sample, false, hypothesis)) {
+                continue;
+            }
+            score(hypothesis, problem, threshold);
+            if (hypothesis.score >= best.score) {
+                continue;
+            }
+            best = hypothesis;
+            optimizeLocally(best, problem, threshold);
+            if (!exhaustive) {
+                double inlierRatio = (double) inlierIndices(best, threshold).size() / n;
+                double allInliers = std::pow(inlierRatio, MINIMAL_SAMPLE_SIZE);
+                if (allInliers >= 1.0) {
+                    break;
+                } else if (allInliers > 0) {
+                    double needed = std::log(1 - confidence) / std::log(1 - allInliers);
+                    requiredIterations = (int) qMin((double) maxIterations,
+                                                    std::ceil(needed));
+                }
+            }
+        }
+    }
+    if (best.rotation.empty()) {
+        qDebug() << "Could not compute a pose from the correspondences.";
+        return solution;
+    }
+
+    // Final refinement with Levenberg-Marquardt on the inliers
+    std::vector<int> inliers = inlierIndices(best, threshold);
+    if ((int) inliers.size() >= MINIMAL_SAMPLE_SIZE) {
+        PnPHypothesis refined = best;
+        if (solveSubset(problem, inliers, true, refined)) {
+            score(refined, problem, threshold);
+            if (refined.score <= best.score) {
+                best = refined;
+                inliers = inlierIndices(best, threshold);
+            }
+        }
+    }
+
+    cv::Mat rotationMatrix;
+    cv::Rodrigues(best.rotation, rotationMatrix);
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            solution.rotation(row, column) = (float) rotationMatrix.at<double>(row, column);
+        }
+    }
+    solution.translation = QVector3D((float) best.translation.at<double>(0),
+                                     (float) best.translation.at<double>(1),
+                                     (float) best.translation.at<double>(2));
+    solution.reprojectionErrors.resize(n);
+    solution.inliers.fill(false, n);
+    for (int i = 0; i < n; i++) {
+        solution.reprojectionErrors[i] = (float) best.errors[i];
+    }
+    double squaredErrorSum = 0;
+    for (int index : inliers) {
+        solution.inliers[index] = true;
+        squaredErrorSum += best.errors[index] * best.errors[index];
+    }
+    solution.numberOfInliers = (int) inliers.size();
+    solution.inlierError = inliers.empty() ? 0.f
+                                           : (float) std::sqrt(squaredErrorSum / inliers.size());
+    solution.valid = solution.numberOfInliers >= MINIMAL_SAMPLE_SIZE;
+    return solution;
+}
+
+void PnPSolver::setRobust(bool robust) {
+    this->robust = robust;
+}
+
+bool PnPSolver::isRobust() const {
+    return robust;
+}
+
+void PnPSolver::setInlierThreshold(float inlierThreshold) {
+    this->inlierThreshold = inlierThreshold;
+}
+
+float PnPSolver::getInlierThreshold() const {
+    return inlierThreshold;
+}
+
+void PnPSolver::setMaxIterations(int maxIterations) {
+    this->maxIterations = maxIterations;
+}
+
+int PnPSolver::getMaxIterations() const {
+    return maxIterations;
+}
+
+void PnPSolver::setConfidence(double confidence) {
+    this->confidence = confidence;
+}
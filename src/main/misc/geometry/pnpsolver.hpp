@@ -0,0 +1,81 @@
+#ifndef PNPSOLVER_H
+#define PNPSOLVER_H
+
+#include <QList>
+#include <QMatrix3x3>
+#include <QPointF>
+#include <QVector>
+#include <QVector3D>
+
+//! The pose found by the PnPSolver and how well it explains the correspondences
+struct PnPSolution {
+    bool valid = false;
+    QMatrix3x3 rotation;
+    QVector3D translation;
+    //! Distance in pixels between each image point and its projected object point
+    QVector<float> reprojectionErrors;
+    //! Whether each correspondence was used for the final pose
+    QVector<bool> inliers;
+    int numberOfInliers = 0;
+    //! Root mean square of the reprojection errors of the inliers
+    float inlierError = 0.f;
+    //! Object points seen in several views, only set by the MultiViewPnPSolver
+    int triangulatedPoints = 0;
+};
+
+/*!
+ * \brief The PnPSolver class computes the pose of an object from correspondences between
+ * points on the object model and pixels of the image, i.e. solves the perspective-n-point
+ * problem.
+ *
+ * With robust solving, which is the default, poses are computed from samples of
+ * MINIMAL_SAMPLE_SIZE correspondences with EPnP and scored by the number of correspondences
+ * they project within the inlier threshold (LO-RANSAC). Every new best pose is re-estimated
+ * from all of its inliers, which usually gains further inliers. If there are at most
+ * getMaxIterations() samples, all of them are tried, which is the usual case for clicked
+ * points, otherwise they are drawn randomly until the confidence is reached. The final pose
+ * is refined with Levenberg-Marquardt on the inliers. Without robust solving all
+ * correspondences are inliers.
+ */
+class PnPSolver
+{
+public:
+    static const int MINIMAL_SAMPLE_SIZE = 4;
+
+    /*!
+     * \brief PnPSolver constructor.
+     * \param inlierThreshold the reprojection error in pixels up to which a correspondence
+     * is an inlier
+     */
+    explicit PnPSolver(float inlierThreshold = 8.f);
+
+    /*!
+     * \brief solve computes the pose.
+     * \param objectPoints the points in object model coordinates
+     * \param imagePoints the corresponding pixels, the center of the top left pixel is at 0.5
+     * \param cameraMatrix the intrinsic camera parameters K
+     * \return the solution, invalid if there are less than MINIMAL_SAMPLE_SIZE
+     * correspondences or inliers
+     */
+    PnPSolution solve(const QList<QVector3D> &objectPoints,
+                      const QList<QPointF> &imagePoints,
+                      const QMatrix3x3 &cameraMatrix) const;
+
+    void setRobust(bool robust);
+    bool isRobust() const;
+    void setInlierThreshold(float inlierThreshold);
+    float getInlierThreshold() const;
+    //! The maximum number of samples, defaults to 1000
+    void setMaxIterations(int maxIterations);
+    int getMaxIterations() const;
+    //! The probability of drawing at least one sample without outliers, defaults to 0.999
+    void setConfidence(double confidence);
+
+private:
+    bool robust = true;
+    float inlierThreshold;
+    int maxIterations = 1000;
+    double confidence = 0.999;
+};
+
+#endif // PNPSOLVER_H
@@ -0,0 +1,491 @@
+#include "poserefiner.hpp"
+#include "misc/generalhelper.h"
+#include "misc/imageloading/imagesource.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <QImage>
+#include <QMutexLocker>
+#include <QQuaternion>
+#include <QRect>
+#include <QThread>
+#include <QtDebug>
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define POSE_REFINER_SSE2
+#include <emmintrin.h>
+#endif
+
+//! Displacement of the outline in pixels of the current level that every level starts with
+static const float INITIAL_STEP = 4.f;
+static const float MIN_STEP = 0.5f;
+//! Relative decrease of the error below which a step does not count as better
+static const float MIN_IMPROVEMENT = 1e-4f;
+//! Silhouettes with less pixels on a level are too coarse to be aligned there
+static const int MIN_SILHOUETTE_PIXELS = 64;
+//! Levels are not made smaller than this
+static const int MIN_LEVEL_SIZE = 32;
+
+//! The edges of an image on every level of the pyramid, level 0 is the full resolution
+struct RefinementTarget {
+    //! Distance to the closest edge in pixels of the level, truncated
+    QVector<cv::Mat> distances;
+    //! The camera matrices of the levels
+    QVector<QMatrix3x3> cameraMatrices;
+    float maxDistance;
+
+    QRect levelRect(int level) const {
+        return QRect(0, 0, distances[level].cols, distances[level].rows);
+    }
+};
+
+//! A pose that is compared with the image
+struct RefinementCandidate {
+    QMatrix3x3 rotation;
+    QVector3D position;
+    //! The area that is rendered in pixels of the level, the silhouette has to be inside
+    QRect crop;
+    float error = 0.f;
+    //! Bounding box of the silhouette in pixels of the level
+    QRect silhouette;
+    int silhouettePixels = 0;
+};
+
+/*!
+ * \brief sumOutline sums the distances at the outline pixels of a row, i.e. at the pixels of
+ * the silhouette with a horizontal or vertical neighbour outside of it. The first and the
+ * last pixel of the row are skipped, the area outside of the rendered crop is unknown.
+ */
+static void sumOutline(const quint8 *above, const quint8 *row, const quint8 *below,
+                       const float *distances, int width, double &sum, int &count) {
+    int x = 1;
+#ifdef POSE_REFINER_SSE2
+    // Outline pixels are rare, sixteen pixels are tested at once and only the outline
+    // pixels among them are summed up
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 < width; x += 16) {
+        __m128i outside = _mm_or_si128(
+                    _mm_or_si128(
+                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (row + x - 1)), zero),
+                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (row + x + 1)), zero)),
+                    _mm_or_si128(
+                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (above + x)), zero),
+                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (below + x)), zero)));
+        __m128i empty = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (row + x)), zero);
+        int mask = _mm_movemask_epi8(_mm_andnot_si128(empty, outside));
+        for (int i = 0; mask != 0; i++, mask >>= 1) {
+            if (mask & 1) {
+                sum += distances[x + i];
+                count++;
+            }
+        }
+    }
+#endif
+    for (; x + 1 < width; x++) {
+        if (row[x] && (!row[x - 1] || !row[x + 1] || !above[x] || !below[x])) {
+            sum += distances[x];
+            count++;
+        }
+    }
+}
+
+static void evaluateCandidate(RefinementCandidate &candidate, CpuRasterizer &rasterizer,
+                              const MeshPtr &mesh, const RefinementTarget &target, int level) {
+    const QRect &crop = candidate.crop;
+    // Moving the principal point renders the crop only
+    QMatrix3x3 cameraMatrix = target.cameraMatrices[level];
+    cameraMatrix(0, 2) -= crop.x();
+    cameraMatrix(1, 2) -= crop.y();
+    RasterInstance instance;
+    instance.mesh = mesh;
+    instance.rotation = candidate.rotation;
+    instance.position = candidate.position;
+    RasterBuffers buffers = rasterizer.rasterize(cameraMatrix, crop.size(),
+                                                 QList<RasterInstance>() << instance);
+
+    candidate.silhouettePixels = buffers.silhouettePixels.value(0);
+    candidate.silhouette = QRect();
+    candidate.error = target.maxDistance;
+    if (candidate.silhouettePixels == 0) {
+        return;
+    }
+
+    const int width = crop.width();
+    const int height = crop.height();
+    const quint8 *coverage = buffers.coverage.constData();
+    const cv::Mat &distance = target.distances[level];
+    double sum = 0;
+    int count = 0;
+    int minX = width, minY = height, maxX = -1, maxY = -1;
+    for (int y = 0; y < height; y++) {
+        const quint8 *row = coverage + y * width;
+        const quint8 *first = std::find_if(row, row + width, [](quint8 c) { return c != 0; });
+        if (first == row + width) {
+            continue;
+        }
+        const quint8 *last = std::find_if(std::reverse_iterator<const quint8 *>(row + width),
+                                          std::reverse_iterator<const quint8 *>(row),
+                                          [](quint8 c) { return c != 0; }).base() - 1;
+        minX = std::min(minX, (int) (first - row));
+        maxX = std::max(maxX, (int) (last - row));
+        minY = std::min(minY, y);
+        maxY = y;
+        if (y > 0 && y + 1 < height) {
+            sumOutline(row - width, row, row + width,
+                       distance.ptr<float>(crop.y() + y) + crop.x(), width, sum, count);
+        }
+    }
+    candidate.silhouette = QRect(QPoint(minX, minY), QPoint(maxX, maxY))
+            .translated(crop.topLeft());
+    if (count > 0) {
+        candidate.error = (float) (sum / count);
+    }
+}
+
+/*!
+ * \brief The CandidateEvaluationRunnable class renders every stride-th candidate starting at
+ * the first one and computes its error.
+ */
+class CandidateEvaluationRunnable : public QRunnable {
+public:
+    CandidateEvaluationRunnable(RefinementCandidate *candidates, int count, int first,
+                                int stride, CpuRasterizer *rasterizer, const MeshPtr &mesh,
+                                const RefinementTarget *target, int level) :
+        candidates(candidates),
+        count(count),
+        first(first),
+        stride(stride),
+        rasterizer(rasterizer),
+        mesh(mesh),
+        target(target),
+        level(level) {
+    }
+
+    void run() override {
+        for (int i = first; i < count; i += stride) {
+            evaluateCandidate(candidates[i], *rasterizer, mesh, *target, level);
+        }
+    }
+
+private:
+    RefinementCandidate *candidates;
+    int count;
+    int first;
+    int stride;
+    CpuRasterizer *rasterizer;
+    MeshPtr mesh;
+    const RefinementTarget *target;
+    int level;
+};
+
+//! Pixels of the mask with a neighbour outside of it
+static cv::Mat outline(const cv::Mat &mask) {
+    cv::Mat eroded;
+    // Pixels outside of the image count as inside, the image border is no edge
+    cv::erode(mask, eroded, cv::Mat());
+    return mask & ~eroded;
+}
+
+static cv::Mat cannyEdges(const cv::Mat &gray) {
+    cv::Mat blurred;
+    cv::GaussianBlur(gray, blurred, cv::Size(5, 5), 1.4);
+    // Thresholds relative to the median brightness adapt to the exposure of the image
+    int histogram[256] = {0};
+    for (int y = 0; y < blurred.rows; y++) {
+        const uchar *row = blurred.ptr<uchar>(y);
+        for (int x = 0; x < blurred.cols; x++) {
+            histogram[row[x]]++;
+        }
+    }
+    int median = 0;
+    for (int pixels = 0; median < 255; median++) {
+        pixels += histogram[median];
+        if (pixels * 2 >= blurred.rows * blurred.cols) {
+            break;
+        }
+    }
+    double lower = std::max(10.0, 0.66 * median);
+    double upper = std::min(255.0, std::max(2 * lower, 1.33 * median));
+    cv::Mat edges;
+    cv::Canny(blurred, edges, lower, upper);
+    return edges;
+}
+
+PoseRefiner::PoseRefiner(int threadCount) {
+    int threads = threadCount > 0 ? threadCount : QThread::idealThreadCount();
+    threadPool.setMaxThreadCount(threads);
+    for (int i = 0; i < threads; i++) {
+        rasterizers << QSharedPointer<CpuRasterizer>(new CpuRasterizer(1));
+    }
+}
+
+PoseRefinement PoseRefiner::refine(const Pose &pose) {
+    return refine(QList<Pose>() << pose).first();
+}
+
+QList<PoseRefinement> PoseRefiner::refine(const QList<Pose> &poses) {
+    QMap<QString, QString> segmentationCodes;
+    {
+        QMutexLocker codesLocker(&segmentationCodesMutex);
+        segmentationCodes = this->segmentationCodes;
+    }
+    QMutexLocker locker(&mutex);
+    QList<PoseRefinement> refinements;
+    QMap<QString, QSharedPointer<RefinementTarget>> targets;
+    for (const Pose &pose : poses) {
+        QString segmentationCode = segmentationCodes.value(pose.getObjectModel()->getPath());
+        QString key = pose.getImage()->getAbsoluteImagePath() + "|" + segmentationCode;
+        if (!targets.contains(key)) {
+            targets[key] = createTarget(*pose.getImage(), segmentationCode);
+        }
+        QSharedPointer<RefinementTarget> target = targets[key];
+        if (target.isNull()) {
+            qWarning() << "Could not read the image " + pose.getImage()->getAbsoluteImagePath()
+                          + " to refine pose " + pose.getID() + ".";
+            PoseRefinement refinement;
+            refinement.rotation = pose.getRotation();
+            refinement.position = pose.getPosition();
+            refinements << refinement;
+            continue;
+        }
+        refinements << refine(pose, *target);
+    }
+    return refinements;
+}
+
+QSharedPointer<RefinementTarget> PoseRefiner::createTarget(
+        const Image &image, const QString &segmentationCode) const {
+    cv::Mat level;
+    bool segmented = false;
+    if (!image.getSegmentationImagePath().isEmpty()) {
+        QImage segmentation = ImageSource::readImage(image.getAbsoluteSegmentationImagePath())
+                .convertToFormat(QImage::Format_RGB32);
+        if (!segmentation.isNull()) {
+            segmented = true;
+            QRgb color = segmentationCode.isEmpty()
+                    ? 0 : GeneralHelper::colorFromSegmentationCode(segmentationCode).rgb();
+            level = cv::Mat(segmentation.height(), segmentation.width(), CV_8U);
+            for (int y = 0; y < segmentation.height(); y++) {
+                const QRgb *line = (const QRgb *) segmentation.constScanLine(y);
+                uchar *mask = level.ptr<uchar>(y);
+                for (int x = 0; x < segmentation.width(); x++) {
+                    bool inside = segmentationCode.isEmpty()
+                            ? line[x] != qRgb(0, 0, 0) && line[x] != qRgb(255, 255, 255)
+                            : line[x] == color;
+                    mask[x] = inside ? 255 : 0;
+                }
+            }
+        }
+    }
+    if (!segmented) {
+        QImage gray = ImageSource::readImage(image.getAbsoluteImagePath())
+                .convertToFormat(QImage::Format_Grayscale8);
+        if (gray.isNull()) {
+            return QSharedPointer<RefinementTarget>();
+        }
+        level = cv::Mat(gray.height(), gray.width(), CV_8U, gray.bits(),
+                        gray.bytesPerLine()).clone();
+    }
+
+    // The segmentation image does not need to have the resolution of the image
+    QSize imageSize = image.getSize();
+    if (imageSize.isEmpty()) {
+        imageSize = QSize(level.cols, level.rows);
+    }
+    QSharedPointer<RefinementTarget> target(new RefinementTarget);
+    target->maxDistance = maxEdgeDistance;
+    for (int i = 0; i < pyramidLevels; i++) {
+        if (i > 0) {
+            if (level.cols < 2 * MIN_LEVEL_SIZE || level.rows < 2 * MIN_LEVEL_SIZE) {
+                break;
+            }
+            cv::Mat smaller;
+            if (segmented) {
+                cv::resize(level, smaller, cv::Size((level.cols + 1) / 2, (level.rows + 1) / 2),
+                           0, 0, cv::INTER_NEAREST);
+            } else {
+                cv::pyrDown(level, smaller);
+            }
+            level = smaller;
+        }
+        cv::Mat edges = segmented ? outline(level) : cannyEdges(level);
+        cv::Mat distance;
+        cv::distanceTransform(edges == 0, distance, cv::DIST_L2, cv::DIST_MASK_PRECISE);
+        cv::min(distance, maxEdgeDistance, distance);
+        target->distances << distance;
+
+        // Scaling the image scales the pixel coordinates, whose origin is the top left corner
+        QMatrix3x3 cameraMatrix = image.getCameraMatrix();
+        float scaleX = (float) level.cols / imageSize.width();
+        float scaleY = (float) level.rows / imageSize.height();
+        for (int column = 0; column < 3; column++) {
+            cameraMatrix(0, column) *= scaleX;
+            cameraMatrix(1, column) *= scaleY;
+        }
+        target->cameraMatrices << cameraMatrix;
+    }
+    return target;
+}
+
+void PoseRefiner::evaluate(QVector<RefinementCandidate> &candidates, const MeshPtr &mesh,
+                           const RefinementTarget &target, int level) {
+    // Detach before the runnables write to the candidates
+    RefinementCandidate *data = candidates.data();
+    int workers = std::min(rasterizers.size(), candidates.size());
+    for (int i = 0; i < workers; i++) {
+        threadPool.start(new CandidateEvaluationRunnable(data, candidates.size(), i, workers,
+                                                         rasterizers[i].data(), mesh,
+                                                         &target, level));
+    }
+    threadPool.waitForDone();
+}
+
+PoseRefinement PoseRefiner::refine(const Pose &pose, const RefinementTarget &target) {
+    PoseRefinement refinement;
+    refinement.rotation = pose.getRotation();
+    refinement.position = pose.getPosition();
+    MeshPtr mesh = meshCache.get(pose.getObjectModel()->getAbsolutePath());
+    if (mesh.isNull()) {
+        qWarning() << "Could not load the object model "
+                      + pose.getObjectModel()->getAbsolutePath() + " to refine its pose.";
+        return refinement;
+    }
+
+    RefinementCandidate best;
+    best.rotation = pose.getRotation();
+    best.position = pose.getPosition();
+    best.crop = target.levelRect(0);
+    QVector<RefinementCandidate> candidates = {best};
+    evaluate(candidates, mesh, target, 0);
+    refinement.evaluations++;
+    if (candidates[0].silhouettePixels == 0) {
+        qWarning() << "Pose " + pose.getID() + " is not visible in its image, it can't be "
+                      "refined.";
+        return refinement;
+    }
+    refinement.valid = true;
+    refinement.initialError = candidates[0].error;
+
+    for (int level = target.distances.size() - 1; level >= 0; level--) {
+        QRect levelRect = target.levelRect(level);
+        best.crop = levelRect;
+        candidates = {best};
+        evaluate(candidates, mesh, target, level);
+        refinement.evaluations++;
+        best = candidates[0];
+        if (best.silhouettePixels < MIN_SILHOUETTE_PIXELS) {
+            continue;
+        }
+
+        const QMatrix3x3 &cameraMatrix = target.cameraMatrices[level];
+        float focalLength = 0.5f * (cameraMatrix(0, 0) + cameraMatrix(1, 1));
+        float step = INITIAL_STEP;
+        for (int iteration = 0; iteration < maxIterations && step >= MIN_STEP; iteration++) {
+            // The steps are chosen so that they move the outline by about step pixels:
+            // sideways by step pixels, scaled or turned by step pixels at the border
+            float depth = std::max(best.position.z(), 1e-3f);
+            float radius = std::max((float) std::sqrt(best.silhouettePixels / M_PI), 1.f);
+            float sideways = step * depth / focalLength;
+            float forward = step * depth / radius;
+            float angle = qRadiansToDegrees(step / radius);
+            int margin = (int) std::ceil(2 * INITIAL_STEP)
+                    + std::max(best.silhouette.width(), best.silhouette.height()) / 8;
+            QRect crop = best.silhouette.adjusted(-margin, -margin, margin, margin) & levelRect;
+
+            candidates.clear();
+            for (int axis = 0; axis < 3; axis++) {
+                for (int sign = -1; sign <= 1; sign += 2) {
+                    QVector3D direction;
+                    direction[axis] = sign;
+                    RefinementCandidate moved = best;
+                    moved.crop = crop;
+                    moved.position += direction * (axis < 2 ? sideways : forward);
+                    candidates << moved;
+                    // Turns around the origin of the object model about the camera axes
+                    RefinementCandidate turned = best;
+                    turned.crop = crop;
+                    turned.rotation = QQuaternion::fromAxisAndAngle(direction, angle)
+                            .toRotationMatrix() * best.rotation;
+                    candidates << turned;
+                }
+            }
+            evaluate(candidates, mesh, target, level);
+            refinement.evaluations += candidates.size();
+
+            const RefinementCandidate *bestCandidate = &candidates[0];
+            for (const RefinementCandidate &candidate : candidates) {
+                if (candidate.error < bestCandidate->error) {
+                    bestCandidate = &candidate;
+                }
+            }
+            if (bestCandidate->silhouettePixels >= MIN_SILHOUETTE_PIXELS
+                    && bestCandidate->error < best.error * (1 - MIN_IMPROVEMENT)) {
+                best = *bestCandidate;
+            } else {
+                step *= 0.5f;
+            }
+        }
+    }
+
+    // On the full image, the last crop might have cut off parts of the silhouette
+    best.crop = target.levelRect(0);
+    candidates = {best};
+    evaluate(candidates, mesh, target, 0);
+    refinement.evaluations++;
+    refinement.finalError = refinement.initialError;
+    if (candidates[0].silhouettePixels > 0 && candidates[0].error < refinement.initialError) {
+        refinement.rotation = best.rotation;
+        refinement.position = best.position;
+        refinement.finalError = candidates[0].error;
+    }
+    qDebug() << "Refined pose " + pose.getID() + " with "
+                + QString::number(refinement.evaluations) + " renderings, error "
+                + QString::number(refinement.initialError) + " px -> "
+                + QString::number(refinement.finalError) + " px.";
+    return refinement;
+}
+
+void PoseRefiner::setSegmentationCodes(const QMap<QString, QString> &codes) {
+    QMutexLocker locker(&segmentationCodesMutex);
+    segmentationCodes = codes;
+}
+
+void PoseRefiner::setPyramidLevels(int levels) {
+    pyramidLevels = std::max(levels, 1);
+}
+
+void PoseRefiner::setMaxIterations(int iterations) {
+    maxIterations = iterations;
+}
+
+void PoseRefiner::setMaxEdgeDistance(float distance) {
+    maxEdgeDistance = distance;
+}
+
+float PoseRefiner::getMaxEdgeDistance() const {
+    return maxEdgeDistance;
+}
+
+MeshCache &PoseRefiner::getMeshCache() {
+    return meshCache;
+}
+
+PoseRefinementRunnable::PoseRefinementRunnable(PoseRefiner *poseRefiner, const Pose &pose) :
+    poseRefiner(poseRefiner),
+    image(*pose.getImage()),
+    objectModel(*pose.getObjectModel()),
+    poseId(pose.getID()),
+    position(pose.getPosition()),
+    rotation(pose.getRotation()) {
+}
+
+void PoseRefinementRunnable::run() {
+    Pose pose(poseId, position, rotation, &image, &objectModel);
+    Q_EMIT poseRefined(poseId, poseRefiner->refine(pose));
+}
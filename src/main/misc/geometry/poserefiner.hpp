@@ -0,0 +1,141 @@
+#ifndef POSEREFINER_H
+#define POSEREFINER_H
+
+#include "misc/geometry/cpurasterizer.hpp"
+#include "misc/geometry/mesh.hpp"
+#include "model/image.hpp"
+#include "model/objectmodel.hpp"
+#include "model/pose.hpp"
+
+#include <QList>
+#include <QMap>
+#include <QMatrix3x3>
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+#include <QVector3D>
+#include <QVector>
+
+//! The result of refining a pose with the PoseRefiner
+struct PoseRefinement {
+    //! False if the image could not be read or the object is not visible in it
+    bool valid = false;
+    QMatrix3x3 rotation;
+    QVector3D position;
+    //! Mean distance in pixels of the silhouette outline to the closest edge in the image,
+    //! before and after the refinement
+    float initialError = 0.f;
+    float finalError = 0.f;
+    //! Number of rendered poses
+    int evaluations = 0;
+};
+
+Q_DECLARE_METATYPE(PoseRefinement)
+
+struct RefinementTarget;
+struct RefinementCandidate;
+
+/*!
+ * \brief The PoseRefiner class aligns a rough pose, e.g. one created from clicked points,
+ * with the image by rendering the object model and comparing the outline of its silhouette
+ * with the edges in the image.
+ *
+ * The edges are the Canny edges of the image or, if the image has a segmentation image, the
+ * outline of the segmentation of the object model. The color of the segmentation is looked up
+ * in the segmentation codes, without a code all pixels that are neither black nor white are
+ * taken to be objects. The error of a pose is the mean distance of its silhouette outline to
+ * the closest edge, read from a distance transform and truncated at getMaxEdgeDistance().
+ *
+ * The pose is optimized from coarse to fine on an image pyramid. On every level the six
+ * degrees of freedom are moved by a step that displaces the outline by a few pixels, in both
+ * directions, and the best of the twelve poses is taken. If none is better the step is halved
+ * until it is below half a pixel. The twelve poses are rendered in parallel with the
+ * CpuRasterizer, cropped to the area around the silhouette. Other objects in the image are not
+ * rendered, i.e. do not occlude the object. If the refined pose is not better than the given
+ * one on the full resolution, the given pose is returned.
+ */
+class PoseRefiner
+{
+public:
+    //! \param threadCount the number of poses that are rendered at once, 0 uses one per core
+    explicit PoseRefiner(int threadCount = 0);
+
+    /*!
+     * \brief refine refines a single pose, the image and object model of the pose are read
+     * from disk.
+     */
+    PoseRefinement refine(const Pose &pose);
+
+    /*!
+     * \brief refine refines the poses one after the other, the edges of every image are
+     * computed only once for all the poses in it.
+     * \return the refinements in the order of the poses
+     */
+    QList<PoseRefinement> refine(const QList<Pose> &poses);
+
+    /*!
+     * \brief setSegmentationCodes sets the segmentation colors of the object models as stored
+     * in the settings, i.e. the paths of the object models mapped to codes like 255,0,0.
+     */
+    void setSegmentationCodes(const QMap<QString, QString> &codes);
+    //! The number of levels of the image pyramid, defaults to 3
+    void setPyramidLevels(int levels);
+    //! The maximum number of steps per level, defaults to 100
+    void setMaxIterations(int iterations);
+    //! The distance in pixels of each pyramid level at which edges are not attracting
+    //! anymore, defaults to 20
+    void setMaxEdgeDistance(float distance);
+    float getMaxEdgeDistance() const;
+    MeshCache &getMeshCache();
+
+private:
+    QThreadPool threadPool;
+    //! One per thread, rasterizing a single pose is not worth splitting up
+    QVector<QSharedPointer<CpuRasterizer>> rasterizers;
+    MeshCache meshCache;
+    QMap<QString, QString> segmentationCodes;
+    int pyramidLevels = 3;
+    int maxIterations = 100;
+    float maxEdgeDistance = 20.f;
+    // Refinements share the thread pool and rasterizers
+    QMutex mutex;
+    // Only guards the segmentation codes, so that setting them doesn't wait for a refinement
+    QMutex segmentationCodesMutex;
+
+    QSharedPointer<RefinementTarget> createTarget(const Image &image,
+                                                  const QString &segmentationCode) const;
+    PoseRefinement refine(const Pose &pose, const RefinementTarget &target);
+    void evaluate(QVector<RefinementCandidate> &candidates, const MeshPtr &mesh,
+                  const RefinementTarget &target, int level);
+};
+
+/*!
+ * \brief The PoseRefinementRunnable class refines a pose in the background and reports
+ * the result through poseRefined.
+ */
+class PoseRefinementRunnable : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    PoseRefinementRunnable(PoseRefiner *poseRefiner, const Pose &pose);
+    void run() override;
+
+Q_SIGNALS:
+    void poseRefined(const QString &poseId, PoseRefinement refinement);
+
+private:
+    PoseRefiner *poseRefiner;
+    // Copies, the model manager might reload its images and object models in the meantime
+    Image image;
+    ObjectModel objectModel;
+    QString poseId;
+    QVector3D position;
+    QMatrix3x3 rotation;
+};
+
+#endif // POSEREFINER_H
@@ -0,0 +1,505 @@
+#include "archiveimagesource.hpp"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <QtDebug>
+
+#include <string.h>
+#include <zlib.h>
+
+//! Identifies the index files, followed by the version
+static const quint32 INDEX_FILE_MAGIC = 0x36504958;
+static const quint32 INDEX_FILE_VERSION = 1;
+
+static const int TAR_BLOCK_SIZE = 512;
+
+static const quint32 ZIP_LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static const quint32 ZIP_DIRECTORY_HEADER_SIGNATURE = 0x02014b50;
+static const quint32 ZIP_END_SIGNATURE = 0x06054b50;
+static const quint32 ZIP64_END_SIGNATURE = 0x06064b50;
+static const quint32 ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+static const int ZIP_LOCAL_HEADER_SIZE = 30;
+static const int ZIP_DIRECTORY_HEADER_SIZE = 46;
+static const int ZIP_END_SIZE = 22;
+static const int ZIP64_END_SIZE = 56;
+static const int ZIP64_LOCATOR_SIZE = 20;
+
+static quint16 readLE16(const QByteArray &data, int offset) {
+    return qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(data.constData() + offset));
+}
+
+static quint32 readLE32(const QByteArray &data, int offset) {
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(data.constData() + offset));
+}
+
+static quint64 readLE64(const QByteArray &data, int offset) {
+    return qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(data.constData() + offset));
+}
+
+//! Reads a string field of a tar header, which is terminated by NUL unless it fills the field
+static QString tarString(const QByteArray &header, int offset, int length) {
+    const char *field = header.constData() + offset;
+    return QString::fromUtf8(field, (int) qstrnlen(field, length));
+}
+
+//! Reads a numeric field of a tar header, octal or base-256 for large values (GNU tar)
+static qint64 tarNumber(const QByteArray &header, int offset, int length) {
+    const uchar *field = reinterpret_cast<const uchar *>(header.constData() + offset);
+    qint64 value = 0;
+    if (field[0] & 0x80) {
+        value = field[0] & 0x7f;
+        for (int i = 1; i < length; i++) {
+            value = (value << 8) | field[i];
+        }
+        return value;
+    }
+    int i = 0;
+    while (i < length && field[i] == ' ') {
+        i++;
+    }
+    for (; i < length && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+static bool tarChecksumValid(const QByteArray &header) {
+    // The checksum is computed with the checksum field filled with spaces
+    qint64 unsignedSum = 0;
+    qint64 signedSum = 0;
+    for (int i = 0; i < TAR_BLOCK_SIZE; i++) {
+        bool inChecksum = i >= 148 && i < 156;
+        unsignedSum += inChecksum ? ' ' : (uchar) header[i];
+        signedSum += inChecksum ? ' ' : (signed char) header[i];
+    }
+    qint64 checksum = tarNumber(header, 148, 8);
+    // Some old implementations sum signed bytes
+    return checksum == unsignedSum || checksum == signedSum;
+}
+
+//! Returns the value of the key in the records of a pax extended header
+static QByteArray paxValue(const QByteArray &records, const QByteArray &key) {
+    int position = 0;
+    while (position < records.size()) {
+        int space = records.indexOf(' ', position);
+        if (space < 0) {
+            break;
+        }
+        // Each record is "<length> <key>=<value>\n", the length includes itself
+        int length = records.mid(position, space - position).toInt();
+        if (length <= 0) {
+            break;
+        }
+        QByteArray record = records.mid(space + 1, position + length - space - 2);
+        int equals = record.indexOf('=');
+        if (equals > 0 && record.left(equals) == key) {
+            return record.mid(equals + 1);
+        }
+        position += length;
+    }
+    return QByteArray();
+}
+
+//! Inflates the raw deflate stream of a zip member
+static QByteArray inflateMember(const QByteArray &compressed, qint64 size) {
+    QByteArray data((int) size, Qt::Uninitialized);
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // Negative window bits, zip members have no zlib header
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return QByteArray();
+    }
+    stream.next_in = (Bytef *) compressed.constData();
+    stream.avail_in = (uInt) compressed.size();
+    stream.next_out = (Bytef *) data.data();
+    stream.avail_out = (uInt) data.size();
+    int result = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END || (qint64) stream.total_out != size) {
+        return QByteArray();
+    }
+    return data;
+}
+
+ArchiveImageSource::ArchiveImageSource(const QString &path, const QString &indexCachePath) :
+    ImageSource(path),
+    indexCachePath(indexCachePath),
+    archive(path) {
+    if (!archive.open(QFile::ReadOnly)) {
+        qWarning() << "Could not open archive " + path + ": " + archive.errorString();
+        return;
+    }
+    if (readIndex()) {
+        valid = true;
+        return;
+    }
+    valid = path.endsWith(".zip", Qt::CaseInsensitive) ? indexZip() : indexTar();
+    if (valid) {
+        writeIndex();
+    }
+}
+
+bool ArchiveImageSource::isValid() const {
+    return valid;
+}
+
+QStringList ArchiveImageSource::getFiles() {
+    return files;
+}
+
+QByteArray ArchiveImageSource::readFile(const QString &file) {
+    Member member;
+    QByteArray data;
+    {
+        QMutexLocker locker(&mutex);
+        int index = memberIndices.value(file, -1);
+        if (index < 0 || !resolveDataOffset(members[index])) {
+            return QByteArray();
+        }
+        member = members[index];
+        data = readRange(member.offset, member.storedSize);
+    }
+    // Inflating doesn't need the file, other threads can read meanwhile
+    if (data.isNull() || member.compression == Stored) {
+        return data;
+    }
+    QByteArray inflated = inflateMember(data, member.size);
+    if (inflated.isNull()) {
+        qDebug() << "Could not inflate " + file + " in " + path;
+    }
+    return inflated;
+}
+
+QString ArchiveImageSource::defaultIndexCachePath() {
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+            .filePath("archive-indices");
+}
+
+QString ArchiveImageSource::indexFilePath() const {
+    QByteArray key = QCryptographicHash::hash(QFileInfo(path).absoluteFilePath().toUtf8(),
+                                              QCryptographicHash::Sha1).toHex();
+    return QDir(indexCachePath).filePath(key + ".index");
+}
+
+bool ArchiveImageSource::readIndex() {
+    if (indexCachePath.isEmpty()) {
+        return false;
+    }
+    QFile file(indexFilePath());
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (magic != INDEX_FILE_MAGIC || version != INDEX_FILE_VERSION) {
+        return false;
+    }
+    // A changed archive has to be indexed again
+    QString archivePath;
+    qint64 archiveSize, lastModified;
+    stream >> archivePath >> archiveSize >> lastModified;
+    QFileInfo info(path);
+    if (archivePath != info.absoluteFilePath() || archiveSize != info.size()
+            || lastModified != info.lastModified().toMSecsSinceEpoch()) {
+        return false;
+    }
+    quint32 count;
+    stream >> count;
+    files.reserve(count);
+    members.reserve(count);
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QString name;
+        Member member;
+        stream >> name >> member.offset >> member.storedSize >> member.size
+               >> member.compression >> member.dataOffsetKnown;
+        addMember(name, member);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        files.clear();
+        members.clear();
+        memberIndices.clear();
+        return false;
+    }
+    return true;
+}
+
+void ArchiveImageSource::writeIndex() const {
+    if (indexCachePath.isEmpty() || !QDir().mkpath(indexCachePath)) {
+        return;
+    }
+    QSaveFile file(indexFilePath());
+    if (!file.open(QFile::WriteOnly)) {
+        return;
+    }
+    QDataStream stream(&file);
+    QFileInfo info(path);
+    stream << INDEX_FILE_MAGIC << INDEX_FILE_VERSION
+           << info.absoluteFilePath() << info.size()
+           << info.lastModified().toMSecsSinceEpoch()
+           << (quint32) members.size();
+    for (int i = 0; i < members.size(); i++) {
+        const Member &member = members[i];
+        stream << files[i] << member.offset << member.storedSize << member.size
+               << member.compression << member.dataOffsetKnown;
+    }
+    if (!file.commit()) {
+        qDebug() << "Could not store the index of " + path;
+    }
+}
+
+void ArchiveImageSource::addMember(const QString &name, const Member &member) {
+    QString file = name.startsWith("./") ? name.mid(2) : name;
+    if (file.isEmpty() || file.endsWith('/')) {
+        return;
+    }
+    // Tar files can contain a file multiple times, the last one is the current one
+    int index = memberIndices.value(file, -1);
+    if (index >= 0) {
+        members[index] = member;
+        return;
+    }
+    memberIndices[file] = members.size();
+    files << file;
+    members << member;
+}
+
+bool ArchiveImageSource::indexTar() {
+    qint64 position = 0;
+    // Set by the GNU long name and pax headers for the header that follows them
+    QString nextName;
+    qint64 nextSize = -1;
+    while (position + TAR_BLOCK_SIZE <= archive.size()) {
+        archive.seek(position);
+        QByteArray header = archive.read(TAR_BLOCK_SIZE);
+        if (header.size() != TAR_BLOCK_SIZE || header.count('\0') == TAR_BLOCK_SIZE) {
+            break;
+        }
+        if (!tarChecksumValid(header)) {
+            if (members.isEmpty()) {
+                qWarning() << path + " is not a tar file.";
+                return false;
+            }
+            qWarning() << "Stopped indexing " + path + " at an invalid header.";
+            break;
+        }
+        qint64 size = nextSize >= 0 ? nextSize : tarNumber(header, 124, 12);
+        char type = header[156];
+        qint64 dataOffset = position + TAR_BLOCK_SIZE;
+        if (type == 'L' || type == 'x') {
+            archive.seek(dataOffset);
+            QByteArray data = archive.read(size);
+            if (type == 'L') {
+                nextName = QString::fromUtf8(data.constData(), (int) qstrnlen(data.constData(),
+                                                                            data.size()));
+            } else {
+                QByteArray paxPath = paxValue(data, "path");
+                if (!paxPath.isEmpty()) {
+                    nextName = QString::fromUtf8(paxPath);
+                }
+                QByteArray paxSize = paxValue(data, "size");
+                if (!paxSize.isEmpty()) {
+                    nextSize = paxSize.toLongLong();
+                }
+            }
+        } else {
+            QString name = nextName;
+            if (name.isEmpty()) {
+                name = tarString(header, 0, 100);
+                QString prefix = tarString(header, 345, 155);
+                if (header.mid(257, 5) == "ustar" && !prefix.isEmpty()) {
+                    name = prefix + "/" + name;
+                }
+            }
+            // Regular files, everything else like folders and links is skipped
+            if (type == '0' || type == '\0' || type == '7') {
+                Member member;
+                member.offset = dataOffset;
+                member.storedSize = size;
+                member.size = size;
+                member.compression = Stored;
+                member.dataOffsetKnown = true;
+                addMember(name, member);
+            }
+            nextName.clear();
+            nextSize = -1;
+        }
+        position = dataOffset + (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+    }
+    return true;
+}
+
+bool ArchiveImageSource::indexZip() {
+    qint64 archiveSize = archive.size();
+    // The end of central directory record is followed by a comment of at most 64 KiB
+    qint64 tailSize = qMin(archiveSize, (qint64) ZIP_END_SIZE + 65535);
+    qint64 tailOffset = archiveSize - tailSize;
+    archive.seek(tailOffset);
+    QByteArray tail = archive.read(tailSize);
+    int end = -1;
+    for (int i = tail.size() - ZIP_END_SIZE; i >= 0; i--) {
+        if (readLE32(tail, i) == ZIP_END_SIGNATURE) {
+            end = i;
+            break;
+        }
+    }
+    if (end < 0) {
+        qWarning() << path + " is not a zip file.";
+        return false;
+    }
+    quint64 count = readLE16(tail, end + 10);
+    quint64 directorySize = readLE32(tail, end + 12);
+    quint64 directoryOffset = readLE32(tail, end + 16);
+    if (count == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) {
+        // Zip64, the locator of the zip64 record precedes the end of central directory record
+        archive.seek(tailOffset + end - ZIP64_LOCATOR_SIZE);
+        QByteArray locator = archive.read(ZIP64_LOCATOR_SIZE);
+        QByteArray end64;
+        if (locator.size() == ZIP64_LOCATOR_SIZE
+                && readLE32(locator, 0) == ZIP64_LOCATOR_SIGNATURE) {
+            archive.seek((qint64) readLE64(locator, 8));
+            end64 = archive.read(ZIP64_END_SIZE);
+        }
+        if (end64.size() != ZIP64_END_SIZE || readLE32(end64, 0) != ZIP64_END_SIGNATURE) {
+            qWarning() << "Could not find the zip64 directory of " + path;
+            return false;
+        }
+        count = readLE64(end64, 32);
+        directorySize = readLE64(end64, 40);
+        directoryOffset = readLE64(end64, 48);
+    }
+
+    archive.seek((qint64) directoryOffset);
+    QByteArray directory = archive.read((qint64) directorySize);
+    if ((quint64) directory.size() != directorySize) {
+        qWarning() << "Could not read the central directory of " + path;
+        return false;
+    }
+    files.reserve((int) count);
+    members.reserve((int) count);
+    int position = 0;
+    for (quint64 i = 0; i < count; i++) {
+        if (position + ZIP_DIRECTORY_HEADER_SIZE > directory.size()
+                || readLE32(directory, position) != ZIP_DIRECTORY_HEADER_SIGNATURE) {
+            qWarning() << "Invalid central directory in " + path;
+            return false;
+        }
+        quint16 flags = readLE16(directory, position + 8);
+        int nameLength = readLE16(directory, position + 28);
+        int extraLength = readLE16(directory, position + 30);
+        int commentLength = readLE16(directory, position + 32);
+        int extra = position + ZIP_DIRECTORY_HEADER_SIZE + nameLength;
+        int extraEnd = extra + extraLength;
+        if (extraEnd + commentLength > directory.size()) {
+            qWarning() << "Invalid central directory in " + path;
+            return false;
+        }
+        Member member;
+        member.compression = readLE16(directory, position + 10);
+        member.storedSize = readLE32(directory, position + 20);
+        member.size = readLE32(directory, position + 24);
+        member.offset = readLE32(directory, position + 42);
+        member.dataOffsetKnown = false;
+        QString name = QString::fromUtf8(directory.constData() + position
+                                         + ZIP_DIRECTORY_HEADER_SIZE, nameLength);
+        // The zip64 extra field holds the values that don't fit, in this order
+        while (extra + 4 <= extraEnd) {
+            quint16 id = readLE16(directory, extra);
+            int fieldEnd = extra + 4 + readLE16(directory, extra + 2);
+            int field = extra + 4;
+            if (id == 0x0001) {
+                if (member.size == 0xFFFFFFFF && field + 8 <= fieldEnd) {
+                    member.size = (qint64) readLE64(directory, field);
+                    field += 8;
+                }
+                if (member.storedSize == 0xFFFFFFFF && field + 8 <= fieldEnd) {
+                    member.storedSize = (qint64) readLE64(directory, field);
+                    field += 8;
+                }
+                if (member.offset == 0xFFFFFFFF && field + 8 <= fieldEnd) {
+                    member.offset = (qint64) readLE64(directory, field);
+                }
+            }
+            extra = fieldEnd;
+        }
+        position = extraEnd + commentLength;
+
+        if (flags & 0x1) {
+            qDebug() << "Skipping encrypted member " + name + " of " + path;
+        } else if (member.compression != Stored && member.compression != Deflated) {
+            qDebug() << "Skipping member " + name + " of " + path
+                        + " with unsupported compression";
+        } else {
+            addMember(name, member);
+        }
+    }
+    return true;
+}
+
+QByteArray ArchiveImageSource::readBlock(qint64 index) {
+    for (int i = 0; i < blocks.size(); i++) {
+        if (blocks[i].index == index) {
+            blocks.move(i, blocks.size() - 1);
+            return blocks.last().data;
+        }
+    }
+    archive.seek(index * BLOCK_SIZE);
+    Block block;
+    block.index = index;
+    block.data = archive.read(BLOCK_SIZE);
+    blocks.append(block);
+    if (blocks.size() > MAX_CACHED_BLOCKS) {
+        blocks.removeFirst();
+    }
+    return block.data;
+}
+
+QByteArray ArchiveImageSource::readRange(qint64 offset, qint64 length) {
+    if (offset < 0 || length < 0 || offset + length > archive.size()) {
+        return QByteArray();
+    }
+    // Reading such members through the blocks would evict everything that was read ahead
+    if (length > BLOCK_SIZE) {
+        archive.seek(offset);
+        QByteArray data = archive.read(length);
+        return data.size() == length ? data : QByteArray();
+    }
+    QByteArray data((int) length, Qt::Uninitialized);
+    qint64 position = offset;
+    while (position < offset + length) {
+        qint64 index = position / BLOCK_SIZE;
+        QByteArray block = readBlock(index);
+        qint64 positionInBlock = position - index * BLOCK_SIZE;
+        qint64 available = qMin(block.size() - positionInBlock, offset + length - position);
+        if (available <= 0) {
+            return QByteArray();
+        }
+        memcpy(data.data() + (position - offset), block.constData() + positionInBlock,
+               (size_t) available);
+        position += available;
+    }
+    return data;
+}
+
+bool ArchiveImageSource::resolveDataOffset(Member &member) {
+    if (member.dataOffsetKnown) {
+        return true;
+    }
+    // The local header has its own name and extra field lengths, the data follows it
+    QByteArray header = readRange(member.offset, ZIP_LOCAL_HEADER_SIZE);
+    if (header.size() != ZIP_LOCAL_HEADER_SIZE
+            || readLE32(header, 0) != ZIP_LOCAL_HEADER_SIGNATURE) {
+        qDebug() << "Invalid local header in " + path;
+        return false;
+    }
+    member.offset += ZIP_LOCAL_HEADER_SIZE + readLE16(header, 26) + readLE16(header, 28);
+    member.dataOffsetKnown = true;
+    return true;
+}
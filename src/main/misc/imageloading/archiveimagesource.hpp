@@ -0,0 +1,97 @@
+#ifndef ARCHIVEIMAGESOURCE_H
+#define ARCHIVEIMAGESOURCE_H
+
+#include "misc/imageloading/imagesource.hpp"
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QVector>
+
+/*!
+ * \brief The ArchiveImageSource class reads the members of a tar or zip archive in place.
+ *
+ * On creation the archive is indexed, i.e. the offset and size of every member is read from
+ * the tar headers or the central directory of the zip file. The index is stored in the cache
+ * location of the user and reused as long as the archive doesn't change, so that archives
+ * with millions of members on network storage are only scanned once.
+ *
+ * Members are read through a cache of large blocks. Images that are stored next to each
+ * other, which is what browsing and prefetching neighbouring images reads, are fetched with
+ * one read of the storage instead of one per image. Stored and deflated zip members are
+ * supported, encrypted ones are not.
+ *
+ * All functions can be called from multiple threads.
+ */
+class ArchiveImageSource : public ImageSource
+{
+public:
+    static const qint64 BLOCK_SIZE = 4 * 1024 * 1024;
+    static const int MAX_CACHED_BLOCKS = 16;
+
+    /*!
+     * \brief ArchiveImageSource constructor, check isValid() afterwards.
+     * \param path the path of the tar or zip file
+     * \param indexCachePath the folder to store the index in, empty to always scan the archive
+     */
+    ArchiveImageSource(const QString &path, const QString &indexCachePath);
+
+    //! Returns whether the archive could be opened and indexed
+    bool isValid() const;
+
+    QStringList getFiles() override;
+    QByteArray readFile(const QString &file) override;
+
+    //! The folder in the cache location of the user
+    static QString defaultIndexCachePath();
+
+private:
+    enum Compression {
+        Stored = 0,
+        Deflated = 8
+    };
+
+    struct Member {
+        //! Offset of the data, for zip files the one of the local header until it was read
+        qint64 offset;
+        //! Size of the data in the archive
+        qint64 storedSize;
+        qint64 size;
+        quint16 compression;
+        bool dataOffsetKnown;
+    };
+
+    struct Block {
+        qint64 index;
+        QByteArray data;
+    };
+
+    QString indexCachePath;
+    bool valid = false;
+    QStringList files;
+    QVector<Member> members;
+    QHash<QString, int> memberIndices;
+
+    //! Guards the file, the blocks and the offsets of the members
+    QMutex mutex;
+    QFile archive;
+    //! Most recently used last
+    QList<Block> blocks;
+
+    bool readIndex();
+    void writeIndex() const;
+    QString indexFilePath() const;
+    bool indexTar();
+    bool indexZip();
+    void addMember(const QString &name, const Member &member);
+
+    //! Expects the mutex to be locked
+    QByteArray readRange(qint64 offset, qint64 length);
+    //! Expects the mutex to be locked
+    QByteArray readBlock(qint64 index);
+    //! Expects the mutex to be locked
+    bool resolveDataOffset(Member &member);
+};
+
+#endif // ARCHIVEIMAGESOURCE_H
@@ -0,0 +1,26 @@
+#include "directoryimagesource.hpp"
+#include "misc/directoryindexer.hpp"
+
+#include <QDir>
+#include <QFile>
+
+DirectoryImageSource::DirectoryImageSource(const QString &path) :
+    ImageSource(path) {
+}
+
+QStringList DirectoryImageSource::getFiles() {
+    // Reopening an unchanged folder reads the manifest instead of listing the folder
+    QStringList files;
+    for (const IndexedFile &file : DirectoryIndexer().index(path)) {
+        files << file.path;
+    }
+    return files;
+}
+
+QByteArray DirectoryImageSource::readFile(const QString &file) {
+    QFile input(absoluteFilePath(file));
+    if (!input.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+    return input.readAll();
+}
@@ -0,0 +1,18 @@
+#ifndef DIRECTORYIMAGESOURCE_H
+#define DIRECTORYIMAGESOURCE_H
+
+#include "misc/imageloading/imagesource.hpp"
+
+/*!
+ * \brief The DirectoryImageSource class provides the files that lie directly in a folder.
+ */
+class DirectoryImageSource : public ImageSource
+{
+public:
+    explicit DirectoryImageSource(const QString &path);
+
+    QStringList getFiles() override;
+    QByteArray readFile(const QString &file) override;
+};
+
+#endif // DIRECTORYIMAGESOURCE_H
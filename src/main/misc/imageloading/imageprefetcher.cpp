@@ -0,0 +1,62 @@
+#include "imageprefetcher.hpp"
+
+#include <QRunnable>
+
+class LevelPrefetchRunnable : public QRunnable {
+public:
+    LevelPrefetchRunnable(ImagePyramidCache *cache,
+                          const QString &path,
+                          float scale,
+                          QSharedPointer<CancellationToken> cancellationToken) :
+        cache(cache),
+        path(path),
+        scale(scale),
+        cancellationToken(cancellationToken) {
+    }
+
+    void run() override {
+        if (cancellationToken->isCancelled()) {
+            return;
+        }
+        ImagePyramidPtr pyramid = cache->get(path);
+        // The coarsest level is drawn first, the other one as soon as it is there
+        pyramid->getLevel(pyramid->getNumberOfLevels() - 1);
+        if (cancellationToken->isCancelled()) {
+            return;
+        }
+        pyramid->getLevel(pyramid->getLevelForScale(scale));
+    }
+
+private:
+    ImagePyramidCache *cache;
+    QString path;
+    float scale;
+    QSharedPointer<CancellationToken> cancellationToken;
+};
+
+ImagePrefetcher::ImagePrefetcher(ImagePyramidCache *cache, QObject *parent) :
+    QObject(parent),
+    cache(cache),
+    prefetchCancellationToken(new CancellationToken()) {
+    // Decoding is mostly bound by the disk, more threads would only compete for it
+    threadPool.setMaxThreadCount(2);
+}
+
+ImagePrefetcher::~ImagePrefetcher() {
+    prefetchCancellationToken->cancel();
+    threadPool.waitForDone();
+}
+
+ImagePyramidPtr ImagePrefetcher::load(const QString &path) {
+    return cache->get(path);
+}
+
+void ImagePrefetcher::prefetch(const QStringList &paths, float scale) {
+    prefetchCancellationToken->cancel();
+    prefetchCancellationToken.reset(new CancellationToken());
+    threadPool.clear();
+    for (const QString &path : paths) {
+        threadPool.start(new LevelPrefetchRunnable(cache, path, scale,
+                                                   prefetchCancellationToken));
+    }
+}
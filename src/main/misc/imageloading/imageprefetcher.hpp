@@ -0,0 +1,48 @@
+#ifndef IMAGEPREFETCHER_H
+#define IMAGEPREFETCHER_H
+
+#include "misc/cancellationtoken.hpp"
+#include "misc/imageloading/imagepyramidcache.hpp"
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+/*!
+ * \brief The ImagePrefetcher class loads the levels of images that are probably displayed
+ * next on worker threads, so that they are in the ImagePyramidCache when they are needed.
+ */
+class ImagePrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Images loaded in advance in the direction the user moves through the images
+    static const int PREFETCH_AHEAD = 2;
+    //! Images loaded in advance in the opposite direction
+    static const int PREFETCH_BEHIND = 1;
+
+    explicit ImagePrefetcher(ImagePyramidCache *cache, QObject *parent = Q_NULLPTR);
+    ~ImagePrefetcher();
+
+    //! Returns the pyramid of the image, its levels are loaded when they are requested
+    ImagePyramidPtr load(const QString &path);
+
+    /*!
+     * \brief prefetch loads the coarsest level and the level that is displayed at the given
+     * scale of the images on worker threads, in the given order. Images of earlier calls that
+     * have not been started yet are not loaded anymore, the user has moved on from them.
+     * \param paths the absolute paths of the images
+     * \param scale screen pixels per image pixel that the images will be displayed at
+     */
+    void prefetch(const QStringList &paths, float scale);
+
+private:
+    ImagePyramidCache *cache;
+    QThreadPool threadPool;
+    QSharedPointer<CancellationToken> prefetchCancellationToken;
+};
+
+#endif // IMAGEPREFETCHER_H
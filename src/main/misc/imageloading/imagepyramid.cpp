@@ -0,0 +1,272 @@
+#include "imagepyramid.hpp"
+#include "imagesource.hpp"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QtDebug>
+
+#include <cmath>
+
+//! Identifies the files of the disk cache, followed by width and height
+static const quint32 LEVEL_FILE_MAGIC = 0x36505952;
+
+static QImage scaledLevel(const QImage &image, const QSize &size) {
+    // Smooth scaling can change the format
+    return image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                .convertToFormat(QImage::Format_RGBA8888);
+}
+
+ImagePyramid::ImagePyramid(const QImage &image, int tileSize) :
+    tileSize(tileSize),
+    imageSize(image.size()) {
+    initializeLevels();
+    setLevel(0, image.convertToFormat(QImage::Format_RGBA8888));
+}
+
+ImagePyramid::ImagePyramid(const QString &imagePath,
+                           const QString &diskCachePath,
+                           int tileSize) :
+    tileSize(tileSize),
+    imagePath(imagePath),
+    diskCachePath(diskCachePath) {
+    imageSize = ImageSource::readImageSize(imagePath);
+    if (!imageSize.isValid()) {
+        qDebug() << "Could not read the size of image " + imagePath;
+        imageSize = QSize(0, 0);
+    }
+    if (!diskCachePath.isEmpty()) {
+        // A changed file gets a new key, the old levels are removed when the cache is trimmed
+        diskCacheKey = QCryptographicHash::hash(ImageSource::fileIdentity(imagePath),
+                                                QCryptographicHash::Sha1).toHex();
+    }
+    initializeLevels();
+}
+
+void ImagePyramid::initializeLevels() {
+    levels << QImage();
+    QSize size = imageSize;
+    while (size.width() > tileSize || size.height() > tileSize) {
+        size = QSize((size.width() + 1) / 2, (size.height() + 1) / 2);
+        levels << QImage();
+    }
+}
+
+QString ImagePyramid::getImagePath() const {
+    return imagePath;
+}
+
+QSize ImagePyramid::getImageSize() const {
+    return imageSize;
+}
+
+int ImagePyramid::getTileSize() const {
+    return tileSize;
+}
+
+int ImagePyramid::getNumberOfLevels() const {
+    return levels.size();
+}
+
+QSize ImagePyramid::getLevelSize(int level) const {
+    QSize size = imageSize;
+    for (int i = 0; i < level; i++) {
+        size = QSize((size.width() + 1) / 2, (size.height() + 1) / 2);
+    }
+    return size;
+}
+
+QSize ImagePyramid::getTileGrid(int level) const {
+    QSize size = getLevelSize(level);
+    return QSize((size.width() + tileSize - 1) / tileSize,
+                 (size.height() + tileSize - 1) / tileSize);
+}
+
+QRect ImagePyramid::getTileRect(int level, int column, int row) const {
+    return QRect(column * tileSize, row * tileSize, tileSize, tileSize)
+            .intersected(QRect(QPoint(0, 0), getLevelSize(level)));
+}
+
+int ImagePyramid::getLevelForScale(float scale) const {
+    if (scale <= 0.f) {
+        return levels.size() - 1;
+    }
+    int level = (int) std::floor(std::log2(1.f / scale));
+    return qBound(0, level, levels.size() - 1);
+}
+
+int ImagePyramid::getLevelForSize(const QSize &minimumSize) const {
+    int level = 0;
+    while (level + 1 < levels.size()) {
+        QSize size = getLevelSize(level + 1);
+        if (size.width() < minimumSize.width() || size.height() < minimumSize.height()) {
+            break;
+        }
+        level++;
+    }
+    return level;
+}
+
+QImage ImagePyramid::getTile(int level, int column, int row) {
+    return getLevel(level).copy(getTileRect(level, column, row));
+}
+
+QImage ImagePyramid::getLevel(int level) {
+    level = qBound(0, level, levels.size() - 1);
+    QMutexLocker locker(&mutex);
+    // The second thread requesting a level gets it from memory instead of loading it again
+    while (levels[level].isNull() && loadingLevels.contains(level)) {
+        levelLoaded.wait(&mutex);
+    }
+    if (!levels[level].isNull()) {
+        return levels[level];
+    }
+    loadingLevels.insert(level);
+    int finer = level - 1;
+    while (finer >= 0 && levels[finer].isNull()) {
+        finer--;
+    }
+    QImage finerImage = finer >= 0 ? levels[finer] : QImage();
+    locker.unlock();
+
+    QMap<int, QImage> loaded = loadLevel(level, finer, finerImage);
+
+    locker.relock();
+    for (auto it = loaded.begin(); it != loaded.end(); it++) {
+        if (!it.value().isNull()) {
+            setLevel(it.key(), it.value());
+        }
+    }
+    loadingLevels.remove(level);
+    levelLoaded.wakeAll();
+    return loaded.value(level);
+}
+
+qint64 ImagePyramid::getMemoryUsage() const {
+    return memoryUsage.load();
+}
+
+void ImagePyramid::releaseMemory() {
+    // A pyramid that is computing a level right now is in use anyway
+    if (!mutex.tryLock()) {
+        return;
+    }
+    if (!loadingLevels.isEmpty()) {
+        mutex.unlock();
+        return;
+    }
+    // Without a file the image itself can't be loaded again
+    for (int i = imagePath.isEmpty() ? 1 : 0; i < levels.size(); i++) {
+        setLevel(i, QImage());
+    }
+    mutex.unlock();
+}
+
+void ImagePyramid::setLevel(int level, const QImage &image) {
+    qint64 bytes = (qint64) image.bytesPerLine() * image.height()
+            - (qint64) levels[level].bytesPerLine() * levels[level].height();
+    memoryUsage.fetchAndAddRelaxed(bytes);
+    levels[level] = image;
+}
+
+QMap<int, QImage> ImagePyramid::loadLevel(int level, int finer, QImage finerImage) {
+    QMap<int, QImage> loaded;
+    QImage image = readStoredLevel(level);
+    if (!image.isNull()) {
+        loaded[level] = image;
+        return loaded;
+    }
+
+    if (finer < 0) {
+        image = decodeLevel(level);
+        if (image.isNull() || level == 0) {
+            loaded[level] = image;
+            return loaded;
+        }
+        if (image.size() != imageSize) {
+            // Decoded at a reduced size, which the reader might have rounded
+            if (image.size() != getLevelSize(level)) {
+                image = scaledLevel(image, getLevelSize(level));
+            }
+            loaded[level] = image;
+            storeLevel(level, image);
+            return loaded;
+        }
+        // The format can't be decoded at a reduced size, this is the whole image
+        loaded[0] = image;
+        finerImage = image;
+        finer = 0;
+    }
+    // Keeps the levels in between, their tiles are usually requested as well
+    image = finerImage;
+    for (int i = finer + 1; i <= level; i++) {
+        image = scaledLevel(image, getLevelSize(i));
+        loaded[i] = image;
+    }
+    storeLevel(level, image);
+    return loaded;
+}
+
+QImage ImagePyramid::decodeLevel(int level) {
+    if (imagePath.isEmpty()) {
+        return QImage();
+    }
+    QImage image = ImageSource::readImage(imagePath,
+                                          level > 0 ? getLevelSize(level) : QSize());
+    if (image.isNull()) {
+        qDebug() << "Could not read image " + imagePath;
+        return image;
+    }
+    return image.convertToFormat(QImage::Format_RGBA8888);
+}
+
+QString ImagePyramid::levelFilePath(int level) const {
+    return QDir(diskCachePath).filePath(diskCacheKey + "_" + QString::number(level) + ".rgba");
+}
+
+QImage ImagePyramid::readStoredLevel(int level) const {
+    if (diskCacheKey.isEmpty() || level == 0) {
+        return QImage();
+    }
+    QFile file(levelFilePath(level));
+    if (!file.open(QFile::ReadOnly)) {
+        return QImage();
+    }
+    QDataStream stream(&file);
+    quint32 magic, width, height;
+    stream >> magic >> width >> height;
+    QSize size = getLevelSize(level);
+    if (magic != LEVEL_FILE_MAGIC || (int) width != size.width()
+            || (int) height != size.height()) {
+        return QImage();
+    }
+    QImage image(size, QImage::Format_RGBA8888);
+    for (int y = 0; y < size.height(); y++) {
+        if (file.read((char *) image.scanLine(y), size.width() * 4) != size.width() * 4) {
+            return QImage();
+        }
+    }
+    return image;
+}
+
+void ImagePyramid::storeLevel(int level, const QImage &image) const {
+    if (diskCacheKey.isEmpty() || level == 0 || image.isNull()
+            || image.width() * image.height() > MAX_STORED_LEVEL_PIXELS) {
+        return;
+    }
+    QDir().mkpath(diskCachePath);
+    // Other processes may read the level at the same time, only rename complete files
+    QSaveFile file(levelFilePath(level));
+    if (!file.open(QFile::WriteOnly)) {
+        return;
+    }
+    QDataStream stream(&file);
+    stream << LEVEL_FILE_MAGIC << (quint32) image.width() << (quint32) image.height();
+    for (int y = 0; y < image.height(); y++) {
+        file.write((const char *) image.constScanLine(y), image.width() * 4);
+    }
+    file.commit();
+}
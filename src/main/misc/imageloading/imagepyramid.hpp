@@ -0,0 +1,123 @@
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include <QAtomicInteger>
+#include <QImage>
+#include <QMap>
+#include <QMutex>
+#include <QRect>
+#include <QSet>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+
+/*!
+ * \brief The ImagePyramid class holds an image at power-of-two resolutions and divides
+ * every level into square tiles. Level 0 is the image itself, level k has half the width
+ * and height of level k - 1 (rounded up), the last level fits into a single tile.
+ *
+ * Levels are only computed when they are requested. A level is taken from memory, from the
+ * disk cache, scaled down from the closest finer level in memory or decoded from the image
+ * file at the reduced size, in that order. Decoding at a reduced size is much faster than
+ * decoding the whole image for formats that support it, e.g. JPEG.
+ *
+ * All levels are in Format_RGBA8888. All functions can be called from multiple threads.
+ * Levels are computed without holding the lock of the pyramid, so that the levels in memory
+ * stay available meanwhile, only threads requesting the same level wait for each other.
+ */
+class ImagePyramid
+{
+public:
+    static const int DEFAULT_TILE_SIZE = 512;
+    //! Larger levels are not written to the disk cache, reading them would not be faster
+    //! than decoding the image
+    static const int MAX_STORED_LEVEL_PIXELS = 4 * 1024 * 1024;
+
+    //! Creates the pyramid of an image that is already in memory
+    explicit ImagePyramid(const QImage &image, int tileSize = DEFAULT_TILE_SIZE);
+
+    /*!
+     * \brief ImagePyramid creates the pyramid of an image file. Only the header of the image
+     * is read here.
+     * \param imagePath the absolute path of the image
+     * \param diskCachePath the folder to store computed levels in, empty to not store them
+     * \param tileSize the width and height of the tiles
+     */
+    ImagePyramid(const QString &imagePath,
+                 const QString &diskCachePath,
+                 int tileSize = DEFAULT_TILE_SIZE);
+
+    QString getImagePath() const;
+    QSize getImageSize() const;
+    int getTileSize() const;
+    int getNumberOfLevels() const;
+    QSize getLevelSize(int level) const;
+    //! Returns the number of tile columns and rows of the level
+    QSize getTileGrid(int level) const;
+    //! Returns the area of the tile in pixels of its level, tiles at the border are smaller
+    QRect getTileRect(int level, int column, int row) const;
+
+    /*!
+     * \brief getLevelForScale returns the coarsest level that still has at least the given
+     * resolution, i.e. whose pixels are not larger than the screen pixels they are drawn to.
+     * \param scale screen pixels per image pixel
+     */
+    int getLevelForScale(float scale) const;
+
+    /*!
+     * \brief getLevelForSize returns the coarsest level that is at least as large as the
+     * given size, e.g. to scale it down to a thumbnail of that size.
+     * \param minimumSize the size, a width or height of 0 is ignored
+     */
+    int getLevelForSize(const QSize &minimumSize) const;
+
+    //! Returns a copy of the pixels of the tile, computing the level if necessary
+    QImage getTile(int level, int column, int row);
+
+    //! Returns the whole level, computing it if necessary, null if the image can't be read
+    QImage getLevel(int level);
+
+    //! Returns the number of bytes of the levels in memory, without waiting for the
+    //! computation of a level
+    qint64 getMemoryUsage() const;
+
+    //! Drops the levels from memory that can be loaded or computed again, does nothing if
+    //! a level is being computed
+    void releaseMemory();
+
+private:
+    int tileSize;
+    QString imagePath;
+    QString diskCachePath;
+    //! Identifies the version of the image file in the disk cache
+    QString diskCacheKey;
+    QSize imageSize;
+    mutable QMutex mutex;
+    //! Null images for the levels that are not in memory
+    QVector<QImage> levels;
+    //! The levels that are being computed, guarded by the mutex
+    QSet<int> loadingLevels;
+    QWaitCondition levelLoaded;
+    QAtomicInteger<qint64> memoryUsage;
+
+    void initializeLevels();
+    //! Expects the mutex to be locked
+    void setLevel(int level, const QImage &image);
+    /*!
+     * \brief loadLevel computes the level without the mutex.
+     * \param finer the finest level in memory above the level, -1 if there is none
+     * \param finerImage the pixels of that level
+     * \return the computed levels, the requested one and those in between that have been
+     * computed on the way
+     */
+    QMap<int, QImage> loadLevel(int level, int finer, QImage finerImage);
+    //! Decodes the image at the size of the level if the format supports it, otherwise at
+    //! full resolution
+    QImage decodeLevel(int level);
+    QString levelFilePath(int level) const;
+    QImage readStoredLevel(int level) const;
+    void storeLevel(int level, const QImage &image) const;
+};
+
+#endif // IMAGEPYRAMID_H
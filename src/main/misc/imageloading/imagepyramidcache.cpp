@@ -0,0 +1,98 @@
+#include "imagepyramidcache.hpp"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+
+ImagePyramidCache::ImagePyramidCache(const QString &diskCachePath, qint64 maxMemory) :
+    diskCachePath(diskCachePath),
+    maxMemory(maxMemory) {
+    if (!diskCachePath.isEmpty()) {
+        trimDiskCache();
+    }
+}
+
+ImagePyramidPtr ImagePyramidCache::get(const QString &imagePath) {
+    QMutexLocker locker(&mutex);
+    ImagePyramidPtr pyramid = pyramids.value(imagePath);
+    if (pyramid.isNull()) {
+        pyramid.reset(new ImagePyramid(imagePath, diskCachePath));
+        pyramids[imagePath] = pyramid;
+    } else {
+        usage.removeOne(imagePath);
+    }
+    usage.append(imagePath);
+    // Levels loaded since the last request count now
+    trim();
+    return pyramid;
+}
+
+QImage ImagePyramidCache::getImage(const QString &imagePath, const QSize &size) {
+    ImagePyramidPtr pyramid = get(imagePath);
+    QImage level = pyramid->getLevel(pyramid->getLevelForSize(size));
+    if (level.isNull()) {
+        return level;
+    }
+    if (size.width() == 0) {
+        return level.scaledToHeight(size.height(), Qt::SmoothTransformation);
+    } else if (size.height() == 0) {
+        return level.scaledToWidth(size.width(), Qt::SmoothTransformation);
+    }
+    return level.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+void ImagePyramidCache::setMaxMemory(qint64 maxMemory) {
+    QMutexLocker locker(&mutex);
+    this->maxMemory = maxMemory;
+    trim();
+}
+
+void ImagePyramidCache::clear() {
+    QMutexLocker locker(&mutex);
+    // Pyramids that are still in use stay valid, they are just not handed out anymore
+    pyramids.clear();
+    usage.clear();
+}
+
+void ImagePyramidCache::trimDiskCache(qint64 maxBytes) {
+    QDir directory(diskCachePath);
+    if (diskCachePath.isEmpty() || !directory.exists()) {
+        return;
+    }
+    QFileInfoList files = directory.entryInfoList({"*.rgba"}, QDir::Files, QDir::Time);
+    qint64 bytes = 0;
+    // Newest first, everything after the limit goes
+    for (const QFileInfo &file : files) {
+        bytes += file.size();
+        if (bytes > maxBytes) {
+            QFile::remove(file.absoluteFilePath());
+        }
+    }
+}
+
+QString ImagePyramidCache::getDiskCachePath() const {
+    return diskCachePath;
+}
+
+QString ImagePyramidCache::defaultDiskCachePath() {
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+            .filePath("pyramids");
+}
+
+void ImagePyramidCache::trim() {
+    qint64 memoryUsage = 0;
+    for (const ImagePyramidPtr &pyramid : pyramids) {
+        memoryUsage += pyramid->getMemoryUsage();
+    }
+    // The most recently requested pyramid is the one that is needed right now
+    for (int i = 0; i < usage.size() - 1 && memoryUsage > maxMemory; i++) {
+        ImagePyramidPtr pyramid = pyramids[usage[i]];
+        memoryUsage -= pyramid->getMemoryUsage();
+        pyramid->releaseMemory();
+        memoryUsage += pyramid->getMemoryUsage();
+    }
+    while (usage.size() > MAX_PYRAMIDS) {
+        pyramids.remove(usage.takeFirst());
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef IMAGEPYRAMIDCACHE_H
+#define IMAGEPYRAMIDCACHE_H
+
+#include "misc/imageloading/imagepyramid.hpp"
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+
+typedef QSharedPointer<ImagePyramid> ImagePyramidPtr;
+
+/*!
+ * \brief The ImagePyramidCache class hands out the ImagePyramid of an image file, so that
+ * everything that needs an image at some resolution, e.g. the gallery, the pose viewer and
+ * image analysis, shares the levels that have already been decoded or computed instead of
+ * decoding the full image on its own.
+ *
+ * The levels in memory are bounded by a total size, the pyramids that have been requested
+ * the longest time ago release their levels first. Levels written to the disk cache survive
+ * restarts of the program, the disk cache is trimmed to a maximum size on creation.
+ *
+ * All functions can be called from multiple threads.
+ */
+class ImagePyramidCache
+{
+public:
+    static const qint64 DEFAULT_MAX_MEMORY = 1024ll * 1024 * 1024;
+    static const qint64 DEFAULT_MAX_DISK_USAGE = 4096ll * 1024 * 1024;
+
+    /*!
+     * \brief ImagePyramidCache constructor.
+     * \param diskCachePath the folder to store computed levels in, empty to only keep them
+     * in memory
+     * \param maxMemory the maximum total size of the levels in memory
+     */
+    explicit ImagePyramidCache(const QString &diskCachePath = QString(),
+                               qint64 maxMemory = DEFAULT_MAX_MEMORY);
+
+    //! Returns the pyramid of the image, nothing is decoded here
+    ImagePyramidPtr get(const QString &imagePath);
+
+    /*!
+     * \brief getImage returns the image scaled down to the given size. The size is taken
+     * from the coarsest level that is large enough.
+     * \param imagePath the absolute path of the image
+     * \param size the size, a width or height of 0 keeps the aspect ratio
+     */
+    QImage getImage(const QString &imagePath, const QSize &size);
+
+    //! Releases the levels of pyramids until they use at most maxMemory
+    void setMaxMemory(qint64 maxMemory);
+    //! Forgets all pyramids, e.g. because the images on disk have changed
+    void clear();
+
+    //! Deletes the least recently written levels from the disk cache until it is small enough
+    void trimDiskCache(qint64 maxBytes = DEFAULT_MAX_DISK_USAGE);
+    QString getDiskCachePath() const;
+    //! The folder in the cache location of the user
+    static QString defaultDiskCachePath();
+
+private:
+    //! Pyramids are forgotten when they are this many requests behind
+    static const int MAX_PYRAMIDS = 4096;
+
+    QMutex mutex;
+    QString diskCachePath;
+    qint64 maxMemory;
+    QHash<QString, ImagePyramidPtr> pyramids;
+    //! Least recently requested first
+    QList<QString> usage;
+
+    //! Expects the mutex to be locked
+    void trim();
+};
+
+#endif // IMAGEPYRAMIDCACHE_H
@@ -0,0 +1,203 @@
+#include "imagesource.hpp"
+#include "archiveimagesource.hpp"
+#include "directoryimagesource.hpp"
+#include "videoimagesource.hpp"
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QImageReader>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QWaitCondition>
+
+const QStringList ImageSource::ARCHIVE_FILES_EXTENSIONS = QStringList({"*.tar", "*.zip"});
+const QStringList ImageSource::VIDEO_FILES_EXTENSIONS =
+        QStringList({"*.mp4", "*.avi", "*.mkv", "*.mov", "*.webm"});
+
+//! Archives and videos are opened from everywhere images are read, each should only be
+//! indexed once
+static const int MAX_OPEN_SOURCES = 64;
+static QMutex openSourcesMutex;
+static QHash<QString, ImageSourcePtr> openSources;
+//! Least recently opened first
+static QList<QString> openSourcesUsage;
+//! The sources that are being indexed, without holding the mutex
+static QSet<QString> openingSources;
+static QWaitCondition sourceOpened;
+
+ImageSource::ImageSource(const QString &path) :
+    path(path) {
+}
+
+ImageSource::~ImageSource() {
+}
+
+ImageSourcePtr ImageSource::open(const QString &path) {
+    QFileInfo info(path);
+    if (info.isDir()) {
+        return ImageSourcePtr(new DirectoryImageSource(path));
+    }
+    if (!info.isFile() || (!isArchive(path) && !isVideo(path))) {
+        return ImageSourcePtr();
+    }
+
+    QString key = info.absoluteFilePath();
+    QMutexLocker locker(&openSourcesMutex);
+    // Concurrent readers of the same archive wait for its index instead of indexing it twice
+    while (openingSources.contains(key)) {
+        sourceOpened.wait(&openSourcesMutex);
+    }
+    ImageSourcePtr source = openSources.value(key);
+    if (!source.isNull()) {
+        openSourcesUsage.removeOne(key);
+        openSourcesUsage.append(key);
+        return source;
+    }
+    // Indexing a large shard takes long, sources that are already open stay available
+    openingSources.insert(key);
+    locker.unlock();
+    if (isArchive(path)) {
+        QSharedPointer<ArchiveImageSource> archive(
+                    new ArchiveImageSource(path, ArchiveImageSource::defaultIndexCachePath()));
+        if (archive->isValid()) {
+            source = archive;
+        }
+    } else {
+        QSharedPointer<VideoImageSource> video(new VideoImageSource(path));
+        if (video->isValid()) {
+            source = video;
+        }
+    }
+    locker.relock();
+    openingSources.remove(key);
+    sourceOpened.wakeAll();
+    if (source.isNull()) {
+        return source;
+    }
+    openSources[key] = source;
+    openSourcesUsage.append(key);
+    if (openSourcesUsage.size() > MAX_OPEN_SOURCES) {
+        openSources.remove(openSourcesUsage.takeFirst());
+    }
+    return source;
+}
+
+bool ImageSource::isArchive(const QString &path) {
+    return QDir::match(ARCHIVE_FILES_EXTENSIONS, QFileInfo(path).fileName());
+}
+
+bool ImageSource::isVideo(const QString &path) {
+    return QDir::match(VIDEO_FILES_EXTENSIONS, QFileInfo(path).fileName());
+}
+
+bool ImageSource::splitSourcePath(const QString &path, QString &sourcePath, QString &member) {
+    // Checking the file system for every image that isn't in an archive would be slow
+    bool mightBeMember = false;
+    for (const QString &extension : ARCHIVE_FILES_EXTENSIONS + VIDEO_FILES_EXTENSIONS) {
+        // The extensions are wildcards like *.tar
+        if (path.contains(extension.mid(1) + "/", Qt::CaseInsensitive)) {
+            mightBeMember = true;
+            break;
+        }
+    }
+    if (!mightBeMember) {
+        return false;
+    }
+    int separator = path.indexOf('/', 1);
+    while (separator > 0) {
+        QString candidate = path.left(separator);
+        if ((isArchive(candidate) || isVideo(candidate)) && QFileInfo(candidate).isFile()) {
+            sourcePath = candidate;
+            member = path.mid(separator + 1);
+            return true;
+        }
+        separator = path.indexOf('/', separator + 1);
+    }
+    return false;
+}
+
+QIODevice *ImageSource::openFile(const QString &path) {
+    QString sourcePath, member;
+    if (splitSourcePath(path, sourcePath, member)) {
+        ImageSourcePtr source = open(sourcePath);
+        QByteArray data = source.isNull() ? QByteArray() : source->readFile(member);
+        if (data.isNull()) {
+            return Q_NULLPTR;
+        }
+        QBuffer *buffer = new QBuffer();
+        buffer->setData(data);
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
+    }
+    QFile *file = new QFile(path);
+    if (!file->open(QIODevice::ReadOnly)) {
+        delete file;
+        return Q_NULLPTR;
+    }
+    return file;
+}
+
+//! Decodes at the scaled size if the format supports it, e.g. JPEG
+static QImage readScaled(QImageReader &reader, const QSize &scaledSize) {
+    if (scaledSize.isValid() && reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        reader.setScaledSize(scaledSize);
+    }
+    return reader.read();
+}
+
+QImage ImageSource::readImage(const QString &path, const QSize &scaledSize) {
+    QString sourcePath, member;
+    if (splitSourcePath(path, sourcePath, member)) {
+        ImageSourcePtr source = open(sourcePath);
+        return source.isNull() ? QImage() : source->readImageFile(member, scaledSize);
+    }
+    QImageReader reader(path);
+    return readScaled(reader, scaledSize);
+}
+
+QSize ImageSource::readImageSize(const QString &path) {
+    QString sourcePath, member;
+    if (splitSourcePath(path, sourcePath, member)) {
+        ImageSourcePtr source = open(sourcePath);
+        return source.isNull() ? QSize() : source->readImageFileSize(member);
+    }
+    return QImageReader(path).size();
+}
+
+QByteArray ImageSource::fileIdentity(const QString &path) {
+    QString sourcePath, member;
+    QFileInfo info(splitSourcePath(path, sourcePath, member) ? sourcePath : path);
+    return QFileInfo(path).absoluteFilePath().toUtf8() + '|'
+            + QByteArray::number(info.size()) + '|'
+            + QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+}
+
+QString ImageSource::getPath() const {
+    return path;
+}
+
+QImage ImageSource::readImageFile(const QString &file, const QSize &scaledSize) {
+    QBuffer buffer;
+    buffer.setData(readFile(file));
+    buffer.open(QIODevice::ReadOnly);
+    // Members of archives have no file name the format could be guessed from
+    QImageReader reader(&buffer);
+    return readScaled(reader, scaledSize);
+}
+
+QSize ImageSource::readImageFileSize(const QString &file) {
+    QBuffer buffer;
+    buffer.setData(readFile(file));
+    buffer.open(QIODevice::ReadOnly);
+    return QImageReader(&buffer).size();
+}
+
+QString ImageSource::absoluteFilePath(const QString &file) const {
+    return QDir(path).absoluteFilePath(file);
+}
@@ -0,0 +1,96 @@
+#ifndef IMAGESOURCE_H
+#define IMAGESOURCE_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QIODevice>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+class ImageSource;
+typedef QSharedPointer<ImageSource> ImageSourcePtr;
+
+/*!
+ * \brief The ImageSource class lists and reads the images of a folder, of an archive, i.e. a
+ * tar or zip shard, or the frames of a video, without extracting the archive or the video.
+ *
+ * The files of an archive or video are addressed like files in a folder named like the
+ * archive or video, e.g. /data/shard_00.tar/rgb/0001.png is the member rgb/0001.png of
+ * /data/shard_00.tar. This way an Image keeps its relative image path, which is what the
+ * poses file refers to, and only its base path points into the archive or video. Everything
+ * that reads images by path should go through the static functions of this class, so that
+ * such paths can be read.
+ */
+class ImageSource
+{
+public:
+    static const QStringList ARCHIVE_FILES_EXTENSIONS;
+    static const QStringList VIDEO_FILES_EXTENSIONS;
+
+    virtual ~ImageSource();
+
+    /*!
+     * \brief open returns the source for the given folder, archive or video. Archives and
+     * videos are only indexed once and then shared, so that all readers use the same
+     * read-ahead.
+     * \return the source or null if the path is neither a folder nor a readable archive or
+     * video
+     */
+    static ImageSourcePtr open(const QString &path);
+
+    //! Returns whether the path names an archive file, by its extension
+    static bool isArchive(const QString &path);
+    //! Returns whether the path names a video file, by its extension
+    static bool isVideo(const QString &path);
+
+    /*!
+     * \brief openFile opens the file at the given absolute path for reading, the path may
+     * point into an archive or video.
+     * \return the opened device that the caller owns or null if the file can't be read
+     */
+    static QIODevice *openFile(const QString &path);
+    /*!
+     * \brief readImage decodes the image at the given absolute path, which may point into an
+     * archive or video.
+     * \param scaledSize the size to decode the image at if the format supports decoding at
+     * reduced size, otherwise the image is returned at its full size
+     */
+    static QImage readImage(const QString &path, const QSize &scaledSize = QSize());
+    //! Reads the size of the image from its header, the path may point into an archive
+    static QSize readImageSize(const QString &path);
+    /*!
+     * \brief fileIdentity returns a value that changes when the file at the given path
+     * changes, for members of archives and videos it is derived from the archive or video.
+     */
+    static QByteArray fileIdentity(const QString &path);
+
+    //! Returns the path of the folder, archive or video
+    QString getPath() const;
+    //! Returns the paths of all files relative to the source, in the order of the source
+    virtual QStringList getFiles() = 0;
+    //! Returns the contents of the file with the given relative path or a null array
+    virtual QByteArray readFile(const QString &file) = 0;
+    //! Decodes the image with the given relative path, see readImage()
+    virtual QImage readImageFile(const QString &file, const QSize &scaledSize);
+    //! Returns the size of the image with the given relative path
+    virtual QSize readImageFileSize(const QString &file);
+    //! Returns the absolute path of the file with the given relative path
+    QString absoluteFilePath(const QString &file) const;
+
+protected:
+    explicit ImageSource(const QString &path);
+
+    QString path;
+
+private:
+    /*!
+     * \brief splitSourcePath splits a path into the path of the archive or video it points
+     * into and the path of the member.
+     * \return whether the path points into an archive or video
+     */
+    static bool splitSourcePath(const QString &path, QString &sourcePath, QString &member);
+};
+
+#endif // IMAGESOURCE_H
@@ -0,0 +1,208 @@
+#include "videoimagesource.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QtDebug>
+
+//! The frame is copied, the matrix reuses its memory for the next frame
+static QImage imageFromFrame(const cv::Mat &frame) {
+    if (frame.type() == CV_8UC1) {
+        return QImage(frame.data, frame.cols, frame.rows, (int) frame.step,
+                      QImage::Format_Grayscale8).copy();
+    } else if (frame.type() == CV_8UC3) {
+        // OpenCV decodes to BGR
+        return QImage(frame.data, frame.cols, frame.rows, (int) frame.step,
+                      QImage::Format_RGB888).rgbSwapped();
+    }
+    return QImage();
+}
+
+VideoReadAheadRunnable::VideoReadAheadRunnable(VideoImageSource *video, int firstFrame,
+                                               int lastFrame, int generation) :
+    video(video),
+    firstFrame(firstFrame),
+    lastFrame(lastFrame),
+    generation(generation) {
+}
+
+void VideoReadAheadRunnable::run() {
+    for (int i = firstFrame; i <= lastFrame; i++) {
+        // A frame elsewhere has been requested, this read-ahead would only delay it
+        if (video->readAheadGeneration.loadAcquire() != generation) {
+            return;
+        }
+        QMutexLocker locker(&video->mutex);
+        if (!video->isCached(i) && video->decodeFrame(i).isNull()) {
+            return;
+        }
+    }
+}
+
+VideoImageSource::VideoImageSource(const QString &path) :
+    ImageSource(path) {
+    readAheadPool.setMaxThreadCount(1);
+    if (!capture.open(path.toStdString())) {
+        qWarning() << "Could not open video " + path;
+        return;
+    }
+    frameCount = (int) capture.get(cv::CAP_PROP_FRAME_COUNT);
+    frameSize = QSize((int) capture.get(cv::CAP_PROP_FRAME_WIDTH),
+                      (int) capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    if (frameCount <= 0 || frameSize.isEmpty()) {
+        qWarning() << "Could not read the frame count or size of video " + path;
+        return;
+    }
+    frameFilePrefix = QFileInfo(path).completeBaseName() + "_";
+    qint64 frameBytes = (qint64) frameSize.width() * frameSize.height() * 3;
+    qint64 cachedFrames = qMax((qint64) READ_AHEAD_FRAMES + 1, MAX_CACHED_BYTES / frameBytes);
+    ring.resize((int) qMin(cachedFrames, (qint64) frameCount));
+    valid = true;
+}
+
+VideoImageSource::~VideoImageSource() {
+    readAheadGeneration.fetchAndAddOrdered(1);
+    readAheadPool.clear();
+    readAheadPool.waitForDone();
+}
+
+bool VideoImageSource::isValid() const {
+    return valid;
+}
+
+QStringList VideoImageSource::getFiles() {
+    QStringList files;
+    files.reserve(frameCount);
+    for (int i = 0; i < frameCount; i++) {
+        files << frameFileName(i);
+    }
+    return files;
+}
+
+QByteArray VideoImageSource::readFile(const QString &file) {
+    // The camera parameters lie next to the video, like the ones of images in a folder
+    if (file == "info.json") {
+        QFile info(QFileInfo(path).dir().filePath(file));
+        return info.open(QFile::ReadOnly) ? info.readAll() : QByteArray();
+    }
+    QImage image = readFrame(frameIndex(file));
+    if (image.isNull()) {
+        return QByteArray();
+    }
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "BMP");
+    return data;
+}
+
+QImage VideoImageSource::readImageFile(const QString &file, const QSize &scaledSize) {
+    // Frames are always decoded at full size, the pyramid scales them down
+    Q_UNUSED(scaledSize);
+    return readFrame(frameIndex(file));
+}
+
+QSize VideoImageSource::readImageFileSize(const QString &file) {
+    return frameIndex(file) >= 0 ? frameSize : QSize();
+}
+
+int VideoImageSource::frameIndex(const QString &file) const {
+    if (!file.startsWith(frameFilePrefix) || !file.endsWith(".png")) {
+        return -1;
+    }
+    bool ok = false;
+    int index = file.mid(frameFilePrefix.size(), file.size() - frameFilePrefix.size() - 4)
+                    .toInt(&ok);
+    return ok && index >= 0 && index < frameCount ? index : -1;
+}
+
+QString VideoImageSource::frameFileName(int index) const {
+    return frameFilePrefix + QString("%1").arg(index, 6, 10, QChar('0')) + ".png";
+}
+
+QImage VideoImageSource::readFrame(int index) {
+    if (index < 0 || index >= frameCount) {
+        return QImage();
+    }
+    QImage image;
+    {
+        QMutexLocker locker(&mutex);
+        image = isCached(index) ? ring[index % ring.size()].image : decodeFrame(index);
+    }
+    startReadAhead(index + 1);
+    return image;
+}
+
+QImage VideoImageSource::decodeFrame(int index) {
+    if ((index < position || index - position > MAX_DECODE_FORWARD) && !seek(index)) {
+        qDebug() << "Could not seek to frame " + QString::number(index) + " of " + path;
+        position = frameCount;
+        return QImage();
+    }
+    // Frames that are skipped are decoded but not converted
+    while (position < index) {
+        if (!capture.grab()) {
+            position = frameCount;
+            return QImage();
+        }
+        position++;
+    }
+    cv::Mat frame;
+    if (!capture.read(frame) || frame.empty()) {
+        qDebug() << "Could not decode frame " + QString::number(index) + " of " + path;
+        // Seek before the next read
+        position = frameCount;
+        return QImage();
+    }
+    position++;
+    QImage image = imageFromFrame(frame);
+    CachedFrame &cachedFrame = ring[index % ring.size()];
+    cachedFrame.index = index;
+    cachedFrame.image = image;
+    return image;
+}
+
+bool VideoImageSource::seek(int index) {
+    int target = index;
+    int backoff = MAX_DECODE_FORWARD;
+    while (target > 0) {
+        capture.set(cv::CAP_PROP_POS_FRAMES, target);
+        // Where the next read actually starts, frames up to the requested one are decoded
+        // forward from there
+        int reported = (int) capture.get(cv::CAP_PROP_POS_FRAMES);
+        if (reported >= 0 && reported <= index) {
+            position = reported;
+            return true;
+        }
+        target = qMax(0, index - backoff);
+        backoff *= 2;
+    }
+    // Reopening is the only position every backend gets right
+    capture.release();
+    position = 0;
+    return capture.open(path.toStdString());
+}
+
+bool VideoImageSource::isCached(int index) const {
+    return ring[index % ring.size()].index == index;
+}
+
+void VideoImageSource::startReadAhead(int firstFrame) {
+    int lastFrame = qMin(firstFrame + READ_AHEAD_FRAMES, frameCount) - 1;
+    int generation = readAheadGeneration.fetchAndAddOrdered(1) + 1;
+    readAheadPool.clear();
+    {
+        QMutexLocker locker(&mutex);
+        while (firstFrame <= lastFrame && isCached(firstFrame)) {
+            firstFrame++;
+        }
+    }
+    if (firstFrame <= lastFrame) {
+        readAheadPool.start(new VideoReadAheadRunnable(this, firstFrame, lastFrame,
+                                                       generation));
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef VIDEOIMAGESOURCE_H
+#define VIDEOIMAGESOURCE_H
+
+#include "misc/imageloading/imagesource.hpp"
+
+#include <opencv2/videoio/videoio.hpp>
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QVector>
+
+class VideoImageSource;
+
+/*!
+ * \brief The VideoReadAheadRunnable class decodes the frames that follow the most recently
+ * read one into the frame cache of the video, until a frame far away is requested.
+ */
+class VideoReadAheadRunnable : public QRunnable
+{
+public:
+    VideoReadAheadRunnable(VideoImageSource *video, int firstFrame, int lastFrame,
+                           int generation);
+    void run() override;
+
+private:
+    VideoImageSource *video;
+    int firstFrame;
+    int lastFrame;
+    int generation;
+};
+
+/*!
+ * \brief The VideoImageSource class provides the frames of a video as images, so that
+ * recorded sequences can be annotated without exporting every frame first.
+ *
+ * Frame i of the video video.mp4 is the file video_<i>.png, with i padded to six digits, the
+ * camera matrices of the frames are read from the info.json next to the video like for
+ * images.
+ *
+ * Decoded frames are kept in a ring cache. After a frame has been read the following
+ * frames are decoded in the background, so that stepping through the sequence only waits
+ * for the first frame. Frames shortly after the current position are reached by decoding
+ * forward. For everything else the decoder seeks, and the position it reports afterwards is
+ * checked: backends may land on a keyframe after the requested frame. The seek is then
+ * repeated further back, and the frames up to the requested one are decoded forward. The
+ * file of a frame, i.e. readFile(), is the frame encoded as BMP.
+ *
+ * All functions can be called from multiple threads.
+ */
+class VideoImageSource : public ImageSource
+{
+public:
+    //! Frames that are decoded ahead of the most recently read frame
+    static const int READ_AHEAD_FRAMES = 16;
+    //! Decoding up to this many frames forward is faster than seeking
+    static const int MAX_DECODE_FORWARD = 48;
+    //! Upper bound of the memory of the ring cache, which holds at least READ_AHEAD_FRAMES
+    static const qint64 MAX_CACHED_BYTES = 256ll * 1024 * 1024;
+
+    explicit VideoImageSource(const QString &path);
+    ~VideoImageSource();
+
+    //! Returns whether the video could be opened
+    bool isValid() const;
+
+    QStringList getFiles() override;
+    QByteArray readFile(const QString &file) override;
+    QImage readImageFile(const QString &file, const QSize &scaledSize) override;
+    QSize readImageFileSize(const QString &file) override;
+
+    //! Returns the index of the frame that the file refers to or -1
+    int frameIndex(const QString &file) const;
+    //! Returns the name of the file of the frame with the given index
+    QString frameFileName(int index) const;
+
+private:
+    friend class VideoReadAheadRunnable;
+
+    struct CachedFrame {
+        int index = -1;
+        QImage image;
+    };
+
+    bool valid = false;
+    int frameCount = 0;
+    QSize frameSize;
+    QString frameFilePrefix;
+
+    //! Guards the capture, its position and the ring cache
+    QMutex mutex;
+    cv::VideoCapture capture;
+    //! Index of the frame that the next read of the capture decodes
+    int position = 0;
+    //! Frame i is stored at i modulo the size
+    QVector<CachedFrame> ring;
+
+    QThreadPool readAheadPool;
+    //! Incremented by every read, running read-aheads of earlier generations stop
+    QAtomicInt readAheadGeneration;
+
+    QImage readFrame(int index);
+    //! Expects the mutex to be locked
+    QImage decodeFrame(int index);
+    //! Moves the capture to the frame or before it, expects the mutex to be locked
+    bool seek(int index);
+    //! Expects the mutex to be locked
+    bool isCached(int index) const;
+    void startReadAhead(int firstFrame);
+};
+
+#endif // VIDEOIMAGESOURCE_H
@@ -0,0 +1,52 @@
+#include "npyfile.hpp"
+
+#include <QFile>
+#include <QtEndian>
+#include <QtDebug>
+
+namespace NpyFile {
+
+    //! Magic string, major and minor version of the format
+    static const char NPY_MAGIC[] = "\x93NUMPY\x01\x00";
+    static const int NPY_MAGIC_SIZE = 8;
+
+    bool writeFloat32(const QString &path, const float *data, const QVector<int> &shape) {
+        QFile file(path);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            qDebug() << "Could not open " + path + " for writing.";
+            return false;
+        }
+
+        QString shapeString;
+        qint64 count = 1;
+        for (int dimension : shape) {
+            shapeString += QString::number(dimension) + ", ";
+            count *= dimension;
+        }
+        if (shape.size() > 1) {
+            // Only a tuple with a single entry needs the trailing comma
+            shapeString.chop(2);
+        }
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        QString descr = "<f4";
+#else
+        QString descr = ">f4";
+#endif
+        QByteArray header = QString("{'descr': '%1', 'fortran_order': False, 'shape': (%2), }")
+                .arg(descr, shapeString).toLatin1();
+        // The data has to start at a multiple of 64 bytes and the header ends with a newline
+        int headerStart = NPY_MAGIC_SIZE + 2;
+        int padding = 64 - (headerStart + header.size() + 1) % 64;
+        header.append(QByteArray(padding % 64, ' '));
+        header.append('\n');
+
+        uchar headerLength[2];
+        qToLittleEndian<quint16>(header.size(), headerLength);
+        file.write(NPY_MAGIC, NPY_MAGIC_SIZE);
+        file.write(reinterpret_cast<const char*>(headerLength), 2);
+        file.write(header);
+        qint64 size = count * (qint64) sizeof(float);
+        return file.write(reinterpret_cast<const char*>(data), size) == size;
+    }
+
+}
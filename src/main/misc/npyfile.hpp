@@ -0,0 +1,21 @@
+#ifndef NPYFILE_H
+#define NPYFILE_H
+
+#include <QString>
+#include <QVector>
+
+//! Writes arrays in the NumPy .npy format (version 1.0), which can be loaded with numpy.load.
+namespace NpyFile {
+
+    /*!
+     * \brief writeFloat32 writes the given data in C order as an array of 32 bit floats.
+     * \param path the path of the file to write
+     * \param data the data, must hold the product of the shape entries values
+     * \param shape the dimensions of the array, e.g. height, width and channels of an image
+     * \return whether the file could be written
+     */
+    bool writeFloat32(const QString &path, const float *data, const QVector<int> &shape);
+
+}
+
+#endif // NPYFILE_H
@@ -0,0 +1,32 @@
+#include "posessnapshot.hpp"
+
+#include <QHash>
+#include <QString>
+
+PosesSnapshot::PosesSnapshot(const QList<Image> &images, const QList<ObjectModel> &objectModels,
+                             const QList<Pose> &poses) :
+    images(images),
+    objectModels(objectModels) {
+    QHash<QString, int> imageIndices, objectModelIndices;
+    for (int i = 0; i < this->images.size(); i++) {
+        imageIndices[this->images[i].getImagePath()] = i;
+    }
+    for (int i = 0; i < this->objectModels.size(); i++) {
+        objectModelIndices[this->objectModels[i].getPath()] = i;
+    }
+    // The non-const access detaches the lists from the ones of the caller, the poses point
+    // into the copies
+    for (const Pose &pose : poses) {
+        int imageIndex = imageIndices.value(pose.getImage()->getImagePath(), -1);
+        int objectModelIndex = objectModelIndices.value(pose.getObjectModel()->getPath(), -1);
+        if (imageIndex >= 0 && objectModelIndex >= 0) {
+            this->poses << Pose(pose.getID(), pose.getPosition(), pose.getRotation(),
+                                &this->images[imageIndex],
+                                &this->objectModels[objectModelIndex]);
+        }
+    }
+}
+
+const QList<Pose> &PosesSnapshot::getPoses() const {
+    return poses;
+}
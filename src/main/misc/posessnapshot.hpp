@@ -0,0 +1,39 @@
+#ifndef POSESSNAPSHOT_H
+#define POSESSNAPSHOT_H
+
+#include "model/image.hpp"
+#include "model/objectmodel.hpp"
+#include "model/pose.hpp"
+
+#include <QList>
+
+/*!
+ * \brief The PosesSnapshot class holds copies of poses together with copies of the images
+ * and object models they refer to, e.g. for a background worker while the model manager
+ * reloads its images and object models.
+ *
+ * The copied poses refer to the copied images and object models, which is why a snapshot
+ * cannot be copied itself.
+ */
+class PosesSnapshot
+{
+public:
+    /*!
+     * \brief PosesSnapshot copies the images and object models and the poses, matched to the
+     * copies by the paths of their images and object models. Poses whose image or object
+     * model is not among the given ones are left out.
+     */
+    PosesSnapshot(const QList<Image> &images, const QList<ObjectModel> &objectModels,
+                  const QList<Pose> &poses);
+
+    const QList<Pose> &getPoses() const;
+
+private:
+    Q_DISABLE_COPY(PosesSnapshot)
+
+    QList<Image> images;
+    QList<ObjectModel> objectModels;
+    QList<Pose> poses;
+};
+
+#endif // POSESSNAPSHOT_H
@@ -0,0 +1,136 @@
+"""Reader for the shared memory image ring that 6D-PAT writes decoded images to.
+
+If the network config contains "IMAGE_TRANSPORT": "shared_memory", 6D-PAT writes the images of
+IMAGE_LIST, in that order, to the shared memory object named by "IMAGE_TRANSPORT_NAME" instead
+of having the network read them from disk. Usage in the inference script:
+
+    from shmimagering import open_from_config
+
+    ring = open_from_config(config)
+    if ring is not None:
+        for image_path, image, camera_matrix in ring.frames():
+            ...
+
+The images are views into the shared memory (numpy arrays of shape (height, width, 3) in RGB
+order if numpy is available, memoryviews otherwise). A frame is only valid until the next
+frame is requested, copy it if it has to be kept longer. The image is None if 6D-PAT could
+not decode the file, the path and camera matrix are still set in that case.
+
+The layout is defined in controller/sharedmemoryimagetransport.cpp and must be kept in sync.
+"""
+
+import mmap
+import os
+import struct
+import time
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+CONFIG_KEY = "IMAGE_TRANSPORT"
+CONFIG_VALUE_SHARED_MEMORY = "shared_memory"
+CONFIG_NAME_KEY = "IMAGE_TRANSPORT_NAME"
+CONFIG_NOTIFY_KEY = "IMAGE_TRANSPORT_NOTIFY"
+
+RING_MAGIC = b"6DPATRB1"
+RING_VERSION = 1
+# magic, version, slot count, slot size, header size, write sequence, read sequence, closed
+RING_HEADER = struct.Struct("<8sIIQQQQI")
+WRITE_SEQUENCE_OFFSET = 32
+READ_SEQUENCE_OFFSET = 40
+CLOSED_OFFSET = 48
+# sequence, width, height, stride, channels, camera matrix
+SLOT_HEADER = struct.Struct("<QIIII9d")
+SLOT_PATH_OFFSET = 96
+SLOT_PATH_SIZE = 1024
+SLOT_HEADER_SIZE = 1152
+
+UINT64 = struct.Struct("<Q")
+UINT32 = struct.Struct("<I")
+
+
+class SharedMemoryImageRing(object):
+
+    def __init__(self, name, poll_interval=0.001, notify_path=None):
+        # POSIX shared memory objects live in /dev/shm on Linux, the name starts with a slash
+        self._file = open(os.path.join("/dev/shm", name.lstrip("/")), "r+b")
+        self._memory = mmap.mmap(self._file.fileno(), 0)
+        magic, version, self.slot_count, self.slot_size, self.header_size, _, _, _ = \
+            RING_HEADER.unpack_from(self._memory, 0)
+        if magic != RING_MAGIC or version != RING_VERSION:
+            self.close()
+            raise ValueError("{} is not a 6D-PAT image ring of version {}".format(name, RING_VERSION))
+        self._poll_interval = poll_interval
+        self._read_sequence = UINT64.unpack_from(self._memory, READ_SEQUENCE_OFFSET)[0]
+        # 6D-PAT sleeps on this FIFO while all slots are full instead of polling
+        self._notify = None
+        if notify_path:
+            try:
+                self._notify = os.open(notify_path, os.O_WRONLY | os.O_NONBLOCK)
+            except OSError:
+                self._notify = None
+
+    def _wait_for(self, sequence):
+        while True:
+            if UINT64.unpack_from(self._memory, WRITE_SEQUENCE_OFFSET)[0] >= sequence:
+                return True
+            if UINT32.unpack_from(self._memory, CLOSED_OFFSET)[0]:
+                # The writer might have published the last frame right before closing
+                return UINT64.unpack_from(self._memory, WRITE_SEQUENCE_OFFSET)[0] >= sequence
+            time.sleep(self._poll_interval)
+
+    def _release(self, sequence):
+        self._read_sequence = sequence
+        UINT64.pack_into(self._memory, READ_SEQUENCE_OFFSET, sequence)
+        if self._notify is not None:
+            try:
+                os.write(self._notify, b"\0")
+            except OSError:
+                # The FIFO is full, i.e. the writer has notifications pending anyway
+                pass
+
+    def frames(self):
+        """Yields (image_path, image, camera_matrix) until 6D-PAT has written all images."""
+        while True:
+            sequence = self._read_sequence + 1
+            if not self._wait_for(sequence):
+                return
+            offset = self.header_size + ((sequence - 1) % self.slot_count) * self.slot_size
+            _, width, height, stride, channels = SLOT_HEADER.unpack_from(self._memory, offset)[:5]
+            camera_matrix = SLOT_HEADER.unpack_from(self._memory, offset)[5:]
+            path_bytes = self._memory[offset + SLOT_PATH_OFFSET:offset + SLOT_PATH_OFFSET + SLOT_PATH_SIZE]
+            image_path = path_bytes.split(b"\0", 1)[0].decode("utf-8")
+            image = None
+            if width > 0 and height > 0:
+                pixels_offset = offset + SLOT_HEADER_SIZE
+                if np is not None:
+                    rows = np.frombuffer(self._memory, dtype=np.uint8, count=stride * height,
+                                         offset=pixels_offset).reshape(height, stride)
+                    image = rows[:, :width * channels].reshape(height, width, channels)
+                else:
+                    image = memoryview(self._memory)[pixels_offset:pixels_offset + stride * height]
+            if np is not None:
+                camera_matrix = np.array(camera_matrix).reshape(3, 3)
+            try:
+                yield image_path, image, camera_matrix
+            finally:
+                # The slot may only be reused by the writer once the consumer is done with it
+                image = None
+                self._release(sequence)
+
+    def close(self):
+        if self._notify is not None:
+            os.close(self._notify)
+            self._notify = None
+        self._memory.close()
+        self._file.close()
+
+
+def open_from_config(config):
+    """Returns the image ring configured in the network config or None if the images are
+    to be read from disk."""
+    if config.get(CONFIG_KEY) != CONFIG_VALUE_SHARED_MEMORY:
+        return None
+    return SharedMemoryImageRing(config[CONFIG_NAME_KEY], notify_path=config.get(CONFIG_NOTIFY_KEY))
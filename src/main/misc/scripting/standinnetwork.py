@@ -0,0 +1,148 @@
+"""Deterministic stand-in for the inference network.
+
+Speaks the same contract as the real network: it is started as
+
+    python standinnetwork.py --config <config.json>
+
+and reads IMAGE_LIST, IMAGES_PATH, CAM_INFO_PATH, OUTPUT_FILE and STREAM_PREDICTIONS from the
+config that 6D-PAT prepared. Instead of running a network it creates synthetic poses that only
+depend on the image path and the seed, i.e. two runs on the same images produce the same poses.
+This allows to test and benchmark the prediction path on machines without a GPU or the
+network's dependencies, only the Python standard library is required.
+
+Additional config keys (all optional):
+
+    STANDIN_OBJECT_MODELS   file names of the object models to create poses for ["obj_01.ply"]
+    STANDIN_POSES_PER_IMAGE number of poses per image [1]
+    STANDIN_LATENCY_MS      time that the prediction of one image takes [0]
+    STANDIN_STARTUP_MS      time until the first image is processed, e.g. loading weights [0]
+    STANDIN_SEED            seed of the synthetic poses [0]
+    STANDIN_FAIL_AFTER      exit with code 1 after this number of images, -1 never fails [-1]
+    STANDIN_TIMING_FILE     if set, a line "<image>\t<epoch milliseconds>" is appended to this
+                            file right before the prediction of the image is written
+
+If IMAGE_TRANSPORT is "shared_memory" the images are consumed from the shared memory ring
+instead of being read from disk (see shmimagering.py).
+"""
+
+import argparse
+import hashlib
+import json
+import math
+import os
+import random
+import sys
+import time
+
+
+def synthetic_pose(image_path, object_model, index, seed, camera_matrix):
+    """Creates a valid rotation and a translation in front of the camera that only depend
+    on the arguments."""
+    key = "{}|{}|{}|{}".format(seed, image_path, object_model, index).encode("utf-8")
+    generator = random.Random(hashlib.sha1(key).hexdigest())
+
+    # Uniformly distributed rotation from a random unit quaternion
+    u1, u2, u3 = generator.random(), generator.random(), generator.random()
+    qx = math.sqrt(1 - u1) * math.sin(2 * math.pi * u2)
+    qy = math.sqrt(1 - u1) * math.cos(2 * math.pi * u2)
+    qz = math.sqrt(u1) * math.sin(2 * math.pi * u3)
+    qw = math.sqrt(u1) * math.cos(2 * math.pi * u3)
+    rotation = [
+        1 - 2 * (qy * qy + qz * qz), 2 * (qx * qy - qz * qw), 2 * (qx * qz + qy * qw),
+        2 * (qx * qy + qz * qw), 1 - 2 * (qx * qx + qz * qz), 2 * (qy * qz - qx * qw),
+        2 * (qx * qz - qy * qw), 2 * (qy * qz + qx * qw), 1 - 2 * (qx * qx + qy * qy)]
+
+    # Place the object somewhere on the image, the translation is in millimeters
+    depth = generator.uniform(400.0, 1200.0)
+    fx, cx, fy, cy = camera_matrix[0], camera_matrix[2], camera_matrix[4], camera_matrix[5]
+    if fx > 0 and fy > 0:
+        u = generator.uniform(0.25, 0.75) * 2 * cx
+        v = generator.uniform(0.25, 0.75) * 2 * cy
+        translation = [(u - cx) * depth / fx, (v - cy) * depth / fy, depth]
+    else:
+        translation = [generator.uniform(-100.0, 100.0), generator.uniform(-100.0, 100.0), depth]
+    return {"obj": object_model, "R": rotation, "t": translation}
+
+
+def load_json(path, default):
+    if not path or not os.path.exists(path):
+        return default
+    with open(path) as json_file:
+        return json.load(json_file)
+
+
+def image_sources(config, image_list, camera_info):
+    """Yields (image_path, camera_matrix) in the order of the image list."""
+    ring = None
+    if config.get("IMAGE_TRANSPORT") == "shared_memory":
+        sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+        from shmimagering import open_from_config
+        ring = open_from_config(config)
+    if ring is not None:
+        for image_path, _, camera_matrix in ring.frames():
+            yield image_path, list(camera_matrix) if not hasattr(camera_matrix, "flatten") \
+                else camera_matrix.flatten().tolist()
+        return
+    for image_path in image_list:
+        full_path = os.path.join(config.get("IMAGES_PATH", ""), image_path)
+        if os.path.exists(full_path):
+            # Read the file like a real network would, the content is not needed
+            with open(full_path, "rb") as image_file:
+                image_file.read()
+        yield image_path, camera_info.get(image_path, {}).get("K", [0.0] * 9)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Deterministic stand-in for the inference network.")
+    parser.add_argument("--config", required=True, help="the config prepared by 6D-PAT")
+    arguments = parser.parse_args()
+
+    config = load_json(arguments.config, {})
+    image_list = load_json(config.get("IMAGE_LIST"), [])
+    camera_info = load_json(config.get("CAM_INFO_PATH"), {})
+    object_models = config.get("STANDIN_OBJECT_MODELS", ["obj_01.ply"])
+    poses_per_image = int(config.get("STANDIN_POSES_PER_IMAGE", 1))
+    latency = float(config.get("STANDIN_LATENCY_MS", 0)) / 1000.0
+    seed = config.get("STANDIN_SEED", 0)
+    fail_after = int(config.get("STANDIN_FAIL_AFTER", -1))
+    stream = bool(config.get("STREAM_PREDICTIONS", False))
+    timing_file = config.get("STANDIN_TIMING_FILE")
+
+    time.sleep(float(config.get("STANDIN_STARTUP_MS", 0)) / 1000.0)
+
+    print("Stand-in network running on {} images.".format(len(image_list)))
+    sys.stdout.flush()
+
+    predictions = {}
+    for index, (image_path, camera_matrix) in enumerate(image_sources(config, image_list, camera_info)):
+        if index == fail_after:
+            print("Stand-in network failing after {} images as configured.".format(index))
+            sys.stdout.flush()
+            return 1
+        if latency > 0:
+            time.sleep(latency)
+        poses = []
+        for object_model in object_models:
+            for pose_index in range(poses_per_image):
+                poses.append(synthetic_pose(image_path, object_model, pose_index, seed, camera_matrix))
+        if timing_file:
+            with open(timing_file, "a") as timing:
+                timing.write("{}\t{}\n".format(image_path, int(time.time() * 1000)))
+        if stream:
+            print(json.dumps({"type": "prediction", "image": image_path, "poses": poses}))
+            print(json.dumps({"type": "progress", "current": index + 1, "total": len(image_list)}))
+            sys.stdout.flush()
+        else:
+            predictions[image_path] = poses
+
+    if not stream:
+        output = load_json(config.get("OUTPUT_FILE"), {})
+        for image_path, poses in predictions.items():
+            output.setdefault(image_path, []).extend(poses)
+        with open(config["OUTPUT_FILE"], "w") as output_file:
+            json.dump(output, output_file, indent=4)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
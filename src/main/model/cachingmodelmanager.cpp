@@ -1,6 +1,8 @@
 #include "cachingmodelmanager.hpp"
 #include "misc/generalhelper.h"
 
+#include <QSet>
+
 CachingModelManager::CachingModelManager(LoadAndStoreStrategy& loadAndStoreStrategy) : ModelManager(loadAndStoreStrategy) {
     images = loadAndStoreStrategy.loadImages();
     objectModels = loadAndStoreStrategy.loadObjectModels();
@@ -125,6 +127,65 @@ bool CachingModelManager::addObjectImagePose(Image *image,
     return true;
 }
 
+QStringList CachingModelManager::addObjectImagePoses(const QList<Pose> &posesToAdd) {
+    QStringList addedIds;
+
+    //! Resolve the managed images and object models by their paths, the poses that are
+    //! passed might have been created with copies of them
+    QMap<QString, const Image*> imageMap;
+    for (int i = 0; i < images.size(); i++) {
+        imageMap[images.at(i).getImagePath()] = &(images.at(i));
+    }
+    QMap<QString, const ObjectModel*> objectModelMap;
+    for (int i = 0; i < objectModels.size(); i++) {
+        objectModelMap[objectModels.at(i).getPath()] = &(objectModels.at(i));
+    }
+    QSet<QString> existingIds;
+    for (const Pose &pose : poses) {
+        existingIds.insert(pose.getID());
+    }
+
+    QList<Pose> newPoses;
+    for (const Pose &pose : posesToAdd) {
+        const Image *image = imageMap.value(pose.getImage()->getImagePath());
+        const ObjectModel *objectModel = objectModelMap.value(pose.getObjectModel()->getPath());
+        if (!image || !objectModel) {
+            //! We do not manage the image or object model, just like when loading poses
+            continue;
+        }
+        QString id = pose.getID();
+        if (id.isEmpty()) {
+            id = GeneralHelper::createPoseId(image, objectModel);
+        }
+        //! The IDs are only precise up to seconds, so poses of the same image and object
+        //! model that are added in one batch would end up with the same ID
+        QString uniqueId = id;
+        for (int suffix = 1; existingIds.contains(uniqueId); suffix++) {
+            uniqueId = id + "_" + QString::number(suffix);
+        }
+        existingIds.insert(uniqueId);
+        newPoses.append(Pose(uniqueId, pose.getPosition(), pose.getRotation(), image, objectModel));
+        addedIds.append(uniqueId);
+    }
+
+    if (newPoses.isEmpty()) {
+        return addedIds;
+    }
+
+    if (!loadAndStoreStrategy.persistPoses(newPoses, false)) {
+        //! Same as for a single pose, if persisting fails we do not add the poses
+        return QStringList();
+    }
+
+    poses.append(newPoses);
+
+    createConditionalCache();
+
+    Q_EMIT posesAdded(addedIds);
+
+    return addedIds;
+}
+
 bool CachingModelManager::updateObjectImagePose(const QString &id,
                                                           QVector3D position,
                                                           QMatrix3x3 rotation) {
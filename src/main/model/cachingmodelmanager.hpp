@@ -43,6 +43,8 @@ public:
                                       QVector3D position,
                                       QMatrix3x3 rotation) override;
 
+    QStringList addObjectImagePoses(const QList<Pose> &posesToAdd) override;
+
     bool updateObjectImagePose(const QString &id,
                                          QVector3D position,
                                          QMatrix3x3 rotation) override;
@@ -1,4 +1,5 @@
 #include "image.hpp"
+#include "misc/imageloading/imagesource.hpp"
 #include <QDir>
 
 Image::Image()
@@ -29,6 +30,11 @@ Image::Image(const Image &other) {
     segmentationImagePath = other.segmentationImagePath;
     basePath = other.basePath;
     cameraMatrix = other.cameraMatrix;
+    extrinsics = other.extrinsics;
+    worldRotation = other.worldRotation;
+    worldTranslation = other.worldTranslation;
+    scene = other.scene;
+    size = other.size;
 }
 
 QString Image::getImagePath() const {
@@ -56,12 +62,49 @@ QMatrix3x3 Image::getCameraMatrix() const {
     return cameraMatrix;
 }
 
+bool Image::hasExtrinsics() const {
+    return extrinsics;
+}
+
+QMatrix3x3 Image::getWorldRotation() const {
+    return worldRotation;
+}
+
+QVector3D Image::getWorldTranslation() const {
+    return worldTranslation;
+}
+
+void Image::setExtrinsics(const QMatrix3x3 &worldRotation, const QVector3D &worldTranslation) {
+    this->worldRotation = worldRotation;
+    this->worldTranslation = worldTranslation;
+    extrinsics = true;
+}
+
+QString Image::getScene() const {
+    return scene.isEmpty() ? basePath : scene;
+}
+
+void Image::setScene(const QString &scene) {
+    this->scene = scene;
+}
+
+QSize Image::getSize() const {
+    if (!size.isValid()) {
+        size = ImageSource::readImageSize(getAbsoluteImagePath());
+    }
+    return size;
+}
+
 bool Image::operator==(const Image &other) {
     // QString supports standard string comparison ==
     return basePath == other.basePath &&
             imagePath == other.imagePath &&
             segmentationImagePath == other.segmentationImagePath &&
-            cameraMatrix == other.cameraMatrix;
+            cameraMatrix == other.cameraMatrix &&
+            extrinsics == other.extrinsics &&
+            worldRotation == other.worldRotation &&
+            worldTranslation == other.worldTranslation &&
+            scene == other.scene;
 }
 
 Image& Image::operator=(const Image &other) {
@@ -69,5 +112,10 @@ Image& Image::operator=(const Image &other) {
     imagePath = other.imagePath;
     segmentationImagePath = other.segmentationImagePath;
     cameraMatrix = other.cameraMatrix;
+    extrinsics = other.extrinsics;
+    worldRotation = other.worldRotation;
+    worldTranslation = other.worldTranslation;
+    scene = other.scene;
+    size = other.size;
     return *this;
 }
@@ -3,6 +3,8 @@
 
 #include <QString>
 #include <QMatrix3x3>
+#include <QSize>
+#include <QVector3D>
 
 /*!
  * \brief The Image class holds the path to the actual image, as well as, if provided the path to the already segmented image.
@@ -69,6 +71,38 @@ public:
 
     QMatrix3x3 getCameraMatrix() const;
 
+    /*!
+     * \brief hasExtrinsics returns whether the pose of the camera in the world, i.e. in the
+     * frame of the scene the image was captured of, is known. The extrinsics are optional,
+     * they are read from the entries R and t of the image in the info.json.
+     */
+    bool hasExtrinsics() const;
+    /*!
+     * \brief getWorldRotation returns the rotation of the extrinsics, a point x in world
+     * coordinates is at getWorldRotation() * x + getWorldTranslation() in camera coordinates.
+     */
+    QMatrix3x3 getWorldRotation() const;
+    //! Returns the translation of the extrinsics, in the units of the poses
+    QVector3D getWorldTranslation() const;
+    void setExtrinsics(const QMatrix3x3 &worldRotation, const QVector3D &worldTranslation);
+
+    /*!
+     * \brief getScene returns the identifier of the scene the image shows, images of the same
+     * scene from different views share the world frame of their extrinsics. It is the entry
+     * scene of the image in the info.json or, without one, the base path of the image.
+     */
+    QString getScene() const;
+    void setScene(const QString &scene);
+
+    /*!
+     * \brief getSize returns the size of the image in pixels. It is read from the header of
+     * the image file on the first call, without decoding the image, and then stored in this
+     * object and copies made of it afterwards. Calling it on the same object from multiple
+     * threads at once is not safe, copy the image for each thread instead.
+     * \return the size of the image or an invalid size if the file can't be read
+     */
+    QSize getSize() const;
+
     bool operator==(const Image &other);
 
     Image& operator=(const Image &other);
@@ -78,6 +112,12 @@ private:
     QString segmentationImagePath;
     QString basePath;
     QMatrix3x3 cameraMatrix;
+    bool extrinsics = false;
+    QMatrix3x3 worldRotation;
+    QVector3D worldTranslation;
+    QString scene;
+    //! Invalid until getSize() read it from the file
+    mutable QSize size;
 
 };
 
@@ -1,23 +1,28 @@
 #include "jsonloadandstorestrategy.hpp"
 #include "misc/generalhelper.h"
+#include "misc/imageloading/imagesource.hpp"
+#include "misc/directoryindexer.hpp"
 
 #include <opencv2/core/mat.hpp>
 
 #include <QSharedPointer>
-#include <QDirIterator>
-#include <QCollator>
 #include <QFileInfo>
 #include <QFile>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QJsonParseError>
+#include <QSaveFile>
 #include <QMap>
+#include <QHash>
 #include <QDir>
+#include <QtDebug>
 
 const QStringList JsonLoadAndStoreStrategy::OBJECT_MODEL_FILES_EXTENSIONS =
                                             QStringList({"*.obj", "*.ply", "*.3ds", "*.fbx"});
 const QStringList JsonLoadAndStoreStrategy::IMAGE_FILES_EXTENSIONS =
                                             QStringList({"*.jpg", "*.jpeg", "*.png", "*.tiff"});
+const int JsonLoadAndStoreStrategy::PERSIST_INTERVAL = 1000;
 
 static QString convertPathToSuffxFileName(const QString &pathToConvert,
                                           const QString &suffix,
@@ -33,91 +38,173 @@ JsonLoadAndStoreStrategy::JsonLoadAndStoreStrategy(SettingsStore *settingsStore,
     onSettingsChanged(settingsIdentifier);
 }
 
+JsonLoadAndStoreStrategy::JsonLoadAndStoreStrategy(const QString &imagesPath,
+                                                   const QString &objectModelsPath,
+                                                   const QString &posesFilePath,
+                                                   const QString &segmentationImagesPath) :
+    LoadAndStoreStrategy(Q_NULLPTR, "") {
+    connectWatcherSignals();
+    setImagesPath(imagesPath);
+    setSegmentationImagesPath(segmentationImagesPath);
+    setObjectModelsPath(objectModelsPath);
+    setPosesFilePath(posesFilePath);
+}
+
 JsonLoadAndStoreStrategy::~JsonLoadAndStoreStrategy() {
+    flushPoses();
+}
+
+//! Converts the pose to its entry in the poses file
+static QJsonObject poseToJsonEntry(const Pose &objectImagePose) {
+    //! Preparation of 3D data for the JSON file
+    QMatrix3x3 rotationMatrix = objectImagePose.getRotation();
+    QJsonArray rotationMatrixArray;
+    rotationMatrixArray << rotationMatrix(0, 0) << rotationMatrix(0, 1) << rotationMatrix(0, 2)
+                        << rotationMatrix(1, 0) << rotationMatrix(1, 1) << rotationMatrix(1, 2)
+                        << rotationMatrix(2, 0) << rotationMatrix(2, 1) << rotationMatrix(2, 2);
+    QVector3D positionVector = objectImagePose.getPosition();
+    QJsonArray positionVectorArray;
+    positionVectorArray << positionVector[0] << positionVector[1] << positionVector[2];
+    QJsonObject entry;
+    entry["id"] = objectImagePose.getID();
+    entry["obj"] = objectImagePose.getObjectModel()->getPath();
+    entry["R"] = rotationMatrixArray;
+    entry["t"] = positionVectorArray;
+    return entry;
+}
+
+//! Applies the entry of a pose to the JSON object that holds the poses of all images, i.e.
+//! either updates, adds or removes the entry with the ID of the pose
+static void writePoseEntryToJsonObject(const QString &imagePath, const QJsonObject &entry,
+                                       bool deletePose, QJsonObject &jsonObject) {
+    if (deletePose && !jsonObject.contains(imagePath)) {
+        return;
+    }
+    QJsonArray entriesForImage = jsonObject[imagePath].toArray();
+    //! We have to check whether our pose exists, and if it does, only update it
+    //! If we don't find it we have to create it anew and add it to the list of poses
+    bool entryFound = false;
+    for (int index = entriesForImage.size() - 1; index >= 0; index--) {
+        if (entriesForImage[index].toObject()["id"] == entry["id"]) {
+            entryFound = true;
+            if (deletePose) {
+                entriesForImage.removeAt(index);
+            } else {
+                entriesForImage[index] = entry;
+            }
+        }
+    }
+    if (!entryFound && !deletePose) {
+        entriesForImage << entry;
+    }
+    jsonObject[imagePath] = entriesForImage;
 }
 
 bool JsonLoadAndStoreStrategy::persistPose(
         Pose *objectImagePose, bool deletePose) {
+    if (!addPendingPoses(QList<Pose>() << *objectImagePose, deletePose)) {
+        return false;
+    }
+    if (writePendingPoses(posesFilePath)) {
+        return true;
+    }
+    //! The caller does not apply the pose if persisting fails, so it must not be written
+    //! with the next batch either, unlike the batches that are pending already
+    QList<PendingPose> &poses = pendingPoses[posesFilePath];
+    poses.removeLast();
+    if (poses.isEmpty()) {
+        pendingPoses.remove(posesFilePath);
+    }
+    return false;
+}
 
-    //! Read in the camera parameters from the JSON file
-    QFile jsonFile(posesFilePath);
-    if (jsonFile.open(QFile::ReadWrite)) {
-        QByteArray data = jsonFile.readAll();
-        QJsonDocument jsonDocument(QJsonDocument::fromJson(data));
-        QJsonObject jsonObject = jsonDocument.object();
+bool JsonLoadAndStoreStrategy::persistPoses(const QList<Pose> &poses, bool deletePoses) {
+    if (!addPendingPoses(poses, deletePoses)) {
+        return false;
+    }
+    //! Not restarted by further batches, otherwise a steady stream would never be written
+    if (!persistTimer.isActive()) {
+        persistTimer.start();
+    }
+    return true;
+}
 
-        QString imagePath = objectImagePose->getImage()->getImagePath();
-        QJsonArray entriesForImage;
-
-        if (deletePose) {
-            if (jsonObject.contains(imagePath)) {
-                entriesForImage = jsonObject[imagePath].toArray();
-                int index = 0;
-                for(const QJsonValue &entry : entriesForImage) {
-                    QJsonObject entryObject = entry.toObject();
-                    if (entryObject["id"] == objectImagePose->getID()) {
-                        entriesForImage.removeAt(index);
-                    }
-                    index++;
-                }
-                jsonObject[imagePath] = entriesForImage;
-            }
-        } else {
-            //! Preparation of 3D data for the JSON file
-            QMatrix3x3 rotationMatrix = objectImagePose->getRotation();
-            QJsonArray rotationMatrixArray;
-            rotationMatrixArray << rotationMatrix(0, 0) << rotationMatrix(0, 1) << rotationMatrix(0, 2)
-                                << rotationMatrix(1, 0) << rotationMatrix(1, 1) << rotationMatrix(1, 2)
-                                << rotationMatrix(2, 0) << rotationMatrix(2, 1) << rotationMatrix(2, 2);
-            QVector3D positionVector = objectImagePose->getPosition();
-            QJsonArray positionVectorArray;
-            positionVectorArray << positionVector[0] << positionVector[1] << positionVector[2];
-            //! Check if any entries for the image exist
-            if (jsonObject.contains(imagePath)) {
-                //! There are some entries already and we check whether the pose
-                //! already exists
-                entriesForImage = jsonObject[imagePath].toArray();
-                //! We have to check whether our pose exists, and if it does, only update it
-                //! If we don't find it we have to create it anew and add it to the list of poses
-                bool entryFound = false;
-                //! Keep track of the index if we find an existing pose
-                int index = 0;
-                //! Create new entry object, as we can't modify the exisiting ones directly somehow
-                QJsonObject entry;
-                entry["id"] = objectImagePose->getID();
-                entry["obj"] = objectImagePose->getObjectModel()->getPath();
-                entry["R"] = rotationMatrixArray;
-                entry["t"] = positionVectorArray;
-
-                for(const QJsonValue &_entry : entriesForImage) {
-                    QJsonObject entryObject = _entry.toObject();
-                    if (entryObject["id"] == objectImagePose->getID()) {
-                        entryFound = true;
-                        entriesForImage[index] = entry;
-                    }
-                    index++;
-                }
+bool JsonLoadAndStoreStrategy::addPendingPoses(const QList<Pose> &poses, bool deletePoses) {
+    //! The poses are only written later, at least fail for a file that can't be written at all
+    QFileInfo jsonFileInfo(posesFilePath);
+    if (!jsonFileInfo.isFile() || !jsonFileInfo.isWritable()) {
+        Q_EMIT failedToPersistPose("Could not write the specified JSON file.");
+        return false;
+    }
+    QList<PendingPose> &pendingPosesOfFile = pendingPoses[posesFilePath];
+    for (const Pose &pose : poses) {
+        pendingPosesOfFile.append({pose.getImage()->getImagePath(), poseToJsonEntry(pose),
+                                   deletePoses});
+    }
+    return true;
+}
 
-                if (!entryFound) {
-                    entriesForImage << entry;
-                }
-            } else {
-                QJsonObject newEntry;
-                newEntry["id"] = objectImagePose->getID();
-                newEntry["obj"] = objectImagePose->getObjectModel()->getPath();
-                newEntry["t"] = positionVectorArray;
-                newEntry["R"] = rotationMatrixArray;
-                entriesForImage << newEntry;
-            }
-        }
-        jsonObject[imagePath] = entriesForImage;
-        jsonFile.resize(0);
-        jsonFile.write(QJsonDocument(jsonObject).toJson());
+bool JsonLoadAndStoreStrategy::flushPoses() {
+    persistTimer.stop();
+    bool written = true;
+    for (const QString &filePath : pendingPoses.keys()) {
+        written = writePendingPoses(filePath) && written;
+    }
+    return written;
+}
+
+bool JsonLoadAndStoreStrategy::writePendingPoses(const QString &filePath) {
+    if (!pendingPoses.contains(filePath)) {
         return true;
-    } else {
-        Q_EMIT failedToPersistPose("Could not read the specified JSON file.");
+    }
+    //! Read in the existing poses from the JSON file right before writing it, so that we
+    //! don't overwrite changes that were made since the poses were added
+    QFile jsonFile(filePath);
+    QJsonObject jsonObject;
+    bool read = jsonFile.open(QFile::ReadOnly);
+    if (read) {
+        QByteArray content = jsonFile.readAll();
+        jsonFile.close();
+        QJsonParseError parseError;
+        QJsonDocument document = QJsonDocument::fromJson(content, &parseError);
+        //! A new poses file is empty, a broken one must not be replaced by the pending poses
+        read = content.trimmed().isEmpty() || parseError.error == QJsonParseError::NoError;
+        jsonObject = document.object();
+    }
+    if (!read) {
+        QString message = "Could not read the JSON file " + filePath
+                + ", the poses are written with the next poses.";
+        qWarning() << message;
+        Q_EMIT failedToFlushPoses(message);
+        return false;
+    }
+    for (const PendingPose &pose : pendingPoses[filePath]) {
+        writePoseEntryToJsonObject(pose.imagePath, pose.entry, pose.deletePose, jsonObject);
+    }
+
+    //! We already know about the changes we are about to write, so we don't want the
+    //! watcher to notify us about them, which would result in reloading all poses
+    bool watched = watcher.files().contains(filePath);
+    if (watched) {
+        watcher.removePath(filePath);
+    }
+    //! Replaces the file only once it is written completely
+    QSaveFile saveFile(filePath);
+    bool written = saveFile.open(QFile::WriteOnly)
+            && saveFile.write(QJsonDocument(jsonObject).toJson()) != -1
+            && saveFile.commit();
+    if (watched) {
+        watcher.addPath(filePath);
+    }
+    if (!written) {
+        QString message = "Could not write the JSON file " + filePath
+                + ", the poses are written with the next poses.";
+        qWarning() << message;
+        Q_EMIT failedToFlushPoses(message);
         return false;
     }
+    pendingPoses.remove(filePath);
+    return true;
 }
 
 static QMatrix3x3 rotVectorFromJsonRotMatrix(QJsonArray &jsonRotationMatrix) {
@@ -150,7 +237,95 @@ static Image createImageWithJsonParams(const QString& filename, const QString &s
         (float) cameraMatrix[7].toDouble(),
         (float) cameraMatrix[8].toDouble()};
     QMatrix3x3 qtCameraMatrix = QMatrix3x3(values);
-    return Image(filename, segmentationFilename, imagesPath, qtCameraMatrix);
+    Image image(filename, segmentationFilename, imagesPath, qtCameraMatrix);
+    //! The extrinsics of calibrated multi-view captures are optional
+    QJsonArray worldRotation = parameters["R"].toArray();
+    QJsonArray worldTranslation = parameters["t"].toArray();
+    if (worldRotation.size() == 9 && worldTranslation.size() == 3) {
+        image.setExtrinsics(rotVectorFromJsonRotMatrix(worldRotation),
+                            QVector3D(worldTranslation[0].toDouble(),
+                                      worldTranslation[1].toDouble(),
+                                      worldTranslation[2].toDouble()));
+    }
+    if (parameters.contains("scene")) {
+        //! Scenes are often numbered
+        image.setScene(parameters["scene"].toVariant().toString());
+    }
+    return image;
+}
+
+//! An image file and the folder or the folder within an archive it lies in
+struct ImageFile {
+    QString fileName;
+    QString basePath;
+};
+
+//! Returns the archive or video at the path or the folder at the path and the shards and
+//! videos that lie in it
+static QList<ImageSourcePtr> imageSourcesAt(const QString &path) {
+    QList<ImageSourcePtr> sources;
+    ImageSourcePtr source = ImageSource::open(path);
+    if (source.isNull()) {
+        return sources;
+    }
+    sources << source;
+    if (!QFileInfo(path).isDir()) {
+        return sources;
+    }
+    // The files of a folder come from the manifest of the DirectoryIndexer, the shards and
+    // videos are picked from the same list instead of listing the folder again
+    for (const QString &file : source->getFiles()) {
+        if (ImageSource::isArchive(file) || ImageSource::isVideo(file)) {
+            ImageSourcePtr container = ImageSource::open(source->absoluteFilePath(file));
+            if (!container.isNull()) {
+                sources << container;
+            }
+        }
+    }
+    return sources;
+}
+
+//! Lists the images of all sources sorted by their file names, the file name is the image
+//! path, so of several images with the same file name only the first one is listed
+static QList<ImageFile> listImageFiles(const QList<ImageSourcePtr> &sources) {
+    QList<ImageFile> imageFiles;
+    QHash<QString, QString> basePaths;
+    for (const ImageSourcePtr &source : sources) {
+        for (const QString &file : source->getFiles()) {
+            // Images in subfolders of archives keep their file name as image path, which is
+            // what the poses file refers to, the subfolder becomes part of the base path
+            int separator = file.lastIndexOf('/');
+            ImageFile imageFile;
+            imageFile.fileName = file.mid(separator + 1);
+            if (!QDir::match(JsonLoadAndStoreStrategy::IMAGE_FILES_EXTENSIONS,
+                             imageFile.fileName)) {
+                continue;
+            }
+            imageFile.basePath = separator < 0 ? source->getPath()
+                                               : source->absoluteFilePath(file.left(separator));
+            if (basePaths.contains(imageFile.fileName)) {
+                // Poses refer to images by file name, they could not tell the two apart
+                qWarning() << "Skipping image " + imageFile.basePath + "/" + imageFile.fileName
+                              + ", an image with the same file name is in "
+                              + basePaths[imageFile.fileName] + ".";
+                continue;
+            }
+            basePaths[imageFile.fileName] = imageFile.basePath;
+            imageFiles << imageFile;
+        }
+    }
+
+    QStringList fileNames;
+    fileNames.reserve(imageFiles.size());
+    for (const ImageFile &imageFile : imageFiles) {
+        fileNames << imageFile.fileName;
+    }
+    QList<ImageFile> sortedImageFiles;
+    sortedImageFiles.reserve(imageFiles.size());
+    for (int i : DirectoryIndexer::naturalOrder(fileNames)) {
+        sortedImageFiles << imageFiles[i];
+    }
+    return sortedImageFiles;
 }
 
 QList<Image> JsonLoadAndStoreStrategy::loadImages() {
@@ -167,56 +342,47 @@ QList<Image> JsonLoadAndStoreStrategy::loadImages() {
         return images;
     }
 
-    QStringList imageFiles = QDir(imagesPath).entryList(IMAGE_FILES_EXTENSIONS, QDir::Files, QDir::Name);
-    QStringList segmentationImageFiles =
-            QDir(segmentationImagesPath).entryList(IMAGE_FILES_EXTENSIONS, QDir::Files, QDir::Name);
-    // Also ensure that the number of elements is the same
+    //! The images can lie in the folder, in tar or zip shards in the folder or in the
+    //! archive that the path points to, frames of videos are images as well
+    QList<ImageSourcePtr> sources = imageSourcesAt(imagesPath);
+    QList<ImageFile> imageFiles = listImageFiles(sources);
+    QList<ImageFile> segmentationImageFiles;
+    if (segmentationImagesPath != "") {
+        segmentationImageFiles = listImageFiles(imageSourcesAt(segmentationImagesPath));
+    }
+    // Also ensure that the number of elements is the same, both lists are sorted and thus
+    // have the corresponding image and segmentation image at the same position
     bool segmentationImagesPathSet = segmentationImagesPath != ""
             && imageFiles.size() == segmentationImageFiles.size();
 
-    // Sort both list the have the corresponding image and segmentation image at the
-    // same position
-    QCollator collator;
-    collator.setNumericMode(true);
-
-    std::sort(
-        imageFiles.begin(),
-        imageFiles.end(),
-        [&collator](const QString &s1, const QString &s2)
-        {
-            return collator.compare(s1, s2) < 0;
-        });
-    std::sort(
-        segmentationImageFiles.begin(),
-        segmentationImageFiles.end(),
-        [&collator](const QString &s1, const QString &s2)
-        {
-            return collator.compare(s1, s2) < 0;
-        });
-
-    //! Read in the camera parameters from the JSON file
-    QFile jsonFile(QDir(imagesPath).filePath("info.json"));
-    if (imageFiles.size() > 0 && jsonFile.open(QFile::ReadOnly)) {
-        QByteArray data = jsonFile.readAll();
-        QJsonDocument jsonDocument(QJsonDocument::fromJson(data));
-        QJsonObject jsonObject = jsonDocument.object();
+    //! Read in the camera parameters from the JSON files, the shards may have their own
+    QList<QJsonObject> cameraParameters;
+    for (const ImageSourcePtr &source : sources) {
+        QByteArray data = source->readFile("info.json");
+        if (!data.isNull()) {
+            cameraParameters << QJsonDocument::fromJson(data).object();
+        }
+    }
+    if (imageFiles.size() > 0 && cameraParameters.size() > 0) {
         for (int i = 0; i < imageFiles.size(); i ++) {
-            QString image = imageFiles[i];
-            QString imageFilename = QFileInfo(image).fileName();
+            const ImageFile &imageFile = imageFiles[i];
+            QJsonObject jsonObject = cameraParameters.first();
+            for (const QJsonObject &parameters : cameraParameters) {
+                if (parameters.contains(imageFile.fileName)) {
+                    jsonObject = parameters;
+                    break;
+                }
+            }
+            QString segmentationImageFilePath;
             if (segmentationImagesPathSet) {
-                QString segmentationImageFile = segmentationImageFiles[i];
-                QString segmentationImageFilePath =
-                        QDir(segmentationImagesPath).absoluteFilePath(segmentationImageFile);
-                images.push_back(createImageWithJsonParams(imageFilename,
-                                                           segmentationImageFilePath,
-                                                           imagesPath,
-                                                           jsonObject));
-            } else {
-                images.push_back(createImageWithJsonParams(imageFilename,
-                                                           "",
-                                                           imagesPath,
-                                                           jsonObject));
+                const ImageFile &segmentationImageFile = segmentationImageFiles[i];
+                segmentationImageFilePath = QDir(segmentationImageFile.basePath)
+                        .absoluteFilePath(segmentationImageFile.fileName);
             }
+            images.push_back(createImageWithJsonParams(imageFile.fileName,
+                                                       segmentationImageFilePath,
+                                                       imageFile.basePath,
+                                                       jsonObject));
         }
     } else if (imageFiles.size() > 0) {
         //! Only if we can read images but do not find the JSON info file we raise the exception
@@ -237,26 +403,23 @@ QList<ObjectModel> JsonLoadAndStoreStrategy::loadObjectModels() {
         return objectModels;
     }
 
-    QDirIterator it(objectModelsPath, OBJECT_MODEL_FILES_EXTENSIONS, QDir::Files, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        QFileInfo fileInfo(it.next());
+    //! The subfolders are listed in parallel, reopening unchanged folders reads the manifest
+    QList<IndexedFile> files = DirectoryIndexer().index(objectModelsPath,
+                                                        OBJECT_MODEL_FILES_EXTENSIONS,
+                                                        true);
+    QStringList fileNames;
+    for (const IndexedFile &file : files) {
+        fileNames << QFileInfo(file.path).fileName();
+    }
+    //! The files are sorted by their paths, the object models by their file names
+    for (int i : DirectoryIndexer::naturalOrder(fileNames)) {
+        QFileInfo fileInfo(QDir(objectModelsPath).filePath(files[i].path));
         //! We store only the filename as object model path, because that's
         //! the format of the ground truth file used by the neural network
         ObjectModel objectModel(fileInfo.fileName(), fileInfo.absolutePath());
         objectModels.append(objectModel);
     }
 
-    QCollator collator;
-    collator.setNumericMode(true);
-
-    std::sort(
-        objectModels.begin(),
-        objectModels.end(),
-        [&collator](const ObjectModel &o1, const ObjectModel &o2)
-        {
-            return collator.compare(o1.getPath(), o2.getPath()) < 0;
-        });
-
     return objectModels;
 }
 
@@ -282,6 +445,8 @@ QMap<QString,const ObjectModel*> createObjectModelMap(const QList<ObjectModel> &
 
 QList<Pose> JsonLoadAndStoreStrategy::loadPoses(const QList<Image> &images, const QList<ObjectModel> &objectModels) {
     QList<Pose> poses;
+    //! The poses that were added last might not be written yet
+    flushPoses();
 
     //! See loadImages for why we don't throw an exception here
     if (!QFileInfo(posesFilePath).exists()) {
@@ -418,6 +583,8 @@ bool JsonLoadAndStoreStrategy::setPosesFilePath(const QString &path) {
     if (posesFilePath == path)
         return true;
 
+    //! The pending poses belong to the old file, they stay pending if they can't be written
+    flushPoses();
     watcher.removePath(posesFilePath);
     watcher.addPath(path);
     posesFilePath = path;
@@ -461,6 +628,10 @@ void JsonLoadAndStoreStrategy::onFileChanged(const QString &filePath) {
 }
 
 void JsonLoadAndStoreStrategy::connectWatcherSignals() {
+    persistTimer.setSingleShot(true);
+    persistTimer.setInterval(PERSIST_INTERVAL);
+    connect(&persistTimer, &QTimer::timeout,
+            this, &JsonLoadAndStoreStrategy::flushPoses);
     connect(&watcher, &QFileSystemWatcher::directoryChanged,
             this, &JsonLoadAndStoreStrategy::onDirectoryChanged);
     connect(&watcher, &QFileSystemWatcher::fileChanged,
@@ -6,6 +6,9 @@
 #include <QStringList>
 #include <QList>
 #include <QFileSystemWatcher>
+#include <QJsonObject>
+#include <QMap>
+#include <QTimer>
 
 /*!
  * \brief The TextFileLoadAndStoreStrategy class is a simple implementation of a LoadAndStoreStrategy that makes no use of
@@ -21,6 +24,8 @@ public:
     //! Unmodifiable constants (i.e. not changable by the user at runtime)
     static const QStringList IMAGE_FILES_EXTENSIONS;
     static const QStringList OBJECT_MODEL_FILES_EXTENSIONS;
+    //! Milliseconds that batches of poses are collected before they are written
+    static const int PERSIST_INTERVAL;
 
 public:
     /*!
@@ -32,16 +37,45 @@ public:
 
     /*!
      * \brief TextFileLoadAndStoreStrategy Convenience constructor setting the paths already.
-     * \param _imagesPath
-     * \param _objectModelsPath
-     * \param _posesPath
+     * The strategy does not listen to any settings, e.g. for tools that run without the UI.
+     * \param imagesPath the path to the folder that holds the images and the info.json
+     * \param objectModelsPath the path to the folder that holds the object models
+     * \param posesFilePath the path to the JSON file with the poses, must exist
+     * \param segmentationImagesPath the path to the segmentation images, may be empty
      */
-    JsonLoadAndStoreStrategy();
+    JsonLoadAndStoreStrategy(const QString &imagesPath,
+                             const QString &objectModelsPath,
+                             const QString &posesFilePath,
+                             const QString &segmentationImagesPath = "");
 
     ~JsonLoadAndStoreStrategy();
 
+    /*!
+     * \brief persistPose Writes the pose to the poses file right away, together with the
+     * batches that are still pending. If writing fails the pose is not written later either,
+     * since the caller does not apply it.
+     */
     bool persistPose(Pose *pose, bool deletePose) override;
 
+    /*!
+     * \brief persistPoses Adds the given poses to the pending poses and writes them at most
+     * PERSIST_INTERVAL later, so that the many small batches of e.g. streamed predictions
+     * are written a few times instead of once per batch. The poses file is read right before
+     * every write, so that changes of the file in the meantime are kept. The file watcher does
+     * not report the write as a change of the poses, since the caller already knows about the
+     * new poses.
+     * \return true if the poses file is writable and the poses were added to the pending
+     * poses, whether they are written is only known later. If the write fails,
+     * failedToFlushPoses is emitted and the poses stay pending until the next write.
+     */
+    bool persistPoses(const QList<Pose> &poses, bool deletePoses) override;
+
+    /*!
+     * \brief flushPoses Writes the pending poses, also when loading poses, changing the poses
+     * file and destroying the strategy. The poses that could not be written stay pending.
+     */
+    bool flushPoses() override;
+
     QList<Image> loadImages() override;
 
     QList<ObjectModel> loadObjectModels() override;
@@ -82,7 +116,20 @@ private:
 
     QFileSystemWatcher watcher;
 
+    //! A pose that is not written yet as entry of the poses file
+    struct PendingPose {
+        QString imagePath;
+        QJsonObject entry;
+        bool deletePose;
+    };
+    //! The poses that are not written yet by the poses file they belong to, they are kept
+    //! until they are written, also when the poses file is changed in the meantime
+    QMap<QString, QList<PendingPose>> pendingPoses;
+    QTimer persistTimer;
+
     void connectWatcherSignals();
+    bool addPendingPoses(const QList<Pose> &poses, bool deletePoses);
+    bool writePendingPoses(const QString &filePath);
 
     //! Internal methods to react to path changes
     bool setImagesPath(const QString &path);
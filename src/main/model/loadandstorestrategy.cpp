@@ -14,6 +14,20 @@ LoadAndStoreStrategy::~LoadAndStoreStrategy() {
 
 }
 
+bool LoadAndStoreStrategy::persistPoses(const QList<Pose> &poses, bool deletePoses) {
+    for (const Pose &pose : poses) {
+        Pose poseToPersist(pose);
+        if (!persistPose(&poseToPersist, deletePoses)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LoadAndStoreStrategy::flushPoses() {
+    return true;
+}
+
 void LoadAndStoreStrategy::setSettingsStore(SettingsStore *value) {
     if (settingsStore) {
         disconnect(settingsStore, &SettingsStore::settingsChanged,
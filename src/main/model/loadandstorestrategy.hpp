@@ -39,6 +39,28 @@ public:
     virtual bool persistPose(Pose *objectImagePose,
                                                   bool deletePose) = 0;
 
+    /*!
+     * \brief persistPoses Persists all the given poses at once. The default implementation
+     * simply calls persistPose for every pose, implementations should override it if they
+     * can write multiple poses in one go (e.g. by touching the underlying file only once).
+     * Implementations may also defer the write to combine several batches, flushPoses writes
+     * the deferred poses.
+     * \param poses the poses to persist
+     * \param deletePoses indicates whether the poses should be persistently deleted
+     * \return true if persisting all the poses was successful, false if not. For deferred
+     * writes true only means that the poses were accepted, failedToFlushPoses reports a failed
+     * write later.
+     */
+    virtual bool persistPoses(const QList<Pose> &poses,
+                              bool deletePoses);
+
+    /*!
+     * \brief flushPoses Writes the poses that persistPoses deferred. The default
+     * implementation does not defer anything and does nothing.
+     * \return true if writing the poses was successful, false if not
+     */
+    virtual bool flushPoses();
+
     /*!
      * \brief loadImages Loads the images.
      * \return the list of images
@@ -72,6 +94,8 @@ signals:
     void posesChanged();
     void failedToLoadPoses(const QString &message);
     void failedToPersistPose(const QString &message);
+    //! Emitted if the poses that persistPoses deferred could not be written
+    void failedToFlushPoses(const QString &message);
 
 protected slots:
     virtual void onSettingsChanged(const QString settingsIdentifier) = 0;
@@ -7,6 +7,7 @@
 #include <QObject>
 #include <QString>
 #include <QList>
+#include <QStringList>
 #include <QSharedPointer>
 
 using namespace std;
@@ -104,6 +105,17 @@ public:
                                               QVector3D position,
                                               QMatrix3x3 rotation) = 0;
 
+    /*!
+     * \brief addObjectImagePoses Adds all the given poses in one batch and persists them at once.
+     * The image and object model of the poses are resolved by their (relative) paths, i.e. they
+     * do not have to be the instances managed by this manager. Poses without an ID get a newly
+     * created one. Poses whose image or object model is not managed by this manager are skipped.
+     * Instead of one poseAdded signal per pose the signal posesAdded is Q_EMITted once.
+     * \param poses the poses to add
+     * \return the IDs of the poses that were added, empty if persisting the poses failed
+     */
+    virtual QStringList addObjectImagePoses(const QList<Pose> &poses) = 0;
+
     /*!
      * \brief addObjectImagePose Updates the given ObjectImagePose and automatically persists it according to the
      * LoadAndStoreStrategy of this Manager. If this manager does not manage the given ObjectImageCorresopndence false will be
@@ -142,6 +154,11 @@ Q_SIGNALS:
      */
     void posesChanged();
     void poseAdded(const QString &id);
+    /*!
+     * \brief posesAdded Q_EMITted when multiple poses were added at once through the
+     * batch method addObjectImagePoses.
+     */
+    void posesAdded(const QStringList &ids);
     void poseUpdated(const QString &id);
     void poseDeleted(const QString &id);
 
@@ -10,6 +10,14 @@ Settings::Settings(const Settings &preferences) {
     this->imagesPath = preferences.imagesPath;
     this->objectModelsPath = preferences.objectModelsPath;
     this->posesFilePath = preferences.posesFilePath;
+    this->pythonInterpreterPath = preferences.pythonInterpreterPath;
+    this->trainingScriptPath = preferences.trainingScriptPath;
+    this->inferenceScriptPath = preferences.inferenceScriptPath;
+    this->networkConfigPath = preferences.networkConfigPath;
+    this->inferenceChunkSize = preferences.inferenceChunkSize;
+    this->useSharedMemoryTransport = preferences.useSharedMemoryTransport;
+    this->robustPoseCreation = preferences.robustPoseCreation;
+    this->poseCreationInlierThreshold = preferences.poseCreationInlierThreshold;
     this->identifier = preferences.identifier;
 }
 
@@ -114,3 +122,43 @@ void Settings::setPythonInterpreterPath(const QString &value)
 {
     pythonInterpreterPath = value;
 }
+
+int Settings::getInferenceChunkSize() const
+{
+    return inferenceChunkSize;
+}
+
+void Settings::setInferenceChunkSize(int value)
+{
+    inferenceChunkSize = value;
+}
+
+bool Settings::getUseSharedMemoryTransport() const
+{
+    return useSharedMemoryTransport;
+}
+
+void Settings::setUseSharedMemoryTransport(bool value)
+{
+    useSharedMemoryTransport = value;
+}
+
+bool Settings::getRobustPoseCreation() const
+{
+    return robustPoseCreation;
+}
+
+void Settings::setRobustPoseCreation(bool value)
+{
+    robustPoseCreation = value;
+}
+
+float Settings::getPoseCreationInlierThreshold() const
+{
+    return poseCreationInlierThreshold;
+}
+
+void Settings::setPoseCreationInlierThreshold(float value)
+{
+    poseCreationInlierThreshold = value;
+}
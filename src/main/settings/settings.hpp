@@ -46,6 +46,22 @@ public:
     QString getPythonInterpreterPath() const;
     void setPythonInterpreterPath(const QString &value);
 
+    //! The number of images that are passed to one run of the inference script
+    int getInferenceChunkSize() const;
+    void setInferenceChunkSize(int value);
+
+    //! Whether the images are passed to the network through shared memory
+    bool getUseSharedMemoryTransport() const;
+    void setUseSharedMemoryTransport(bool value);
+
+    //! Whether clicked points that don't agree with the others are ignored when creating poses
+    bool getRobustPoseCreation() const;
+    void setRobustPoseCreation(bool value);
+
+    //! The reprojection error in pixels up to which a clicked point agrees with a pose
+    float getPoseCreationInlierThreshold() const;
+    void setPoseCreationInlierThreshold(float value);
+
 private:
     QMap<QString, QString> segmentationCodes;
     QString segmentationImagesPath;
@@ -56,6 +72,10 @@ private:
     QString trainingScriptPath;
     QString inferenceScriptPath;
     QString networkConfigPath;
+    int inferenceChunkSize = 100;
+    bool useSharedMemoryTransport = false;
+    bool robustPoseCreation = true;
+    float poseCreationInlierThreshold = 8.f;
 
     QString identifier;
 };
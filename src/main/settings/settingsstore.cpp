@@ -23,6 +23,11 @@ void SettingsStore::savePreferences(Settings *settingsPointer) {
     settings.setValue("trainingScriptPath", settingsPointer->getTrainingScriptPath());
     settings.setValue("inferenceScriptPath", settingsPointer->getInferenceScriptPath());
     settings.setValue("networkConfigPath", settingsPointer->getNetworkConfigPath());
+    settings.setValue("inferenceChunkSize", settingsPointer->getInferenceChunkSize());
+    settings.setValue("useSharedMemoryTransport", settingsPointer->getUseSharedMemoryTransport());
+    settings.setValue("robustPoseCreation", settingsPointer->getRobustPoseCreation());
+    settings.setValue("poseCreationInlierThreshold",
+                      settingsPointer->getPoseCreationInlierThreshold());
     settings.endGroup();
 
     //! Persist the object color codes so that the user does not have to enter them at each program start
@@ -58,6 +63,14 @@ QSharedPointer<Settings> SettingsStore::loadPreferencesByIdentifier(const QStrin
                 settings.value("inferenceScriptPath", "").toString());
     settingsPointer->setNetworkConfigPath(
                 settings.value("networkConfigPath", "").toString());
+    settingsPointer->setInferenceChunkSize(
+                settings.value("inferenceChunkSize", 100).toInt());
+    settingsPointer->setUseSharedMemoryTransport(
+                settings.value("useSharedMemoryTransport", false).toBool());
+    settingsPointer->setRobustPoseCreation(
+                settings.value("robustPoseCreation", true).toBool());
+    settingsPointer->setPoseCreationInlierThreshold(
+                settings.value("poseCreationInlierThreshold", 8.f).toFloat());
     settings.endGroup();
 
     settings.beginGroup(fullIdentifier + "-colorcodes");
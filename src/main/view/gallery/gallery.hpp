@@ -19,6 +19,10 @@ class Gallery : public QWidget
     Q_OBJECT
 
 public:
+    //! Models that sort or filter their items return the index of the item under this role,
+    //! it is emitted instead of the row on selection
+    static const int ItemIndexRole = Qt::UserRole;
+
     explicit Gallery(QWidget *parent = 0);
     ~Gallery();
     void setAllowFreeSelection(bool allowFreeSelection);
@@ -1,12 +1,19 @@
 #include "galleryimagemodel.hpp"
+#include "gallery.hpp"
 #include <QDebug>
 #include <QIcon>
 #include <QPainter>
 
-GalleryImageModel::GalleryImageModel(ModelManager* modelManager) {
+#include <algorithm>
+
+GalleryImageModel::GalleryImageModel(ModelManager* modelManager,
+                                     ImagePyramidCache *imagePyramidCache) {
     Q_ASSERT(modelManager != Q_NULLPTR);
+    Q_ASSERT(imagePyramidCache != Q_NULLPTR);
     this->modelManager = modelManager;
+    this->imagePyramidCache = imagePyramidCache;
     imagesCache = modelManager->getImages();
+    createIndexMapping();
     resizeImages();
     connect(modelManager, SIGNAL(imagesChanged()),
             this, SLOT(onImagesChanged()));
@@ -20,10 +27,11 @@ GalleryImageModel::~GalleryImageModel() {
 QVariant GalleryImageModel::data(const QModelIndex &index, int role) const {
     // Just in case for some weird asynchronous behavior
     // Not entirely thread-safe but might catch some errors
-    if (index.row() >= imagesCache.size())
+    if (index.row() >= indexMapping.size() || indexMapping[index.row()] >= imagesCache.size())
         return QVariant();
 
-    QString imagePath = imagesCache[index.row()].getImagePath();
+    int imageIndex = indexMapping[index.row()];
+    QString imagePath = imagesCache[imageIndex].getImagePath();
     if (role == Qt::DecorationRole) {
         if (resizedImagesCache.contains(imagePath)) {
             return QIcon(QPixmap::fromImage(resizedImagesCache[imagePath]));
@@ -38,13 +46,77 @@ QVariant GalleryImageModel::data(const QModelIndex &index, int role) const {
             return QIcon(pix);
         }
     } else if (role == Qt::ToolTipRole) {
+        if (qualityScores.contains(imagePath)) {
+            return imagePath + "\nWorst score: "
+                    + QString::number(qualityScores[imagePath], 'f', 3);
+        }
         return imagePath;
+    } else if (role == Gallery::ItemIndexRole) {
+        return imageIndex;
     }
     return QVariant();
 }
 
 int GalleryImageModel::rowCount(const QModelIndex &/* parent */) const {
-    return imagesCache.size();
+    return indexMapping.size();
+}
+
+void GalleryImageModel::setQualityScores(const QMap<QString, float> &scores) {
+    beginResetModel();
+    qualityScores = scores;
+    createIndexMapping();
+    endResetModel();
+}
+
+bool GalleryImageModel::hasQualityScores() const {
+    return !qualityScores.isEmpty();
+}
+
+void GalleryImageModel::setSortByQualityScore(bool sortByQualityScore) {
+    beginResetModel();
+    this->sortByQualityScore = sortByQualityScore;
+    createIndexMapping();
+    endResetModel();
+}
+
+void GalleryImageModel::setQualityScoreThreshold(float threshold) {
+    beginResetModel();
+    qualityScoreThreshold = threshold;
+    createIndexMapping();
+    endResetModel();
+}
+
+float GalleryImageModel::getQualityScoreThreshold() const {
+    return qualityScoreThreshold;
+}
+
+void GalleryImageModel::createIndexMapping() {
+    indexMapping.clear();
+    for (int i = 0; i < imagesCache.size(); i++) {
+        const QString &imagePath = imagesCache[i].getImagePath();
+        if (qualityScoreThreshold >= 1.f
+                || (qualityScores.contains(imagePath)
+                    && qualityScores[imagePath] < qualityScoreThreshold)) {
+            indexMapping << i;
+        }
+    }
+    if (sortByQualityScore) {
+        // Stable so that images with the same score and the ones without a score stay in
+        // the order of the model manager
+        std::stable_sort(indexMapping.begin(), indexMapping.end(), [this](int i1, int i2) {
+            const QString &imagePath1 = imagesCache[i1].getImagePath();
+            const QString &imagePath2 = imagesCache[i2].getImagePath();
+            if (!qualityScores.contains(imagePath2)) {
+                return qualityScores.contains(imagePath1);
+            }
+            return qualityScores.contains(imagePath1)
+                    && qualityScores[imagePath1] < qualityScores[imagePath2];
+        });
+    }
+    rowMapping.fill(-1, imagesCache.size());
+    for (int row = 0; row < indexMapping.size(); row++) {
+        rowMapping[indexMapping[row]] = row;
+    }
 }
 
 void GalleryImageModel::resizeImages() {
@@ -54,7 +126,7 @@ void GalleryImageModel::resizeImages() {
         resizeImagesThreadpool.waitForDone();
     }
     resizedImagesCache.clear();
-    resizeImagesRunnable = new ResizeImagesRunnable(imagesCache);
+    resizeImagesRunnable = new ResizeImagesRunnable(imagesCache, imagePyramidCache);
     connect(resizeImagesRunnable, &ResizeImagesRunnable::imageResized,
             this, &GalleryImageModel::onImageResized);
     resizeImagesThreadpool.start(resizeImagesRunnable);
@@ -62,15 +134,20 @@ void GalleryImageModel::resizeImages() {
 
 void GalleryImageModel::onImageResized(int imageIndex, QString imagePath, QImage resizedImage) {
     resizedImagesCache[imagePath] = resizedImage;
-    QModelIndex top = index(imageIndex, 0);
-    QModelIndex bottom = index(imageIndex, 0);
+    int row = rowMapping.value(imageIndex, -1);
+    if (row < 0) {
+        return;
+    }
+    QModelIndex top = index(row, 0);
+    QModelIndex bottom = index(row, 0);
     Q_EMIT dataChanged(top, bottom);
 }
 
 void GalleryImageModel::onImagesChanged() {
     imagesCache = modelManager->getImages();
+    createIndexMapping();
     resizeImages();
     QModelIndex top = index(0, 0);
-    QModelIndex bottom = index(imagesCache.size() - 1, 0);
+    QModelIndex bottom = index(indexMapping.size() - 1, 0);
     Q_EMIT dataChanged(top, bottom);
 }
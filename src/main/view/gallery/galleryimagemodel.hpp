@@ -2,15 +2,22 @@
 #define GALLERYIMAGEMODEL_H
 
 #include "model/modelmanager.hpp"
+#include "misc/imageloading/imagepyramidcache.hpp"
 #include "resizeimagesrunnable.h"
 
 #include <QAbstractListModel>
 #include <QImage>
+#include <QMap>
 #include <QThreadPool>
+#include <QVector>
 
 /*!
  * \brief The GalleryImageModel class provides the image data for a listview that is supposed to
  * display images maintained by the injected model manager.
+ *
+ * The images can be given quality scores, e.g. the worst IoU of their poses, to show the
+ * images with the worst score first or only the images below a score. The index of the image
+ * in the model manager is returned for Gallery::ItemIndexRole.
  */
 class GalleryImageModel : public QAbstractListModel
 {
@@ -20,24 +27,46 @@ public:
     /*!
      * \brief GalleryImageModel constructor.
      * \param modelManager the model manager that is supposed to be used for image retrieval
+     * \param imagePyramidCache the cache the thumbnails are read from
      */
-    explicit GalleryImageModel(ModelManager* modelManager);
+    GalleryImageModel(ModelManager* modelManager, ImagePyramidCache *imagePyramidCache);
     ~GalleryImageModel();
 
     //! Implementations of QAbstractListModel
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
     int rowCount(const QModelIndex &) const;
 
+    //! Sets the scores by the paths of the images, lower is worse
+    void setQualityScores(const QMap<QString, float> &scores);
+    bool hasQualityScores() const;
+    //! Shows the scored images from the worst score to the best one, the others after them
+    void setSortByQualityScore(bool sortByQualityScore);
+    /*!
+     * \brief setQualityScoreThreshold shows only the images whose score is below the given
+     * one, the default of 1 or more shows all images, including the ones without a score
+     */
+    void setQualityScoreThreshold(float threshold);
+    float getQualityScoreThreshold() const;
+
 private:
     ModelManager *modelManager;
+    ImagePyramidCache *imagePyramidCache;
     QList<Image> imagesCache;
     ResizeImagesRunnable *resizeImagesRunnable = Q_NULLPTR;
     QThreadPool resizeImagesThreadpool;
     QMap<QString, QImage> resizedImagesCache;
     bool abortResize = false;
+    QMap<QString, float> qualityScores;
+    bool sortByQualityScore = false;
+    float qualityScoreThreshold = 1.f;
+    //! The index of the image in imagesCache of every row and the row of every image, -1 if
+    //! it is filtered out
+    QVector<int> indexMapping;
+    QVector<int> rowMapping;
 
     void threadedResizeImages();
     void resizeImages();
+    void createIndexMapping();
 
 private Q_SLOTS:
     void onImageResized(int imageIndex, QString imagePath, QImage resizedImage);
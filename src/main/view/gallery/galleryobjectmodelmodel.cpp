@@ -1,5 +1,6 @@
 #include "galleryobjectmodelmodel.hpp"
 #include "misc/generalhelper.h"
+#include "misc/imageloading/imagesource.hpp"
 #include <QIcon>
 #include <QPainter>
 #include <QDir>
@@ -140,7 +141,8 @@ void GalleryObjectModelModel::onSelectedImageChanged(int index) {
 
         //! If we find an segmentation image update the colors that are used to filter tools
         if (image.getSegmentationImagePath().compare("") != 0) {
-            QImage loadedImage(image.getAbsoluteSegmentationImagePath());
+            QImage loadedImage =
+                    ImageSource::readImage(image.getAbsoluteSegmentationImagePath());
             for (QColor color : loadedImage.colorTable()) {
                 colorsOfCurrentImage.push_back(color);
             }
@@ -1,27 +1,27 @@
 #include "resizeimagesrunnable.h"
 
-#include <QUrl>
-
-ResizeImagesRunnable::ResizeImagesRunnable(const QList<Image> images) :
-    images(images) {
+ResizeImagesRunnable::ResizeImagesRunnable(const QList<Image> images,
+                                           ImagePyramidCache *imagePyramidCache) :
+    images(images),
+    imagePyramidCache(imagePyramidCache) {
 
 }
 
 void ResizeImagesRunnable::run() {
     int i = 0;
     for (Image image : images) {
-        if (stopProcess) {
+        if (cancellationToken.isCancelled()) {
             break;
         }
-        //beginInsertRows(QModelIndex(), resizedImagesCache.size(), resizedImagesCache.size());
-        QImage loadedImage(QUrl::fromLocalFile(image.getAbsoluteImagePath()).path());
-        // No one is going to view images larger than 300 px height
-        loadedImage = loadedImage.scaledToHeight(300);
+        // No one is going to view images larger than 300 px height, the smallest pyramid level
+        // that is at least that high is decoded at reduced size or read from the disk cache
+        QImage loadedImage = imagePyramidCache->getImage(image.getAbsoluteImagePath(),
+                                                         QSize(0, 300));
         emit imageResized(i, image.getImagePath(), loadedImage);
         i++;
     }
 }
 
 void ResizeImagesRunnable::stop() {
-    stopProcess = true;
+    cancellationToken.cancel();
 }
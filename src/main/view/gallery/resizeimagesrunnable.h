@@ -2,6 +2,8 @@
 #define RESIZEIMAGESRUNNABLE_H
 
 #include "model/image.hpp"
+#include "misc/cancellationtoken.hpp"
+#include "misc/imageloading/imagepyramidcache.hpp"
 
 #include <QList>
 #include <QRunnable>
@@ -13,7 +15,7 @@ class ResizeImagesRunnable : public QObject, public QRunnable {
     Q_OBJECT
 
 public:
-    ResizeImagesRunnable(const QList<Image> images);
+    ResizeImagesRunnable(const QList<Image> images, ImagePyramidCache *imagePyramidCache);
     void run() override;
     void stop();
 
@@ -22,7 +24,9 @@ signals:
 
 private:
     QList<Image> images;
-    bool stopProcess = false;
+    ImagePyramidCache *imagePyramidCache;
+    // stop() is called from the GUI thread while run() executes on a pool thread
+    CancellationToken cancellationToken;
 };
 
 #endif // RESIZEIMAGESRUNNABLE_H
@@ -0,0 +1,390 @@
+#include "groundtruthrenderer.hpp"
+#include "misc/generalhelper.h"
+#include "misc/global.h"
+#include "misc/npyfile.hpp"
+#include "view/poseviewer/rendering/poserenderable.hpp"
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QSurfaceFormat>
+#include <QThreadPool>
+#include <QVector>
+#include <QtDebug>
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 13, 0)
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#endif
+
+#include <algorithm>
+
+#define PROGRAM_VERTEX_ATTRIBUTE 0
+#define PROGRAM_NORMAL_ATTRIBUTE 1
+
+const QString GroundTruthRenderer::INDEX_FILE_NAME = "ground_truth.json";
+
+void GroundTruthRenderer::selectHeadlessPlatform() {
+    if (!qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")
+            || !qEnvironmentVariableIsEmpty("DISPLAY")
+            || !qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")) {
+        return;
+    }
+    qputenv("QT_QPA_PLATFORM", "minimalegl");
+    if (qEnvironmentVariableIsEmpty("EGL_PLATFORM")) {
+        qputenv("EGL_PLATFORM", "surfaceless");
+    }
+}
+
+//! Writes the instances of the first channel as 16 bit PNG, QImage only has a 16 bit
+//! grayscale format since Qt 5.13
+static bool writeWideMask(const QString &path, const QSize &size,
+                          const QVector<float> &instanceAndDepth) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    QImage mask(size, QImage::Format_Grayscale16);
+    for (int y = 0; y < size.height(); y++) {
+        quint16 *row = reinterpret_cast<quint16*>(mask.scanLine(y));
+        for (int x = 0; x < size.width(); x++) {
+            row[x] = (quint16) qBound(0.f, instanceAndDepth[(y * size.width() + x) * 4], 65535.f);
+        }
+    }
+    return mask.save(path);
+#else
+    cv::Mat mask(size.height(), size.width(), CV_16UC1);
+    for (int y = 0; y < size.height(); y++) {
+        quint16 *row = mask.ptr<quint16>(y);
+        for (int x = 0; x < size.width(); x++) {
+            row[x] = (quint16) qBound(0.f, instanceAndDepth[(y * size.width() + x) * 4], 65535.f);
+        }
+    }
+    return cv::imwrite(path.toStdString(), mask);
+#endif
+}
+
+//! State that is shared by all render threads
+struct GroundTruthRenderJob {
+    QList<Image> images;
+    QList<QList<Pose>> poses;
+    QString outputPath;
+    float nearPlane;
+    float farPlane;
+    bool writeMasks;
+    bool writeDepth;
+    bool writeObjectCoordinates;
+
+    //! Index of the next image that is to be rendered by any of the threads
+    QAtomicInt nextImage;
+    QAtomicInt renderedImages;
+    QAtomicInt failedImages;
+
+    QMutex indexMutex;
+    QJsonObject index;
+};
+
+//! Renders images of the job until all images have been taken by one of the threads
+class GroundTruthRenderRunnable : public QRunnable {
+public:
+    GroundTruthRenderRunnable(GroundTruthRenderJob *job, QOffscreenSurface *surface) :
+        job(job),
+        surface(surface) {
+    }
+
+    void run() override {
+        QOpenGLContext context;
+        context.setFormat(surface->format());
+        if (!context.create() || !context.makeCurrent(surface)) {
+            qWarning() << "Could not create an OpenGL context for rendering the ground truth.";
+            return;
+        }
+        f = context.extraFunctions();
+        f->glEnable(GL_DEPTH_TEST);
+        f->glDepthFunc(GL_LESS);
+        // Like in the pose viewer
+        f->glEnable(GL_CULL_FACE);
+
+        program.reset(new QOpenGLShaderProgram);
+        program->addShaderFromSourceFile(
+                    QOpenGLShader::Vertex, ":/shaders/poseeditor/objectcoords.vert");
+        program->addShaderFromSourceFile(
+                    QOpenGLShader::Fragment, ":/shaders/poseeditor/objectcoords.frag");
+        program->bindAttributeLocation("vertex", PROGRAM_VERTEX_ATTRIBUTE);
+        program->bindAttributeLocation("normal", PROGRAM_NORMAL_ATTRIBUTE);
+        program->link();
+
+        int imageIndex;
+        while ((imageIndex = job->nextImage.fetchAndAddOrdered(1)) < job->images.size()) {
+            const Image &image = job->images[imageIndex];
+            if (renderImage(image, job->poses[imageIndex])) {
+                int rendered = job->renderedImages.fetchAndAddOrdered(1) + 1;
+                qInfo() << QString("Rendered %1 (%2/%3)").arg(image.getImagePath())
+                           .arg(rendered).arg(job->images.size());
+            } else {
+                job->failedImages.fetchAndAddOrdered(1);
+                qWarning() << "Could not render the ground truth of " + image.getImagePath();
+            }
+        }
+
+        // The OpenGL resources have to be freed while the context is current
+        renderables.clear();
+        fbo.reset();
+        program.reset();
+        context.doneCurrent();
+    }
+
+private:
+    GroundTruthRenderJob *job;
+    QOffscreenSurface *surface;
+    QOpenGLExtraFunctions *f = Q_NULLPTR;
+    QScopedPointer<QOpenGLShaderProgram> program;
+    QScopedPointer<QOpenGLFramebufferObject> fbo;
+    //! Loading the object models is expensive, the renderables are moved to each pose instead
+    QHash<QString, QSharedPointer<PoseRenderable>> renderables;
+
+    PoseRenderable *renderableForPose(const Pose &pose) {
+        QString objectModelPath = pose.getObjectModel()->getAbsolutePath();
+        QSharedPointer<PoseRenderable> renderable = renderables.value(objectModelPath);
+        if (renderable.isNull()) {
+            renderable.reset(new PoseRenderable(pose,
+                                                PROGRAM_VERTEX_ATTRIBUTE,
+                                                PROGRAM_NORMAL_ATTRIBUTE));
+            renderables[objectModelPath] = renderable;
+        } else {
+            renderable->setPosition(pose.getPosition());
+            renderable->setRotation(pose.getRotation());
+        }
+        return renderable.data();
+    }
+
+    void prepareFramebuffer(const QSize &size) {
+        if (!fbo.isNull() && fbo->size() == size) {
+            return;
+        }
+        QOpenGLFramebufferObjectFormat format;
+        format.setAttachment(QOpenGLFramebufferObject::Depth);
+        // Multisampling would blend the values of neighbouring objects
+        format.setSamples(0);
+        format.setTextureTarget(GL_TEXTURE_2D);
+        format.setInternalTextureFormat(GL_RGBA32F);
+        fbo.reset(new QOpenGLFramebufferObject(size, format));
+        fbo->addColorAttachment(size, GL_RGBA32F);
+    }
+
+    //! Reads the given color attachment with the first row being the top of the image
+    QVector<float> readAttachment(int attachment, const QSize &size) {
+        QVector<float> flipped(size.width() * size.height() * 4);
+        f->glReadBuffer(GL_COLOR_ATTACHMENT0 + attachment);
+        f->glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_FLOAT, flipped.data());
+        QVector<float> pixels(flipped.size());
+        int rowLength = size.width() * 4;
+        for (int y = 0; y < size.height(); y++) {
+            std::copy(flipped.constData() + (size.height() - 1 - y) * rowLength,
+                      flipped.constData() + (size.height() - y) * rowLength,
+                      pixels.data() + y * rowLength);
+        }
+        return pixels;
+    }
+
+    bool renderImage(const Image &image, const QList<Pose> &poses) {
+        QSize size = image.getSize();
+        if (!size.isValid()) {
+            return false;
+        }
+        prepareFramebuffer(size);
+        fbo->bind();
+        f->glViewport(0, 0, size.width(), size.height());
+
+        GLenum bufs[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        f->glDrawBuffers(2, bufs);
+        GLfloat background[4] = { 0.f, 0.f, 0.f, 0.f };
+        f->glClearBufferfv(GL_COLOR, 0, background);
+        f->glClearBufferfv(GL_COLOR, 1, background);
+        f->glClear(GL_DEPTH_BUFFER_BIT);
+
+        QMatrix4x4 projectionMatrix = GeneralHelper::projectionMatrixFromCameraMatrix(
+                    image.getCameraMatrix(), size.width(), size.height(),
+                    job->nearPlane, job->farPlane);
+        QJsonArray instances;
+        program->bind();
+        for (int i = 0; i < poses.size(); i++) {
+            PoseRenderable *renderable = renderableForPose(poses[i]);
+            QOpenGLVertexArrayObject::Binder vaoBinder(renderable->getVertexArrayObject());
+            program->setUniformValue("projectionMatrix",
+                                     projectionMatrix * renderable->getModelViewMatrix());
+            program->setUniformValue("instanceId", (GLfloat) (i + 1));
+            f->glDrawElements(GL_TRIANGLES, renderable->getIndicesCount(), GL_UNSIGNED_INT, 0);
+
+            QJsonObject instance;
+            instance["instance"] = i + 1;
+            instance["id"] = poses[i].getID();
+            instance["obj"] = poses[i].getObjectModel()->getPath();
+            instances << instance;
+        }
+        program->release();
+        f->glFinish();
+
+        QVector<float> objectCoordinates = readAttachment(0, size);
+        QVector<float> instanceAndDepth = readAttachment(1, size);
+        fbo->release();
+
+        return writeOutput(image, size, objectCoordinates, instanceAndDepth, instances);
+    }
+
+    bool writeOutput(const Image &image, const QSize &size,
+                     const QVector<float> &objectCoordinates,
+                     const QVector<float> &instanceAndDepth,
+                     const QJsonArray &instances) {
+        QFileInfo imageInfo(image.getImagePath());
+        QString relativeBase = QDir(imageInfo.path()).filePath(imageInfo.completeBaseName());
+        QDir outputDir(job->outputPath);
+        QString basePath = outputDir.filePath(relativeBase);
+        outputDir.mkpath(QFileInfo(basePath).path());
+
+        int pixelCount = size.width() * size.height();
+        QJsonObject entry;
+        entry["instances"] = instances;
+        bool success = true;
+
+        if (job->writeMasks) {
+            // 8 bit masks are what most tools expect, more instances need 16 bit
+            bool wideMask = instances.size() > 255;
+            if (instances.size() > 65535) {
+                qWarning() << "More than 65535 poses on " + image.getImagePath()
+                              + ", the mask merges the others into instance 65535.";
+            }
+            if (wideMask) {
+                success &= writeWideMask(basePath + "_mask.png", size, instanceAndDepth);
+            } else {
+                QImage mask(size, QImage::Format_Grayscale8);
+                for (int y = 0; y < size.height(); y++) {
+                    for (int x = 0; x < size.width(); x++) {
+                        float instance = instanceAndDepth[(y * size.width() + x) * 4];
+                        mask.scanLine(y)[x] = (uchar) qBound(0.f, instance, 255.f);
+                    }
+                }
+                success &= mask.save(basePath + "_mask.png");
+            }
+            entry["mask"] = relativeBase + "_mask.png";
+        }
+
+        if (job->writeDepth) {
+            QVector<float> depth(pixelCount);
+            for (int i = 0; i < pixelCount; i++) {
+                // Pixels without an object have been cleared to 0
+                depth[i] = instanceAndDepth[i * 4 + 1];
+            }
+            success &= NpyFile::writeFloat32(basePath + "_depth.npy", depth.constData(),
+                                             {size.height(), size.width()});
+            entry["depth"] = relativeBase + "_depth.npy";
+        }
+
+        if (job->writeObjectCoordinates) {
+            QVector<float> coordinates(pixelCount * 3);
+            for (int i = 0; i < pixelCount; i++) {
+                coordinates[i * 3] = objectCoordinates[i * 4];
+                coordinates[i * 3 + 1] = objectCoordinates[i * 4 + 1];
+                coordinates[i * 3 + 2] = objectCoordinates[i * 4 + 2];
+            }
+            success &= NpyFile::writeFloat32(basePath + "_objectcoords.npy",
+                                             coordinates.constData(),
+                                             {size.height(), size.width(), 3});
+            entry["object_coordinates"] = relativeBase + "_objectcoords.npy";
+        }
+
+        QMutexLocker locker(&job->indexMutex);
+        job->index[image.getImagePath()] = entry;
+        return success;
+    }
+};
+
+GroundTruthRenderer::GroundTruthRenderer(ModelManager *modelManager, const QString &outputPath) :
+    modelManager(modelManager),
+    outputPath(outputPath) {
+}
+
+bool GroundTruthRenderer::render() {
+    if (!QDir().mkpath(outputPath)) {
+        qWarning() << "Could not create the output folder " + outputPath;
+        return false;
+    }
+
+    GroundTruthRenderJob job;
+    job.images = modelManager->getImages();
+    for (const Image &image : job.images) {
+        job.poses << modelManager->getPosesForImage(image);
+    }
+    job.outputPath = outputPath;
+    job.nearPlane = nearPlane;
+    job.farPlane = farPlane;
+    job.writeMasks = writeMasks;
+    job.writeDepth = writeDepth;
+    job.writeObjectCoordinates = writeObjectCoordinates;
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    int threads = threadCount > 0 ? threadCount : pool->maxThreadCount();
+    threads = qMax(1, qMin(threads, job.images.size()));
+    pool->setMaxThreadCount(qMax(pool->maxThreadCount(), threads));
+
+    QSurfaceFormat surfaceFormat;
+    surfaceFormat.setMajorVersion(3);
+    surfaceFormat.setMinorVersion(0);
+    surfaceFormat.setDepthBufferSize(DEPTH_BUFFER_SIZE);
+    surfaceFormat.setRenderableType(QSurfaceFormat::OpenGL);
+    surfaceFormat.setProfile(QSurfaceFormat::CoreProfile);
+    surfaceFormat.setOption(QSurfaceFormat::DeprecatedFunctions);
+
+    QList<QSharedPointer<QOffscreenSurface>> surfaces;
+    for (int i = 0; i < threads; i++) {
+        QSharedPointer<QOffscreenSurface> surface(new QOffscreenSurface());
+        surface->setFormat(surfaceFormat);
+        surface->create();
+        surfaces << surface;
+        pool->start(new GroundTruthRenderRunnable(&job, surface.data()));
+    }
+    pool->waitForDone();
+
+    QFile indexFile(QDir(outputPath).filePath(INDEX_FILE_NAME));
+    if (!indexFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "Could not write " + indexFile.fileName();
+        return false;
+    }
+    indexFile.write(QJsonDocument(job.index).toJson());
+    return job.failedImages.load() == 0 && job.renderedImages.load() == job.images.size();
+}
+
+void GroundTruthRenderer::setNearPlane(float value) {
+    nearPlane = value;
+}
+
+void GroundTruthRenderer::setFarPlane(float value) {
+    farPlane = value;
+}
+
+void GroundTruthRenderer::setThreadCount(int value) {
+    threadCount = value;
+}
+
+void GroundTruthRenderer::setWriteMasks(bool value) {
+    writeMasks = value;
+}
+
+void GroundTruthRenderer::setWriteDepth(bool value) {
+    writeDepth = value;
+}
+
+void GroundTruthRenderer::setWriteObjectCoordinates(bool value) {
+    writeObjectCoordinates = value;
+}
@@ -0,0 +1,70 @@
+#ifndef GROUNDTRUTHRENDERER_H
+#define GROUNDTRUTHRENDERER_H
+
+#include "model/modelmanager.hpp"
+
+#include <QString>
+
+/*!
+ * \brief The GroundTruthRenderer class renders the poses of all images of a model manager
+ * offscreen and writes per image
+ *
+ *  - an instance mask (PNG, 0 is background, i is the i-th pose of the image, 8 bit unless
+ *    the image has more than 255 poses, 16 bit then)
+ *  - a depth map (float32 .npy, distance from the camera plane in the units of the poses,
+ *    0 where no object is)
+ *  - an object coordinate map (float32 .npy with three channels, the coordinates of the
+ *    visible surface point in the frame of its object model)
+ *
+ * The projection is the one that the pose viewer uses to display the poses on the image.
+ * Which file belongs to which image and which instance to which pose is written to
+ * ground_truth.json in the output folder. The images are rendered on the global thread
+ * pool, every thread has its own OpenGL context, so that the renderer also runs on machines
+ * without a GPU on a software rasterizer like Mesa's llvmpipe. Tools that run on machines
+ * without a display call selectHeadlessPlatform() first.
+ */
+class GroundTruthRenderer
+{
+public:
+    GroundTruthRenderer(ModelManager *modelManager, const QString &outputPath);
+
+    //! Name of the file that lists the written files of all images
+    static const QString INDEX_FILE_NAME;
+
+    /*!
+     * \brief selectHeadlessPlatform makes Qt create its OpenGL contexts through EGL without a
+     * window system if neither QT_QPA_PLATFORM nor a display is set. The offscreen platform is
+     * no option, it creates the contexts through GLX, which needs an X display. Mesa renders
+     * without any device on the surfaceless EGL platform. Has to be called before the
+     * QGuiApplication is created.
+     */
+    static void selectHeadlessPlatform();
+
+    /*!
+     * \brief render renders the ground truth of all images and blocks until done. Has to be
+     * called from the GUI thread because the offscreen surfaces are created there.
+     * \return whether the ground truth of all images could be written
+     */
+    bool render();
+
+    void setNearPlane(float value);
+    void setFarPlane(float value);
+    void setThreadCount(int value);
+    void setWriteMasks(bool value);
+    void setWriteDepth(bool value);
+    void setWriteObjectCoordinates(bool value);
+
+private:
+    ModelManager *modelManager;
+    QString outputPath;
+    // Wider than in the pose viewer, the depth precision is not an issue because the depth
+    // is computed in the shader
+    float nearPlane = 10.f;
+    float farPlane = 10000.f;
+    int threadCount = 0;
+    bool writeMasks = true;
+    bool writeDepth = true;
+    bool writeObjectCoordinates = true;
+};
+
+#endif // GROUNDTRUTHRENDERER_H
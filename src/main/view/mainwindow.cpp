@@ -5,6 +5,7 @@
 #include <QSettings>
 #include <QCloseEvent>
 #include <QMessageBox>
+#include <QInputDialog>
 #include <QLayout>
 
 //! The main window of the application that holds the individual components.<
@@ -17,10 +18,15 @@ MainWindow::MainWindow(QWidget *parent) :
     setStatusBarText(QString("Loading..."));
 
     // If the selected image changes, we also need to cancel any started creation of a pose
+    // Unless the images are views of a calibrated scene, which the points are kept for
     connect(ui->galleryLeft, &Gallery::selectedItemChanged,
-            this, &MainWindow::poseCreationAborted);
+            this, &MainWindow::onImageChangedDuringPoseCreation);
     connect(ui->galleryRight, &Gallery::selectedItemChanged,
             this, &MainWindow::poseCreationAborted);
+    connect(ui->poseEditor, &PoseEditor::poseRefinementRequested,
+            this, &MainWindow::poseRefinementRequested);
+    connect(ui->poseEditor, &PoseEditor::posePropagationRequested,
+            this, &MainWindow::posePropagationRequested);
 }
 
 MainWindow::~MainWindow() {
@@ -104,6 +110,7 @@ void MainWindow::setPathOnRightNavigationControls(const QString &path) {
 }
 
 void MainWindow::setGalleryImageModel(GalleryImageModel* model) {
+    this->galleryImageModel = model;
     this->ui->galleryLeft->setModel(model);
 }
 
@@ -123,6 +130,14 @@ void MainWindow::setModelManager(ModelManager* modelManager) {
     ui->poseEditor->setModelManager(modelManager);
 }
 
+void MainWindow::setImagePyramidCache(ImagePyramidCache *imagePyramidCache) {
+    ui->poseViewer->setImagePyramidCache(imagePyramidCache);
+}
+
+void MainWindow::onPoseRefined(const QString &poseId, QVector3D position, QMatrix3x3 rotation) {
+    ui->poseEditor->onPoseRefined(poseId, position, rotation);
+}
+
 void MainWindow::resetPoseViewer() {
     ui->poseViewer->reset();
 }
@@ -263,6 +278,17 @@ void MainWindow::onPoseCreationReset() {
     poseCreationInProgress = false;
 }
 
+void MainWindow::abortPoseCreation() {
+    onPoseCreationReset();
+    Q_EMIT poseCreationAborted();
+}
+
+void MainWindow::onImageChangedDuringPoseCreation() {
+    // The clicks belong to the previous image, the points clicked on the object model stay
+    ui->poseViewer->onPoseCreationAborted();
+    Q_EMIT poseCreationInterrupted();
+}
+
 void MainWindow::onPoseCreationRequested() {
     setStatusBarText("Creating pose...");
     Q_EMIT requestPoseCreation();
@@ -270,10 +296,37 @@ void MainWindow::onPoseCreationRequested() {
 }
 
 void MainWindow::hideNetworkProgressView() {
+    if (networkProgressView.isNull() || networkProgressView->isHidden()) {
+        return;
+    }
     networkProgressView->hide();
     QApplication::restoreOverrideCursor();
 }
 
+void MainWindow::setNetworkProgress(int current, int total) {
+    if (!networkProgressView.isNull()) {
+        networkProgressView->setProgress(current, total);
+    }
+}
+
+void MainWindow::setNetworkThroughput(double imagesPerSecond) {
+    if (!networkProgressView.isNull()) {
+        networkProgressView->setThroughput(imagesPerSecond);
+    }
+}
+
+void MainWindow::showNetworkProgressView() {
+    if (networkProgressView.isNull()) {
+        networkProgressView.reset(new NetworkProgressView(this));
+        connect(networkProgressView.data(), &NetworkProgressView::stopRequested,
+                this, &MainWindow::networkStopRequested);
+    }
+    networkProgressView->resetProgress();
+    networkProgressView->show();
+    networkProgressView->setGeometry(QRect(0, 0, this->width(), this->height()));
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+}
+
 void MainWindow::onSettingsChanged(const QString &identifier) {
     QSharedPointer<Settings> preferences = preferencesStore->loadPreferencesByIdentifier(identifier);
     setPathOnLeftBreadcrumbView(preferences->getImagesPath());
@@ -335,23 +388,61 @@ void MainWindow::onActionNetworkPredictTriggered() {
     neuralNetworkDialog->show();
 }
 
-void MainWindow::onPosePredictionRequestedForImages(QList<Image> images) {
-    if (networkProgressView.isNull()) {
-        networkProgressView.reset(new NetworkProgressView(this));
+void MainWindow::onActionInterpolatePosesTriggered() {
+    Q_EMIT poseInterpolationRequested();
+}
+
+void MainWindow::onActionPropagateToViewsTriggered() {
+    Image *image = getCurrentlyViewedImage();
+    if (!image) {
+        setStatusBarText("Select the image whose poses are to be propagated first.");
+        return;
     }
-    networkProgressView->show();
-    networkProgressView->setGeometry(QRect(0, 0, this->width(), this->height()));
-    QApplication::setOverrideCursor(Qt::WaitCursor);
+    Q_EMIT posePropagationToViewsRequested(*image);
+}
+
+void MainWindow::onActionScorePosesTriggered() {
+    Q_EMIT poseScoringRequested();
+}
+
+void MainWindow::onActionSortImagesByScoreToggled(bool checked) {
+    if (!galleryImageModel->hasQualityScores() && checked) {
+        setStatusBarText("The images have no scores yet, score the poses against the "
+                         "segmentations first.");
+    }
+    galleryImageModel->setSortByQualityScore(checked);
+}
+
+void MainWindow::onActionFilterImagesByScoreTriggered() {
+    bool ok;
+    double threshold = QInputDialog::getDouble(
+                this, "Filter Images by Score",
+                "Show only the images whose worst pose has an IoU below (1 shows all images):",
+                galleryImageModel->getQualityScoreThreshold(), 0.0, 1.0, 2, &ok);
+    if (ok) {
+        galleryImageModel->setQualityScoreThreshold((float) threshold);
+        if (threshold < 1.0 && !galleryImageModel->hasQualityScores()) {
+            setStatusBarText("The images have no scores yet, score the poses against the "
+                             "segmentations first.");
+        }
+    }
+}
+
+void MainWindow::onActionComputeVisibilityTriggered() {
+    Q_EMIT visibilityComputationRequested();
+}
+
+void MainWindow::onActionCheckPenetrationsTriggered() {
+    Q_EMIT penetrationCheckRequested();
+}
+
+void MainWindow::onPosePredictionRequestedForImages(QList<Image> images) {
+    showNetworkProgressView();
     emit posePredictionRequestedForImages(images);
 }
 
 void MainWindow::onPosePredictionRequested() {
-    if (networkProgressView.isNull()) {
-        networkProgressView.reset(new NetworkProgressView(this));
-    }
-    networkProgressView->show();
-    networkProgressView->setGeometry(QRect(0, 0, this->width(), this->height()));
-    QApplication::setOverrideCursor(Qt::WaitCursor);
+    showNetworkProgressView();
     Q_EMIT posePredictionRequested();
 }
 
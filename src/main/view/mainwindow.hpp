@@ -2,6 +2,7 @@
 #define MAINWINDOW_H
 
 #include "view/navigationcontrols/navigationcontrols.hpp"
+#include "model/pose.hpp"
 #include "settings/settingsstore.hpp"
 #include "view/gallery/galleryimagemodel.hpp"
 #include "view/gallery/galleryobjectmodelmodel.hpp"
@@ -75,6 +76,11 @@ public:
      */
     void setModelManager(ModelManager* modelManager);
 
+    /*!
+     * \brief setImagePyramidCache sets the cache that the pose viewer loads its images through.
+     */
+    void setImagePyramidCache(ImagePyramidCache *imagePyramidCache);
+
     void setPreferencesStore(SettingsStore *preferencesStore);
 
     /*!
@@ -84,6 +90,18 @@ public:
      */
     Image *getCurrentlyViewedImage();
 
+    /*!
+     * \brief onPoseRefined passes a refined pose on to the pose editor, which displays it if
+     * the user is still editing the pose.
+     */
+    void onPoseRefined(const QString &poseId, QVector3D position, QMatrix3x3 rotation);
+
+    /*!
+     * \brief abortPoseCreation resets the views as if the user aborted the creation of the
+     * pose through the menu.
+     */
+    void abortPoseCreation();
+
     void resizeEvent(QResizeEvent *event) override;
 
 public Q_SLOTS:
@@ -179,6 +197,19 @@ public Q_SLOTS:
      */
     void hideNetworkProgressView();
 
+    /*!
+     * \brief setNetworkProgress will be called externally when the network reports its progress
+     * \param current the number of processed items
+     * \param total the total number of items
+     */
+    void setNetworkProgress(int current, int total);
+
+    /*!
+     * \brief setNetworkThroughput will be called externally when the network has completed images
+     * \param imagesPerSecond the number of images the network processes per second
+     */
+    void setNetworkThroughput(double imagesPerSecond);
+
 Q_SIGNALS:
     /*!
      * \brief imageClicked Q_EMITted when the image in the pose viewer is clicked.
@@ -238,7 +269,8 @@ Q_SIGNALS:
      * overlay that is being added to the view as soon as the image is clicked anywhere. Clicking
      * the overlay can be an accident or because the image was clicked at the wrong position.
      * Thus we assume that the user only interrupted the creation, not aborted it. The user
-     * can abort the creation from the menu.
+     * can abort the creation from the menu. It is also Q_EMITted when the user selects another
+     * image, which might be another view of the object.
      */
     void poseCreationInterrupted();
 
@@ -269,7 +301,50 @@ Q_SIGNALS:
     void objectModelsPathChanged(const QString &newPath);
 
     void posePredictionRequested();
+    /*!
+     * \brief poseRefinementRequested Q_EMITted when the user wants the pose that is being
+     * edited to be aligned with the image automatically
+     * \param pose the pose as it is currently displayed
+     */
+    void poseRefinementRequested(const Pose &pose);
+    /*!
+     * \brief posePropagationRequested Q_EMITted when the user wants the pose that is being
+     * edited to be tracked through the neighbouring images
+     * \param pose the pose as it is currently displayed
+     * \param frames the number of images before and after the image of the pose
+     */
+    void posePropagationRequested(const Pose &pose, int frames);
+    /*!
+     * \brief poseInterpolationRequested Q_EMITted when the user wants the images between
+     * annotated keyframes to be filled with interpolated poses
+     */
+    void poseInterpolationRequested();
+    /*!
+     * \brief posePropagationToViewsRequested Q_EMITted when the user wants the poses of the
+     * image to be transferred to the other views of its scene
+     * \param image the image that is currently viewed
+     */
+    void posePropagationToViewsRequested(const Image &image);
+    /*!
+     * \brief poseScoringRequested Q_EMITted when the user wants all poses to be compared with
+     * the segmentation images
+     */
+    void poseScoringRequested();
+    /*!
+     * \brief visibilityComputationRequested Q_EMITted when the user wants the visible
+     * fraction of all poses to be computed
+     */
+    void visibilityComputationRequested();
+    /*!
+     * \brief penetrationCheckRequested Q_EMITted when the user wants all poses to be checked
+     * for objects that intersect other objects of the same image
+     */
+    void penetrationCheckRequested();
     void posePredictionRequestedForImages(QList<Image> images);
+    /*!
+     * \brief networkStopRequested Q_EMITted when the user wants to stop the running network
+     */
+    void networkStopRequested();
 
 private:
     Ui::MainWindow *ui;
@@ -280,6 +355,8 @@ private:
 
     SettingsStore *preferencesStore = Q_NULLPTR;
     ModelManager* modelManager;
+    // To sort and filter the images by their quality scores
+    GalleryImageModel *galleryImageModel = Q_NULLPTR;
 
     // Used to write and read main view related settings, like position etc.
     void writeSettings();
@@ -310,6 +387,8 @@ private:
     static QString SPLITTER_RIGHT_SIZE_TOP_KEY;
     static QString SPLITTER_RIGHT_SIZE_BOTTOM_KEY;
 
+    void showNetworkProgressView();
+
 private Q_SLOTS:
     // Mouse event receivers of the bottom left widget to draw a line behind the mouse when the user
     // right clicks in the image to start creating a pose
@@ -323,6 +402,14 @@ private Q_SLOTS:
     void onActionAbortCreationTriggered();
     void onActionReloadViewsTriggered();
     void onActionNetworkPredictTriggered();
+    void onActionInterpolatePosesTriggered();
+    void onActionPropagateToViewsTriggered();
+    void onActionScorePosesTriggered();
+    void onActionSortImagesByScoreToggled(bool checked);
+    void onActionFilterImagesByScoreTriggered();
+    void onActionComputeVisibilityTriggered();
+    void onActionCheckPenetrationsTriggered();
+    void onImageChangedDuringPoseCreation();
     void onPosePredictionRequestedForImages(QList<Image> images);
     void onPosePredictionRequested();
 };
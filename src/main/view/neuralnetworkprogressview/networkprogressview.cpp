@@ -12,9 +12,31 @@ NetworkProgressView::NetworkProgressView(QWidget *parent) :
     setAttribute(Qt::WA_NoSystemBackground, true);
     //setAttribute(Qt::WA_TranslucentBackground, true);
     setStyleSheet("background-color: rgba(0,0,0,240)");
+    connect(ui->buttonStop, &QPushButton::clicked, this, &NetworkProgressView::stopRequested);
 }
 
 NetworkProgressView::~NetworkProgressView()
 {
     delete ui;
 }
+
+void NetworkProgressView::setProgress(int current, int total) {
+    if (total <= 0) {
+        resetProgress();
+        return;
+    }
+    ui->progressBar->setMaximum(total);
+    ui->progressBar->setValue(qMin(current, total));
+}
+
+void NetworkProgressView::resetProgress() {
+    // Maximum 0 shows the busy indicator
+    ui->progressBar->setMaximum(0);
+    ui->progressBar->setValue(-1);
+    ui->label->setText("Inference in Progress...");
+}
+
+void NetworkProgressView::setThroughput(double imagesPerSecond) {
+    ui->label->setText("Inference in Progress... ("
+                       + QString::number(imagesPerSecond, 'f', 1) + " images/s)");
+}
@@ -15,6 +15,30 @@ public:
     explicit NetworkProgressView(QWidget *parent = 0);
     ~NetworkProgressView();
 
+public Q_SLOTS:
+    /*!
+     * \brief setProgress displays the progress the network reported. As long as no
+     * progress has been reported the progress bar shows a busy indicator.
+     * \param current the number of processed items
+     * \param total the total number of items, 0 if unknown
+     */
+    void setProgress(int current, int total);
+    /*!
+     * \brief resetProgress resets the progress bar to the busy indicator
+     */
+    void resetProgress();
+    /*!
+     * \brief setThroughput displays how many images the network processes per second
+     * \param imagesPerSecond the number of images per second
+     */
+    void setThroughput(double imagesPerSecond);
+
+Q_SIGNALS:
+    /*!
+     * \brief stopRequested Q_EMITted when the user clicks the stop button
+     */
+    void stopRequested();
+
 private:
     Ui::NetworkProgressView *ui;
 };
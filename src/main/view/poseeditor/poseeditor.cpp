@@ -9,6 +9,7 @@
 #include <QUrl>
 #include <QThread>
 #include <QMessageBox>
+#include <QInputDialog>
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QSizePolicy>
@@ -28,6 +29,8 @@ PoseEditor::PoseEditor(QWidget *parent, ModelManager *modelManager) :
         // to remove all visualizations because the pose creation process was finished
         connect(modelManager, SIGNAL(poseAdded(QString)),
                 this, SLOT(onPoseAdded(QString)));
+        connect(modelManager, SIGNAL(posesAdded(QStringList)),
+                this, SLOT(onPosesAdded(QStringList)));
         connect(modelManager, SIGNAL(poseDeleted(QString)),
                 this, SLOT(onPoseDeleted(QString)));
         // Reset view when object models are changed of course but also when the
@@ -58,6 +61,8 @@ void PoseEditor::setModelManager(ModelManager *modelManager) {
     if (this->modelManager) {
         disconnect(this->modelManager, SIGNAL(poseAdded(QString)),
                    this, SLOT(onPoseAdded(QString)));
+        disconnect(this->modelManager, SIGNAL(posesAdded(QStringList)),
+                   this, SLOT(onPosesAdded(QStringList)));
         disconnect(this->modelManager, SIGNAL(poseDeleted(QString)),
                 this, SLOT(poseDeleted(QString)));
         disconnect(modelManager, SIGNAL(objectModelsChanged()),
@@ -70,6 +75,8 @@ void PoseEditor::setModelManager(ModelManager *modelManager) {
     this->modelManager = modelManager;
     connect(modelManager, SIGNAL(poseAdded(QString)),
             this, SLOT(onPoseAdded(QString)));
+    connect(modelManager, SIGNAL(posesAdded(QStringList)),
+            this, SLOT(onPosesAdded(QStringList)));
     connect(modelManager, SIGNAL(poseDeleted(QString)),
             this, SLOT(onPoseDeleted(QString)));
     connect(modelManager, SIGNAL(objectModelsChanged()),
@@ -90,6 +97,8 @@ void PoseEditor::setEnabledPoseEditorControls(bool enabled) {
     // The next line is the difference to setEnabledAllControls
     ui->buttonRemove->setEnabled(enabled);
     ui->buttonSave->setEnabled(enabled);
+    ui->buttonRefine->setEnabled(enabled);
+    ui->buttonPropagate->setEnabled(enabled);
     ui->sliderOpacity->setEnabled(enabled);
 }
 
@@ -105,6 +114,8 @@ void PoseEditor::setEnabledAllControls(bool enabled) {
     ui->buttonCreate->setEnabled(enabled);
     ui->comboBoxPose->setEnabled(enabled);
     ui->buttonSave->setEnabled(enabled);
+    ui->buttonRefine->setEnabled(enabled);
+    ui->buttonPropagate->setEnabled(enabled);
     ui->buttonPredict->setEnabled(enabled);
 }
 
@@ -213,6 +224,23 @@ void PoseEditor::onPoseAdded(const QString &pose) {
     ui->openGLWidget->removeClicks();
 }
 
+void PoseEditor::onPosesAdded(const QStringList &poses) {
+    if (currentlySelectedImage.getImagePath().isEmpty()) {
+        return;
+    }
+    for (const QString &id : poses) {
+        QSharedPointer<Pose> actualPose = modelManager->getPoseById(id);
+        if (!actualPose.isNull() &&
+                actualPose->getImage()->getImagePath() == currentlySelectedImage.getImagePath()) {
+            //! Only refresh the list of poses, the pose that is currently being edited
+            //! stays selected so that the user is not interrupted by the network
+            addPosesToComboBoxPoses(&currentlySelectedImage,
+                                    currentPose ? currentPose->getID() : "");
+            return;
+        }
+    }
+}
+
 void PoseEditor::onPoseDeleted(const QString& /* pose */) {
     // Just select the default entry
     ui->comboBoxPose->setCurrentIndex(0);
@@ -319,6 +347,31 @@ void PoseEditor::onButtonSaveClicked() {
     ui->buttonSave->setEnabled(false);
 }
 
+void PoseEditor::onButtonRefineClicked() {
+    Q_EMIT poseRefinementRequested(*currentPose);
+}
+
+void PoseEditor::onButtonPropagateClicked() {
+    bool ok;
+    int frames = QInputDialog::getInt(this, "Propagate pose",
+                                      "Number of images before and after this one:",
+                                      10, 1, 10000, 1, &ok);
+    if (ok) {
+        Q_EMIT posePropagationRequested(*currentPose, frames);
+    }
+}
+
+void PoseEditor::onPoseRefined(const QString &poseId, QVector3D position, QMatrix3x3 rotation) {
+    if (!currentPose || currentPose->getID() != poseId) {
+        return;
+    }
+    currentPose->setPosition(position);
+    currentPose->setRotation(rotation);
+    setPoseValuesOnControls(currentPose.get());
+    Q_EMIT poseUpdated(currentPose.get());
+    ui->buttonSave->setEnabled(true);
+}
+
 void PoseEditor::onComboBoxPoseIndexChanged(int index) {
     if (index < 0 || ignoreValueChanges)
         return;
@@ -65,6 +65,14 @@ public Q_SLOTS:
      * \brief reset resets this view, i.e. clears the displayed object models
      */
     void reset();
+    /*!
+     * \brief onPoseRefined displays the refined pose if it is still being edited. The pose
+     * is not stored before the user saves it.
+     * \param poseId the ID of the refined pose
+     * \param position the refined position
+     * \param rotation the refined rotation
+     */
+    void onPoseRefined(const QString &poseId, QVector3D position, QMatrix3x3 rotation);
 
 Q_SIGNALS:
 
@@ -83,6 +91,16 @@ Q_SIGNALS:
      * The button is only enabled when enough pose points where clicked.
      */
     void buttonCreateClicked();
+    /*!
+     * \brief poseRefinementRequested is Q_EMITted when the user clicks the refine button,
+     * with the pose as it is currently displayed, i.e. including unsaved changes.
+     */
+    void poseRefinementRequested(const Pose &pose);
+    /*!
+     * \brief posePropagationRequested is Q_EMITted when the user clicks the propagate button
+     * and chose how many images before and after the image of the pose it is tracked through.
+     */
+    void posePropagationRequested(const Pose &pose, int frames);
     void poseUpdated(Pose *pose);
     void poseCreationAborted();
     void opacityChangeStarted(int opacity);
@@ -120,6 +138,7 @@ private Q_SLOTS:
      */
     void updateCurrentlyEditedPose();
     void onPoseAdded(const QString &pose);
+    void onPosesAdded(const QStringList &poses);
     void onPoseDeleted(const QString &pose);
 
     void onGLWidgetXRotationChanged(float angle);
@@ -135,6 +154,8 @@ private Q_SLOTS:
     void onButtonPredictClicked();
     void onButtonCreateClicked();
     void onButtonSaveClicked();
+    void onButtonRefineClicked();
+    void onButtonPropagateClicked();
     /*!
      * \brief removeCurrentlyEditedPose gets called when the user wants to remove the
      * currenlty edited pose from the currenlty displayed image.
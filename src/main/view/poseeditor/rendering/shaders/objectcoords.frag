@@ -1,5 +1,10 @@
 #version 130
 in highp vec3 vert;
+// Written to the second render target together with the depth, the pose editor does not
+// attach one and ignores it
+uniform highp float instanceId;
 void main() {
            gl_FragData[0] = vec4(vert, 1.0);
+           // Distance from the camera plane, 1 / w of the projection is the view space depth
+           gl_FragData[1] = vec4(instanceId, 1.0 / gl_FragCoord.w, 0.0, 1.0);
 }
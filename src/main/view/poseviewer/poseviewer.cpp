@@ -42,15 +42,24 @@ void PoseViewer::setModelManager(ModelManager* modelManager) {
         disconnect(modelManager, SIGNAL(posesChanged()), this, SLOT(onPosesChanged()));
         disconnect(modelManager, SIGNAL(poseAdded(QString)),
                    this, SLOT(onPoseAdded(QString)));
+        disconnect(modelManager, SIGNAL(posesAdded(QStringList)),
+                   this, SLOT(onPosesAdded(QStringList)));
         disconnect(modelManager, SIGNAL(poseDeleted(QString)),
                    this, SLOT(onPoseDeleted(QString)));
-        disconnect(this->modelManager, SIGNAL(imagesChanged()), this, SLOT(reset()));
+        disconnect(this->modelManager, SIGNAL(imagesChanged()), this, SLOT(onImagesChanged()));
         disconnect(this->modelManager, SIGNAL(objectModelsChanged()), this, SLOT(reset()));
     }
     this->modelManager = modelManager;
     connectModelManagerSlots();
 }
 
+void PoseViewer::setImagePyramidCache(ImagePyramidCache *imagePyramidCache) {
+    Q_ASSERT(imagePyramidCache != Q_NULLPTR);
+    this->imagePyramidCache = imagePyramidCache;
+    delete imagePrefetcher;
+    imagePrefetcher = new ImagePrefetcher(imagePyramidCache, this);
+}
+
 Image *PoseViewer::getCurrentlyViewedImage() {
     return currentlyDisplayedImage.data();
 }
@@ -74,21 +83,71 @@ void PoseViewer::setImage(Image *image) {
     } else {
         ui->buttonSwitchView->setEnabled(true);
     }
-    QString toDisplay = showingNormalImage ?  currentlyDisplayedImage->getAbsoluteImagePath() :
-                                    currentlyDisplayedImage->getAbsoluteSegmentationImagePath();
+    ImagePyramidPtr toDisplay = imagePrefetcher->load(displayedImagePath(*currentlyDisplayedImage));
     QList<Pose> posesForImage = modelManager->getPosesForImage(*image);
     ui->openGLWidget->setBackgroundImageAndPoses(toDisplay,
                                                            image->getCameraMatrix(),
                                                            posesForImage);
+    prefetchNeighbours();
+}
+
+QString PoseViewer::displayedImagePath(const Image &image) {
+    return showingNormalImage ? image.getAbsoluteImagePath() :
+                                image.getAbsoluteSegmentationImagePath();
+}
 
+void PoseViewer::prefetchNeighbours() {
+    QList<Image> images = modelManager->getImages();
+    int index = -1;
+    for (int i = 0; i < images.size(); i++) {
+        if (images[i].getImagePath() == currentlyDisplayedImage->getImagePath()) {
+            index = i;
+            break;
+        }
+    }
+    if (index == -1) {
+        return;
+    }
+    int direction = index < previousImageIndex ? -1 : 1;
+    previousImageIndex = index;
+
+    QList<int> offsets;
+    for (int i = 1; i <= ImagePrefetcher::PREFETCH_AHEAD; i++) {
+        offsets << i * direction;
+    }
+    for (int i = 1; i <= ImagePrefetcher::PREFETCH_BEHIND; i++) {
+        offsets << -i * direction;
+    }
+    QStringList paths;
+    for (int offset : offsets) {
+        int neighbour = index + offset;
+        if (neighbour < 0 || neighbour >= images.size()) {
+            continue;
+        }
+        // Images without segmentation image are displayed normally when they are reached
+        if (!showingNormalImage && images[neighbour].getSegmentationImagePath().isEmpty()) {
+            paths << images[neighbour].getAbsoluteImagePath();
+        } else {
+            paths << displayedImagePath(images[neighbour]);
+        }
+    }
+    imagePrefetcher->prefetch(paths, ui->openGLWidget->getDisplayScale());
+    QList<ImagePyramidPtr> pyramids;
+    for (const QString &path : paths) {
+        pyramids << imagePrefetcher->load(path);
+    }
+    // Decoding ahead alone still leaves the upload of the tiles for when the image is shown
+    ui->openGLWidget->preloadBackgroundImages(pyramids);
 }
 
 void PoseViewer::connectModelManagerSlots() {
     connect(modelManager, SIGNAL(poseAdded(QString)),
                this, SLOT(onPoseAdded(QString)));
+    connect(modelManager, SIGNAL(posesAdded(QStringList)),
+               this, SLOT(onPosesAdded(QStringList)));
     connect(modelManager, SIGNAL(poseDeleted(QString)),
                this, SLOT(onPoseDeleted(QString)));
-    connect(modelManager, SIGNAL(imagesChanged()), this, SLOT(reset()));
+    connect(modelManager, SIGNAL(imagesChanged()), this, SLOT(onImagesChanged()));
     connect(modelManager, SIGNAL(objectModelsChanged()), this, SLOT(reset()));
     connect(modelManager, SIGNAL(posesChanged()), this, SLOT(onPosesChanged()));
 }
@@ -103,6 +162,7 @@ void PoseViewer::reset() {
     ui->buttonResetPosition->setEnabled(false);
     ui->buttonSwitchView->setEnabled(false);
     currentlyDisplayedImage.reset();
+    previousImageIndex = -1;
 }
 
 void PoseViewer::reloadPoses() {
@@ -163,12 +223,11 @@ void PoseViewer::onOpacityChangeEnded() {
 void PoseViewer::switchImage() {
     ui->buttonSwitchView->setIcon(awesome->icon(showingNormalImage ? fa::toggleon : fa::toggleoff));
     showingNormalImage = !showingNormalImage;
-    if (showingNormalImage)
-        ui->openGLWidget->setBackgroundImage(currentlyDisplayedImage->getAbsoluteImagePath(),
-                                             currentlyDisplayedImage->getCameraMatrix());
-    else
-        ui->openGLWidget->setBackgroundImage(currentlyDisplayedImage->getAbsoluteSegmentationImagePath(),
-                                             currentlyDisplayedImage->getCameraMatrix());
+    ui->openGLWidget->setBackgroundImage(
+                imagePrefetcher->load(displayedImagePath(*currentlyDisplayedImage)),
+                currentlyDisplayedImage->getCameraMatrix());
+    // The neighbours are now needed in the other variant
+    prefetchNeighbours();
 
     if (showingNormalImage)
         qDebug() << "Setting viewer to display normal image.";
@@ -178,8 +237,7 @@ void PoseViewer::switchImage() {
 }
 
 void PoseViewer::resetPositionOfGraphicsView() {
-    QRect geo = ui->openGLWidget->geometry();
-    ui->openGLWidget->setGeometry(0, 0, geo.width(), geo.height());
+    ui->openGLWidget->resetView();
 }
 
 void PoseViewer::onImageClicked(QPoint point) {
@@ -200,11 +258,28 @@ void PoseViewer::onPoseAdded(const QString &id) {
     ui->openGLWidget->removeClicks();
 }
 
+void PoseViewer::onPosesAdded(const QStringList &ids) {
+    if (currentlyDisplayedImage.isNull()) {
+        return;
+    }
+    //! Poses are added in batches e.g. by the network, most of them will not
+    //! belong to the image that is currently displayed
+    for (const QString &id : ids) {
+        QSharedPointer<Pose> pose = modelManager->getPoseById(id);
+        if (!pose.isNull() &&
+                pose->getImage()->getImagePath() == currentlyDisplayedImage->getImagePath()) {
+            ui->openGLWidget->addPose(*pose.data());
+        }
+    }
+}
+
 void PoseViewer::onPosesChanged() {
     reloadPoses();
 }
 
 void PoseViewer::onImagesChanged() {
+    // The images might have been replaced on disk under the same paths
+    imagePyramidCache->clear();
     reset();
 }
 
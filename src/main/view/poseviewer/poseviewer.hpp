@@ -5,6 +5,7 @@
 #include "model/objectmodel.hpp"
 #include "model/pose.hpp"
 #include "model/modelmanager.hpp"
+#include "misc/imageloading/imageprefetcher.hpp"
 #include "rendering/poseviewerglwidget.hpp"
 
 #include <QList>
@@ -37,6 +38,12 @@ public:
      * \param modelManager the manager to be set, must not be null
      */
     void setModelManager(ModelManager* modelManager);
+    /*!
+     * \brief setImagePyramidCache sets the cache that the displayed images are loaded from.
+     * It has to be set before the first image is displayed.
+     * \param imagePyramidCache the cache, must not be null
+     */
+    void setImagePyramidCache(ImagePyramidCache *imagePyramidCache);
     Image *getCurrentlyViewedImage();
 
 public Q_SLOTS:
@@ -115,12 +122,24 @@ private:
     // function.
     QPoint lastClickedPosition;
     QScopedPointer<Image> currentlyDisplayedImage;
+    ImagePyramidCache *imagePyramidCache = Q_NULLPTR;
+    // Loads the images next to the displayed one, so that switching images only has to
+    // upload the tiles to the GPU
+    ImagePrefetcher *imagePrefetcher = Q_NULLPTR;
+    // Index of the previously displayed image, to know in which direction to prefetch
+    int previousImageIndex = -1;
 
     // Stores, whether we are currently looking at the "normal" image, or the (maybe present)
     // segmentation image
     bool showingNormalImage = true;
 
     void connectModelManagerSlots();
+    QString displayedImagePath(const Image &image);
+    /*!
+     * \brief prefetchNeighbours loads the images that are probably displayed next in the
+     * background, i.e. the next ones in the direction the user moves through the images.
+     */
+    void prefetchNeighbours();
 
 private Q_SLOTS:
     /*!
@@ -132,6 +151,12 @@ private Q_SLOTS:
     // Private slot listening to model manager
     void onPoseDeleted(const QString &id);
     void onPoseAdded(const QString &id);
+    /*!
+     * \brief onPosesAdded adds the poses of the batch that belong to the currently
+     * displayed image without reloading the already displayed poses.
+     * \param ids the IDs of the added poses
+     */
+    void onPosesAdded(const QStringList &ids);
     void onPosesChanged();
     void onImagesChanged();
     void onObjectModelsChanged();
@@ -1,38 +1,265 @@
 #include "backgroundimagerenderable.hpp"
 
-#include <QUrl>
 #include <QMatrix3x3>
-#include <QImage>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
+#include <QSet>
 
-BackgroundImageRenderable::BackgroundImageRenderable(const QString &image,
+#include <cmath>
+
+BackgroundImageRenderable::BackgroundImageRenderable(TexturePool *texturePool,
                                                      int vertexAttributeLoc,
                                                      int texCoordAttributeLoc) :
-    image(image),
+    texturePool(texturePool),
     vertexAttributeLoc(vertexAttributeLoc),
     texCoordAttributeLoc(texCoordAttributeLoc) {
     // The next to calls need only to be made once on creation.
     createGeometry();
     populateVertexArrayObject();
-    createTexture();
 }
 
 BackgroundImageRenderable::~BackgroundImageRenderable() {
-    texture->destroy();
+    releaseTiles();
+    for (const QString &path : preloadedImages.keys()) {
+        releasePreloadedImage(path);
+    }
+}
+
+void BackgroundImageRenderable::setImage(ImagePyramidPtr pyramid) {
+    releaseTiles();
+    // The levels are loaded when their tiles are requested
+    this->pyramid = pyramid;
+    if (pyramid.isNull()) {
+        return;
+    }
+    QString path = pyramid->getImagePath();
+    if (preloadedImages.contains(path) && preloadedImages[path].pyramid == pyramid) {
+        PreloadedImage preloaded = preloadedImages.take(path);
+        for (auto it = preloaded.tiles.begin(); it != preloaded.tiles.end(); it++) {
+            tiles[it.key()] = it.value();
+            tileUsage.append(it.key());
+        }
+        for (auto it = preloaded.pendingUploads.begin();
+             it != preloaded.pendingUploads.end(); it++) {
+            preloadUploads.remove(it.key());
+            pendingUploads[it.key()] = it.value();
+            pendingTiles[it.value()] = it.key();
+        }
+        failedTiles = preloaded.failedTiles;
+    } else if (preloadedImages.contains(path)) {
+        // The pyramid has been evicted from the cache and loaded again in the meantime
+        releasePreloadedImage(path);
+    }
+}
+
+void BackgroundImageRenderable::preloadImages(const QList<ImagePyramidPtr> &pyramids,
+                                              const QRectF &visibleArea, float scale) {
+    QSet<QString> paths;
+    for (const ImagePyramidPtr &preloadPyramid : pyramids) {
+        paths.insert(preloadPyramid->getImagePath());
+    }
+    for (const QString &path : preloadedImages.keys()) {
+        if (!paths.contains(path)) {
+            releasePreloadedImage(path);
+        }
+    }
+
+    for (const ImagePyramidPtr &preloadPyramid : pyramids) {
+        QString path = preloadPyramid->getImagePath();
+        if (preloadPyramid->getImageSize().isEmpty()
+                || (!pyramid.isNull() && pyramid->getImagePath() == path)) {
+            continue;
+        }
+        if (preloadedImages.contains(path) && preloadedImages[path].pyramid != preloadPyramid) {
+            releasePreloadedImage(path);
+        }
+        PreloadedImage &preloaded = preloadedImages[path];
+        preloaded.pyramid = preloadPyramid;
+
+        // The same tiles getTilesToDraw() requests first when the image is displayed
+        int coarsestLevel = preloadPyramid->getNumberOfLevels() - 1;
+        QList<quint64> keys;
+        QList<QPoint> positions;
+        keys << tileKey(coarsestLevel, 0, 0);
+        positions << QPoint(0, 0);
+        int level = preloadPyramid->getLevelForScale(scale);
+        if (level != coarsestLevel) {
+            for (const QPoint &position : tilesInArea(preloadPyramid, level, visibleArea)) {
+                keys << tileKey(level, position.x(), position.y());
+                positions << position;
+            }
+        }
+        for (int i = 0; i < keys.size() && i < MAX_PRELOADED_TILES; i++) {
+            if (preloaded.tiles.contains(keys[i]) || preloaded.failedTiles.contains(keys[i])
+                    || preloaded.pendingUploads.values().contains(keys[i])) {
+                continue;
+            }
+            int id = startTileUpload(preloadPyramid, i == 0 ? coarsestLevel : level,
+                                     positions[i].x(), positions[i].y());
+            if (id != -1) {
+                preloaded.pendingUploads[id] = keys[i];
+                preloadUploads[id] = path;
+            }
+        }
+    }
+}
+
+QSize BackgroundImageRenderable::getImageSize() const {
+    return pyramid.isNull() ? QSize() : pyramid->getImageSize();
 }
 
-void BackgroundImageRenderable::setImage(const QString &image) {
-    this->image = image;
-    createTexture();
+QList<BackgroundImageRenderable::Tile> BackgroundImageRenderable::getTilesToDraw(
+        const QRectF &visibleArea, float scale) {
+    QList<Tile> tilesToDraw;
+    if (pyramid.isNull() || pyramid->getImageSize().isEmpty()) {
+        return tilesToDraw;
+    }
+    Tile tile;
+    // The coarsest level is a single tile and fills the gaps while the others are uploaded
+    int coarsestLevel = pyramid->getNumberOfLevels() - 1;
+    if (requestTile(coarsestLevel, 0, 0, tile)) {
+        tilesToDraw << tile;
+    }
+
+    int level = pyramid->getLevelForScale(scale);
+    if (level != coarsestLevel) {
+        for (const QPoint &position : tilesInArea(pyramid, level, visibleArea)) {
+            if (requestTile(level, position.x(), position.y(), tile)) {
+                tilesToDraw << tile;
+            }
+        }
+    }
+
+    // Drop the least recently drawn tiles, but never the ones that are drawn now
+    QSet<QOpenGLTexture*> drawn;
+    for (const Tile &drawnTile : tilesToDraw) {
+        drawn.insert(drawnTile.texture);
+    }
+    for (int i = 0; i < tileUsage.size() && tiles.size() > MAX_CACHED_TILES;) {
+        QOpenGLTexture *texture = tiles[tileUsage[i]];
+        if (drawn.contains(texture)) {
+            i++;
+        } else {
+            tiles.remove(tileUsage.takeAt(i));
+            texturePool->release(texture);
+        }
+    }
+    return tilesToDraw;
+}
+
+bool BackgroundImageRenderable::onUploadPrepared(int id) {
+    if (preloadUploads.contains(id)) {
+        PreloadedImage &preloaded = preloadedImages[preloadUploads.take(id)];
+        quint64 key = preloaded.pendingUploads.take(id);
+        QOpenGLTexture *texture = texturePool->finishUpload(id);
+        if (texture) {
+            preloaded.tiles[key] = texture;
+        } else {
+            preloaded.failedTiles.insert(key);
+        }
+        // Nothing to redraw, the image is not displayed yet
+        return false;
+    }
+    if (!pendingUploads.contains(id)) {
+        return false;
+    }
+    quint64 key = pendingUploads.take(id);
+    pendingTiles.remove(key);
+    QOpenGLTexture *texture = texturePool->finishUpload(id);
+    if (!texture) {
+        failedTiles.insert(key);
+        return false;
+    }
+    tiles[key] = texture;
+    tileUsage.append(key);
+    return true;
 }
 
 QOpenGLVertexArrayObject *BackgroundImageRenderable::getVertexArrayObject() {
     return &vao;
 }
 
-QOpenGLTexture *BackgroundImageRenderable::getTexture() {
-    return texture.data();
+quint64 BackgroundImageRenderable::tileKey(int level, int column, int row) {
+    return ((quint64) level << 48) | ((quint64) column << 24) | (quint64) row;
+}
+
+bool BackgroundImageRenderable::requestTile(int level, int column, int row, Tile &tile) {
+    quint64 key = tileKey(level, column, row);
+    if (tiles.contains(key)) {
+        tileUsage.removeOne(key);
+        tileUsage.append(key);
+        QSize imageSize = pyramid->getImageSize();
+        QSize levelSize = pyramid->getLevelSize(level);
+        float scaleX = (float) imageSize.width() / levelSize.width();
+        float scaleY = (float) imageSize.height() / levelSize.height();
+        QRect rect = pyramid->getTileRect(level, column, row);
+        tile.texture = tiles[key];
+        tile.imageRect = QRectF(rect.x() * scaleX, rect.y() * scaleY,
+                                rect.width() * scaleX, rect.height() * scaleY);
+        return true;
+    }
+    if (!pendingTiles.contains(key) && !failedTiles.contains(key)) {
+        int id = startTileUpload(pyramid, level, column, row);
+        if (id != -1) {
+            pendingUploads[id] = key;
+            pendingTiles[key] = id;
+        }
+    }
+    return false;
+}
+
+QList<QPoint> BackgroundImageRenderable::tilesInArea(const ImagePyramidPtr &pyramid, int level,
+                                                      const QRectF &visibleArea) {
+    QList<QPoint> positions;
+    QSize imageSize = pyramid->getImageSize();
+    QSize levelSize = pyramid->getLevelSize(level);
+    QSize grid = pyramid->getTileGrid(level);
+    float tileWidth = pyramid->getTileSize() * (float) imageSize.width() / levelSize.width();
+    float tileHeight = pyramid->getTileSize() * (float) imageSize.height() / levelSize.height();
+    int firstColumn = qMax(0, (int) std::floor(visibleArea.left() / tileWidth));
+    int lastColumn = qMin(grid.width() - 1, (int) std::floor(visibleArea.right() / tileWidth));
+    int firstRow = qMax(0, (int) std::floor(visibleArea.top() / tileHeight));
+    int lastRow = qMin(grid.height() - 1, (int) std::floor(visibleArea.bottom() / tileHeight));
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            positions << QPoint(column, row);
+        }
+    }
+    return positions;
+}
+
+int BackgroundImageRenderable::startTileUpload(const ImagePyramidPtr &pyramid,
+                                               int level, int column, int row) {
+    // The level is decoded on the worker thread of the pool if it hasn't been prefetched
+    return texturePool->startUpload(pyramid->getTileRect(level, column, row).size(),
+                                    [pyramid, level, column, row]() {
+        return pyramid->getTile(level, column, row);
+    });
+}
+
+void BackgroundImageRenderable::releaseTiles() {
+    for (int id : pendingUploads.keys()) {
+        texturePool->cancelUpload(id);
+    }
+    pendingUploads.clear();
+    pendingTiles.clear();
+    failedTiles.clear();
+    for (QOpenGLTexture *texture : tiles) {
+        texturePool->release(texture);
+    }
+    tiles.clear();
+    tileUsage.clear();
+}
+
+void BackgroundImageRenderable::releasePreloadedImage(const QString &path) {
+    PreloadedImage preloaded = preloadedImages.take(path);
+    for (int id : preloaded.pendingUploads.keys()) {
+        texturePool->cancelUpload(id);
+        preloadUploads.remove(id);
+    }
+    for (QOpenGLTexture *texture : preloaded.tiles) {
+        texturePool->release(texture);
+    }
 }
 
 void BackgroundImageRenderable::createGeometry() {
@@ -45,24 +272,10 @@ void BackgroundImageRenderable::createGeometry() {
         vertexData.append(coords[i][0]);
         vertexData.append(coords[i][1]);
         vertexData.append(coords[i][2]);
-        // texture coordinate
+        // texture coordinate, the image is uploaded top row first, i.e. upside down
         vertexData.append(i == 0 || i == 3);
-        vertexData.append(i == 0 || i == 1);
-    }
-}
-
-void BackgroundImageRenderable::createTexture() {
-    QImage textureImage = QImage(
-                QUrl::fromLocalFile(image).path())
-                          .mirrored();
-    if (!texture.isNull()){
-        texture->destroy();
-        texture->create();
-        texture->setSize(textureImage.width(), textureImage.height());
+        vertexData.append(i == 2 || i == 3);
     }
-    texture.reset(new QOpenGLTexture(textureImage));
-    texture->setMagnificationFilter(QOpenGLTexture::Nearest);
-    texture->setMinificationFilter(QOpenGLTexture::Nearest);
 }
 
 void BackgroundImageRenderable::populateVertexArrayObject() {
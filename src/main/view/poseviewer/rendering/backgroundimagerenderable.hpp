@@ -1,40 +1,128 @@
 #ifndef BACKGROUNDIMAGERENDERABLE_H
 #define BACKGROUNDIMAGERENDERABLE_H
 
-#include "model/image.hpp"
+#include "misc/imageloading/imagepyramidcache.hpp"
+#include "view/poseviewer/rendering/texturepool.hpp"
 
+#include <QHash>
+#include <QList>
+#include <QPoint>
+#include <QRectF>
+#include <QSet>
 #include <QString>
-#include <QScopedPointer>
 #include <QVector>
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLBuffer>
 #include <QOpenGLTexture>
 #include <QMatrix4x4>
 
-typedef QScopedPointer<QOpenGLTexture> QOpenGLTexturePtr;
-
+/*!
+ * \brief The BackgroundImageRenderable class displays an image as tiles of an ImagePyramid,
+ * so that images larger than the maximum texture size can be shown and only the tiles that
+ * are visible at the current zoom are uploaded.
+ *
+ * The tiles are uploaded through the TexturePool, i.e. asynchronously. Until the tiles of the
+ * level that fits the zoom are there, the coarsest level is drawn below them. The tiles of
+ * the images that are probably displayed next can be uploaded ahead with preloadImages(),
+ * setImage() then takes them over instead of starting their uploads. All functions have to
+ * be called with the OpenGL context current.
+ */
 class BackgroundImageRenderable
 {
 public:
-    BackgroundImageRenderable(const QString &image,
+    //! A tile with its area in pixels of the full resolution image
+    struct Tile {
+        QOpenGLTexture *texture;
+        QRectF imageRect;
+    };
+
+    //! Number of tile textures that are kept when they are not visible anymore
+    static const int MAX_CACHED_TILES = 64;
+    //! Number of tiles that are uploaded ahead per image
+    static const int MAX_PRELOADED_TILES = 16;
+
+    BackgroundImageRenderable(TexturePool *texturePool,
                               int vertexAttributeLoc,
                               int texCoordAttributeLoc);
     ~BackgroundImageRenderable();
-    void setImage(const QString &image);
+    //! Sets the pyramid of the image to display, it is shared with the ImagePyramidCache
+    void setImage(ImagePyramidPtr pyramid);
+
+    /*!
+     * \brief preloadImages uploads the coarsest tile and the tiles of the visible area of the
+     * given images ahead. Tiles preloaded for images that are not in the list are released.
+     * \param pyramids the pyramids of the images that are probably displayed next
+     * \param visibleArea the visible area in pixels of the full resolution image, the view is
+     * kept when the next image has the same size
+     * \param scale screen pixels per image pixel
+     */
+    void preloadImages(const QList<ImagePyramidPtr> &pyramids,
+                       const QRectF &visibleArea, float scale);
+    QSize getImageSize() const;
+
+    /*!
+     * \brief getTilesToDraw returns the tiles to draw for the visible area, coarse ones
+     * first, and requests the missing ones.
+     * \param visibleArea the visible area in pixels of the full resolution image
+     * \param scale screen pixels per image pixel
+     */
+    QList<Tile> getTilesToDraw(const QRectF &visibleArea, float scale);
+
+    /*!
+     * \brief onUploadPrepared finishes the upload if it is one of the tiles of this renderable.
+     * Tiles whose upload failed, e.g. because the image could not be decoded, are not
+     * requested again for the displayed image.
+     * \return whether a tile of the displayed image has been added, i.e. it has to be redrawn
+     */
+    bool onUploadPrepared(int id);
+
+    //! The unit square with texture coordinates, scaled to the area of a tile to draw it
     QOpenGLVertexArrayObject *getVertexArrayObject();
-    QOpenGLTexture *getTexture();
 
 private:
-    QString image;
+    TexturePool *texturePool;
+    ImagePyramidPtr pyramid;
+    //! Key of a tile: level, column and row packed into one number
+    QHash<quint64, QOpenGLTexture*> tiles;
+    //! Least recently drawn tile first
+    QList<quint64> tileUsage;
+    //! Upload ID to tile
+    QHash<int, quint64> pendingUploads;
+    QHash<quint64, int> pendingTiles;
+    //! Tiles whose upload failed, requesting them again would fail the same way
+    QSet<quint64> failedTiles;
+
+    //! The tiles uploaded ahead for an image that is not displayed yet
+    struct PreloadedImage {
+        ImagePyramidPtr pyramid;
+        QHash<quint64, QOpenGLTexture*> tiles;
+        //! Upload ID to tile
+        QHash<int, quint64> pendingUploads;
+        QSet<quint64> failedTiles;
+    };
+    //! By the paths of the images
+    QHash<QString, PreloadedImage> preloadedImages;
+    //! Upload ID to the path of the preloaded image
+    QHash<int, QString> preloadUploads;
+
     QOpenGLVertexArrayObject vao;
     QOpenGLBuffer vbo;
     QVector<GLfloat> vertexData;
-    QOpenGLTexturePtr texture;
     int vertexAttributeLoc = 0;
     int texCoordAttributeLoc = 0;
 
+    static quint64 tileKey(int level, int column, int row);
+    //! Returns the column and row of the tiles of the level that intersect the area
+    static QList<QPoint> tilesInArea(const ImagePyramidPtr &pyramid, int level,
+                                     const QRectF &visibleArea);
+    //! Returns the ID of the upload or -1
+    int startTileUpload(const ImagePyramidPtr &pyramid, int level, int column, int row);
+    //! Returns the tile if it is uploaded, otherwise requests it and returns false
+    bool requestTile(int level, int column, int row, Tile &tile);
+    void releaseTiles();
+    void releasePreloadedImage(const QString &path);
+
     void createGeometry();
-    void createTexture();
     void populateVertexArrayObject();
 
 };
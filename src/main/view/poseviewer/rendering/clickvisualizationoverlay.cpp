@@ -16,12 +16,18 @@ void ClickVisualizationOverlay::removeClickedPoints() {
     update();
 }
 
+void ClickVisualizationOverlay::setViewTransform(const QTransform &transform) {
+    viewTransform = transform;
+    update();
+}
+
 void ClickVisualizationOverlay::paintEvent(QPaintEvent* /* event */) {
     QPainter painter(this);
     for (Click &click : clickedPoints) {
         QPen pen(click.color);
         pen.setWidth(4);
         painter.setPen(pen);
-        painter.drawPoint(click.position);
+        // Drawn at the center of the clicked pixel
+        painter.drawPoint(viewTransform.map(QPointF(click.position) + QPointF(0.5, 0.5)));
     }
 }
@@ -4,6 +4,7 @@
 #include <QFrame>
 #include <QColor>
 #include <QPoint>
+#include <QTransform>
 
 class ClickVisualizationOverlay : public QFrame {
     Q_OBJECT
@@ -15,6 +16,9 @@ public:
 
     void removeClickedPoints();
 
+    //! Sets the transformation from image pixels to the overlay, the clicks are in pixels
+    void setViewTransform(const QTransform &transform);
+
 protected:
     void paintEvent(QPaintEvent*);
 
@@ -25,6 +29,7 @@ private:
     };
 
     QVector<Click> clickedPoints;
+    QTransform viewTransform;
 };
 
 #endif // CLICKVISUALIZATIONOVERLAY_H
@@ -1,5 +1,6 @@
 #include "view/poseviewer/rendering/poseviewerglwidget.hpp"
 #include "misc/global.h"
+#include "misc/generalhelper.h"
 
 #include <QFrame>
 #include <QImage>
@@ -11,11 +12,21 @@
 #include <QThread>
 #include <QApplication>
 #include <QPainter>
+#include <QTransform>
+#include <QWheelEvent>
+#include <QtDebug>
+
+#include <cmath>
 
 #define PROGRAM_VERTEX_ATTRIBUTE 0
 #define PROGRAM_TEXCOORD_ATTRIBUTE 1
 #define PROGRAM_NORMAL_ATTRIBUTE 1
 
+// Zoom factor of one step of the mouse wheel
+static const float ZOOM_STEP = 1.25f;
+static const float MIN_ZOOM = 1.f / 256.f;
+static const float MAX_ZOOM = 64.f;
+
 PoseViewerGLWidget::PoseViewerGLWidget(QWidget *parent)
     : QOpenGLWidget(parent) {
     QTimer *timer = new QTimer(this);
@@ -30,9 +41,15 @@ PoseViewerGLWidget::PoseViewerGLWidget(QWidget *parent)
 
     clickOverlay = new ClickVisualizationOverlay(this);
     clickOverlay->resize(this->size());
+
+    texturePool = new TexturePool(this);
+    // Keeps the tile textures for the next image, which usually has the same size
+    texturePool->setMaxFreeTextures(BackgroundImageRenderable::MAX_CACHED_TILES);
+    connect(texturePool, SIGNAL(uploadPrepared(int)),
+            this, SLOT(onBackgroundImageUploadPrepared(int)));
 }
 
-void PoseViewerGLWidget::setBackgroundImageAndPoses(const QString &image,
+void PoseViewerGLWidget::setBackgroundImageAndPoses(ImagePyramidPtr image,
                                                                         QMatrix3x3 cameraMatrix,
                                                                         QList<Pose> &poses) {
     // Update only at the end
@@ -48,11 +65,12 @@ PoseViewerGLWidget::~PoseViewerGLWidget()
     makeCurrent();
     // To invoke destructors
     backgroundImageRenderable.reset();
+    texturePool->clear();
     removePoses();
     doneCurrent();
 }
 
-void PoseViewerGLWidget::setBackgroundImage(const QString& image, QMatrix3x3 cameraMatrix) {
+void PoseViewerGLWidget::setBackgroundImage(ImagePyramidPtr image, QMatrix3x3 cameraMatrix) {
     setBackgroundImage(image, cameraMatrix, true);
 }
 
@@ -96,6 +114,37 @@ void PoseViewerGLWidget::setObjectsOpacity(float opacity) {
     update();
 }
 
+void PoseViewerGLWidget::resetView() {
+    if (imageSize.isEmpty() || width() == 0 || height() == 0) {
+        // Done when the widget gets its size
+        viewNeedsReset = true;
+        return;
+    }
+    viewNeedsReset = false;
+    // Fit the whole image into the widget and center it
+    zoom = qMin((float) width() / imageSize.width(), (float) height() / imageSize.height());
+    translation = QPointF((width() - imageSize.width() * zoom) / 2.f,
+                          (height() - imageSize.height() * zoom) / 2.f);
+    updateViewTransform();
+}
+
+float PoseViewerGLWidget::getDisplayScale() const {
+    // Tiles are selected by the resolution of the framebuffer, not of the widget
+    return zoom * devicePixelRatio();
+}
+
+QPointF PoseViewerGLWidget::mapToImage(const QPointF &position) const {
+    return (position - translation) / zoom;
+}
+
+void PoseViewerGLWidget::updateViewTransform() {
+    QTransform transform;
+    transform.translate(translation.x(), translation.y());
+    transform.scale(zoom, zoom);
+    clickOverlay->setViewTransform(transform);
+    update();
+}
+
 void PoseViewerGLWidget::addClick(QPoint position, QColor color) {
     clickOverlay->addClickedPoint(position, color);
 }
@@ -107,7 +156,10 @@ void PoseViewerGLWidget::removeClicks() {
 void PoseViewerGLWidget::reset() {
     removeClicks();
     removePoses();
+    makeCurrent();
     backgroundImageRenderable.reset();
+    doneCurrent();
+    imageSize = QSize();
 }
 
 void PoseViewerGLWidget::initializeGL() {
@@ -154,20 +206,31 @@ void PoseViewerGLWidget::paintGL() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     if (!backgroundImageRenderable.isNull()) {
+        QList<BackgroundImageRenderable::Tile> tiles =
+                backgroundImageRenderable->getTilesToDraw(
+                    QRectF(mapToImage(QPointF(0, 0)), mapToImage(QPointF(width(), height()))),
+                    getDisplayScale());
+        // Finer tiles are drawn over the coarse ones in the same plane
+        glDisable(GL_DEPTH_TEST);
         backgroundProgram->bind();
         {
-            QMatrix4x4 m;
-            m.ortho(0, 1, 1, 0, 1.0f, 3.0f);
-            m.translate(0.0f, 0.0f, -2.0f);
-
             QOpenGLVertexArrayObject::Binder vaoBinder(
                         backgroundImageRenderable->getVertexArrayObject());
-
-            backgroundProgram->setUniformValue("matrix", m);
-            backgroundImageRenderable->getTexture()->bind();
-            glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+            for (const BackgroundImageRenderable::Tile &tile : tiles) {
+                // Scales the unit square to the area of the tile in the widget
+                QMatrix4x4 m;
+                m.ortho(0, width(), height(), 0, 1.0f, 3.0f);
+                m.translate(translation.x() + tile.imageRect.x() * zoom,
+                            translation.y() + tile.imageRect.y() * zoom,
+                            -2.0f);
+                m.scale(tile.imageRect.width() * zoom, tile.imageRect.height() * zoom, 1.0f);
+                backgroundProgram->setUniformValue("matrix", m);
+                tile.texture->bind();
+                glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+            }
         }
         backgroundProgram->release();
+        glEnable(GL_DEPTH_TEST);
     }
 
     glClear(GL_DEPTH_BUFFER_BIT);
@@ -177,6 +240,18 @@ void PoseViewerGLWidget::paintGL() {
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     }
 
+    // The projection maps the image to the whole viewport, this moves it to where the
+    // image is displayed
+    QMatrix4x4 viewMatrix;
+    if (!imageSize.isEmpty()) {
+        float scaleX = zoom * imageSize.width() / width();
+        float scaleY = zoom * imageSize.height() / height();
+        viewMatrix(0, 0) = scaleX;
+        viewMatrix(0, 3) = 2.f * translation.x() / width() + scaleX - 1.f;
+        viewMatrix(1, 1) = scaleY;
+        viewMatrix(1, 3) = 1.f - 2.f * translation.y() / height() - scaleY;
+    }
+
     objectsProgram->bind();
     {
         projectionMatrixLoc = objectsProgram->uniformLocation("projectionMatrix");
@@ -194,7 +269,7 @@ void PoseViewerGLWidget::paintGL() {
             // Compute the projection matrix that includes the intrinsic camera parameters
             // as well as the translation and rotation of the object
             QMatrix4x4 modelViewMatrix = renderable->getModelViewMatrix();
-            QMatrix4x4 modelViewProjectionMatrix = projectionMatrix * modelViewMatrix;
+            QMatrix4x4 modelViewProjectionMatrix = viewMatrix * projectionMatrix * modelViewMatrix;
             objectsProgram->setUniformValue(projectionMatrixLoc, modelViewProjectionMatrix);
 
             QMatrix3x3 normalMatrix = modelViewMatrix.normalMatrix();
@@ -206,57 +281,101 @@ void PoseViewerGLWidget::paintGL() {
     objectsProgram->release();
 }
 
+void PoseViewerGLWidget::resizeGL(int /* w */, int /* h */) {
+    clickOverlay->resize(this->size());
+    if (viewNeedsReset) {
+        resetView();
+    }
+}
+
 void PoseViewerGLWidget::mousePressEvent(QMouseEvent *event) {
-    lastPos = event->globalPos() - QPoint(geometry().x(), geometry().y());
+    lastPos = event->pos();
 }
 
 void PoseViewerGLWidget::mouseMoveEvent(QMouseEvent *event) {
     if (event->buttons() & Qt::LeftButton) {
-        QPoint newPosition = event->globalPos();
-        newPosition.setX(newPosition.x() - lastPos.x());
-        newPosition.setY(newPosition.y() - lastPos.y());
-        move(newPosition);
+        // Panning moves the image inside the widget, not the widget itself
+        translation += event->pos() - lastPos;
+        lastPos = event->pos();
         mouseMoved = true;
+        updateViewTransform();
     }
 }
 
 void PoseViewerGLWidget::mouseReleaseEvent(QMouseEvent *event) {
     if (!mouseMoved && !backgroundImageRenderable.isNull()) {
-        Q_EMIT positionClicked(event->pos());
+        QPointF position = mapToImage(event->pos());
+        QPoint pixel(std::floor(position.x()), std::floor(position.y()));
+        if (QRect(QPoint(0, 0), imageSize).contains(pixel)) {
+            Q_EMIT positionClicked(pixel);
+        }
     }
     mouseMoved = false;
 }
 
-void PoseViewerGLWidget::setBackgroundImage(const QString &image,
+void PoseViewerGLWidget::wheelEvent(QWheelEvent *event) {
+    if (imageSize.isEmpty()) {
+        return;
+    }
+    // Zoom around the cursor, i.e. keep the image point below it where it is
+    QPointF imagePosition = mapToImage(event->pos());
+    float factor = std::pow(ZOOM_STEP, event->angleDelta().y() / 120.f);
+    zoom = qBound(MIN_ZOOM, zoom * factor, MAX_ZOOM);
+    translation = QPointF(event->pos()) - imagePosition * zoom;
+    updateViewTransform();
+    event->accept();
+}
+
+void PoseViewerGLWidget::setBackgroundImage(ImagePyramidPtr image,
                                                       QMatrix3x3 cameraMatrix,
                                                       bool update) {
-    QImage loadedImage(QUrl::fromLocalFile(image).path());
-    this->resize(loadedImage.width(), loadedImage.height());
-    clickOverlay->resize(this->size());
+    QSize size = image->getImageSize();
+    if (size.isEmpty()) {
+        qWarning() << "Cannot display image " + image->getImagePath();
+    }
+    makeCurrent();
     if (!backgroundImageRenderable) {
-        makeCurrent();
-        backgroundImageRenderable.reset(new BackgroundImageRenderable(image,
+        backgroundImageRenderable.reset(new BackgroundImageRenderable(texturePool,
                                                                   PROGRAM_VERTEX_ATTRIBUTE,
                                                                   PROGRAM_TEXCOORD_ATTRIBUTE));
-        doneCurrent();
-    } else {
-        backgroundImageRenderable->setImage(image);
     }
+    // The tiles are uploaded when they are drawn the first time
+    backgroundImageRenderable->setImage(image);
+    doneCurrent();
 
-    float w = loadedImage.width();
-    float h = loadedImage.height();
-    float depth = (float) farPlane - nearPlane;
-    float q = -(farPlane + nearPlane) / depth;
-    float qn = -2 * (farPlane * nearPlane) / depth;
-    const QMatrix3x3 K = cameraMatrix;
-    projectionMatrix = QMatrix4x4(2 * K(0, 0) / w, -2 * K(0, 1) / w, (-2 * K(0, 2) + w) / w, 0,
-                                                0,  2 * K(1, 1) / h,  (2 * K(1 ,2) - h) / h, 0,
-                                                0,                0,                      q, qn,
-                                                0,                0,                     -1, 0);
+    // Images of a sequence usually have the same size, then the user keeps the view
+    if (size != imageSize) {
+        imageSize = size;
+        resetView();
+    }
+    projectionMatrix = GeneralHelper::projectionMatrixFromCameraMatrix(
+                cameraMatrix, size.width(), size.height(), nearPlane, farPlane);
     if (update)
         this->update();
 }
 
+void PoseViewerGLWidget::preloadBackgroundImages(const QList<ImagePyramidPtr> &images) {
+    if (!backgroundImageRenderable) {
+        return;
+    }
+    makeCurrent();
+    backgroundImageRenderable->preloadImages(
+                images,
+                QRectF(mapToImage(QPointF(0, 0)), mapToImage(QPointF(width(), height()))),
+                getDisplayScale());
+    doneCurrent();
+}
+
+void PoseViewerGLWidget::onBackgroundImageUploadPrepared(int id) {
+    makeCurrent();
+    bool tileUploaded = backgroundImageRenderable
+            && backgroundImageRenderable->onUploadPrepared(id);
+    doneCurrent();
+    if (tileUploaded) {
+        update();
+    }
+}
+
 void PoseViewerGLWidget::addPose(const Pose &pose,
                                                      bool update) {
     makeCurrent();
@@ -5,6 +5,7 @@
 #include "view/poseviewer/rendering/backgroundimagerenderable.hpp"
 #include "view/poseviewer/rendering/poserenderable.hpp"
 #include "view/poseviewer/rendering/clickvisualizationoverlay.hpp"
+#include "view/poseviewer/rendering/texturepool.hpp"
 
 #include <QString>
 #include <QList>
@@ -28,10 +29,12 @@ class PoseViewerGLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_0
 
 public:
     explicit PoseViewerGLWidget(QWidget *parent = 0);
-    void setBackgroundImageAndPoses(const QString& image,
+    void setBackgroundImageAndPoses(ImagePyramidPtr image,
                                               QMatrix3x3 cameraMatrix,
                                               QList<Pose> &poses);
-    void setBackgroundImage(const QString& image, QMatrix3x3 cameraMatrix);
+    void setBackgroundImage(ImagePyramidPtr image, QMatrix3x3 cameraMatrix);
+    //! Uploads the tiles of the images that are probably displayed next at the current view
+    void preloadBackgroundImages(const QList<ImagePyramidPtr> &images);
     void addPose(const Pose &pose);
     void updatePose(const Pose &pose);
     void removePose(const QString &id);
@@ -42,6 +45,10 @@ public:
     void addClick(QPoint position, QColor color);
     void removeClicks();
     void reset();
+    //! Zooms and moves the image so that it fits into the widget
+    void resetView();
+    //! Returns the pixels of the framebuffer per image pixel at the current zoom
+    float getDisplayScale() const;
 
     ~PoseViewerGLWidget();
 
@@ -51,24 +58,41 @@ Q_SIGNALS:
 protected:
     void initializeGL() override;
     void paintGL() override;
+    void resizeGL(int w, int h) override;
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private Q_SLOTS:
+    void onBackgroundImageUploadPrepared(int id);
 
 private:
 
-    void setBackgroundImage(const QString& image,
+    void setBackgroundImage(ImagePyramidPtr image,
                             QMatrix3x3 cameraMatrix,
                             bool update);
     void addPose(const Pose &pose, bool update);
 
     void initializeBackgroundProgram();
     void initializeObjectProgram();
+    //! Maps a position in the widget to pixel coordinates of the displayed image
+    QPointF mapToImage(const QPointF &position) const;
+    void updateViewTransform();
 
     // Background stuff
     BackgroundImageRenderablePtr backgroundImageRenderable;
     QOpenGLShaderProgramPtr backgroundProgram;
     QMatrix4x4 backgroundProjectionMatrix;
+    // Uploads the tiles of the background image asynchronously
+    TexturePool *texturePool;
+    QSize imageSize;
+
+    // The image is zoomed and panned inside the widget, a pixel of the image is displayed at
+    // translation + zoom * pixel
+    float zoom = 1.f;
+    QPointF translation;
+    bool viewNeedsReset = false;
 
     QVector<PoseRenderablePtr> poseRenderables;
     QOpenGLShaderProgramPtr objectsProgram;
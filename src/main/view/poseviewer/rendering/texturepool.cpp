@@ -0,0 +1,234 @@
+#include "texturepool.hpp"
+
+#include <QMetaObject>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QRunnable>
+#include <QThread>
+#include <QtDebug>
+
+#include <cstring>
+
+class PixelCopyRunnable : public QRunnable {
+public:
+    PixelCopyRunnable(TexturePool *pool, int id, const QSize &size,
+                      TexturePool::ImageProducer producer, void *destination) :
+        pool(pool),
+        id(id),
+        size(size),
+        producer(producer),
+        destination(destination) {
+    }
+
+    void run() override {
+        QImage image = producer();
+        if (image.format() != QImage::Format_RGBA8888) {
+            image = image.convertToFormat(QImage::Format_RGBA8888);
+        }
+        bool success = image.size() == size;
+        if (success && destination) {
+            std::memcpy(destination, image.constBits(),
+                        (size_t) image.bytesPerLine() * image.height());
+            // Only needed if there is no buffer to upload from
+            image = QImage();
+        }
+        QMetaObject::invokeMethod(pool, "onPixelsCopied", Qt::QueuedConnection,
+                                  Q_ARG(int, id), Q_ARG(bool, success), Q_ARG(QImage, image));
+    }
+
+private:
+    TexturePool *pool;
+    int id;
+    QSize size;
+    TexturePool::ImageProducer producer;
+    void *destination;
+};
+
+TexturePool::TexturePool(QObject *parent) :
+    QObject(parent) {
+    // Producers might scale images, but most uploads are superseded by the next image
+    threadPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+TexturePool::~TexturePool() {
+    threadPool.waitForDone();
+    if (!uploads.isEmpty() || !freeTextures.isEmpty() || !freeBuffers.isEmpty()) {
+        qWarning() << "Texture pool destroyed without clearing it, OpenGL resources leak.";
+    }
+}
+
+QOpenGLTexture *TexturePool::acquire(const QSize &size) {
+    // Take the least recently released texture, the GPU is most likely done drawing it
+    for (int i = 0; i < freeTextures.size(); i++) {
+        if (QSize(freeTextures[i]->width(), freeTextures[i]->height()) == size) {
+            return freeTextures.takeAt(i);
+        }
+    }
+    QOpenGLTexture *texture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+    texture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+    texture->setSize(size.width(), size.height());
+    texture->setMipLevels(1);
+    texture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+    // Zoomed in the user wants to see the pixels, zoomed out a coarser level is drawn
+    texture->setMagnificationFilter(QOpenGLTexture::Nearest);
+    texture->setMinificationFilter(QOpenGLTexture::Linear);
+    texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+    return texture;
+}
+
+void TexturePool::release(QOpenGLTexture *texture) {
+    if (!texture) {
+        return;
+    }
+    freeTextures.append(texture);
+    while (freeTextures.size() > maxFreeTextures) {
+        delete freeTextures.takeFirst();
+    }
+}
+
+void TexturePool::setMaxFreeTextures(int maxFreeTextures) {
+    this->maxFreeTextures = maxFreeTextures;
+    while (freeTextures.size() > maxFreeTextures) {
+        delete freeTextures.takeFirst();
+    }
+}
+
+int TexturePool::startUpload(const QImage &image) {
+    if (image.isNull()) {
+        return -1;
+    }
+    return startUpload(image.size(), [image]() { return image; });
+}
+
+int TexturePool::startUpload(const QSize &size, ImageProducer producer) {
+    collectCancelledUploads();
+    if (size.isEmpty()) {
+        return -1;
+    }
+    int numberOfBytes = size.width() * size.height() * 4;
+
+    QOpenGLBuffer *buffer;
+    if (!freeBuffers.isEmpty()) {
+        buffer = freeBuffers.takeLast();
+    } else {
+        buffer = new QOpenGLBuffer(QOpenGLBuffer::PixelUnpackBuffer);
+        buffer->setUsagePattern(QOpenGLBuffer::StreamDraw);
+        buffer->create();
+    }
+    buffer->bind();
+    // Allocating again orphans the old storage, the driver doesn't have to wait for it
+    buffer->allocate(numberOfBytes);
+    void *destination = buffer->mapRange(0, numberOfBytes,
+                                         QOpenGLBuffer::RangeWrite
+                                         | QOpenGLBuffer::RangeInvalidateBuffer);
+    buffer->release();
+    if (!destination) {
+        // No buffer mapping on this implementation, upload from the image in finishUpload
+        delete buffer;
+        buffer = Q_NULLPTR;
+    }
+
+    int id = nextUploadId++;
+    uploads[id] = Upload{size, buffer, QImage(), false, false, false};
+    threadPool.start(new PixelCopyRunnable(this, id, size, producer, destination));
+    return id;
+}
+
+QOpenGLTexture *TexturePool::finishUpload(int id) {
+    collectCancelledUploads();
+    if (!uploads.contains(id) || !uploads[id].copied || uploads[id].cancelled) {
+        return Q_NULLPTR;
+    }
+    Upload upload = uploads.take(id);
+    if (!upload.success) {
+        if (upload.buffer) {
+            unmapAndReleaseBuffer(upload.buffer);
+        }
+        return Q_NULLPTR;
+    }
+    QOpenGLTexture *texture = acquire(upload.size);
+    if (upload.buffer) {
+        QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+        upload.buffer->bind();
+        upload.buffer->unmap();
+        texture->bind();
+        f->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        // With the unpack buffer bound the last argument is the offset into the buffer
+        f->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                           upload.size.width(), upload.size.height(),
+                           GL_RGBA, GL_UNSIGNED_BYTE, Q_NULLPTR);
+        texture->release();
+        upload.buffer->release();
+        recycleBuffer(upload.buffer);
+    } else {
+        texture->setData(0, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8,
+                         upload.image.constBits());
+    }
+    return texture;
+}
+
+void TexturePool::cancelUpload(int id) {
+    if (uploads.contains(id)) {
+        uploads[id].cancelled = true;
+    }
+    collectCancelledUploads();
+}
+
+void TexturePool::clear() {
+    threadPool.waitForDone();
+    for (Upload &upload : uploads) {
+        if (upload.buffer) {
+            upload.buffer->bind();
+            upload.buffer->unmap();
+            upload.buffer->release();
+            delete upload.buffer;
+        }
+    }
+    uploads.clear();
+    qDeleteAll(freeTextures);
+    freeTextures.clear();
+    qDeleteAll(freeBuffers);
+    freeBuffers.clear();
+}
+
+void TexturePool::onPixelsCopied(int id, bool success, QImage image) {
+    if (!uploads.contains(id)) {
+        return;
+    }
+    Upload &upload = uploads[id];
+    upload.copied = true;
+    upload.success = success;
+    upload.image = image;
+    if (!upload.cancelled) {
+        Q_EMIT uploadPrepared(id);
+    }
+}
+
+void TexturePool::collectCancelledUploads() {
+    // The buffer of an upload that is still being copied can only be unmapped afterwards
+    QMutableMapIterator<int, Upload> iterator(uploads);
+    while (iterator.hasNext()) {
+        Upload &upload = iterator.next().value();
+        if (upload.cancelled && upload.copied) {
+            if (upload.buffer) {
+                unmapAndReleaseBuffer(upload.buffer);
+            }
+            iterator.remove();
+        }
+    }
+}
+
+void TexturePool::unmapAndReleaseBuffer(QOpenGLBuffer *buffer) {
+    buffer->bind();
+    buffer->unmap();
+    buffer->release();
+    recycleBuffer(buffer);
+}
+
+void TexturePool::recycleBuffer(QOpenGLBuffer *buffer) {
+    if (freeBuffers.size() < MAX_FREE_BUFFERS) {
+        freeBuffers.append(buffer);
+    } else {
+        delete buffer;
+    }
+}
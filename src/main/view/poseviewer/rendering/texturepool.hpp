@@ -0,0 +1,114 @@
+#ifndef TEXTUREPOOL_H
+#define TEXTUREPOOL_H
+
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QOpenGLBuffer>
+#include <QOpenGLTexture>
+#include <QSize>
+#include <QThreadPool>
+
+#include <functional>
+
+/*!
+ * \brief The TexturePool class uploads images to RGBA textures and reuses the textures of
+ * images that are not displayed anymore. Since the images of a dataset usually all have the
+ * same size, switching images only replaces the contents of an existing texture instead of
+ * allocating new storage on the GPU.
+ *
+ * The pixels are copied into a mapped pixel unpack buffer on a worker thread, only mapping
+ * the buffer and the final transfer into the texture happen on the GL thread. Uploading is
+ * therefore asynchronous: startUpload() returns an ID, uploadPrepared() is emitted on the
+ * thread of the pool once the pixels have been copied and finishUpload() returns the texture.
+ *
+ * All functions have to be called with the OpenGL context current that the textures belong
+ * to. clear() has to be called with the context current before the context is destroyed.
+ */
+class TexturePool : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Produces the pixels of an upload on the worker thread
+    typedef std::function<QImage()> ImageProducer;
+
+    //! Number of unused textures that are kept for reuse by default
+    static const int DEFAULT_MAX_FREE_TEXTURES = 2;
+    //! Number of unused pixel unpack buffers that are kept for reuse
+    static const int MAX_FREE_BUFFERS = 4;
+
+    explicit TexturePool(QObject *parent = Q_NULLPTR);
+    ~TexturePool();
+
+    //! Returns a texture with storage for an RGBA image of the given size
+    QOpenGLTexture *acquire(const QSize &size);
+    //! Gives back a texture returned by acquire() or finishUpload()
+    void release(QOpenGLTexture *texture);
+    void setMaxFreeTextures(int maxFreeTextures);
+
+    /*!
+     * \brief startUpload starts copying the pixels of the image into a pixel unpack buffer.
+     * \param image the image, images in Format_RGBA8888 are copied without conversion
+     * \return the ID of the upload or -1 if the image is null
+     */
+    int startUpload(const QImage &image);
+
+    /*!
+     * \brief startUpload starts an upload whose pixels are computed on the worker thread,
+     * e.g. because they have to be cut out of a larger image or scaled first.
+     * \param size the size of the image the producer returns
+     * \param producer returns the image, it is converted to Format_RGBA8888 if necessary,
+     * uploads whose producer returns an image of another size fail
+     * \return the ID of the upload or -1 if the size is empty
+     */
+    int startUpload(const QSize &size, ImageProducer producer);
+
+    /*!
+     * \brief finishUpload transfers the pixels of the upload into a texture of the pool.
+     * \param id the ID of the upload that uploadPrepared() has been emitted for
+     * \return the texture or null if there is no prepared upload with the ID or it failed,
+     * ownership stays with the pool, pass the texture to release() when it is not needed
+     * anymore
+     */
+    QOpenGLTexture *finishUpload(int id);
+
+    //! Drops the upload, uploadPrepared() will not be emitted for it anymore
+    void cancelUpload(int id);
+
+    //! Waits for running copies and deletes all textures and buffers of the pool
+    void clear();
+
+Q_SIGNALS:
+    void uploadPrepared(int id);
+
+private Q_SLOTS:
+    //! Called by the copy runnables through the event loop
+    void onPixelsCopied(int id, bool success, QImage image);
+
+private:
+    struct Upload {
+        QSize size;
+        //! Null if buffers can't be mapped, then the image is uploaded directly
+        QOpenGLBuffer *buffer;
+        QImage image;
+        bool copied;
+        bool success;
+        bool cancelled;
+    };
+
+    QThreadPool threadPool;
+    QMap<int, Upload> uploads;
+    int nextUploadId = 0;
+    int maxFreeTextures = DEFAULT_MAX_FREE_TEXTURES;
+    QList<QOpenGLTexture*> freeTextures;
+    QList<QOpenGLBuffer*> freeBuffers;
+
+    //! Unmaps and frees the buffers of cancelled uploads whose copy has finished
+    void collectCancelledUploads();
+    void unmapAndReleaseBuffer(QOpenGLBuffer *buffer);
+    void recycleBuffer(QOpenGLBuffer *buffer);
+};
+
+#endif // TEXTUREPOOL_H
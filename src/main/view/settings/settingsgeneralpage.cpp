@@ -31,6 +31,9 @@ void SettingsGeneralPage::setPreferences(Settings *preferences) {
     ui->editObjectModelsPath->setText(preferences->getObjectModelsPath());
     ui->editPosesPath->setText(preferences->getPosesFilePath());
     ui->editSegmentationImagesPath->setText(preferences->getSegmentationImagesPath());
+    ui->checkBoxRobustPoseCreation->setChecked(preferences->getRobustPoseCreation());
+    ui->doubleSpinBoxInlierThreshold->setValue(preferences->getPoseCreationInlierThreshold());
+    ui->doubleSpinBoxInlierThreshold->setEnabled(preferences->getRobustPoseCreation());
 }
 
 QString SettingsGeneralPage::openFolderDialogForPath(QString path) {
@@ -82,3 +85,12 @@ void SettingsGeneralPage::buttonPosesPathClicked() {
     }
 }
 
+
+void SettingsGeneralPage::checkBoxRobustPoseCreationToggled(bool checked) {
+    preferences->setRobustPoseCreation(checked);
+    ui->doubleSpinBoxInlierThreshold->setEnabled(checked);
+}
+
+void SettingsGeneralPage::doubleSpinBoxInlierThresholdValueChanged(double value) {
+    preferences->setPoseCreationInlierThreshold((float) value);
+}
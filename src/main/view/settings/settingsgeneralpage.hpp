@@ -24,6 +24,8 @@ private Q_SLOTS:
     void buttonSegmentationImagesPathClicked();
     void buttonObjectModelsPathClicked();
     void buttonPosesPathClicked();
+    void checkBoxRobustPoseCreationToggled(bool checked);
+    void doubleSpinBoxInlierThresholdValueChanged(double value);
 
 private:
     Ui::SettingsGeneralPage *ui;
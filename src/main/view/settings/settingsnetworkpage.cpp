@@ -30,6 +30,8 @@ void SettingsNetworkPage::setPreferences(Settings *preferences) {
     ui->editInferenceScriptPath->setText(preferences->getInferenceScriptPath());
     ui->editNetworkConfigPath->setText(preferences->getNetworkConfigPath());
     ui->editPythonInterpreterPath->setText(preferences->getPythonInterpreterPath());
+    ui->spinBoxInferenceChunkSize->setValue(preferences->getInferenceChunkSize());
+    ui->checkBoxSharedMemoryTransport->setChecked(preferences->getUseSharedMemoryTransport());
 }
 
 void SettingsNetworkPage::buttonPythonInterpreterPathClicked() {
@@ -73,6 +75,14 @@ void SettingsNetworkPage::buttonNetworkConfigPathClicked() {
 
 }
 
+void SettingsNetworkPage::spinBoxInferenceChunkSizeValueChanged(int value) {
+    preferences->setInferenceChunkSize(value);
+}
+
+void SettingsNetworkPage::checkBoxSharedMemoryTransportToggled(bool checked) {
+    preferences->setUseSharedMemoryTransport(checked);
+}
+
 QString SettingsNetworkPage::openFileDialogForPath(const QString &path,
                                                    const QString &title,
                                                    const QString &type) {
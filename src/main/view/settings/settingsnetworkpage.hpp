@@ -22,6 +22,8 @@ private Q_SLOTS:
     void buttonTrainingScriptPathClicked();
     void buttonInferenceScriptPathClicked();
     void buttonNetworkConfigPathClicked();
+    void spinBoxInferenceChunkSizeValueChanged(int value);
+    void checkBoxSharedMemoryTransportToggled(bool checked);
 
 private:
     Ui::SettingsNetworkPage *ui;
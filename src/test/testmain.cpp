@@ -1,9 +1,24 @@
 #include "tst_modeltests.h"
+#include "tst_jsonloadandstorestrategytests.h"
+#include "tst_archivetests.h"
+#include "tst_videoimagesourcetests.h"
+#include "tst_directoryindexertests.h"
+#include "tst_geometrytests.h"
+#include "tst_poserefinertests.h"
+#include "tst_posepropagatortests.h"
+#include "tst_poseinterpolatortests.h"
+#include "tst_posequalityscorertests.h"
+#include "tst_visibilitycomputertests.h"
+#include "tst_penetrationcheckertests.h"
 
 #include <gtest/gtest.h>
 
+#include <QCoreApplication>
+
 int main(int argc, char *argv[])
 {
+    // The strategies and the background workers need an application, e.g. for their timers
+    QCoreApplication app(argc, argv);
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,65 @@
+#ifndef TESTSCENE_H
+#define TESTSCENE_H
+
+#include "misc/geometry/cpurasterizer.hpp"
+#include "misc/geometry/mesh.hpp"
+
+#include <QFile>
+#include <QImage>
+#include <QList>
+#include <QMatrix3x3>
+#include <QTextStream>
+
+//! Helpers of the tests that render object models, i.e. write models and images of them
+
+//! Writes the cube with the given edge length centered at the origin as OBJ file
+static bool writeCubeModel(const QString &path, float size) {
+    QFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        return false;
+    }
+    QTextStream stream(&file);
+    for (int corner = 0; corner < 8; corner++) {
+        stream << "v " << ((corner & 1) - 0.5f) * size << " "
+               << (((corner >> 1) & 1) - 0.5f) * size << " "
+               << (((corner >> 2) & 1) - 0.5f) * size << "\n";
+    }
+    stream << "f 1 3 4 2\n" << "f 5 6 8 7\n" << "f 1 2 6 5\n"
+           << "f 3 7 8 4\n" << "f 1 5 7 3\n" << "f 2 4 8 6\n";
+    stream.flush();
+    return stream.status() == QTextStream::Ok;
+}
+
+//! The camera of the test images, which are 320 x 240 pixels
+static QMatrix3x3 testCameraMatrix() {
+    QMatrix3x3 cameraMatrix;
+    cameraMatrix(0, 0) = 500.f;
+    cameraMatrix(0, 2) = 160.f;
+    cameraMatrix(1, 1) = 500.f;
+    cameraMatrix(1, 2) = 120.f;
+    return cameraMatrix;
+}
+
+/*!
+ * \brief writeRenderedImage renders the instances with the CpuRasterizer and writes the
+ * visible instance of every pixel in its color on black, e.g. as image to refine against or
+ * as segmentation image.
+ */
+static bool writeRenderedImage(const QString &path, const QList<RasterInstance> &instances,
+                               const QList<QRgb> &colors) {
+    QSize size(320, 240);
+    RasterBuffers buffers = CpuRasterizer(1).rasterize(testCameraMatrix(), size, instances);
+    QImage image(size, QImage::Format_RGB32);
+    image.fill(Qt::black);
+    for (int y = 0; y < size.height(); y++) {
+        for (int x = 0; x < size.width(); x++) {
+            int instance = buffers.instanceAt(QPoint(x, y));
+            if (instance >= 0) {
+                image.setPixel(x, y, colors[instance]);
+            }
+        }
+    }
+    return image.save(path);
+}
+
+#endif // TESTSCENE_H
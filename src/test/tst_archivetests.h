@@ -0,0 +1,186 @@
+#include "misc/imageloading/archiveimagesource.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QPair>
+#include <QTemporaryDir>
+#include <QtEndian>
+
+using namespace testing;
+
+typedef QList<QPair<QByteArray, QByteArray>> ArchiveMembers;
+
+//! The contents of the members, the second one spans several tar blocks
+static ArchiveMembers archiveMembers() {
+    QByteArray large;
+    for (int i = 0; i < 1300; i++) {
+        large.append((char) ('a' + i % 26));
+    }
+    return ArchiveMembers() << qMakePair(QByteArray("rgb/0001.png"), QByteArray("first"))
+                            << qMakePair(QByteArray("rgb/0002.png"), large)
+                            << qMakePair(QByteArray("info.json"), QByteArray("{}"));
+}
+
+static QByteArray tarHeader(const QByteArray &name, qint64 size, char type) {
+    QByteArray header(512, '\0');
+    header.replace(0, name.size(), name);
+    header.replace(100, 7, "0000644");
+    header.replace(108, 7, "0000000");
+    header.replace(116, 7, "0000000");
+    header.replace(124, 11, QByteArray::number(size, 8).rightJustified(11, '0'));
+    header.replace(136, 11, "00000000000");
+    header[156] = type;
+    header.replace(257, 6, QByteArray("ustar\0", 6));
+    header.replace(263, 2, "00");
+    // The checksum is computed with the checksum field filled with spaces
+    header.replace(148, 8, "        ");
+    int checksum = 0;
+    for (char byte : header) {
+        checksum += (uchar) byte;
+    }
+    header.replace(148, 7, QByteArray::number(checksum, 8).rightJustified(6, '0') + '\0');
+    return header;
+}
+
+static bool writeTar(const QString &path, const ArchiveMembers &members) {
+    QByteArray tar = tarHeader("rgb/", 0, '5');
+    for (const auto &member : members) {
+        tar += tarHeader(member.first, member.second.size(), '0');
+        tar += member.second;
+        tar += QByteArray((512 - member.second.size() % 512) % 512, '\0');
+    }
+    tar += QByteArray(1024, '\0');
+    QFile file(path);
+    return file.open(QFile::WriteOnly) && file.write(tar) == tar.size();
+}
+
+static QByteArray littleEndian16(quint16 value) {
+    QByteArray bytes(2, '\0');
+    qToLittleEndian(value, reinterpret_cast<uchar *>(bytes.data()));
+    return bytes;
+}
+
+static QByteArray littleEndian32(quint32 value) {
+    QByteArray bytes(4, '\0');
+    qToLittleEndian(value, reinterpret_cast<uchar *>(bytes.data()));
+    return bytes;
+}
+
+/*!
+ * \brief writeZip writes the members stored and, if deflate is set, every other one deflated.
+ * The local headers have an extra field that the central directory doesn't have, the data
+ * offset has to be taken from the local header. The CRCs are not checked and left 0.
+ */
+static bool writeZip(const QString &path, const ArchiveMembers &members, bool deflate) {
+    QByteArray zip;
+    QByteArray directory;
+    for (int i = 0; i < members.size(); i++) {
+        const QByteArray &name = members[i].first;
+        const QByteArray &data = members[i].second;
+        bool deflated = deflate && i % 2 == 1;
+        // qCompress prepends the size and wraps the raw stream in a zlib header and checksum
+        QByteArray stored = deflated ? qCompress(data).mid(6) : data;
+        if (deflated) {
+            stored.chop(4);
+        }
+        QByteArray extra = littleEndian16(0xcafe) + littleEndian16(4) + QByteArray(4, 'x');
+        quint32 localHeaderOffset = (quint32) zip.size();
+        zip += littleEndian32(0x04034b50) + littleEndian16(20) + littleEndian16(0)
+                + littleEndian16(deflated ? 8 : 0) + littleEndian32(0) + littleEndian32(0)
+                + littleEndian32((quint32) stored.size()) + littleEndian32((quint32) data.size())
+                + littleEndian16((quint16) name.size()) + littleEndian16((quint16) extra.size())
+                + name + extra + stored;
+        directory += littleEndian32(0x02014b50) + littleEndian16(20) + littleEndian16(20)
+                + littleEndian16(0) + littleEndian16(deflated ? 8 : 0) + littleEndian32(0)
+                + littleEndian32(0) + littleEndian32((quint32) stored.size())
+                + littleEndian32((quint32) data.size()) + littleEndian16((quint16) name.size())
+                + littleEndian16(0) + littleEndian16(0) + littleEndian16(0) + littleEndian16(0)
+                + littleEndian32(0) + littleEndian32(localHeaderOffset) + name;
+    }
+    quint32 directoryOffset = (quint32) zip.size();
+    zip += directory;
+    zip += littleEndian32(0x06054b50) + littleEndian16(0) + littleEndian16(0)
+            + littleEndian16((quint16) members.size()) + littleEndian16((quint16) members.size())
+            + littleEndian32((quint32) directory.size()) + littleEndian32(directoryOffset)
+            + littleEndian16(0);
+    QFile file(path);
+    return file.open(QFile::WriteOnly) && file.write(zip) == zip.size();
+}
+
+static void expectMembers(ArchiveImageSource &archive, const ArchiveMembers &members) {
+    ASSERT_TRUE(archive.isValid());
+    QStringList files;
+    for (const auto &member : members) {
+        files << QString::fromUtf8(member.first);
+    }
+    // Folders are not members
+    EXPECT_EQ(archive.getFiles(), files);
+    for (const auto &member : members) {
+        EXPECT_EQ(archive.readFile(QString::fromUtf8(member.first)), member.second)
+                << member.first.constData();
+    }
+    EXPECT_TRUE(archive.readFile("rgb/missing.png").isNull());
+}
+
+TEST(ArchiveTests, TarMembers)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("shard_00.tar");
+    ASSERT_TRUE(writeTar(path, archiveMembers()));
+    ArchiveImageSource archive(path, QString());
+    expectMembers(archive, archiveMembers());
+}
+
+TEST(ArchiveTests, StoredZipMembers)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("shard_00.zip");
+    ASSERT_TRUE(writeZip(path, archiveMembers(), false));
+    ArchiveImageSource archive(path, QString());
+    expectMembers(archive, archiveMembers());
+}
+
+TEST(ArchiveTests, DeflatedZipMembers)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("shard_00.zip");
+    ASSERT_TRUE(writeZip(path, archiveMembers(), true));
+    ArchiveImageSource archive(path, QString());
+    expectMembers(archive, archiveMembers());
+}
+
+TEST(ArchiveTests, IndexIsReused)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("shard_00.zip");
+    QString indexCachePath = directory.filePath("indices");
+    ASSERT_TRUE(writeZip(path, archiveMembers(), true));
+    {
+        ArchiveImageSource archive(path, indexCachePath);
+        expectMembers(archive, archiveMembers());
+    }
+    // Read from the stored index, whose data offsets of zip members are not resolved yet
+    ArchiveImageSource archive(path, indexCachePath);
+    expectMembers(archive, archiveMembers());
+}
+
+TEST(ArchiveTests, NotAnArchive)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("broken.tar");
+    QFile file(path);
+    ASSERT_TRUE(file.open(QFile::WriteOnly));
+    file.write(QByteArray(2048, 'x'));
+    file.close();
+    ArchiveImageSource archive(path, QString());
+    EXPECT_FALSE(archive.isValid());
+}
@@ -0,0 +1,95 @@
+#include "misc/directoryindexer.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+using namespace testing;
+
+static bool writeFile(const QString &path, const QByteArray &content) {
+    QFile file(path);
+    return file.open(QFile::WriteOnly | QFile::Truncate) && file.write(content) == content.size();
+}
+
+static QStringList indexedPaths(const QList<IndexedFile> &files) {
+    QStringList paths;
+    for (const IndexedFile &file : files) {
+        paths << file.path;
+    }
+    return paths;
+}
+
+TEST(DirectoryIndexerTests, NaturalOrder)
+{
+    QStringList strings = {"image_10.png", "image_2.png", "image_1.png", "image_100.png"};
+    QVector<int> order = DirectoryIndexer::naturalOrder(strings);
+    EXPECT_EQ(order, QVector<int>({2, 1, 0, 3}));
+    EXPECT_TRUE(DirectoryIndexer::naturalOrder(QStringList()).isEmpty());
+}
+
+TEST(DirectoryIndexerTests, IndexesSubfoldersWithFilters)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QDir root(directory.path());
+    ASSERT_TRUE(root.mkpath("scene_2") && root.mkpath("scene_10/depth"));
+    ASSERT_TRUE(writeFile(root.filePath("10.png"), "a"));
+    ASSERT_TRUE(writeFile(root.filePath("9.png"), "b"));
+    ASSERT_TRUE(writeFile(root.filePath("info.json"), "{}"));
+    ASSERT_TRUE(writeFile(root.filePath("scene_2/1.png"), "c"));
+    ASSERT_TRUE(writeFile(root.filePath("scene_10/1.png"), "d"));
+    ASSERT_TRUE(writeFile(root.filePath("scene_10/depth/1.png"), "e"));
+
+    DirectoryIndexer indexer(QString());
+    EXPECT_EQ(indexedPaths(indexer.index(directory.path(), {"*.png"})),
+              QStringList({"9.png", "10.png"}));
+    EXPECT_EQ(indexedPaths(indexer.index(directory.path())),
+              QStringList({"9.png", "10.png", "info.json"}));
+    EXPECT_EQ(indexedPaths(indexer.index(directory.path(), {"*.png"}, true)),
+              QStringList({"9.png", "10.png", "scene_2/1.png", "scene_10/1.png",
+                           "scene_10/depth/1.png"}));
+    EXPECT_TRUE(indexer.index(root.filePath("missing")).isEmpty());
+}
+
+TEST(DirectoryIndexerTests, DoesNotFollowLinksToFolders)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QDir root(directory.path());
+    ASSERT_TRUE(root.mkpath("scene"));
+    ASSERT_TRUE(writeFile(root.filePath("scene/1.png"), "a"));
+    // A cycle, following it would never end
+    ASSERT_TRUE(QFile::link(directory.path(), root.filePath("scene/loop")));
+
+    DirectoryIndexer indexer(QString());
+    EXPECT_EQ(indexedPaths(indexer.index(directory.path(), QStringList(), true)),
+              QStringList({"scene/1.png"}));
+}
+
+TEST(DirectoryIndexerTests, ManifestIsReused)
+{
+    QTemporaryDir directory;
+    QTemporaryDir manifests;
+    ASSERT_TRUE(directory.isValid() && manifests.isValid());
+    QString path = QDir(directory.path()).filePath("1.png");
+    ASSERT_TRUE(writeFile(path, "abc"));
+
+    DirectoryIndexer indexer(manifests.path());
+    QList<IndexedFile> files = indexer.index(directory.path());
+    ASSERT_EQ(files.size(), 1);
+    EXPECT_EQ(files[0].size, 3);
+    EXPECT_EQ(QDir(manifests.path()).entryList(QDir::Files).size(), 1);
+
+    // Overwriting a file doesn't modify its folder, so the manifest is still used
+    ASSERT_TRUE(writeFile(path, "abcdef"));
+    files = DirectoryIndexer(manifests.path()).index(directory.path());
+    ASSERT_EQ(files.size(), 1);
+    EXPECT_EQ(files[0].size, 3);
+    // Other filters have their own manifest
+    files = indexer.index(directory.path(), {"*.png"});
+    ASSERT_EQ(files.size(), 1);
+    EXPECT_EQ(files[0].size, 6);
+}
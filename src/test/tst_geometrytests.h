@@ -0,0 +1,203 @@
+#include "misc/geometry/bvh.hpp"
+#include "misc/geometry/kdtree.hpp"
+#include "misc/geometry/mesh.hpp"
+#include "misc/geometry/pnpsolver.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QFile>
+#include <QQuaternion>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <cmath>
+#include <random>
+
+using namespace testing;
+
+static QVector3D rotate(const QMatrix3x3 &rotation, const QVector3D &point) {
+    return QVector3D(
+        rotation(0, 0) * point.x() + rotation(0, 1) * point.y() + rotation(0, 2) * point.z(),
+        rotation(1, 0) * point.x() + rotation(1, 1) * point.y() + rotation(1, 2) * point.z(),
+        rotation(2, 0) * point.x() + rotation(2, 1) * point.y() + rotation(2, 2) * point.z());
+}
+
+//! Writes the cube from 0 to 1 as OBJ file and loads it, every face is a quad
+static MeshPtr loadUnitCube(const QTemporaryDir &directory) {
+    QString path = directory.filePath("cube.obj");
+    QFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        return MeshPtr();
+    }
+    QTextStream stream(&file);
+    for (int corner = 0; corner < 8; corner++) {
+        stream << "v " << (corner & 1) << " " << ((corner >> 1) & 1) << " "
+               << ((corner >> 2) & 1) << "\n";
+    }
+    stream << "f 1 3 4 2\n"   // z = 0
+           << "f 5 6 8 7\n"   // z = 1
+           << "f 1 2 6 5\n"   // y = 0
+           << "f 3 7 8 4\n"   // y = 1
+           << "f 1 5 7 3\n"   // x = 0
+           << "f 2 4 8 6\n";  // x = 1
+    stream.flush();
+    file.close();
+    return Mesh::load(path);
+}
+
+TEST(GeometryTests, BvhOfUnitCube)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    MeshPtr mesh = loadUnitCube(directory);
+    ASSERT_FALSE(mesh.isNull());
+    Bvh bvh(*mesh);
+
+    EXPECT_EQ(bvh.getTriangleCount(), 12);
+    EXPECT_EQ(bvh.getMinimum(), QVector3D(0, 0, 0));
+    EXPECT_EQ(bvh.getMaximum(), QVector3D(1, 1, 1));
+
+    // Off the diagonals of the faces, so that the rays don't hit the edges of the triangles
+    EXPECT_TRUE(bvh.contains(QVector3D(0.3f, 0.6f, 0.45f)));
+    EXPECT_TRUE(bvh.contains(QVector3D(0.9f, 0.15f, 0.7f)));
+    EXPECT_FALSE(bvh.contains(QVector3D(1.3f, 0.6f, 0.45f)));
+    EXPECT_FALSE(bvh.contains(QVector3D(0.3f, -0.2f, 0.45f)));
+    EXPECT_FALSE(bvh.contains(QVector3D(-2.f, -2.f, -2.f)));
+
+    EXPECT_NEAR(bvh.distance(QVector3D(0.5f, 0.5f, 0.5f)), 0.5f, 1e-5f);
+    EXPECT_NEAR(bvh.distance(QVector3D(0.3f, 0.6f, 0.9f)), 0.1f, 1e-5f);
+    EXPECT_NEAR(bvh.distance(QVector3D(2.f, 0.5f, 0.5f)), 1.f, 1e-5f);
+    EXPECT_NEAR(bvh.distance(QVector3D(2.f, 2.f, 0.5f)), std::sqrt(2.f), 1e-5f);
+    EXPECT_NEAR(bvh.distance(QVector3D(2.f, 2.f, 2.f)), std::sqrt(3.f), 1e-5f);
+}
+
+TEST(GeometryTests, BvhCrossings)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    MeshPtr mesh = loadUnitCube(directory);
+    ASSERT_FALSE(mesh.isNull());
+    Bvh bvh(*mesh);
+
+    // Through the faces at x = 0 and x = 1, off their diagonals
+    QVector<float> crossings = bvh.crossings(QVector3D(-0.5f, 0.3f, 0.45f),
+                                             QVector3D(1.5f, 0.3f, 0.45f));
+    ASSERT_EQ(crossings.size(), 2);
+    EXPECT_NEAR(crossings[0], 0.25f, 1e-5f);
+    EXPECT_NEAR(crossings[1], 0.75f, 1e-5f);
+    // The other way round
+    crossings = bvh.crossings(QVector3D(1.5f, 0.3f, 0.45f), QVector3D(0.5f, 0.3f, 0.45f));
+    ASSERT_EQ(crossings.size(), 1);
+    EXPECT_NEAR(crossings[0], 0.5f, 1e-5f);
+    // Inside, ending before the cube and along an axis, i.e. with zero components
+    EXPECT_TRUE(bvh.crossings(QVector3D(0.2f, 0.3f, 0.45f),
+                              QVector3D(0.8f, 0.7f, 0.45f)).isEmpty());
+    EXPECT_TRUE(bvh.crossings(QVector3D(-0.5f, 0.3f, 0.45f),
+                              QVector3D(-0.1f, 0.3f, 0.45f)).isEmpty());
+}
+
+TEST(GeometryTests, EmptyBvh)
+{
+    Bvh bvh;
+    EXPECT_EQ(bvh.getTriangleCount(), 0);
+    EXPECT_FALSE(bvh.contains(QVector3D(0, 0, 0)));
+    EXPECT_TRUE(std::isinf(bvh.distance(QVector3D(0, 0, 0))));
+    EXPECT_TRUE(bvh.crossings(QVector3D(0, 0, 0), QVector3D(1, 1, 1)).isEmpty());
+}
+
+TEST(GeometryTests, KdTreeFindsNearestPoint)
+{
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> coordinate(-100.f, 100.f);
+    QVector<QVector3D> points;
+    for (int i = 0; i < 1000; i++) {
+        points << QVector3D(coordinate(random), coordinate(random), coordinate(random));
+    }
+    KdTree tree(points);
+    EXPECT_EQ(tree.size(), points.size());
+
+    for (int query = 0; query < 200; query++) {
+        QVector3D point(coordinate(random), coordinate(random), coordinate(random));
+        int expected = 0;
+        for (int i = 1; i < points.size(); i++) {
+            if ((points[i] - point).lengthSquared()
+                    < (points[expected] - point).lengthSquared()) {
+                expected = i;
+            }
+        }
+        float squaredDistance = -1.f;
+        int nearest = tree.nearest(point, &squaredDistance);
+        ASSERT_EQ(nearest, expected);
+        EXPECT_FLOAT_EQ(squaredDistance, (points[expected] - point).lengthSquared());
+    }
+
+    // The points themselves are their own nearest points
+    EXPECT_EQ(tree.nearest(points[17]), 17);
+}
+
+TEST(GeometryTests, EmptyKdTree)
+{
+    KdTree tree;
+    EXPECT_EQ(tree.size(), 0);
+    EXPECT_EQ(tree.nearest(QVector3D(1, 2, 3)), -1);
+}
+
+TEST(GeometryTests, PnPWithOutliers)
+{
+    QMatrix3x3 cameraMatrix;
+    cameraMatrix(0, 0) = 500.f;
+    cameraMatrix(0, 2) = 320.f;
+    cameraMatrix(1, 1) = 500.f;
+    cameraMatrix(1, 2) = 240.f;
+    QMatrix3x3 rotation = QQuaternion::fromAxisAndAngle(QVector3D(1, 2, 3).normalized(), 30.f)
+            .toRotationMatrix();
+    QVector3D translation(10.f, -20.f, 600.f);
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> coordinate(-50.f, 50.f);
+    const int correspondences = 25;
+    const int outliers = 5;
+    QList<QVector3D> objectPoints;
+    QList<QPointF> imagePoints;
+    for (int i = 0; i < correspondences; i++) {
+        QVector3D objectPoint(coordinate(random), coordinate(random), coordinate(random));
+        QVector3D cameraPoint = rotate(rotation, objectPoint) + translation;
+        QPointF imagePoint(cameraMatrix(0, 0) * cameraPoint.x() / cameraPoint.z()
+                           + cameraMatrix(0, 2),
+                           cameraMatrix(1, 1) * cameraPoint.y() / cameraPoint.z()
+                           + cameraMatrix(1, 2));
+        // The first correspondences are wrong by far more than the inlier threshold
+        if (i < outliers) {
+            imagePoint += QPointF(60.f + 10.f * i, -80.f);
+        }
+        objectPoints << objectPoint;
+        imagePoints << imagePoint;
+    }
+
+    PnPSolver solver;
+    PnPSolution solution = solver.solve(objectPoints, imagePoints, cameraMatrix);
+    ASSERT_TRUE(solution.valid);
+    EXPECT_EQ(solution.numberOfInliers, correspondences - outliers);
+    for (int i = 0; i < correspondences; i++) {
+        EXPECT_EQ(solution.inliers[i], i >= outliers) << "correspondence " << i;
+    }
+    EXPECT_LT(solution.inlierError, 0.01f);
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            EXPECT_NEAR(solution.rotation(row, column), rotation(row, column), 1e-3f);
+        }
+        EXPECT_NEAR(solution.translation[row], translation[row], 0.1f);
+    }
+}
+
+TEST(GeometryTests, PnPNeedsMinimalSample)
+{
+    QMatrix3x3 cameraMatrix;
+    PnPSolver solver;
+    PnPSolution solution = solver.solve({QVector3D(0, 0, 0), QVector3D(1, 0, 0),
+                                         QVector3D(0, 1, 0)},
+                                        {QPointF(0, 0), QPointF(1, 0), QPointF(0, 1)},
+                                        cameraMatrix);
+    EXPECT_FALSE(solution.valid);
+}
@@ -0,0 +1,160 @@
+#include "model/jsonloadandstorestrategy.hpp"
+#include "model/image.hpp"
+#include "model/objectmodel.hpp"
+#include "model/pose.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+using namespace testing;
+
+//! The folders and the poses file that the strategy needs
+struct PosesFolder {
+    QTemporaryDir directory;
+    QString imagesPath;
+    QString objectModelsPath;
+    QString posesFilePath;
+
+    PosesFolder() {
+        QDir(directory.path()).mkpath("images");
+        QDir(directory.path()).mkpath("models");
+        imagesPath = directory.filePath("images");
+        objectModelsPath = directory.filePath("models");
+        posesFilePath = directory.filePath("poses.json");
+        writePosesFile("{}");
+    }
+
+    bool writePosesFile(const QByteArray &content) const {
+        QFile file(posesFilePath);
+        return file.open(QFile::WriteOnly | QFile::Truncate) && file.write(content) == content.size();
+    }
+
+    QByteArray readPosesFile() const {
+        QFile file(posesFilePath);
+        return file.open(QFile::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+    QJsonObject posesFileObject() const {
+        return QJsonDocument::fromJson(readPosesFile()).object();
+    }
+};
+
+static QStringList idsOfImage(const QJsonObject &posesFile, const QString &imagePath) {
+    QStringList ids;
+    for (const QJsonValue &entry : posesFile[imagePath].toArray()) {
+        ids << entry.toObject()["id"].toString();
+    }
+    return ids;
+}
+
+TEST(JsonLoadAndStoreStrategyTests, BatchesAreWrittenOnFlush)
+{
+    PosesFolder folder;
+    ASSERT_TRUE(folder.directory.isValid());
+    JsonLoadAndStoreStrategy strategy(folder.imagesPath, folder.objectModelsPath,
+                                      folder.posesFilePath);
+    Image image("0001.png", folder.imagesPath, QMatrix3x3());
+    ObjectModel objectModel("cup.ply", folder.objectModelsPath);
+
+    ASSERT_TRUE(strategy.persistPoses({Pose("first", QVector3D(1, 2, 3), QMatrix3x3(),
+                                            &image, &objectModel)}, false));
+    ASSERT_TRUE(strategy.persistPoses({Pose("second", QVector3D(4, 5, 6), QMatrix3x3(),
+                                            &image, &objectModel)}, false));
+    // Deferred until the next flush
+    EXPECT_EQ(folder.readPosesFile(), QByteArray("{}"));
+
+    ASSERT_TRUE(strategy.flushPoses());
+    EXPECT_EQ(idsOfImage(folder.posesFileObject(), "0001.png"),
+              QStringList({"first", "second"}));
+
+    QList<Pose> poses = strategy.loadPoses({image}, {objectModel});
+    ASSERT_EQ(poses.size(), 2);
+    EXPECT_EQ(poses[1].getPosition(), QVector3D(4, 5, 6));
+
+    // Updating and deleting poses in a batch
+    ASSERT_TRUE(strategy.persistPoses({Pose("first", QVector3D(7, 8, 9), QMatrix3x3(),
+                                            &image, &objectModel)}, false));
+    ASSERT_TRUE(strategy.persistPoses({Pose("second", QVector3D(), QMatrix3x3(),
+                                            &image, &objectModel)}, true));
+    ASSERT_TRUE(strategy.flushPoses());
+    QJsonArray entries = folder.posesFileObject()["0001.png"].toArray();
+    ASSERT_EQ(entries.size(), 1);
+    EXPECT_EQ(entries[0].toObject()["id"].toString(), QString("first"));
+    EXPECT_EQ(entries[0].toObject()["t"].toArray()[2].toDouble(), 9.0);
+}
+
+TEST(JsonLoadAndStoreStrategyTests, FlushKeepsChangesOfTheFileInTheMeantime)
+{
+    PosesFolder folder;
+    ASSERT_TRUE(folder.directory.isValid());
+    JsonLoadAndStoreStrategy strategy(folder.imagesPath, folder.objectModelsPath,
+                                      folder.posesFilePath);
+    Image image("0001.png", folder.imagesPath, QMatrix3x3());
+    ObjectModel objectModel("cup.ply", folder.objectModelsPath);
+
+    ASSERT_TRUE(strategy.persistPoses({Pose("new", QVector3D(), QMatrix3x3(),
+                                            &image, &objectModel)}, false));
+    // E.g. a pose that was edited and written right away by another tool
+    ASSERT_TRUE(folder.writePosesFile(
+                    R"({"0002.png": [{"id": "external", "obj": "cup.ply", )"
+                    R"("R": [1, 0, 0, 0, 1, 0, 0, 0, 1], "t": [0, 0, 0]}]})"));
+    ASSERT_TRUE(strategy.flushPoses());
+
+    QJsonObject posesFile = folder.posesFileObject();
+    EXPECT_EQ(idsOfImage(posesFile, "0001.png"), QStringList({"new"}));
+    EXPECT_EQ(idsOfImage(posesFile, "0002.png"), QStringList({"external"}));
+}
+
+TEST(JsonLoadAndStoreStrategyTests, FailedFlushKeepsThePendingPoses)
+{
+    PosesFolder folder;
+    ASSERT_TRUE(folder.directory.isValid());
+    JsonLoadAndStoreStrategy strategy(folder.imagesPath, folder.objectModelsPath,
+                                      folder.posesFilePath);
+    int failures = 0;
+    QObject::connect(&strategy, &LoadAndStoreStrategy::failedToFlushPoses,
+                     [&failures](const QString &) { failures++; });
+    Image image("0001.png", folder.imagesPath, QMatrix3x3());
+    ObjectModel objectModel("cup.ply", folder.objectModelsPath);
+
+    ASSERT_TRUE(strategy.persistPoses({Pose("pending", QVector3D(), QMatrix3x3(),
+                                            &image, &objectModel)}, false));
+    // A broken file must neither be replaced nor drop the pending poses
+    ASSERT_TRUE(folder.writePosesFile("{\"0002.png\": ["));
+    EXPECT_FALSE(strategy.flushPoses());
+    EXPECT_EQ(failures, 1);
+    EXPECT_EQ(folder.readPosesFile(), QByteArray("{\"0002.png\": ["));
+
+    ASSERT_TRUE(folder.writePosesFile("{}"));
+    EXPECT_TRUE(strategy.flushPoses());
+    EXPECT_EQ(failures, 1);
+    EXPECT_EQ(idsOfImage(folder.posesFileObject(), "0001.png"), QStringList({"pending"}));
+}
+
+TEST(JsonLoadAndStoreStrategyTests, FailedPersistPoseIsNotWrittenLater)
+{
+    PosesFolder folder;
+    ASSERT_TRUE(folder.directory.isValid());
+    JsonLoadAndStoreStrategy strategy(folder.imagesPath, folder.objectModelsPath,
+                                      folder.posesFilePath);
+    Image image("0001.png", folder.imagesPath, QMatrix3x3());
+    ObjectModel objectModel("cup.ply", folder.objectModelsPath);
+
+    ASSERT_TRUE(strategy.persistPoses({Pose("batch", QVector3D(), QMatrix3x3(),
+                                            &image, &objectModel)}, false));
+    ASSERT_TRUE(folder.writePosesFile("not json"));
+    Pose single("single", QVector3D(), QMatrix3x3(), &image, &objectModel);
+    EXPECT_FALSE(strategy.persistPose(&single, false));
+
+    // The caller did not apply the single pose, but the batch is still pending
+    ASSERT_TRUE(folder.writePosesFile("{}"));
+    EXPECT_TRUE(strategy.flushPoses());
+    EXPECT_EQ(idsOfImage(folder.posesFileObject(), "0001.png"), QStringList({"batch"}));
+}
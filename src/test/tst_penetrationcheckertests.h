@@ -0,0 +1,121 @@
+#include "testscene.h"
+#include "misc/evaluation/penetrationchecker.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QFile>
+#include <QQuaternion>
+#include <QTemporaryDir>
+
+#include <cmath>
+
+using namespace testing;
+
+//! Cubes with edge lengths of 100 and 200 in two images
+class PenetratingCubes
+{
+public:
+    PenetratingCubes() :
+        firstImage("0000.png", directory.path(), testCameraMatrix()),
+        secondImage("0001.png", directory.path(), testCameraMatrix()),
+        cube("cube.obj", directory.path()),
+        largeCube("large.obj", directory.path()) {
+        valid = directory.isValid()
+                && writeCubeModel(directory.filePath("cube.obj"), 100.f)
+                && writeCubeModel(directory.filePath("large.obj"), 200.f);
+    }
+
+    //! The cubes stick into each other with a corner each
+    QList<Pose> cornerPoses() const {
+        return {Pose("first", QVector3D(0.f, 0.f, 600.f), QMatrix3x3(), &firstImage, &cube),
+                Pose("second", QVector3D(70.f, 20.f, 630.f), QMatrix3x3(), &firstImage,
+                     &cube)};
+    }
+
+    /*!
+     * \brief edgePoses returns the cube and the large cube turned by 45 degrees, whose lower
+     * edge cuts through the cube 10 below its top. No vertex of either is inside the other.
+     */
+    QList<Pose> edgePoses() const {
+        QMatrix3x3 rotation = QQuaternion::fromAxisAndAngle(QVector3D(1, 0, 0), 45.f)
+                .toRotationMatrix();
+        float height = 100.f * std::sqrt(2.f);
+        return {Pose("cube", QVector3D(0.f, 0.f, 600.f), QMatrix3x3(), &secondImage, &cube),
+                Pose("large", QVector3D(0.f, 0.f, 640.f + height), rotation, &secondImage,
+                     &largeCube)};
+    }
+
+    QTemporaryDir directory;
+    Image firstImage;
+    Image secondImage;
+    ObjectModel cube;
+    ObjectModel largeCube;
+    bool valid;
+};
+
+TEST(PenetrationCheckerTests, VerticesInsideEachOther)
+{
+    PenetratingCubes cubes;
+    ASSERT_TRUE(cubes.valid);
+
+    QList<Penetration> penetrations = PenetrationChecker(1).check(cubes.cornerPoses());
+    ASSERT_EQ(penetrations.size(), 1);
+    const Penetration &penetration = penetrations.first();
+    EXPECT_EQ(penetration.imagePath, "0000.png");
+    EXPECT_EQ(penetration.poseId1, "first");
+    EXPECT_EQ(penetration.poseId2, "second");
+    EXPECT_EQ(penetration.objectModelPath2, "cube.obj");
+    // A corner of each cube, 20 below the closest face of the other cube
+    EXPECT_EQ(penetration.penetratingVertices, 2);
+    EXPECT_GT(penetration.crossingEdges, 0);
+    EXPECT_GE(penetration.depth, 20.f - 1e-3f);
+}
+
+TEST(PenetrationCheckerTests, EdgesCrossingEachOther)
+{
+    PenetratingCubes cubes;
+    ASSERT_TRUE(cubes.valid);
+
+    QList<Penetration> penetrations = PenetrationChecker(1).check(cubes.edgePoses());
+    ASSERT_EQ(penetrations.size(), 1);
+    const Penetration &penetration = penetrations.first();
+    EXPECT_EQ(penetration.poseId1, "cube");
+    EXPECT_EQ(penetration.poseId2, "large");
+    EXPECT_EQ(penetration.penetratingVertices, 0);
+    EXPECT_GT(penetration.crossingEdges, 0);
+    // The middle of the lower edge of the large cube
+    EXPECT_NEAR(penetration.depth, 10.f, 1e-2f);
+}
+
+TEST(PenetrationCheckerTests, DeepestFirstAndMinDepth)
+{
+    PenetratingCubes cubes;
+    ASSERT_TRUE(cubes.valid);
+    // The last cube is apart from the others
+    QList<Pose> poses = cubes.edgePoses() + cubes.cornerPoses()
+            << Pose("apart", QVector3D(300.f, 0.f, 600.f), QMatrix3x3(), &cubes.firstImage,
+                    &cubes.cube);
+
+    PenetrationChecker checker(2);
+    QList<Penetration> penetrations = checker.check(poses);
+    ASSERT_EQ(penetrations.size(), 2);
+    EXPECT_EQ(penetrations[0].imagePath, "0000.png");
+    EXPECT_EQ(penetrations[1].imagePath, "0001.png");
+    EXPECT_GT(penetrations[0].depth, penetrations[1].depth);
+
+    QString path = cubes.directory.filePath("penetrations.csv");
+    ASSERT_TRUE(PenetrationChecker::writeCsv(path, penetrations));
+    QFile file(path);
+    ASSERT_TRUE(file.open(QFile::ReadOnly | QFile::Text));
+    QStringList lines = QString::fromUtf8(file.readAll()).trimmed().split('\n');
+    ASSERT_EQ(lines.size(), 3);
+    EXPECT_EQ(lines[0], "image,pose_id_1,object_model_1,pose_id_2,object_model_2,depth,"
+                        "penetrating_vertices,crossing_edges");
+    EXPECT_TRUE(lines[2].startsWith("0001.png,cube,cube.obj,large,large.obj,"));
+
+    checker.setMinDepth(15.f);
+    penetrations = checker.check(poses);
+    ASSERT_EQ(penetrations.size(), 1);
+    EXPECT_EQ(penetrations[0].imagePath, "0000.png");
+}
@@ -0,0 +1,120 @@
+#include "controller/poseinterpolator.hpp"
+#include "model/image.hpp"
+#include "model/objectmodel.hpp"
+#include "model/pose.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QQuaternion>
+
+using namespace testing;
+
+static QList<Image> sequenceImages(const QList<int> &frameNumbers) {
+    QList<Image> images;
+    for (int frameNumber : frameNumbers) {
+        images << Image(QString("frame_%1.png").arg(frameNumber, 6, 10, QChar('0')),
+                        "/data/sequence", QMatrix3x3());
+    }
+    return images;
+}
+
+static QMatrix3x3 rotationAboutZ(float angle) {
+    return QQuaternion::fromAxisAndAngle(QVector3D(0, 0, 1), angle).toRotationMatrix();
+}
+
+static void expectRotation(const QMatrix3x3 &actual, const QMatrix3x3 &expected) {
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            EXPECT_NEAR(actual(row, column), expected(row, column), 1e-5f)
+                    << "at " << row << ", " << column;
+        }
+    }
+}
+
+static void expectPosition(const QVector3D &actual, const QVector3D &expected) {
+    for (int axis = 0; axis < 3; axis++) {
+        EXPECT_NEAR(actual[axis], expected[axis], 1e-4f) << "axis " << axis;
+    }
+}
+
+TEST(PoseInterpolatorTests, SlerpBetweenTwoKeyframes)
+{
+    QList<Image> images = sequenceImages({0, 1, 2, 3, 4});
+    ObjectModel objectModel("cup.ply", "/data/models");
+    QVector3D endPosition(4.f, 8.f, -4.f);
+    QList<Pose> keyframes;
+    keyframes << Pose("start", QVector3D(), rotationAboutZ(0.f), &images[0], &objectModel)
+              << Pose("end", endPosition, rotationAboutZ(90.f), &images[4], &objectModel);
+
+    QList<Pose> poses = PoseInterpolator().interpolate(images, keyframes);
+    // The keyframes themselves are not interpolated
+    ASSERT_EQ(poses.size(), 3);
+    for (int i = 0; i < poses.size(); i++) {
+        const Pose &pose = poses[i];
+        EXPECT_EQ(pose.getImage(), &images[i + 1]);
+        EXPECT_EQ(pose.getObjectModel(), &objectModel);
+        EXPECT_TRUE(pose.getID().isEmpty());
+        // Two keyframes have one-sided tangents, the translation is linear
+        expectPosition(pose.getPosition(), endPosition * (i + 1) / 4.f);
+        expectRotation(pose.getRotation(), rotationAboutZ(22.5f * (i + 1)));
+    }
+    // The midpoint of the slerp is half the angle
+    expectRotation(poses[1].getRotation(), rotationAboutZ(45.f));
+}
+
+TEST(PoseInterpolatorTests, TimesFromFileNumbers)
+{
+    // Frames 12 and 19 are 0.2 and 0.9 of the way from frame 10 to frame 20
+    QList<Image> images = sequenceImages({10, 12, 19, 20});
+    ObjectModel objectModel("cup.ply", "/data/models");
+    QList<Pose> keyframes;
+    keyframes << Pose("start", QVector3D(0.f, 0.f, 10.f), rotationAboutZ(0.f), &images[0],
+                      &objectModel)
+              << Pose("end", QVector3D(10.f, 0.f, 10.f), rotationAboutZ(60.f), &images[3],
+                      &objectModel);
+
+    PoseInterpolator interpolator;
+    QList<Pose> poses = interpolator.interpolate(images, keyframes);
+    ASSERT_EQ(poses.size(), 2);
+    expectPosition(poses[0].getPosition(), QVector3D(2.f, 0.f, 10.f));
+    expectRotation(poses[0].getRotation(), rotationAboutZ(12.f));
+    expectPosition(poses[1].getPosition(), QVector3D(9.f, 0.f, 10.f));
+    expectRotation(poses[1].getRotation(), rotationAboutZ(54.f));
+
+    // By index the images are evenly spaced
+    interpolator.setUseFileNumbers(false);
+    poses = interpolator.interpolate(images, keyframes);
+    ASSERT_EQ(poses.size(), 2);
+    expectPosition(poses[0].getPosition(), QVector3D(10.f / 3.f, 0.f, 10.f));
+    expectRotation(poses[1].getRotation(), rotationAboutZ(40.f));
+}
+
+TEST(PoseInterpolatorTests, SkipsGapsAndAmbiguousKeyframes)
+{
+    QList<Image> images = sequenceImages({0, 1, 2, 3, 4});
+    ObjectModel objectModel("cup.ply", "/data/models");
+    QList<Pose> keyframes;
+    keyframes << Pose("start", QVector3D(), rotationAboutZ(0.f), &images[0], &objectModel)
+              << Pose("end", QVector3D(4.f, 0.f, 0.f), rotationAboutZ(0.f), &images[4],
+                      &objectModel);
+
+    PoseInterpolator interpolator;
+    interpolator.setMaxGap(2);
+    EXPECT_TRUE(interpolator.interpolate(images, keyframes).isEmpty());
+    interpolator.setMaxGap(3);
+    EXPECT_EQ(interpolator.interpolate(images, keyframes).size(), 3);
+
+    // With two instances in an image it is unclear which one continues the track
+    keyframes << Pose("second", QVector3D(1.f, 1.f, 1.f), rotationAboutZ(0.f), &images[4],
+                      &objectModel);
+    EXPECT_TRUE(interpolator.interpolate(images, keyframes).isEmpty());
+    EXPECT_TRUE(interpolator.interpolate(images, keyframes, {"other.ply"}).isEmpty());
+}
+
+TEST(PoseInterpolatorTests, FileNumber)
+{
+    EXPECT_EQ(PoseInterpolator::fileNumber("/data/video_000123.png"), 123);
+    EXPECT_EQ(PoseInterpolator::fileNumber("1618033988.jpg"), 1618033988);
+    EXPECT_EQ(PoseInterpolator::fileNumber("image.png"), -1);
+}
@@ -0,0 +1,105 @@
+#include "testscene.h"
+#include "controller/posepropagator.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QImage>
+#include <QQuaternion>
+#include <QTemporaryDir>
+
+using namespace testing;
+
+//! The cube moves by about three pixels from image to image
+static QVector3D sequencePosition(int index) {
+    return QVector3D(-20.f + 4.f * index, 2.f * index, 600.f);
+}
+
+static QMatrix3x3 sequenceRotation() {
+    return QQuaternion::fromAxisAndAngle(QVector3D(1, 1, 0).normalized(), 25.f)
+            .toRotationMatrix();
+}
+
+//! Renders the moving cube into images 0000.png to 0004.png, emptyImage shows no cube
+static QList<Image> writeSequence(const QTemporaryDir &directory, int emptyImage = -1) {
+    QList<Image> images;
+    MeshPtr mesh = Mesh::load(directory.filePath("cube.obj"));
+    for (int i = 0; i < 5; i++) {
+        QString fileName = QString("%1.png").arg(i, 4, 10, QChar('0'));
+        QList<RasterInstance> instances;
+        if (i != emptyImage) {
+            instances << RasterInstance {mesh, sequenceRotation(), sequencePosition(i)};
+        }
+        if (!writeRenderedImage(directory.filePath(fileName), instances,
+                                {qRgb(255, 255, 255)})) {
+            return QList<Image>();
+        }
+        images << Image(fileName, directory.path(), testCameraMatrix());
+    }
+    return images;
+}
+
+//! Runs the propagation in this thread and returns the propagated poses by image index
+static QMap<int, PropagatedPose> runPropagation(PosePropagationRunnable &runnable,
+                                                int *trackedFrames) {
+    QMap<int, PropagatedPose> propagatedPoses;
+    QObject::connect(&runnable, &PosePropagationRunnable::finished,
+                     [&](QList<PropagatedPose> poses, int frames, double) {
+        for (const PropagatedPose &pose : poses) {
+            propagatedPoses[pose.imageIndex] = pose;
+        }
+        *trackedFrames = frames;
+    });
+    runnable.run();
+    return propagatedPoses;
+}
+
+TEST(PosePropagatorTests, TracksInBothDirections)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    ASSERT_TRUE(writeCubeModel(directory.filePath("cube.obj"), 100.f));
+    QList<Image> images = writeSequence(directory);
+    ASSERT_EQ(images.size(), 5);
+    ObjectModel objectModel("cube.obj", directory.path());
+
+    PoseRefiner refiner(2);
+    refiner.setPyramidLevels(2);
+    // Image 3 has been annotated already, tracking continues from its pose
+    QMap<int, QList<PropagatedPose>> existingPoses;
+    existingPoses[3] << PropagatedPose {3, sequencePosition(3), sequenceRotation(), 0.f};
+    PosePropagationRunnable runnable(&refiner, images, objectModel, 2, sequencePosition(2),
+                                     sequenceRotation(), 2, 4.f, existingPoses);
+    int trackedFrames = 0;
+    QMap<int, PropagatedPose> propagatedPoses = runPropagation(runnable, &trackedFrames);
+
+    EXPECT_EQ(trackedFrames, 4);
+    EXPECT_EQ(propagatedPoses.keys(), QList<int>({0, 1, 4}));
+    for (int index : propagatedPoses.keys()) {
+        EXPECT_LT((propagatedPoses[index].position - sequencePosition(index)).length(), 2.f)
+                << "image " << index;
+        EXPECT_LE(propagatedPoses[index].error, 4.f);
+    }
+}
+
+TEST(PosePropagatorTests, StopsWhereTheObjectIsLost)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    ASSERT_TRUE(writeCubeModel(directory.filePath("cube.obj"), 100.f));
+    QList<Image> images = writeSequence(directory, 2);
+    ASSERT_EQ(images.size(), 5);
+    ObjectModel objectModel("cube.obj", directory.path());
+
+    PoseRefiner refiner(2);
+    refiner.setPyramidLevels(2);
+    PosePropagationRunnable runnable(&refiner, images, objectModel, 0, sequencePosition(0),
+                                     sequenceRotation(), 4, 4.f,
+                                     QMap<int, QList<PropagatedPose>>());
+    int trackedFrames = 0;
+    QMap<int, PropagatedPose> propagatedPoses = runPropagation(runnable, &trackedFrames);
+
+    // Image 3 would align again, but the track was lost on image 2
+    EXPECT_EQ(propagatedPoses.keys(), QList<int>({1}));
+    EXPECT_EQ(trackedFrames, 2);
+}
@@ -0,0 +1,103 @@
+#include "testscene.h"
+#include "misc/evaluation/posequalityscorer.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QQuaternion>
+#include <QTemporaryDir>
+
+using namespace testing;
+
+TEST(PoseQualityScorerTests, ScoresAgainstTheSegmentation)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    // Two object models with different segmentation codes
+    ASSERT_TRUE(writeCubeModel(directory.filePath("cube.obj"), 100.f));
+    ASSERT_TRUE(writeCubeModel(directory.filePath("box.obj"), 100.f));
+    MeshPtr mesh = Mesh::load(directory.filePath("cube.obj"));
+    ASSERT_FALSE(mesh.isNull());
+    QMatrix3x3 rotation = QQuaternion::fromAxisAndAngle(QVector3D(1, 1, 0).normalized(), 25.f)
+            .toRotationMatrix();
+    QVector3D cubePosition(-80.f, 0.f, 600.f);
+    QVector3D boxPosition(80.f, 0.f, 600.f);
+    ASSERT_TRUE(writeRenderedImage(directory.filePath("0000.png"),
+                                   {RasterInstance {mesh, rotation, cubePosition},
+                                    RasterInstance {mesh, rotation, boxPosition}},
+                                   {qRgb(255, 0, 0), qRgb(0, 255, 0)}));
+
+    Image image("0000.png", directory.filePath("0000.png"), directory.path(),
+                testCameraMatrix());
+    ObjectModel cube("cube.obj", directory.path());
+    ObjectModel box("box.obj", directory.path());
+    // The box about 12 pixels off
+    Pose cubePose("cube", cubePosition, rotation, &image, &cube);
+    Pose boxPose("box", boxPosition + QVector3D(15.f, 0.f, 0.f), rotation, &image, &box);
+
+    PoseQualityScorer scorer(1);
+    scorer.setSegmentationCodes({{"cube.obj", "255.0.0"}, {"box.obj", "0.255.0"}});
+    QList<PoseQuality> qualities = scorer.score({cubePose, boxPose});
+    ASSERT_EQ(qualities.size(), 2);
+
+    const PoseQuality &cubeQuality = qualities[0];
+    EXPECT_EQ(cubeQuality.poseId, "cube");
+    ASSERT_TRUE(cubeQuality.valid);
+    EXPECT_FLOAT_EQ(cubeQuality.iou, 1.f);
+    EXPECT_FLOAT_EQ(cubeQuality.boundaryFScore, 1.f);
+    EXPECT_GT(cubeQuality.renderedPixels, 0);
+    EXPECT_EQ(cubeQuality.renderedPixels, cubeQuality.segmentedPixels);
+
+    const PoseQuality &boxQuality = qualities[1];
+    EXPECT_EQ(boxQuality.poseId, "box");
+    ASSERT_TRUE(boxQuality.valid);
+    EXPECT_GT(boxQuality.iou, 0.3f);
+    EXPECT_LT(boxQuality.iou, 0.9f);
+    EXPECT_LT(boxQuality.boundaryFScore, 0.5f);
+
+    QMap<QString, float> worstScores = PoseQualityScorer::worstScores(qualities);
+    EXPECT_EQ(worstScores.keys(), QStringList({"0000.png"}));
+    EXPECT_FLOAT_EQ(worstScores["0000.png"], boxQuality.iou);
+}
+
+TEST(PoseQualityScorerTests, NoSegmentationImage)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    ASSERT_TRUE(writeCubeModel(directory.filePath("cube.obj"), 100.f));
+    Image image("0000.png", directory.path(), testCameraMatrix());
+    ObjectModel cube("cube.obj", directory.path());
+    Pose pose("cube", QVector3D(0.f, 0.f, 600.f), QMatrix3x3(), &image, &cube);
+
+    QList<PoseQuality> qualities = PoseQualityScorer(1).score({pose});
+    ASSERT_EQ(qualities.size(), 1);
+    EXPECT_FALSE(qualities[0].valid);
+    EXPECT_TRUE(PoseQualityScorer::worstScores(qualities).isEmpty());
+}
+
+TEST(PosesSnapshotTests, OutlivesTheImagesAndObjectModels)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QList<Image> images {Image("0000.png", directory.path(), testCameraMatrix()),
+                         Image("0001.png", directory.path(), testCameraMatrix())};
+    QList<ObjectModel> objectModels {ObjectModel("cube.obj", directory.path())};
+    Image otherImage("0002.png", directory.path(), testCameraMatrix());
+    QList<Pose> poses {Pose("first", QVector3D(1, 2, 3), QMatrix3x3(), &images[1],
+                            &objectModels[0]),
+                       Pose("unknown", QVector3D(), QMatrix3x3(), &otherImage,
+                            &objectModels[0])};
+
+    PosesSnapshot snapshot(images, objectModels, poses);
+    // E.g. the model manager reloads
+    poses.clear();
+    images.clear();
+    objectModels.clear();
+
+    ASSERT_EQ(snapshot.getPoses().size(), 1);
+    const Pose &pose = snapshot.getPoses().first();
+    EXPECT_EQ(pose.getID(), "first");
+    EXPECT_EQ(pose.getPosition(), QVector3D(1, 2, 3));
+    EXPECT_EQ(pose.getImage()->getImagePath(), "0001.png");
+    EXPECT_EQ(pose.getObjectModel()->getPath(), "cube.obj");
+}
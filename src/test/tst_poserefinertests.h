@@ -0,0 +1,61 @@
+#include "testscene.h"
+#include "misc/geometry/poserefiner.hpp"
+#include "model/image.hpp"
+#include "model/objectmodel.hpp"
+#include "model/pose.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QDir>
+#include <QQuaternion>
+#include <QTemporaryDir>
+
+using namespace testing;
+
+TEST(PoseRefinerTests, AlignsShiftedPoseWithTheEdges)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    ASSERT_TRUE(writeCubeModel(directory.filePath("cube.obj"), 100.f));
+    MeshPtr mesh = Mesh::load(directory.filePath("cube.obj"));
+    ASSERT_FALSE(mesh.isNull());
+    QMatrix3x3 rotation = QQuaternion::fromAxisAndAngle(QVector3D(1, 1, 0).normalized(), 25.f)
+            .toRotationMatrix();
+    QVector3D position(0.f, 0.f, 600.f);
+    ASSERT_TRUE(writeRenderedImage(directory.filePath("0001.png"),
+                                   {RasterInstance {mesh, rotation, position}},
+                                   {qRgb(255, 255, 255)}));
+
+    Image image("0001.png", directory.path(), testCameraMatrix());
+    ObjectModel objectModel("cube.obj", directory.path());
+    // About 7 pixels off
+    QVector3D shiftedPosition = position + QVector3D(7.f, -5.f, 0.f);
+    Pose pose("cube", shiftedPosition, rotation, &image, &objectModel);
+
+    PoseRefiner refiner(2);
+    PoseRefinement refinement = refiner.refine(pose);
+    ASSERT_TRUE(refinement.valid);
+    EXPECT_GT(refinement.evaluations, 0);
+    EXPECT_LT(refinement.finalError, refinement.initialError);
+    EXPECT_LT((refinement.position - position).length(),
+              (shiftedPosition - position).length() / 2.f);
+}
+
+TEST(PoseRefinerTests, UnreadableImageKeepsThePose)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    ASSERT_TRUE(writeCubeModel(directory.filePath("cube.obj"), 100.f));
+    Image image("missing.png", directory.path(), testCameraMatrix());
+    ObjectModel objectModel("cube.obj", directory.path());
+    QVector3D position(1.f, 2.f, 600.f);
+    Pose pose("cube", position, QMatrix3x3(), &image, &objectModel);
+
+    QList<PoseRefinement> refinements = PoseRefiner(1).refine(QList<Pose>() << pose << pose);
+    ASSERT_EQ(refinements.size(), 2);
+    for (const PoseRefinement &refinement : refinements) {
+        EXPECT_FALSE(refinement.valid);
+        EXPECT_EQ(refinement.position, position);
+    }
+}
@@ -0,0 +1,86 @@
+#include "misc/imageloading/videoimagesource.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio/videoio.hpp>
+
+#include <QImage>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <random>
+
+using namespace testing;
+
+static const int VIDEO_FRAMES = 200;
+
+/*!
+ * \brief writeNumberedVideo writes a Motion JPEG video, which OpenCV can write and read
+ * without any other library. The left half of frame i shows i % 16 and the right half i / 16
+ * as gray levels 16 apart, far enough apart for the compression.
+ */
+static bool writeNumberedVideo(const QString &path) {
+    cv::VideoWriter writer(path.toStdString(), cv::VideoWriter::fourcc('M', 'J', 'P', 'G'),
+                           25, cv::Size(320, 240));
+    if (!writer.isOpened()) {
+        return false;
+    }
+    for (int i = 0; i < VIDEO_FRAMES; i++) {
+        cv::Mat frame(240, 320, CV_8UC3);
+        frame(cv::Rect(0, 0, 160, 240)).setTo(cv::Scalar::all(i % 16 * 16 + 8));
+        frame(cv::Rect(160, 0, 160, 240)).setTo(cv::Scalar::all(i / 16 * 16 + 8));
+        writer.write(frame);
+    }
+    return true;
+}
+
+//! Returns the number of the frame in the image
+static int frameNumber(const QImage &image) {
+    if (image.isNull()) {
+        return -1;
+    }
+    return qGray(image.pixel(80, 120)) / 16 + qGray(image.pixel(240, 120)) / 16 * 16;
+}
+
+TEST(VideoImageSourceTests, FrameFiles)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("sequence.avi");
+    ASSERT_TRUE(writeNumberedVideo(path));
+    VideoImageSource video(path);
+    ASSERT_TRUE(video.isValid());
+
+    QStringList files = video.getFiles();
+    ASSERT_EQ(files.size(), VIDEO_FRAMES);
+    EXPECT_EQ(files[17], QString("sequence_000017.png"));
+    EXPECT_EQ(video.frameIndex("sequence_000017.png"), 17);
+    EXPECT_EQ(video.frameIndex("sequence_000200.png"), -1);
+    EXPECT_EQ(video.frameIndex("other_000017.png"), -1);
+    EXPECT_EQ(video.readImageFileSize(files[0]), QSize(320, 240));
+}
+
+TEST(VideoImageSourceTests, SeeksToEveryFrame)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    QString path = directory.filePath("sequence.avi");
+    ASSERT_TRUE(writeNumberedVideo(path));
+    VideoImageSource video(path);
+    ASSERT_TRUE(video.isValid());
+
+    // Forward within MAX_DECODE_FORWARD, far forward, backwards and to the last frame
+    QList<int> frames = {0, 1, 30, 150, 5, 60, 61, 199, 100, 99};
+    std::mt19937 random(3);
+    std::uniform_int_distribution<int> frame(0, VIDEO_FRAMES - 1);
+    for (int i = 0; i < 40; i++) {
+        frames << frame(random);
+    }
+    for (int index : frames) {
+        QImage image = video.readImageFile(video.frameFileName(index), QSize());
+        EXPECT_EQ(frameNumber(image), index);
+    }
+    EXPECT_TRUE(video.readImageFile("sequence_000200.png", QSize()).isNull());
+}
@@ -0,0 +1,98 @@
+#include "testscene.h"
+#include "misc/evaluation/visibilitycomputer.hpp"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock-matchers.h>
+
+#include <QFile>
+#include <QQuaternion>
+#include <QTemporaryDir>
+
+using namespace testing;
+
+//! A cube in front of another one that it partly hides
+class OccludingCubes
+{
+public:
+    OccludingCubes() :
+        image("0000.png", directory.path(), testCameraMatrix()),
+        objectModel("cube.obj", directory.path()) {
+        // Only the size of the image is needed
+        valid = directory.isValid()
+                && writeCubeModel(directory.filePath("cube.obj"), 100.f)
+                && writeRenderedImage(directory.filePath("0000.png"), {}, {});
+    }
+
+    QList<Pose> poses(const QVector3D &backPosition = QVector3D(60.f, 0.f, 800.f)) const {
+        QMatrix3x3 rotation = QQuaternion::fromAxisAndAngle(QVector3D(0, 1, 0), 30.f)
+                .toRotationMatrix();
+        return {Pose("front", QVector3D(0.f, 0.f, 600.f), rotation, &image, &objectModel),
+                Pose("back", backPosition, rotation, &image, &objectModel)};
+    }
+
+    QTemporaryDir directory;
+    Image image;
+    ObjectModel objectModel;
+    bool valid;
+};
+
+TEST(VisibilityComputerTests, PartlyOccludedPose)
+{
+    OccludingCubes cubes;
+    ASSERT_TRUE(cubes.valid);
+
+    QList<PoseVisibility> visibilities = VisibilityComputer(1).compute(cubes.poses());
+    ASSERT_EQ(visibilities.size(), 2);
+
+    const PoseVisibility &front = visibilities[0];
+    EXPECT_EQ(front.poseId, "front");
+    ASSERT_TRUE(front.valid);
+    EXPECT_GT(front.amodalPixels, 0);
+    EXPECT_EQ(front.visiblePixels, front.amodalPixels);
+    EXPECT_FLOAT_EQ(front.visibleFraction, 1.f);
+    EXPECT_EQ(front.visibleBox, front.amodalBox);
+
+    const PoseVisibility &back = visibilities[1];
+    EXPECT_EQ(back.poseId, "back");
+    ASSERT_TRUE(back.valid);
+    EXPECT_GT(back.visiblePixels, 0);
+    EXPECT_LT(back.visiblePixels, back.amodalPixels);
+    EXPECT_FLOAT_EQ(back.visibleFraction, (float) back.visiblePixels / back.amodalPixels);
+    // Its right part sticks out behind the front cube
+    EXPECT_TRUE(back.amodalBox.contains(back.visibleBox));
+    EXPECT_EQ(back.visibleBox.right(), back.amodalBox.right());
+    EXPECT_GT(back.visibleBox.left(), back.amodalBox.left());
+}
+
+TEST(VisibilityComputerTests, UnchangedImagesAreCached)
+{
+    OccludingCubes cubes;
+    ASSERT_TRUE(cubes.valid);
+    QString cachePath = VisibilityComputer::cachePath(cubes.directory.filePath("poses.json"));
+    EXPECT_EQ(cachePath, cubes.directory.filePath("poses.visibility.json"));
+
+    VisibilityComputer computer(1);
+    int cachedImages = -1;
+    QList<PoseVisibility> computed = computer.compute(cubes.poses(), cachePath, &cachedImages);
+    EXPECT_EQ(cachedImages, 0);
+    ASSERT_TRUE(QFile::exists(cachePath));
+
+    QList<PoseVisibility> cached = computer.compute(cubes.poses(), cachePath, &cachedImages);
+    EXPECT_EQ(cachedImages, 1);
+    ASSERT_EQ(cached.size(), computed.size());
+    for (int i = 0; i < cached.size(); i++) {
+        EXPECT_EQ(cached[i].poseId, computed[i].poseId);
+        EXPECT_EQ(cached[i].visiblePixels, computed[i].visiblePixels);
+        EXPECT_EQ(cached[i].amodalPixels, computed[i].amodalPixels);
+        EXPECT_FLOAT_EQ(cached[i].visibleFraction, computed[i].visibleFraction);
+        EXPECT_EQ(cached[i].visibleBox, computed[i].visibleBox);
+        EXPECT_EQ(cached[i].amodalBox, computed[i].amodalBox);
+    }
+
+    // Moved out from behind the front cube
+    QList<PoseVisibility> moved = computer.compute(cubes.poses(QVector3D(180.f, 0.f, 800.f)),
+                                                   cachePath, &cachedImages);
+    EXPECT_EQ(cachedImages, 0);
+    ASSERT_EQ(moved.size(), 2);
+    EXPECT_FLOAT_EQ(moved[1].visibleFraction, 1.f);
+}